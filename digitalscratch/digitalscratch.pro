@@ -43,6 +43,7 @@ INCLUDEPATH += . include/player include/gui include
 HEADERS += include/app/application_const.h \
            include/app/application_logging.h \
            include/app/application_settings.h \
+           include/app/job_scheduler.h \
            include/audiodev/sound_card_control_rules.h \
            include/audiodev/jack_client_control_rules.h \
            include/audiodev/audio_io_control_rules.h \
@@ -52,21 +53,38 @@ HEADERS += include/app/application_const.h \
            include/gui/config_dialog.h \
            include/gui/gui.h \
            include/gui/waveform.h \
+           include/gui/waveform_zoom.h \
            include/player/deck_playback_process.h \
            include/player/playback_parameters.h \
            include/player/control_and_playback_process.h \
            include/control/dicer_control_process.h \
            include/tracks/data_persistence.h \
+           include/tracks/data_persistence_worker.h \
            include/tracks/audio_collection_model.h \
            include/tracks/audio_track_key_process.h \
            include/tracks/playlist.h \
            include/tracks/playlist_persistence.h \
+           include/tracks/directory_scanner.h \
+           include/tracks/collection_watcher.h \
+           include/tracks/audio_collection_store.h \
+           include/tracks/audio_collection_search_index.h \
            include/tracks/audio_file_decoding_process.h \
+           include/tracks/audio_file_analysis_process.h \
+           include/tracks/audio_stream_analyzer.h \
+           include/tracks/audio_file_decoding_segment.h \
+           include/tracks/audio_file_pcm_mapping.h \
            include/tracks/audio_track.h \
+           include/tracks/audio_track_peaks.h \
+           include/tracks/audio_track_band_process.h \
+           include/tracks/audio_track_bpm_process.h \
+           include/tracks/audio_track_loudness_process.h \
+           include/tracks/audio_track_prefetch_pool.h \
+           include/tracks/audio_sample_converter.h \
            include/utils.h \
            include/singleton.h
       
 SOURCES += src/app/application_settings.cpp \
+           src/app/job_scheduler.cpp \
            src/app/application_logging.cpp \
            src/audiodev/sound_card_control_rules.cpp \
            src/audiodev/jack_client_control_rules.cpp \
@@ -78,16 +96,31 @@ SOURCES += src/app/application_settings.cpp \
            src/gui/config_dialog.cpp \
            src/gui/gui.cpp \
            src/gui/waveform.cpp \
+           src/gui/waveform_zoom.cpp \
            src/player/deck_playback_process.cpp \
            src/player/playback_parameters.cpp \
            src/player/control_and_playback_process.cpp \
            src/tracks/audio_file_decoding_process.cpp \
+           src/tracks/audio_file_analysis_process.cpp \
+           src/tracks/audio_file_decoding_segment.cpp \
+           src/tracks/audio_file_pcm_mapping.cpp \
            src/tracks/audio_track.cpp \
+           src/tracks/audio_track_peaks.cpp \
+           src/tracks/audio_track_band_process.cpp \
+           src/tracks/audio_track_bpm_process.cpp \
+           src/tracks/audio_track_loudness_process.cpp \
+           src/tracks/audio_track_prefetch_pool.cpp \
+           src/tracks/audio_sample_converter.cpp \
            src/tracks/data_persistence.cpp \
+           src/tracks/data_persistence_worker.cpp \
            src/tracks/audio_collection_model.cpp \
            src/tracks/audio_track_key_process.cpp \
            src/tracks/playlist.cpp \
            src/tracks/playlist_persistence.cpp \
+           src/tracks/directory_scanner.cpp \
+           src/tracks/collection_watcher.cpp \
+           src/tracks/audio_collection_store.cpp \
+           src/tracks/audio_collection_search_index.cpp \
            src/utils.cpp \
            src/main.cpp
 
@@ -98,18 +131,42 @@ CONFIG(test) {
 
     HEADERS += test/audio_track_test.h \
                test/audio_file_decoding_process_test.h \
+               test/audio_sample_converter_test.h \
+               test/audio_track_peaks_test.h \
+               test/audio_track_prefetch_pool_test.h \
+               test/job_scheduler_test.h \
+               test/audio_track_bpm_process_test.h \
+               test/audio_track_key_process_test.h \
+               test/audio_track_loudness_process_test.h \
                test/utils_test.h \
                test/data_persistence_test.h \
                test/playlist_persistence_test.h \
+               test/directory_scanner_test.h \
+               test/collection_watcher_test.h \
+               test/audio_collection_store_test.h \
+               test/audio_collection_search_index_test.h \
+               test/audio_collection_model_test.h \
                test/audio_device_access_rules_test.h \
                test/control_and_playback_process_test.h
 
     SOURCES += test/main_test.cpp \
                test/audio_track_test.cpp \
                test/audio_file_decoding_process_test.cpp \
+               test/audio_sample_converter_test.cpp \
+               test/audio_track_peaks_test.cpp \
+               test/audio_track_prefetch_pool_test.cpp \
+               test/job_scheduler_test.cpp \
+               test/audio_track_bpm_process_test.cpp \
+               test/audio_track_key_process_test.cpp \
+               test/audio_track_loudness_process_test.cpp \
                test/utils_test.cpp \
                test/data_persistence_test.cpp \
                test/playlist_persistence_test.cpp \
+               test/directory_scanner_test.cpp \
+               test/collection_watcher_test.cpp \
+               test/audio_collection_store_test.cpp \
+               test/audio_collection_search_index_test.cpp \
+               test/audio_collection_model_test.cpp \
                test/audio_device_access_rules_test.cpp \
                test/control_and_playback_process_test.cpp
 }
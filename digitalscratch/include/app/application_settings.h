@@ -70,6 +70,10 @@ using namespace std;
 #define NB_DECKS_DEFAULT          2
 #define NB_SAMPLERS_CFG           "player/nb_samplers"
 #define NB_SAMPLERS_DEFAULT       4
+#define PREFETCH_POOL_SIZE_CFG    "player/prefetch_pool_size"
+#define PREFETCH_POOL_SIZE_DEFAULT 2
+#define PAUSE_ANALYSIS_WHILE_PLAYING_CFG     "player/pause_analysis_while_playing"
+#define PAUSE_ANALYSIS_WHILE_PLAYING_DEFAULT 0
 
 // Sound caracteristics.
 #define SAMPLE_RATE_CFG                     "sound_card/sample_rate"
@@ -82,6 +86,12 @@ using namespace std;
 #define SOUND_DRIVER_DEFAULT                SOUND_DRIVER_JACK
 #define SOUND_CARD_CFG                      "sound_card/sound_card_id"
 #define SOUND_CARD_DEFAULT                  "0"
+#define RESAMPLING_QUALITY_CFG              "sound_card/resampling_quality"
+#define RESAMPLING_QUALITY_BEST             "best"
+#define RESAMPLING_QUALITY_MEDIUM           "medium"
+#define RESAMPLING_QUALITY_FASTEST          "fastest"
+#define RESAMPLING_QUALITY_LINEAR           "linear"
+#define RESAMPLING_QUALITY_DEFAULT          RESAMPLING_QUALITY_MEDIUM
 
 // Decks: motion detection.
 #define DECK_INDEX                          "deck_"
@@ -166,6 +176,7 @@ class Application_settings : public QObject
     QList<unsigned int>              available_sample_rates;
     QList<unsigned short int>        available_nb_decks;
     QList<QString>                   available_sound_cards;
+    QList<QString>                   available_resampling_qualities;
     bool                             audio_collection_full_refresh;
 
  public:
@@ -206,11 +217,24 @@ class Application_settings : public QObject
     unsigned short int   get_nb_samplers();
     unsigned short int   get_nb_samplers_default();
 
+    void                 set_prefetch_pool_size(const unsigned short int &pool_size);
+    unsigned short int   get_prefetch_pool_size();
+    unsigned short int   get_prefetch_pool_size_default();
+
+    void                 set_pause_analysis_while_playing(const bool &is_paused);
+    bool                 get_pause_analysis_while_playing();
+    bool                 get_pause_analysis_while_playing_default();
+
     void                 set_sample_rate(const unsigned int &sample_rate);
     unsigned int         get_sample_rate();
     unsigned int         get_sample_rate_default();
     QList<unsigned int>  get_available_sample_rates();
 
+    void            set_resampling_quality(const QString &quality);
+    QString         get_resampling_quality();
+    QString         get_resampling_quality_default();
+    QList<QString>  get_available_resampling_qualities();
+
     void            set_sound_driver(const QString &driver);
     QString         get_sound_driver();
     QString         get_sound_driver_default();
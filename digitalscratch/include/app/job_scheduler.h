@@ -0,0 +1,222 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*--------------------------------------------------------( job_scheduler.h )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: run background jobs (prefetch, analysis,...) with         */
+/*                  priorities, giving way to the realtime audio thread.      */
+/*                                                                            */
+/*============================================================================*/
+
+#pragma once
+
+#include <QObject>
+#include <QThread>
+#include <QThreadPool>
+#include <QFuture>
+#include <QFutureInterface>
+#include <QTimer>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <functional>
+
+#include "audiodev/audio_io_control_rules.h"
+
+using namespace std;
+
+#define JOB_BUDGET_CHECK_MSEC  250  // Period of the realtime budget check.
+#define JOB_MAX_CPU_LOAD       60.0 // Above this load of the audio thread (percent) background jobs are paused.
+#define JOB_XRUN_COOLDOWN_MSEC 5000 // Background jobs stay paused during this time after an xrun.
+#define JOB_PAUSE_MSEC         50   // A paused job checks the budget (and if it is canceled) again after this time.
+
+enum class Job_priority
+{
+    USER,       // Asked by the user (e.g. open a directory), run on the global pool and never paused.
+    PREFETCH,   // Tracks likely to be loaded, paused when the audio thread is loaded.
+    ANALYSIS    // Collection analysis, also paused while decks are playing (if configured).
+};
+
+struct Parked_job
+{
+    Job_priority                         priority;
+    QSharedPointer<QFutureInterfaceBase> interface;
+    std::function<bool()>                process_next;         // Process next item of a map, false when no item is left.
+};
+
+class Job_scheduler : public QObject
+{
+    Q_OBJECT
+
+ private:
+    QThreadPool                            prefetch_pool;     // Idle priority workers (prefetch never waits behind a paused analysis).
+    QThreadPool                            analysis_pool;
+    QMutex                                 parked_jobs_mutex;
+    QList<Parked_job>                      parked_jobs;       // Paused maps waiting for the budget, they do not hold a thread.
+    QThreadPool                            parked_pool;       // One thread watching parked maps (a canceled map finishes even if the GUI thread waits for it).
+    QWaitCondition                         parked_jobs_changed;
+    bool                                   is_watching_parked;
+    QSharedPointer<Audio_IO_control_rules> sound_card;
+    std::function<bool()>                  is_playing;        // Optional check: true if a deck is playing.
+    QTimer                                 budget_timer;
+    QAtomicInt                             budget_tight;      // Audio thread is loaded or had an xrun recently.
+    QAtomicInt                             decks_playing;     // Decks are playing and analysis must wait.
+    int                                    last_nb_xruns;
+    QElapsedTimer                          last_xrun_timer;
+
+ public:
+    Job_scheduler();
+    virtual ~Job_scheduler();
+
+    void set_sound_card(const QSharedPointer<Audio_IO_control_rules> &sound_card); // Start to watch the realtime budget.
+    void set_playing_check(std::function<bool()> is_playing);                      // Analysis is paused while it returns true.
+
+    template <typename T>
+    QFuture<T> run(const Job_priority &priority,
+                   std::function<T()>  job);                    // Run a job, get its result with the future.
+    template <typename T>
+    QFuture<T> run_stream(const Job_priority                          &priority,
+                          std::function<void(QFutureInterface<T>&)>    job); // Run a job which reports its results itself (e.g. by batches).
+    template <typename Sequence, typename Function>
+    QFuture<void> map(const Job_priority &priority,
+                      Sequence           &sequence,
+                      Function            function);            // Call function on a copy of each item (a few workers share the items, progress is reported).
+
+    bool must_pause(const Job_priority &priority);              // True if jobs of this priority must give way to playback.
+    bool must_pause_current_job();                              // Same for the job of the calling thread (false if it is canceled or not a job).
+
+ signals:
+    void budget_available();                                    // Paused jobs can continue.
+
+ private:
+    void start(const Job_priority   &priority,
+               QFutureInterfaceBase *interface,
+               std::function<void()> job);
+    void start_map_worker(const Parked_job &worker);            // Process items until the map is done or must pause.
+    int  get_max_nb_workers(const Job_priority &priority);
+    void resume_parked_jobs();
+    void watch_parked_jobs();                                   // Resume parked maps which are canceled or can continue, until none is left.
+    void check_realtime_budget();
+};
+
+template <typename T>
+QFuture<T>
+Job_scheduler::run(const Job_priority &priority,
+                   std::function<T()>  job)
+{
+    QSharedPointer<QFutureInterface<T>> interface(new QFutureInterface<T>());
+    interface->reportStarted();
+    QFuture<T> future = interface->future();
+    this->start(priority, interface.data(), [interface, job]()
+    {
+        T result = job();
+        interface->reportResult(result);
+        interface->reportFinished();
+    });
+
+    return future;
+}
+
+template <typename T>
+QFuture<T>
+Job_scheduler::run_stream(const Job_priority                       &priority,
+                          std::function<void(QFutureInterface<T>&)> job)
+{
+    QSharedPointer<QFutureInterface<T>> interface(new QFutureInterface<T>());
+    interface->reportStarted();
+    QFuture<T> future = interface->future();
+    this->start(priority, interface.data(), [interface, job]()
+    {
+        job(*interface);
+        interface->reportFinished();
+    });
+
+    return future;
+}
+
+template <typename Sequence, typename Function>
+QFuture<void>
+Job_scheduler::map(const Job_priority &priority,
+                   Sequence           &sequence,
+                   Function            function)
+{
+    typedef typename std::decay<decltype(*sequence.begin())>::type Item;
+
+    QSharedPointer<QFutureInterface<void>> interface(new QFutureInterface<void>());
+    QSharedPointer<QAtomicInt>             next_item(new QAtomicInt(0));
+    QSharedPointer<QAtomicInt>             nb_done(new QAtomicInt(0));
+    int                                    nb_items = sequence.size();
+    interface->reportStarted();
+    interface->setProgressRange(0, nb_items);
+    QFuture<void> future = interface->future();
+    if (nb_items == 0)
+    {
+        interface->reportFinished();
+        return future;
+    }
+
+    // Items are copied (the sequence can grow while jobs are running), so use a sequence of pointers to modify the objects.
+    QSharedPointer<QVector<Item>> items(new QVector<Item>());
+    items->reserve(nb_items);
+    for (auto item = sequence.begin(); item != sequence.end(); ++item)
+    {
+        items->append(*item);
+    }
+
+    // A few workers take the items one by one. Items of a canceled map are skipped, the last one finishes the future.
+    Parked_job worker;
+    worker.priority     = priority;
+    worker.interface    = interface;
+    worker.process_next = [interface, items, next_item, nb_done, nb_items, function]() mutable
+    {
+        int index = next_item->fetchAndAddOrdered(1);
+        if (index >= nb_items)
+        {
+            return false;
+        }
+        if (interface->isCanceled() == false)
+        {
+            function((*items)[index]);
+        }
+        int done = nb_done->fetchAndAddOrdered(1) + 1;
+        interface->setProgressValue(done);
+        if (done == nb_items)
+        {
+            interface->reportFinished();
+        }
+        return true;
+    };
+    int nb_workers = qMin(nb_items, this->get_max_nb_workers(priority));
+    for (int i = 0; i < nb_workers; i++)
+    {
+        this->start_map_worker(worker);
+    }
+
+    return future;
+}
@@ -88,6 +88,7 @@ class Config_dialog : public QDialog
     QComboBox            *gui_style_select;
     QComboBox            *nb_decks_select;
     QComboBox            *sample_rate_select;
+    QComboBox            *resampling_quality_select;
     QCheckBox            *device_jack_check;
     QCheckBox            *auto_jack_connections_check;
     QCheckBox            *device_internal_check;
@@ -33,6 +33,7 @@
 #pragma once
 
 #include <QLabel>
+#include <QBitArray>
 #include <QGroupBox>
 #include <QTreeView>
 #include <QDirModel>
@@ -49,6 +50,7 @@
 
 #include "gui/config_dialog.h"
 #include "gui/waveform.h"
+#include "gui/waveform_zoom.h"
 #include "app/application_settings.h"
 #include "app/application_const.h"
 #include "player/deck_playback_process.h"
@@ -58,6 +60,9 @@
 #include "tracks/audio_track.h"
 #include "tracks/audio_file_decoding_process.h"
 #include "tracks/audio_collection_model.h"
+#include "tracks/collection_watcher.h"
+#include "tracks/audio_track_prefetch_pool.h"
+#include "tracks/audio_track_band_process.h"
 #include "tracks/playlist.h"
 #include "control/dicer_control_process.h"
 
@@ -66,6 +71,8 @@ using namespace std;
 #define XSTR(x) #x
 #define STR(x) XSTR(x)
 
+#define PREFETCH_NB_FOLLOWING_TRACKS 1 // Tracks following the selected one which are prefetched.
+
 class SpeedQPushButton : public QPushButton
 {
    Q_OBJECT
@@ -146,6 +153,7 @@ class Deck : public PlaybackQGroupBox
        QPushButton                  *thru_button;
        QLabel                       *key;
        Waveform                     *waveform;
+       Waveform_zoom                *waveform_zoom;
        QHBoxLayout                  *remaining_time_layout;
        QLabel                       *rem_time_minus;
        QLabel                       *rem_time_min;
@@ -291,7 +299,6 @@ class Gui : public QObject
     // File browser.
     QSplitter                          *browser_splitter;
     QGroupBox                          *file_browser_gbox;
-    QFutureWatcher<void>               *watcher_parse_directory;
 
     // Folder browser.
     TreeViewIconProvider               *treeview_icon_provider;
@@ -300,6 +307,7 @@ class Gui : public QObject
 
     // Track browser.
     Audio_collection_model             *file_system_model;
+    QSharedPointer<Collection_watcher>  collection_watcher;
     QTreeView                          *file_browser;
     QShortcut                          *shortcut_collapse_browser;
     QShortcut                          *shortcut_load_audio_file;
@@ -378,6 +386,19 @@ class Gui : public QObject
     QSharedPointer<Control_and_playback_process>               control_and_play;
     Application_settings                                      *settings;
 
+    // Speculative decoding of the tracks which are likely to be loaded next.
+    QSharedPointer<Audio_track_prefetch_pool>                  prefetch_pool;
+    QStringList                                                next_keys_paths;
+
+    // Background analysis of frequency bands of the tracks loaded on decks.
+    QList<QSharedPointer<Audio_track_band_process>>            band_processes;
+    QList<QFutureWatcher<bool>*>                               watchers_band_process;
+
+    // Background load of cue points and tags of the tracks loaded on decks.
+    QList<QSharedPointer<Audio_track>>                         loaded_track_data;
+    QList<QFutureWatcher<bool>*>                               watchers_track_data;
+    QList<QBitArray>                                           edited_cue_points;    // Cue points set or deleted by the user during the load.
+
     // External controller.
     QSharedPointer<Dicer_control_process>                      dicer_control;
 
@@ -430,6 +451,10 @@ class Gui : public QObject
     void hide_samplers();
     void show_samplers();
     void add_track_path_to_tracklist(const unsigned short int &deck_index);
+    void run_band_process(const unsigned short int &deck_index);
+    void stop_band_process(const unsigned short int &deck_index);
+    void run_track_data_load(const unsigned short int &deck_index);
+    void show_cue_points(const unsigned short int &deck_index);
     void write_tracklist();
     void connect_dicer_actions();
     bool get_dicer_index_from_deck_index(const unsigned short &deck_index, dicer_t &out_dicer_index);
@@ -502,9 +527,12 @@ class Gui : public QObject
     void on_file_browser_double_click(QModelIndex in_model_index);
     void sync_file_browser_to_audio_collection();
     void on_finished_analyze_audio_collection();
+    void on_finished_band_process(const unsigned short int &deck_index);
+    void on_finished_track_data_load(const unsigned short int &deck_index);
     void update_refresh_progress_value(const unsigned int &value);
     void select_and_show_next_keys(const unsigned short int &deck_index);
     void show_next_keys();
+    void update_prefetch_candidates();
     void on_file_browser_header_click(const int &index);
     void on_progress_cancel_button_click();
     void run_concurrent_read_collection_from_db();
@@ -33,11 +33,13 @@
 #pragma once
 
 #include <QLabel>
+#include <QVector>
+#include <QLine>
+#include <QPixmap>
+#include <QColor>
 #include "tracks/audio_track.h"
 #include "app/application_const.h"
 
-#define POINTS_MAX_SIZE (this->at->get_max_nb_samples() / 100) // Number of samples for a track of 15 min (divided by 100).
-
 using namespace std;
 
 class Waveform : public QLabel
@@ -48,31 +50,34 @@ class Waveform : public QLabel
     int                          area_height;
     int                          area_width;
     QSharedPointer<Audio_track>  at;
-    QLabel                      *slider;
     int                          slider_position_x;
     float                        slider_absolute_position;
-    QList<QLabel*>               cue_sliders;
-    QList<QLabel*>               cue_sliders_number;
     QList<int>                   cue_sliders_position_x;
     QList<float>                 cue_sliders_absolute_position;
-    unsigned int                 end_of_waveform;
-    bool                         force_regenerate_polyline;
-    QPointF                     *points; // Table of points to display.
+    int                          end_of_waveform;  // Last column showing samples.
+    bool                         force_regenerate_cache;
+    QVector<QLine>               peak_lines;       // One vertical line (min to max) per column.
+    QVector<QLine>               rms_lines;        // One vertical line (-rms to rms) per column.
+    QVector<QColor>              band_colors;      // Color of each column (empty if frequency bands are not analyzed yet).
+    QPixmap                      cache;            // Waveform and minute separators, only drawn again on resize or track change.
 
  public:
     Waveform(const QSharedPointer<Audio_track> &at, QWidget *parent = 0);
     ~Waveform();
 
-    void reset();                                                             // Clean list of points and force repaint.
+    void reset();                                                             // Force drawing the waveform again at next repaint.
     bool move_slider(const float &position);                                  // Position is between 0.0 and 1.0.
     bool move_cue_slider(const unsigned short &cue_point_num,                 // Position is between 0.0 and 1.0.
                          const float          &position);
 
+    static QColor get_band_color(const Audio_bands &bands);                   // Red for low, green for mid and blue for high frequencies.
+
  private:
     void get_area_size();
     bool jump_slider(const int &x_pos);
-    bool generate_polyline();
-    void draw_cue_slider(const unsigned short &cue_point_num);
+    bool generate_lines();                                                    // Get a line per column from the peaks of the track.
+    void generate_cache();                                                    // Draw static part of the waveform.
+    void update_column(const int &x_pos, const int &width);                   // Repaint only a part of the widget.
 
  protected:
     virtual void paintEvent(QPaintEvent *);
@@ -0,0 +1,79 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*--------------------------------------------------------( waveform_zoom.h )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Display class: zoomed waveform scrolling around the playback position.    */
+/*                                                                            */
+/*============================================================================*/
+
+#pragma once
+
+#include <QWidget>
+#include <QTimer>
+#include <QImage>
+#include <QHash>
+#include <QSharedPointer>
+
+#include "tracks/audio_track.h"
+#include "player/deck_playback_process.h"
+#include "app/application_const.h"
+
+#define WAVEFORM_ZOOM_SEC          4   // Number of seconds shown before and after the playback position.
+#define WAVEFORM_ZOOM_REFRESH_MSEC 16  // About 60 fps.
+#define WAVEFORM_ZOOM_TILE_WIDTH   256 // Waveform is drawn by tiles of this width (pixels).
+#define WAVEFORM_ZOOM_MAX_NB_TILES 16  // Maximum number of tiles kept in cache.
+
+using namespace std;
+
+class Waveform_zoom : public QWidget
+{
+    Q_OBJECT
+
+ private:
+    QSharedPointer<Audio_track>           at;
+    QSharedPointer<Deck_playback_process> playback;
+    QTimer                                refresh_timer;
+    QHash<qint64, QImage>                 tiles;                // Drawn tiles (key = index of the tile in the track).
+    float                                 nb_frames_per_pixel;
+    qint64                                position_x;           // Playback position (pixels from the beginning of the track).
+
+ public:
+    Waveform_zoom(const QSharedPointer<Audio_track> &at, QWidget *parent = 0);
+    virtual ~Waveform_zoom();
+
+    void set_playback(const QSharedPointer<Deck_playback_process> &playback); // Start following its position.
+    void reset();                                                             // Track changed: drop drawn tiles.
+
+ private:
+    void          refresh();                                                  // Repaint only if position moved by one pixel.
+    const QImage &get_tile(const qint64 &index);
+    void          draw_tile(const qint64 &index, QImage &tile);
+
+ protected:
+    virtual void paintEvent(QPaintEvent *event);
+    virtual void resizeEvent(QResizeEvent *event);
+};
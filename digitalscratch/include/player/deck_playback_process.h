@@ -35,6 +35,7 @@
 
 #include <QObject>
 #include <QSharedPointer>
+#include <QAtomicInt>
 #include <samplerate.h>
 
 #include "tracks/audio_track.h"
@@ -57,6 +58,7 @@ class Deck_playback_process : public QObject
     QList<QSharedPointer<Audio_track>>    at_samplers;
     QSharedPointer<Playback_parameters>   param;
     unsigned int                          current_sample;
+    QAtomicInt                            position_snapshot;              // Copy of current_sample readable from other threads.
     QList<unsigned int>                   cue_points;
     unsigned int                          remaining_time;
     QList<unsigned int>                   sampler_current_samples;
@@ -86,6 +88,7 @@ class Deck_playback_process : public QObject
     bool reset();
     bool jump_to_position(const float &position);
     float get_position(); // 0.0 < position < 1.0
+    unsigned int get_position_snapshot(); // Sample index at the end of last playback cycle (lock free).
     bool is_track_loaded();
 
     bool is_cue_point_defined(const unsigned short int &cue_point_number);
@@ -42,37 +42,65 @@
 #include <QPixmap>
 #include <QList>
 #include <QSharedPointer>
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+#include <QPair>
+#include <functional>
 
 #include "tracks/playlist.h"
+#include "tracks/audio_collection_store.h"
+#include "tracks/audio_collection_search_index.h"
+#include "utils.h"
 
 using namespace std;
 
 #define COLUMN_FILE_NAME 0
 #define COLUMN_KEY       1
-#define COLUMN_PATH      2
+#define COLUMN_BPM       2
+#define COLUMN_PATH      3
+
+#define COLLECTION_FETCH_BATCH_SIZE        64   // Entries of a directory are inserted in the model by batches.
+#define COLLECTION_SORT_PARALLEL_MIN_ITEMS 2000 // Directories with more items are sorted in parallel.
+#define COLLECTION_READ_CHUNK_SIZE         1024 // Files joined with data loaded from DB by a job.
+
+// File or directory found by a background enumeration.
+struct Audio_collection_entry
+{
+    QString name;
+    QString path;
+    QString hash;         // Empty for a directory.
+    bool    is_directory;
+};
+
+struct Audio_track_data;
 
 class Audio_collection_item
 {
  public:
     QList<Audio_collection_item*>  childItems;
  private:
-    QList<QVariant>                itemData;
     Audio_collection_item         *parentItem;
-    QString                        fullPath;
+    Audio_collection_store        *store;           // Data of a file (nullptr for directories).
+    int                            file_id;         // Id of the file in the store.
+    QList<QVariant>                itemData;        // Data of a directory.
+    QString                        fullPath;        // Path of a directory.
     bool                           directoryFlag;
-    QString                        fileHash;
-    bool                           next_key;
-    bool                           next_major_key;
+    bool                           fetched;         // Children of the directory are enumerated.
 
  public:
-    Audio_collection_item(const QList<QVariant>       &in_data,
-                                QString                in_file_hash    = "",
-                                QString                in_full_path    = "",
-                                bool                   in_is_directory = false,
-                                Audio_collection_item *in_parent       = 0);
+    Audio_collection_item(const QList<QVariant>       &in_data,           // Directory (or header).
+                                QString                in_full_path = "",
+                                Audio_collection_item *in_parent    = 0);
+    Audio_collection_item(Audio_collection_store      *in_store,          // File.
+                                int                    in_file_id,
+                                Audio_collection_item *in_parent    = 0);
     ~Audio_collection_item();
 
     void                   append_child(Audio_collection_item *in_item);
+    void                   set_parent(Audio_collection_item *in_parent);
+    void                   clear_children();                // Delete sub-directories (files are owned by the collection index).
     Audio_collection_item *get_child(int in_row);
     int                    get_child_count() const;
     Audio_collection_item *get_parent();
@@ -83,35 +111,66 @@ class Audio_collection_item
     void                   set_data(int in_column, QVariant in_data);
     QString                get_full_path();
     QString                get_file_hash();
+    void                   set_file_hash(QString in_file_hash);
+    bool                   is_fetched();
+    void                   set_fetched(bool in_fetched);
 
-    void                   read_from_db();
+    void                   read_from_track(const QSharedPointer<Audio_track> &in_at); // Get data of a track read from DB.
+    void                   read_from_data(const QHash<Hash_128, Audio_track_data> &in_data); // Same, from data of all tracks loaded at once (if not read yet).
+    bool                   is_read_from_db();                                  // Data of the file were looked for in DB.
+    bool                   is_analyzed();                                      // Data of the file were computed (the bpm may be 0).
     void                   compute_and_store_to_db();
 
     bool                   is_directory();
+    int                    get_file_id() const;
 
     bool                   is_a_next_key();
     bool                   is_a_next_major_key();
-    void                   set_next_key(bool is_a_next_key);
-    void                   set_next_major_key(bool is_a_next_major_key);
 
  private:
-    void calculate_audio_data();     // Compute music key, bpm, etc...
-    void store_to_db();              // Persist to DB.
+    void calculate_audio_data(QByteArray &out_waveform_bands);     // Compute music key, bpm, etc... (decoding the file only once).
+    void store_to_db(const QByteArray &waveform_bands);            // Persist to DB.
 };
 
 class Audio_collection_model : public QAbstractItemModel
 {
+    Q_OBJECT
+
  public:
-    QSharedPointer<QFutureWatcher<void>>  concurrent_watcher_read;
-    QSharedPointer<QFutureWatcher<void>>  concurrent_watcher_store;
+    QSharedPointer<QFutureWatcher<void>>                    concurrent_watcher_read;
+    QSharedPointer<QFutureWatcher<void>>                    concurrent_watcher_store;
+    QSharedPointer<QFutureWatcher<Audio_collection_entry>>  concurrent_watcher_index;
+    QSharedPointer<QFutureWatcher<void>>                    concurrent_watcher_update;
+    QSharedPointer<QFutureWatcher<bool>>                    concurrent_watcher_tags;
 
  private:
-    Audio_collection_item         *rootItem;
-    QSharedPointer<QFuture<void>>  concurrent_future;
-    QPixmap                        audio_file_icon;
-    QPixmap                        directory_icon;
-    QList<Audio_collection_item*>  audio_item_list;
-    QString                        root_path;
+    Audio_collection_item                   *rootItem;
+    QSharedPointer<QFuture<void>>            concurrent_future;
+    QPixmap                                  audio_file_icon;
+    QPixmap                                  directory_icon;
+    Audio_collection_store                   store;            // Data of all files (items of files are views on it).
+    Audio_collection_search_index            search_index;     // Words of files of the store.
+    QHash<QString, QStringList>              tags_by_hash;     // Tags of tracks (loaded with the root path).
+    QSharedPointer<QHash<QString, QStringList>> loaded_tags;   // Tags being read by the DB thread.
+    QList<Audio_collection_item*>            audio_item_list;  // Flat index of all files (used by analysis and search).
+    QHash<QString, Audio_collection_item*>   items_by_path;    // Same, by full path.
+    QList<Audio_collection_item*>            removed_items;    // Removed from disk, deleted at the next reset (background jobs can still use them).
+    QList<Audio_collection_item*>            pending_analysis; // Changed files waiting for the analysis of the previous ones.
+    QList<QFutureWatcher<Audio_collection_entry>*> updates;    // Running hashing of changed files.
+    QHash<Audio_collection_item*,
+          QFutureWatcher<Audio_collection_entry>*> fetches;    // Running enumerations of directories of the tree.
+    QString                                  root_path;
+    QString                                  shown_dir_path;   // Directory shown by the tree (empty for a playlist).
+    bool                                     is_playlist;      // The tree shows a playlist instead of a directory.
+    QStringList                              playlist_tracklist; // Tracks of the shown playlist (listed in background like a directory).
+    QHash<QString, File_identity>            file_identities;  // Identities of files cached in DB (loaded with the root path).
+    QSharedPointer<QHash<QString, File_identity>> loaded_identities; // Identities being read by the DB thread.
+    QFuture<bool>                            identities_loading;
+    QMutex                                   identities_mutex;
+    QList<QFutureWatcher<bool>*>             db_reads;         // Running reads of data of changed files.
+    int                                      sort_column;      // Order chosen by the user (-1 if none).
+    Qt::SortOrder                            sort_order;
+    QList<QPair<QString, bool>>              requested_paths;  // Paths to select (or directories to expand if true), waiting for their parents to be enumerated.
 
  public:
     explicit Audio_collection_model(QObject *in_parent = 0);
@@ -129,28 +188,76 @@ class Audio_collection_model : public QAbstractItemModel
     QModelIndex   parent(const QModelIndex &in_index) const;
     QModelIndex   parent_from_item(Audio_collection_item &in_item) const;
     int           rowCount(const QModelIndex &in_parent = QModelIndex()) const;
+    bool          hasChildren(const QModelIndex &in_parent = QModelIndex()) const;
+    bool          canFetchMore(const QModelIndex &in_parent) const;
+    void          fetchMore(const QModelIndex &in_parent);           // Enumerate a directory in background, insert entries by batches.
     int           columnCount(const QModelIndex &in_parent = QModelIndex()) const;
     void          sort(int in_column, Qt::SortOrder in_order);
     QStringList   mimeTypes() const;
     QMimeData    *mimeData(const QModelIndexList &in_indexes) const;
 
-    void concurrent_read_collection_from_db();                  // Call Audio_collection_item::read_from_db() on all collection in separate threads.
+    void concurrent_read_collection_from_db();                  // Load data of all tracks from DB and put them to the collection in separate threads.
     void stop_concurrent_read_collection_from_db();             // Stop concurrent_read_collection_from_db().
     void concurrent_analyse_audio_collection();                 // Call Audio_collection_item::compute_and_store_to_db() on all collection in separate threads.
     void stop_concurrent_analyse_audio_collection();            // Stop concurrent_analyse_audio_collection().
+    void stop_concurrent_index_collection();                    // Stop the background listing of all files (started by set_root_path() and set_playlist()).
+    void select_path(const QString &in_path);                   // Emit path_selected() once the item is in the tree (parents are enumerated in background).
+    void apply_file_changes(const QStringList &in_changed_paths, // Update the tree and the index with files changed on disk,
+                            const QStringList &in_removed_paths); // changed files are analyzed (if their data are not in DB).
+    void rescan_directory(const QString &in_dir_path);          // List files under a directory again (changes missed by the watcher).
+    void stop_concurrent_update();                              // Stop hashing and analysis of changed files.
     int  get_nb_items();                                        // Get number of files.
     int  get_nb_new_items();                                    // Get number of new files (i.e. files with missing data such as music key).
-    QList<QModelIndex> set_next_keys(QString in_next_key,       // Set flags for previous/next keys (for all items).
-                                     QString in_previous_key,
-                                     QString in_next_major_key);
+    void set_next_keys(QString in_next_key,                     // Select previous/next keys, emit directory_to_expand() for directories
+                       QString in_previous_key,                 // containing them (once they are in the tree).
+                       QString in_next_major_key);
+    QStringList get_next_keys_paths(const int &max_nb_items);  // Get paths of items of keys selected by set_next_keys() (next/previous keys first).
 
     void set_icons(QPixmap in_audio_file_icon,
                    QPixmap in_directory_icon);
-    QModelIndexList search(QString in_text);
+    QStringList search(QString in_text);                        // Get paths of top directories starting with in_text and of files matching it (see Audio_collection_search_index).
     void clear();
 
+ signals:
+    void path_selected(QModelIndex index);                      // Item asked by select_path() is in the tree.
+    void directory_to_expand(QModelIndex index);                // Directory containing next keys (see set_next_keys()) is in the tree.
+
  private:
-    void setup_model_data(QString in_path, Audio_collection_item *in_item);
-    void setup_model_data_from_tracklist(QStringList in_tracklist, Audio_collection_item *in_item);
     void create_header(QString in_path, bool in_show_path);
+    void start_concurrent_index_collection(const QStringList &in_dir_paths);
+    void stop_fetches();
+    void request_path(const QString &in_path,                                // Emit the item once it is in the tree (see select_path()
+                      const bool    &in_expand);                             // and set_next_keys()).
+    void process_requested_paths();                                          // Emit requested items which are in the tree, enumerate directories on the way to others.
+    void insert_children(Audio_collection_item                 *in_item,    // Insert enumerated entries in the tree (at their place in the current order).
+                         const QVector<Audio_collection_entry> &in_entries);
+    void add_to_index(const QVector<Audio_collection_entry> &in_entries);    // Add files to the flat index.
+    Audio_collection_item *get_indexed_item(const Audio_collection_entry &in_entry); // Get (or create) the item of a file.
+    QModelIndex index_from_item(Audio_collection_item *in_item);
+    Audio_collection_item *find_item(const QString &in_path,                 // Get item of a file or directory of the tree (nullptr if a parent directory is
+                                     const bool    &in_get_not_fetched = false); // not enumerated yet, or this directory if in_get_not_fetched is true).
+    void remove_item(Audio_collection_item *in_item);                        // Remove an item from the tree.
+    void update_files(const QVector<Audio_collection_entry> &in_entries);    // Insert or update hashed changed files.
+    void read_items_from_db(const QList<Audio_collection_item*> &in_items,   // Read data of files by the DB thread, then show them
+                            const bool                          &in_analyze_missing); // (and analyze files which are not in DB).
+    void concurrent_analyse_items(const QList<Audio_collection_item*> &in_items); // Analyze changed files (one analysis at a time).
+    void sort_directories(const QList<Audio_collection_item*> &in_directories); // Sort children of directories in the current order.
+    void enumerate_directory(const QString &in_path,                         // List and hash entries of a directory
+                             std::function<void(const QVector<Audio_collection_entry>&)> in_report, // (reported by batches).
+                             std::function<bool()> in_is_canceled);
+    void enumerate_tracklist(const QStringList &in_tracklist,                // List and hash entries of a playlist (same as enumerate_directory()).
+                             std::function<void(const QVector<Audio_collection_entry>&)> in_report,
+                             std::function<bool()> in_is_canceled);
+    void index_directories(const QStringList &in_dir_paths,                  // List and hash all files under directories with parallel workers
+                           std::function<void(const QVector<Audio_collection_entry>&)> in_report,   // (reported by batches from several threads).
+                           std::function<bool()> in_is_canceled);
+    void load_file_identities(const QString &in_root_path);  // Read by the DB thread (see wait_file_identities()).
+    void wait_file_identities();                              // Wait until identities are loaded (by background jobs, identities_mutex must not be locked).
+    void load_tags();                                         // Read by the DB thread, files already indexed get their tags when done.
+    QString get_file_hash(const QString                 &in_path,            // Get cached hash of a file, compute it only if the file changed.
+                          QHash<QString, File_identity> &io_new_identities);
+    QString get_file_hash(const QString                 &in_path,            // Same with size, modification time and inode already known.
+                          File_identity                  in_identity,
+                          QHash<QString, File_identity> &io_new_identities);
+    void store_file_identities(const QHash<QString, File_identity> &in_new_identities);
 };
@@ -0,0 +1,96 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*----------------------------------------( audio_collection_search_index.h )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: search index of the audio collection (trigrams of names,  */
+/*                  paths and tags, key and bpm, typo tolerant).              */
+/*                                                                            */
+/*============================================================================*/
+
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QVector>
+
+#include "tracks/audio_collection_store.h"
+
+using namespace std;
+
+#define SEARCH_MAX_MSEC       8  // Time budget of a search (typo tolerant matching stops when it is elapsed).
+#define SEARCH_MAX_NB_RESULTS 1000
+
+// A word of a search.
+struct Search_word
+{
+    QString          text;           // Normalized.
+    QVector<quint64> trigrams;       // Distinct trigrams of the word.
+    int              max_errors;     // Allowed typos (insertion, deletion, substitution).
+    qint8            key;            // Camelot index if the word is a key, CAMELOT_UNKNOWN_KEY otherwise.
+    int              bpm;            // Rounded bpm if the word is a number, 0 otherwise.
+};
+
+class Audio_collection_search_index
+{
+ private:
+    const Audio_collection_store   *store;
+    QVector<QString>                file_texts;        // Normalized name and tags, by file id.
+    QVector<int>                    name_lengths;      // Length of the name in the text, by file id.
+    QVector<QString>                dir_texts;         // Normalized path, by directory id.
+    QVector<QVector<int>>           files_by_dir;
+    QHash<quint64, QVector<int>>    files_by_trigram;  // Can contain files which do not have the trigram anymore.
+    QHash<quint64, QVector<int>>    dirs_by_trigram;
+    QVector<quint16>                counts;            // Number of trigrams found by file (reused from a search to another).
+    QString                         last_text;         // Last search and its exact matches (a longer search is only a filter of them).
+    QVector<int>                    last_file_ids;
+    int                             last_nb_changes;   // Changes of the store when the last search was done.
+
+ public:
+    Audio_collection_search_index(const Audio_collection_store *store);
+    virtual ~Audio_collection_search_index();
+
+    void         set_file(const int         &id,           // (Re)index a file of the store.
+                          const QStringList &tags);
+    void         clear();
+    QVector<int> search(const QString &text);              // Get ids of files matching all words of text (names first, then
+                                                           // paths, tags, keys and bpms, then typos).
+    static QString normalize(const QString &text);         // Lower case, no accent, only letters and digits separated by a space.
+
+ private:
+    static void  get_trigrams(const QString &text, QVector<quint64> &out_trigrams);
+    static int   get_distance(const QString &word,         // Lowest edit distance of word to a substring of text,
+                              const QString &text,         // max_errors + 1 if it is higher.
+                              const int     &max_errors);
+    void         get_candidates(const Search_word &word,   // Files which have at least min_nb_trigrams of word
+                                const int         &min_nb_trigrams, // in their text or in the one of their directory.
+                                QVector<int>      &out_ids);
+    int          match(const int         &id,              // Number of typos of word in file (-1 if it does not match).
+                       const Search_word &word,
+                       const bool        &is_typo_allowed,
+                       bool              &out_is_in_name);
+};
@@ -0,0 +1,139 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*-----------------------------------------------( audio_collection_store.h )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: compact storage of the files of the audio collection      */
+/*                  (one array by field, interned directories).               */
+/*                                                                            */
+/*============================================================================*/
+
+#pragma once
+
+#include <QString>
+#include <QHash>
+#include <QVector>
+#include <QBitArray>
+#include <QMutex>
+#include <QAtomicInt>
+
+#include "utils.h"
+
+using namespace std;
+
+#define COLLECTION_STORE_CHUNK_SIZE 8192 // Files (or directories) by chunk, a chunk is never moved.
+#define COLLECTION_STORE_MAX_CHUNKS 8192 // The tables of chunks are never reallocated (up to 64M files).
+
+// Flags of a file.
+#define COLLECTION_FILE_HAS_HASH 0x01
+#define COLLECTION_FILE_REMOVED  0x02
+#define COLLECTION_FILE_DB_READ  0x04 // Data were looked for in DB.
+#define COLLECTION_FILE_ANALYZED 0x08 // Key, bpm and loudness were computed (stored or not).
+
+// Fields of COLLECTION_STORE_CHUNK_SIZE files, one array by field so a scan of the collection reads only what it needs.
+struct Audio_collection_file_chunk
+{
+    qint32  dir_id[COLLECTION_STORE_CHUNK_SIZE];     // Interned directory.
+    QString name[COLLECTION_STORE_CHUNK_SIZE];
+    quint64 hash_high[COLLECTION_STORE_CHUNK_SIZE];  // 128 bits hash (binary).
+    quint64 hash_low[COLLECTION_STORE_CHUNK_SIZE];
+    qint8   key[COLLECTION_STORE_CHUNK_SIZE];        // Camelot index (CAMELOT_UNKNOWN_KEY if not analyzed).
+    quint8  flags[COLLECTION_STORE_CHUNK_SIZE];
+    float   bpm[COLLECTION_STORE_CHUNK_SIZE];        // 0 if not analyzed.
+    float   loudness[COLLECTION_STORE_CHUNK_SIZE];   // Integrated loudness (LUFS, 0 if unknown).
+    quint32 first_beat[COLLECTION_STORE_CHUNK_SIZE]; // Position of the first beat (msec).
+};
+
+struct Audio_collection_dir_chunk
+{
+    QString path[COLLECTION_STORE_CHUNK_SIZE];
+};
+
+class Audio_collection_store
+{
+ private:
+    Audio_collection_file_chunk **file_chunks;       // Only the GUI thread adds files, background jobs use the ones they get.
+    Audio_collection_dir_chunk  **dir_chunks;
+    QAtomicInt                    nb_files;          // Incremented once a new file is filled (read by background jobs).
+    int                           nb_dirs;
+    QHash<QString, qint32>        dir_ids;           // Interned directories.
+    QAtomicInt                    nb_changes;        // Incremented when files, keys or bpms change (e.g. to invalidate a search).
+
+    // Index of keys, updated when a key is set (by analysis jobs). Also taken to change flags.
+    QMutex                        key_index_mutex;
+    QBitArray                     files_by_key[CAMELOT_NB_KEYS];    // By file id.
+    QVector<int>                  nb_files_by_dir[CAMELOT_NB_KEYS]; // By directory id.
+    QBitArray                     dirs_by_key[CAMELOT_NB_KEYS];     // By directory id (directories with at least one file).
+    QAtomicInteger<quint32>       next_keys;         // Keys selected by set_next_keys() (one bit by Camelot index),
+    QAtomicInteger<quint32>       next_major_keys;   // written under key_index_mutex, read without lock when drawing rows.
+
+ public:
+    Audio_collection_store();
+    virtual ~Audio_collection_store();
+
+    int     add_file(const QString &dir_path,        // Add a file, get its id.
+                     const QString &name,
+                     const QString &hash);
+    void    clear();                                  // Forget all files (background jobs must be stopped).
+    int     get_nb_files() const;
+    int     get_nb_changes() const;
+
+    QString get_name(const int &id) const;
+    QString get_dir_path(const int &id) const;
+    int     get_dir_id(const int &id) const;
+    QString get_full_path(const int &id) const;
+    QString get_hash(const int &id) const;           // As hexadecimal string.
+    bool    get_hash_128(const int &id,              // As binary value (false if the file has no hash).
+                         Hash_128  &out_hash) const;
+    void    set_hash(const int &id, const QString &hash);
+    qint8   get_key(const int &id) const;
+    void    set_key(const int &id, const qint8 &key);
+    float   get_bpm(const int &id) const;
+    void    set_bpm(const int &id, const float &bpm);
+    float   get_loudness(const int &id) const;
+    void    set_loudness(const int &id, const float &loudness);
+    quint32 get_first_beat(const int &id) const;
+    void    set_first_beat(const int &id, const quint32 &first_beat);
+    bool    has_flag(const int &id, const quint8 &flag) const;
+    void    set_flag(const int &id, const quint8 &flag, const bool &value);
+
+    int     get_nb_missing_data() const;              // Number of files not analyzed yet (not removed).
+    void    set_next_keys(const qint8    &next_key,  // Select next/previous keys and next major/minor key,
+                          const qint8    &prev_key,  // get directories containing files of these keys.
+                          const qint8    &next_major_key,
+                          QVector<int>   &out_dir_ids);
+    bool    is_next_key(const int &id) const;
+    bool    is_next_major_key(const int &id) const;
+    QVector<int> get_next_key_files(const bool &is_major, // Get ids of files of selected keys (in order of id).
+                                    const int  &max_nb_files);
+    QString get_dir(const int &dir_id) const;
+
+ private:
+    qint32  intern_dir(const QString &dir_path);
+    Audio_collection_file_chunk *get_chunk(const int &id) const;
+    void    add_to_key_index(const int &id, const qint8 &key);      // key_index_mutex must be locked.
+    void    remove_from_key_index(const int &id, const qint8 &key);
+};
@@ -0,0 +1,62 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*------------------------------------------( audio_file_analysis_process.h )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: decode an audio file once and give it chunk by chunk to   */
+/*                  several analyzers (music key, tempo, loudness,...).       */
+/*                                                                            */
+/*============================================================================*/
+
+#pragma once
+
+#include <iostream>
+#include <QString>
+#include <QList>
+#include <QSharedPointer>
+
+#include "tracks/audio_track.h"
+#include "tracks/audio_stream_analyzer.h"
+
+#define ANALYSIS_SAMPLE_RATE  44100 // Files are analyzed at this rate, whatever the sound card.
+#define ANALYSIS_MAX_MINUTES  10    // Only the beginning of long files is analyzed.
+
+using namespace std;
+
+class Audio_file_analysis_process
+{
+ private:
+    QList<Audio_stream_analyzer*> analyzers;        // Not owned.
+    int                           resampler_type;
+
+ public:
+    Audio_file_analysis_process();
+    virtual ~Audio_file_analysis_process();
+
+    void add_analyzer(Audio_stream_analyzer *analyzer);
+    bool run(const QString                     &path,
+             const QSharedPointer<Audio_track> &io_at); // io_at gives the analysis sample rate and gets the results (no samples are stored).
+};
@@ -38,12 +38,16 @@
 #include <QFile>
 #include <QString>
 #include <QSharedPointer>
+#include <functional>
 
 #include "tracks/audio_track.h"
+#include "tracks/audio_file_decoding_segment.h"
 #include "app/application_const.h"
 
 using namespace std;
 
+#define DECODING_MIN_SEGMENT_SEC 5 // Minimal duration decoded by one thread.
+
 class Audio_file_decoding_process : public QObject
 {
     Q_OBJECT
@@ -53,6 +57,10 @@ class Audio_file_decoding_process : public QObject
     QFile                       file;
     bool                        do_resample;
     unsigned int                decoded_sample_rate;
+    std::function<bool()>       must_pause;                 // Optional check used by background decoding to give way to realtime work.
+    std::function<bool()>       is_canceled;                // Optional check used by background decoding to stop when the track is not needed.
+    int                         resampler_type;             // Libsamplerate converter used if file and sound card sample rates differ.
+    int                         max_nb_threads;             // Maximum number of segments decoded in parallel.
 
  public:
     Audio_file_decoding_process(const QSharedPointer<Audio_track> &at,
@@ -63,10 +71,18 @@ class Audio_file_decoding_process : public QObject
     bool run(const QString &path,
              const QString &file_hash = "",
              const QString &music_key = "");    // Make decoding of the audio file.
+    bool load_decoded_track(const QString &file_hash = "",
+                            const QString &music_key = "");    // Publish a track which is already decoded (name, key, hash).
+    void set_pause_check(std::function<bool()> must_pause);    // Decoding waits while must_pause() returns true.
+    void set_cancel_check(std::function<bool()> is_canceled);  // Decoding stops (and fails) once is_canceled() returns true.
+    void set_max_nb_threads(const int &max_nb_threads);       // 1 = always decode sequentially.
+    static int get_resampler_type(const QString &quality);    // Get libsamplerate converter from a quality name.
 
  private:
-    void resample_track();                    // Change sample rate of the audio track.
     bool decode();                            // Internal audio decoding.
+    bool decode_sequential();                 // Decode the whole file in the calling thread.
+    bool decode_segments(Audio_file_decoding_segment &probe,
+                         const int                   &nb_segments); // Decode regions of the file in parallel.
 
  signals:
     void name_changed(const QString &name);
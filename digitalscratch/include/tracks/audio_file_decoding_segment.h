@@ -0,0 +1,122 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*------------------------------------------( audio_file_decoding_segment.h )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: decode (and resample) a part of an audio file into its    */
+/*                  own region of an audio track.                             */
+/*                                                                            */
+/*============================================================================*/
+
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <QSharedPointer>
+#include <functional>
+#include <cstdint>
+#include <samplerate.h>
+
+#include "tracks/audio_track.h"
+#include "tracks/audio_sample_converter.h"
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVStream;
+struct AVFrame;
+
+using namespace std;
+
+#define DECODING_PAUSE_MSEC      50
+#define RESAMPLING_CHUNK_FRAMES  4096 // Size of the working buffers used to resample while decoding.
+#define SEGMENT_OVERLAP_FRAMES   8192 // Input decoded before a segment to prime the resampler filter.
+
+class Audio_file_decoding_segment
+{
+ private:
+    QString                      path;
+    QSharedPointer<Audio_track>  at;
+    bool                         do_resample;
+    int                          resampler_type;            // Libsamplerate converter used if file and sound card sample rates differ.
+    std::function<bool()>        must_pause;                // Optional check used by background decoding to give way to realtime work.
+    std::function<bool()>        is_canceled;               // Optional check: decoding stops (and fails) once it returns true.
+    std::function<bool(const short signed int*,
+                       const unsigned int&)> output_sink;   // Optional receiver of the output frames (instead of the track buffer).
+    AVFormatContext             *format_context;
+    AVCodecContext              *codec_context;
+    AVStream                    *audio_stream;
+    AVFrame                     *frame;
+    unsigned int                 decoded_sample_rate;
+    Audio_sample_converter       converter;                 // Convert decoded frames to interleaved stereo 16 bits.
+    SRC_STATE                   *src_state;                 // Streaming resampler (null if no resampling needed).
+    double                       src_ratio;                 // Output sample rate / input sample rate.
+    QVector<short signed int>    s16_buffer;                // Decoded frame before resampling or partial copy.
+    QVector<float>               src_input_buffer;          // Bounded working buffers of the resampler.
+    QVector<float>               src_output_buffer;
+    QVector<short signed int>    src_s16_output_buffer;     // Resampled frames converted back to 16 bits.
+    int64_t                      warmup_frame;              // First input frame used (decoded frames before it are dropped).
+    int64_t                      output_first_frame;        // First output frame written by this segment.
+    int64_t                      output_last_frame;         // Output frame where the segment stops (-1 = end of file).
+    int64_t                      output_position;           // Output frame of the next produced sample.
+    int64_t                      output_end;                // Last written output frame + 1.
+    unsigned int                 peaks_position;            // First output frame not summarized for the waveform.
+
+ public:
+    Audio_file_decoding_segment(const QString                     &path,
+                                const QSharedPointer<Audio_track> &at,
+                                const bool                        &do_resample,
+                                const int                         &resampler_type,
+                                std::function<bool()>              must_pause  = nullptr,
+                                std::function<bool()>              is_canceled = nullptr);
+    virtual ~Audio_file_decoding_segment();
+
+    void         set_output_sink(std::function<bool(const short signed int*,
+                                                    const unsigned int&)> sink); // Stream output frames (return false to stop decoding).
+
+    bool         open();                                     // Open file and decoder.
+    bool         is_sample_exact_seekable();                 // True for formats where seeking is sample accurate (PCM, FLAC).
+    unsigned int get_decoded_sample_rate();
+    int64_t      get_nb_frames();                            // Estimated number of decoded frames (0 if unknown).
+    int64_t      get_alignment();                            // Boundaries multiple of it give an integer output position.
+    int64_t      get_output_frame(const int64_t &input_frame); // Output frame of an (aligned) input frame.
+    bool         decode(const int64_t &first_frame,
+                        const int64_t &last_frame);          // Decode input frames [first, last[ (last = -1: up to end of file).
+    int64_t      get_output_end();                           // Last written output frame + 1.
+
+ private:
+    bool is_resampling();
+    bool seek(const int64_t &input_frame);
+    bool store_frame(const int64_t &input_position);         // Convert (and resample) current decoded frame.
+    bool write_output(const short signed int *samples,
+                      const unsigned int     &nb_frames);    // Write frames at current output position (clipped to the segment).
+    bool resample(const short signed int *input,
+                  const unsigned int     &nb_frames,
+                  const bool             &end_of_input);
+    bool convert_frame(const unsigned int &nb_frames,
+                       short signed int   *output_samples);  // Convert current decoded frame to the internal format.
+    void update_peaks();                                     // Summarize decoded frames while they are in cache.
+    void close();
+};
@@ -0,0 +1,86 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*-----------------------------------------------( audio_file_pcm_mapping.h )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: read uncompressed audio files (WAV, AIFF) without         */
+/*                  decoding, samples are mapped or converted in one pass.    */
+/*                                                                            */
+/*============================================================================*/
+
+#pragma once
+
+#include <QString>
+#include <QFile>
+#include <QSharedPointer>
+
+#include "tracks/audio_track.h"
+#include "tracks/audio_sample_converter.h"
+
+using namespace std;
+
+enum class Pcm_sample_format
+{
+    UNSUPPORTED,
+    S16,            // Same as the internal format (if stereo).
+    S16_SWAPPED,    // Big endian (AIFF).
+    S24_PACKED,
+    S32,
+    FLOAT,
+    DOUBLE
+};
+
+class Audio_file_pcm_mapping
+{
+ private:
+    QSharedPointer<QFile>   file;
+    uchar                  *file_data;                 // Whole file mapped in memory.
+    Pcm_sample_format       sample_format;
+    unsigned short int      nb_channels;
+    unsigned int            sample_rate;
+    unsigned int            nb_frames;
+    qint64                  data_offset;               // Position of first sample in the file.
+    Audio_sample_converter  converter;
+
+ public:
+    Audio_file_pcm_mapping();
+    virtual ~Audio_file_pcm_mapping();
+
+    bool         open(const QString &path);            // Map the file and parse RIFF/WAVE or AIFF header.
+    unsigned int get_sample_rate();
+    bool         load(const QSharedPointer<Audio_track> &at,
+                      const bool                        &do_resample); // Use file samples in the track (false: must be decoded).
+
+ private:
+    bool   parse_wav(const qint64 &file_size);
+    bool   parse_aiff(const qint64 &file_size);
+    bool   set_format(const Pcm_sample_format  &sample_format,
+                      const unsigned short int &nb_channels,
+                      const unsigned int       &sample_rate,
+                      const qint64             &data_offset,
+                      const qint64             &data_size);
+    void   close();
+};
@@ -0,0 +1,86 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*-----------------------------------------------( audio_sample_converter.h )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: convert decoded samples (planar or interleaved, integer   */
+/*                  or floating point) to the internal interleaved stereo     */
+/*                  16 bits format.                                           */
+/*                                                                            */
+/*============================================================================*/
+
+#pragma once
+
+#include <cstdint>
+
+using namespace std;
+
+class Audio_sample_converter
+{
+ private:
+    uint32_t dither_state[4];  // Random generators (one per SIMD lane) used for TPDF dithering.
+    bool     do_dither;
+
+ public:
+    Audio_sample_converter();
+    virtual ~Audio_sample_converter();
+
+ public:
+    // All converters write nb_frames stereo frames (interleaved) to out_samples.
+    // Mono input is duplicated on both channels, only the 2 first channels are used for multichannel input.
+    void set_dither(const bool &do_dither);                    // Enable TPDF dithering when reducing resolution to 16 bits.
+    void set_dither_seed(const uint64_t &seed);                // Start dither generators from a seed (converters used
+                                                               // in parallel on one track must have different seeds).
+
+    void s16_to_s16(const int16_t *in_samples, const unsigned short int &nb_channels,
+                    const unsigned int &nb_frames, int16_t *out_samples);
+    void s16_planar_to_s16(const int16_t * const *in_planes, const unsigned short int &nb_channels,
+                           const unsigned int &nb_frames, int16_t *out_samples);
+    void s16_swapped_to_s16(const int16_t *in_samples, const unsigned short int &nb_channels,
+                            const unsigned int &nb_frames, int16_t *out_samples); // Other endianness (AIFF).
+    void s24_packed_to_s16(const uint8_t *in_samples, const unsigned short int &nb_channels,
+                           const unsigned int &nb_frames, int16_t *out_samples);  // 3 bytes little endian (WAV).
+    void s32_to_s16(const int32_t *in_samples, const unsigned short int &nb_channels,
+                    const unsigned int &nb_frames, int16_t *out_samples);
+    void s32_planar_to_s16(const int32_t * const *in_planes, const unsigned short int &nb_channels,
+                           const unsigned int &nb_frames, int16_t *out_samples);
+    void flt_to_s16(const float *in_samples, const unsigned short int &nb_channels,
+                    const unsigned int &nb_frames, int16_t *out_samples);
+    void flt_planar_to_s16(const float * const *in_planes, const unsigned short int &nb_channels,
+                           const unsigned int &nb_frames, int16_t *out_samples);
+    void dbl_to_s16(const double *in_samples, const unsigned short int &nb_channels,
+                    const unsigned int &nb_frames, int16_t *out_samples);
+    void dbl_planar_to_s16(const double * const *in_planes, const unsigned short int &nb_channels,
+                           const unsigned int &nb_frames, int16_t *out_samples);
+
+ private:
+    template <typename T> void interleaved_to_s16(const T *in_samples, const unsigned short int &nb_channels,
+                                                  const unsigned int &nb_frames, const float &scale, int16_t *out_samples);
+    template <typename T> void planar_to_s16(const T * const *in_planes, const unsigned short int &nb_channels,
+                                             const unsigned int &nb_frames, const float &scale, int16_t *out_samples);
+    float   next_dither();                                     // Scalar TPDF noise in [-1.0, 1.0[ (16 bits LSB).
+    int16_t to_s16(const float &value);                        // Dither, round and saturate one sample.
+};
@@ -0,0 +1,51 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*------------------------------------------------( audio_stream_analyzer.h )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Interface class: analysis of an audio stream given chunk by chunk         */
+/*                   (so a file is decoded once for all analyzers).           */
+/*                                                                            */
+/*============================================================================*/
+
+#pragma once
+
+#include <QSharedPointer>
+
+#include "tracks/audio_track.h"
+
+using namespace std;
+
+class Audio_stream_analyzer
+{
+ public:
+    virtual ~Audio_stream_analyzer() {}
+
+    virtual void start(const unsigned int &sample_rate) = 0;           // A new stream begins (working buffers are kept for the next one).
+    virtual void process(const short signed int *samples,              // Analyze a chunk of interleaved stereo frames.
+                         const unsigned int     &nb_frames) = 0;
+    virtual bool finish(const QSharedPointer<Audio_track> &io_at) = 0; // End of stream: compute result (set to the track if it is a track attribute).
+};
@@ -35,8 +35,15 @@
 #include <string>
 #include <QObject>
 #include <QString>
+#include <QStringList>
+#include <QFile>
+#include <QSharedPointer>
 
 #include <app/application_const.h>
+#include "tracks/audio_track_peaks.h"
+
+#define MAPPED_LOCKED_HEAD_SEC 60 // If the memlock limit is too low to lock a whole mapped file, only its beginning is locked (sec).
+#define MAPPED_FAULT_NB_PAGES  256 // Pages of mapped samples loaded in background between two budget checks.
 
 using namespace std;
 
@@ -45,7 +52,12 @@ class Audio_track : public QObject
  private:
     unsigned int       sample_rate;               // Sample rate of decoded samples.
     short signed int  *samples;                   // Table of decoded samples.
+    short signed int  *mapped_samples;            // Samples read directly in a memory mapped file (null if decoded).
+    QSharedPointer<QFile> mapped_file;            // File kept open (and mapped) while its samples are used.
+    unsigned int       mapped_nb_samples;         // Number of mapped samples.
     unsigned int       end_of_samples;            // The last filled sample in the table of samples.
+    unsigned int       max_used_samples;          // Highest end of samples since last reset (part of the table to clear).
+    Audio_track_peaks *peaks;                     // Summary of samples used to draw waveforms.
     unsigned int       length;                    // Length of the track (ms).
     QString            name;                      // Name of the track.
     QString            path;                      // Path of the file.
@@ -54,6 +66,16 @@ class Audio_track : public QObject
     QString            hash;                      // Hash of the first kbytes of the file.
     QString            music_key;                 // The main musical key of the track.
     QString            music_key_tag;             // The main musical key of the track (get from metadata tag).
+    float              bpm;                       // Tempo of the track (0 if unknown).
+    unsigned int       first_beat;                // Position of the first beat of the beat grid (msec).
+    float              loudness;                  // Integrated loudness of the track (LUFS, 0 if unknown).
+    bool               analyzed;                  // Key, bpm and loudness were computed by an analysis of the file.
+    unsigned int       cue_points[MAX_NB_CUE_POINTS]; // Positions of cue points (msec, 0 if not defined), loaded with the track.
+    QStringList        tags;                      // Tags of the track, loaded with the track.
+
+    bool               lock_mapped_samples(const unsigned int &nb_samples); // Load and lock in memory pages of the first mapped samples.
+    void               unlock_mapped_samples();
+    void               fault_mapped_samples(const unsigned int &from_sample); // Load pages of mapped samples in background (not locked).
 
  public:
     explicit Audio_track(const unsigned int &sample_rate);   // Does not contains any samples.
@@ -63,9 +85,15 @@ class Audio_track : public QObject
 
  public:
     void              reset();                                                // Reset internal track parameters.
+    bool              swap(Audio_track &other);                               // Exchange samples and metadata with another track of same size.
     short signed int *get_samples() const;                                    // Get a pointer on table of samples.
     unsigned int      get_end_of_samples() const;                             // Get index of last used sample.
     bool              set_end_of_samples(const unsigned int &end_of_samples); // Set index of last used sample.
+    bool              set_mapped_samples(const QSharedPointer<QFile> &file,
+                                         short signed int            *samples,
+                                         const unsigned int          &nb_samples);  // Use samples of a mapped file instead of decoded ones.
+    bool              is_mapped() const;                                      // True if samples are read in a mapped file.
+    Audio_track_peaks *get_peaks() const;                                     // Get summary of samples (null if no samples).
     unsigned int      get_max_nb_samples() const;                             // Get maximum number of samples.
     unsigned int      get_sample_rate() const;                                // Get sample rate.
     unsigned int      get_security_nb_samples() const;                        // Get number of samples used for decoding security purpose.
@@ -83,4 +111,19 @@ class Audio_track : public QObject
     bool              set_music_key(const QString &key);                      // Set music key of the track.
     QString           get_music_key_tag() const;                              // Get music key of the track (from tag).
     bool              set_music_key_tag(const QString &key_tag);              // Set music key of the track (from tag).
+    float             get_bpm() const;                                        // Get tempo of the track (0 if unknown).
+    bool              set_bpm(const float &bpm);                              // Set tempo of the track.
+    unsigned int      get_first_beat() const;                                 // Get position of the first beat (msec).
+    bool              set_first_beat(const unsigned int &first_beat_msec);    // Set position of the first beat (msec).
+    float             get_loudness() const;                                   // Get integrated loudness (LUFS, 0 if unknown).
+    bool              set_loudness(const float &loudness);                    // Set integrated loudness (LUFS).
+    bool              is_analyzed() const;                                    // True if key, bpm and loudness come from an analysis.
+    void              set_analyzed(const bool &analyzed);                     // Mark the track as analyzed (even if bpm is 0).
+    unsigned int      get_cue_point(const unsigned int &number) const;        // Get position of a cue point (msec, 0 if not defined).
+    bool              set_cue_point(const unsigned int &number,               // Set position of a cue point (msec, 0 to delete it).
+                                    const unsigned int &position_msec);
+    QStringList       get_tags() const;                                       // Get tags of the track.
+    void              set_tags(const QStringList &tags);                      // Set tags of the track.
+    QSharedPointer<Audio_track> get_metadata_copy() const;                    // Get a track without samples but with the same metadata
+                                                                              // (safe to use in another thread).
 };
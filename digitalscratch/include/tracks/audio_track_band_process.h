@@ -0,0 +1,90 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*---------------------------------------------( audio_track_band_process.h )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: compute low/mid/high energies of a decoded track with a   */
+/*                  3 bands crossover filter bank.                            */
+/*                                                                            */
+/*============================================================================*/
+
+#pragma once
+
+#include <iostream>
+#include <QSharedPointer>
+#include <QByteArray>
+#include <QAtomicInt>
+#include <QVector>
+
+#include "tracks/audio_track.h"
+#include "tracks/audio_track_peaks.h"
+#include "tracks/audio_stream_analyzer.h"
+
+#define BAND_LOW_CROSSOVER_HZ  200.0f  // Below is the low band.
+#define BAND_HIGH_CROSSOVER_HZ 2000.0f // Above is the high band, in between is the mid band.
+#define BAND_NB_FILTER_BANKS   2       // First bank splits at low crossover, second one splits its upper part at high crossover.
+#define BAND_NB_FILTER_STAGES  2       // Two cascaded Butterworth biquads (4th order Linkwitz-Riley).
+#define BAND_NB_LANES          4       // Each bank runs 4 filters in parallel: [low pass left, low pass right, high pass left, high pass right].
+
+using namespace std;
+
+class Audio_track_band_process : public Audio_stream_analyzer
+{
+ private:
+    QSharedPointer<Audio_track> at;
+    QString                     hash;                                            // Hash of the analyzed track.
+    QByteArray                  bands;                                           // Result (see Audio_track_peaks::set_bands()).
+    QAtomicInt                  must_stop;
+    bool                        is_loaded;                                       // Bands come from DB (not computed).
+    float                       coefs[BAND_NB_FILTER_BANKS][5][BAND_NB_LANES];                         // b0, b1, b2, a1, a2 of each lane.
+    float                       states[BAND_NB_FILTER_BANKS][BAND_NB_FILTER_STAGES][2][BAND_NB_LANES]; // z1, z2 of each stage and lane.
+    QVector<float>              rms;                                             // RMS of each band for each bin.
+    float                       bin_energies[PEAKS_NB_BANDS];                    // Bin being computed.
+    unsigned int                bin_nb_frames;
+
+ public:
+    Audio_track_band_process();                                     // Streaming use only.
+    explicit Audio_track_band_process(const QSharedPointer<Audio_track> &at);
+    virtual ~Audio_track_band_process();
+
+    bool              load();             // Get energies of bands computed before (from DB).
+    bool              run();              // Compute energies of low/mid/high bands for each bin of the track.
+    void              stop();             // Ask a running analysis to stop as soon as possible.
+    const QString    &get_hash() const;
+    const QByteArray &get_bands() const;
+    bool              is_loaded_from_db() const;
+
+    void start(const unsigned int &sample_rate);
+    void process(const short signed int *samples,
+                 const unsigned int     &nb_frames);
+    bool finish(const QSharedPointer<Audio_track> &io_at);  // Bands are kept here (io_at gives the hash).
+
+ private:
+    void init_filters(const unsigned int &sample_rate);
+    void filter_bin(const short signed int *samples,
+                    const unsigned int     &nb_frames,
+                    float                  *energies);  // Sum of squares of each band.
+};
@@ -0,0 +1,87 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*----------------------------------------------( audio_track_bpm_process.h )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: estimate tempo and beat grid of a decoded track.          */
+/*                                                                            */
+/*============================================================================*/
+
+#pragma once
+
+#include <iostream>
+#include <QSharedPointer>
+#include <QVector>
+
+#include "tracks/audio_track.h"
+#include "tracks/audio_stream_analyzer.h"
+
+#define BPM_DOWNSAMPLED_RATE 11025  // Approximate sample rate of the mono signal used for analysis (Hz).
+#define BPM_ENVELOPE_RATE    200    // Approximate number of onset envelope values per second.
+#define BPM_MIN              70.0f  // Tempo is searched inside [BPM_MIN, BPM_MAX].
+#define BPM_MAX              180.0f
+#define BPM_PREFERRED        120.0f // Tempo prior: center of the preferred range (used to avoid half/double tempo).
+#define BPM_NB_HARMONICS     4      // Number of multiples of the beat period summed by the comb filter.
+#define BPM_ONSET_SMOOTHING  2      // Onsets are smoothed over +/- 2 envelope values (so peaks of autocorrelation are not too sharp).
+#define BPM_REFINE_RANGE     0.01f  // Period is refined inside +/- 1% of the one found by the comb filter.
+#define BPM_REFINE_NB_STEPS  100
+
+using namespace std;
+
+class Audio_track_bpm_process : public Audio_stream_analyzer
+{
+ private:
+    QSharedPointer<Audio_track> at;
+    QVector<float>              onsets;         // Onset strength envelope.
+    float                       envelope_rate;  // Exact number of onset values per second.
+    unsigned int                decimation;     // Number of frames averaged in a downsampled value.
+    unsigned int                hop;            // Number of downsampled values in an onset value.
+    int                         mono_sum;       // Downsampled value being computed.
+    unsigned int                nb_mono_frames;
+    float                       hop_energy;     // Energy of the onset value being computed.
+    unsigned int                nb_hop_values;
+    float                       previous_energy;
+
+ public:
+    Audio_track_bpm_process();                                  // Streaming use only.
+    explicit Audio_track_bpm_process(const QSharedPointer<Audio_track> &at);
+    virtual ~Audio_track_bpm_process();
+
+    bool run();         // Compute tempo and first beat of the track and set them to the Audio_track object.
+
+    void start(const unsigned int &sample_rate);
+    void process(const short signed int *samples,
+                 const unsigned int     &nb_frames);
+    bool finish(const QSharedPointer<Audio_track> &io_at);
+
+ private:
+    void  smooth_onsets();                             // Remove the mean and sharpness of the onset strength envelope.
+    float get_beat_period(const QVector<float> &ac);   // Period (in envelope values) selected by the comb filter.
+    float get_comb_score(const QVector<float> &ac,
+                         const float          &period);
+    float get_beat_phase(const float &period,          // Offset of the first beat (in envelope values).
+                         float       &out_score);      // Sum of onsets hit by the beat grid.
+};
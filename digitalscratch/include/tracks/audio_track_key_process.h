@@ -34,21 +34,51 @@
 
 #include <iostream>
 #include <QSharedPointer>
+#include <QVector>
 #include <keyfinder_api.h>
 
 #include "tracks/audio_track.h"
+#include "tracks/audio_stream_analyzer.h"
 #include "app/application_const.h"
 
+#define KEY_DOWNSAMPLED_RATE  11025   // Approximate rate of the mono signal given to the key finder (Hz).
+#define KEY_LOWPASS_HZ        4000.0f // Anti aliasing filter before decimation (key finder does not use notes above ~3.5 kHz).
+#define KEY_FILTER_NB_STAGES  4       // 8th order Butterworth low pass.
+#define KEY_NB_WINDOWS        8       // By default, key is computed on 8 windows of 15 sec spread across the track.
+#define KEY_WINDOW_MSEC       15000
+
 using namespace std;
 
-class Audio_track_key_process
+class Audio_track_key_process : public Audio_stream_analyzer
 {
  private:
     QSharedPointer<Audio_track> at;
+    QVector<short signed int>   mono_samples;                       // Downsampled stream (buffer is reused from a stream to another).
+    unsigned int                sample_rate;                        // Rate of mono_samples.
+    unsigned int                decimation;                         // Number of input frames for one mono sample.
+    unsigned int                nb_decimated_frames;                // Input frames since last kept mono sample.
+    float                       coefs[KEY_FILTER_NB_STAGES][5];     // b0, b1, b2, a1, a2 of the low pass stages.
+    float                       states[KEY_FILTER_NB_STAGES][2];    // z1, z2 of each stage.
+    unsigned short int          nb_windows;                         // Analyzed parts of the track (0 = whole track).
+    unsigned int                window_msec;
 
  public:
+    Audio_track_key_process();                                  // Streaming use only.
     explicit Audio_track_key_process(const QSharedPointer<Audio_track> &at);
     virtual ~Audio_track_key_process();
 
     bool run();         // Compute music key of the track and set it to the Audio_track object.
+    void set_windows(const unsigned short int &nb_windows,      // Analyze only nb_windows parts of the track (0 = whole track).
+                     const unsigned int       &window_msec);
+
+    void start(const unsigned int &sample_rate);
+    void process(const short signed int *samples,
+                 const unsigned int     &nb_frames);
+    bool finish(const QSharedPointer<Audio_track> &io_at);
+
+ private:
+    void         init_filter(const unsigned int &input_sample_rate);
+    unsigned int select_windows();                              // Keep only analyzed windows at the beginning of mono_samples.
+    bool         set_key(const QString                     &key,
+                         const QSharedPointer<Audio_track> &io_at);
 };
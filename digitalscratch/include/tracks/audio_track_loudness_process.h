@@ -0,0 +1,71 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*-----------------------------------------( audio_track_loudness_process.h )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: measure integrated loudness of a track (ITU-R BS.1770     */
+/*                  K-weighting and gating).                                  */
+/*                                                                            */
+/*============================================================================*/
+
+#pragma once
+
+#include <iostream>
+#include <QSharedPointer>
+#include <QVector>
+
+#include "tracks/audio_track.h"
+#include "tracks/audio_stream_analyzer.h"
+
+#define LOUDNESS_STEP_MSEC         100     // Gating blocks are 400 msec long and overlap by 75%, so they are made of 4 steps.
+#define LOUDNESS_NB_STEPS_BY_BLOCK 4
+#define LOUDNESS_ABSOLUTE_GATE     -70.0   // Blocks under it are silence (LUFS).
+#define LOUDNESS_RELATIVE_GATE     -10.0   // Blocks under the loudness of the others minus 10 LU are ignored.
+
+using namespace std;
+
+class Audio_track_loudness_process : public Audio_stream_analyzer
+{
+ private:
+    double         coefs[2][5];         // b0, b1, b2, a1, a2 of the K-weighting filter (high shelf, then high pass).
+    double         states[2][2][2];     // z1, z2 of each stage and channel.
+    QVector<float> step_powers;         // Mean square of K-weighted signal for each step.
+    double         step_sum;            // Step being computed.
+    unsigned int   step_nb_frames;
+    unsigned int   step_size;           // Number of frames in a step.
+
+ public:
+    Audio_track_loudness_process();
+    virtual ~Audio_track_loudness_process();
+
+    void start(const unsigned int &sample_rate);
+    void process(const short signed int *samples,
+                 const unsigned int     &nb_frames);
+    bool finish(const QSharedPointer<Audio_track> &io_at);  // Set integrated loudness to the track.
+
+ private:
+    float get_gated_power(const double &threshold);          // Mean power of blocks above threshold (0 if none).
+};
@@ -0,0 +1,98 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*----------------------------------------------------( audio_track_peaks.h )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: min/max/RMS summary of an audio track at several          */
+/*                  resolutions (used to draw waveforms).                     */
+/*                                                                            */
+/*============================================================================*/
+
+#pragma once
+
+#include <QVector>
+#include <QByteArray>
+#include <cstdint>
+
+using namespace std;
+
+#define PEAKS_NB_LEVELS      4
+#define PEAKS_BASE_BIN_SIZE  64 // Number of frames summarized by a bin of the first level.
+#define PEAKS_LEVEL_FACTOR   4  // Each level has bins 4 times bigger than the previous one (64, 256, 1024, 4096 frames).
+#define PEAKS_BAND_BIN_SIZE  1024 // Number of frames summarized by a bin of band energies.
+#define PEAKS_NB_BANDS       3    // Low, mid and high.
+
+struct Audio_peak
+{
+    short signed int min;
+    short signed int max;
+    float            rms;
+};
+
+struct Audio_bands
+{
+    unsigned char low;  // Energies are between 0 and 255 (relative to the loudest bin of the track for this band).
+    unsigned char mid;
+    unsigned char high;
+};
+
+class Audio_track_peaks
+{
+ private:
+    QVector<Audio_peak> levels[PEAKS_NB_LEVELS];
+    unsigned int        nb_bins[PEAKS_NB_LEVELS];    // Number of bins in use for each level.
+    unsigned int        max_nb_frames;
+    QByteArray          bands;                       // Low/mid/high energies of each band bin (empty if not analyzed yet).
+
+ public:
+    explicit Audio_track_peaks(const unsigned int &max_nb_frames);
+    virtual ~Audio_track_peaks();
+
+    void              reset();
+    unsigned int      compute_bins(const short signed int *samples,
+                                   const unsigned int     &first_frame,
+                                   const unsigned int     &last_frame); // Summarize first level bins inside [first, last[, return end of last summarized bin.
+    void              finish(const short signed int *samples,
+                             const unsigned int     &nb_frames);        // Summarize missing bins and build other levels.
+    unsigned short    get_level(const float &nb_frames_per_pixel) const; // Most detailed level with bins not bigger than a pixel.
+    unsigned int      get_bin_size(const unsigned short &level) const;
+    unsigned int      get_nb_bins(const unsigned short &level) const;
+    const Audio_peak *get_bins(const unsigned short &level) const;
+    Audio_peak        get_peak(const unsigned short &level,
+                               const unsigned int   &first_bin,
+                               const unsigned int   &last_bin) const;  // Summary of bins [first, last[.
+
+    void              set_bands(const QByteArray &bands);                // PEAKS_NB_BANDS bytes per band bin.
+    const QByteArray &get_bands() const;
+    bool              has_bands() const;
+    Audio_bands       get_bands(const unsigned int &first_frame,
+                                const unsigned int &last_frame) const; // Highest energy of each band inside [first, last[.
+
+ private:
+    void summarize_bin(const short signed int *samples,
+                       const unsigned int     &nb_frames,
+                       Audio_peak             &peak);
+};
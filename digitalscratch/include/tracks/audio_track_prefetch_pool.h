@@ -0,0 +1,100 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*--------------------------------------------( audio_track_prefetch_pool.h )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: speculative decoding of the tracks which are likely to    */
+/*                  be loaded next, kept in a bounded pool of audio tracks.   */
+/*                                                                            */
+/*============================================================================*/
+
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QTimer>
+#include <QAtomicInt>
+#include <QFutureWatcher>
+#include <QSharedPointer>
+
+#include "tracks/audio_track.h"
+#include "tracks/audio_file_decoding_process.h"
+#include "app/application_const.h"
+
+using namespace std;
+
+#define PREFETCH_START_DELAY_MSEC   300  // Wait for the selection to be stable before decoding.
+
+enum class Prefetch_state
+{
+    FREE,
+    DECODING,
+    READY
+};
+
+struct Prefetch_slot
+{
+    QSharedPointer<Audio_track>                 at;
+    QSharedPointer<Audio_file_decoding_process> decoder;
+    QString                                     path;
+    Prefetch_state                              state;
+    unsigned long int                           last_use;
+};
+
+class Audio_track_prefetch_pool : public QObject
+{
+    Q_OBJECT
+
+ private:
+    QList<Prefetch_slot>                    pool_slots;
+    unsigned short int                      max_nb_slots;
+    unsigned int                            sample_rate;
+    QStringList                             candidates;
+    QStringList                             failed_paths;
+    QFutureWatcher<bool>                    decoding_watcher;
+    int                                     decoding_slot;
+    QTimer                                  start_timer;
+    QAtomicInt                              decoding_canceled;  // The track being decoded is not needed anymore (e.g. loaded by a deck).
+    unsigned long int                       use_counter;
+
+ public:
+    Audio_track_prefetch_pool(const unsigned short int &nb_slots,
+                              const unsigned int       &sample_rate);
+    virtual ~Audio_track_prefetch_pool();
+
+    void set_candidates(const QStringList &paths);                   // Tracks likely to be loaded next (most probable first).
+    bool take(const QString &path, const QSharedPointer<Audio_track> &deck_at); // Swap a prefetched track into the deck track.
+    bool is_prefetched(const QString &path);                         // True if path is decoded and ready to be taken.
+
+ private:
+    void schedule_next();                                            // Start decoding of the next missing candidate.
+    int  find_slot(const QString &path);                             // Get slot which contains or decodes path (-1 if none).
+    int  get_victim_slot();                                          // Get a slot to decode into (-1 if none).
+    void on_decoding_finished();                                     // Publish the decoded slot and continue with next candidate.
+    void publish_decoded_slot();                                     // Make the decoded slot ready (or free if decoding failed or was canceled).
+};
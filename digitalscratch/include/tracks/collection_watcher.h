@@ -0,0 +1,94 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*---------------------------------------------------( collection_watcher.h )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: watch the tracks base directory (inotify) and report      */
+/*                  changed and removed audio files.                          */
+/*                                                                            */
+/*============================================================================*/
+
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QTimer>
+#include <QFutureSynchronizer>
+#include <QAtomicInt>
+#include <QSocketNotifier>
+
+using namespace std;
+
+#define WATCHER_FLUSH_DELAY_MSEC 1000  // Changes are reported together once the file system is quiet for this time.
+#define WATCHER_RESCAN_MSEC      60000 // Directories which can not be watched are listed again with this period.
+
+class Collection_watcher : public QObject
+{
+    Q_OBJECT
+
+ private:
+    int                       fd;               // inotify instance (-1 if not available).
+    QSocketNotifier          *notifier;
+    QString                   root_path;
+    QMutex                    mutex;            // Watches are also added by a background job.
+    QHash<int, QString>       dir_by_watch;     // Watched directories.
+    QSet<QString>             changed_paths;    // Created, modified or moved in since the last report.
+    QSet<QString>             removed_paths;    // Deleted or moved out since the last report.
+    QFutureSynchronizer<bool> watches_jobs;     // Background listings of directories to watch.
+    QAtomicInt                is_stopping;
+    QTimer                    flush_timer;
+    QTimer                    rescan_timer;
+    bool                      limit_reached;    // Too many directories (see fs.inotify.max_user_watches).
+    QStringList               unwatched_dirs;   // Top directories of subtrees not watched because of the limit.
+
+ public:
+    Collection_watcher();
+    virtual ~Collection_watcher();
+
+    bool set_root_path(const QString &path);                  // Watch all directories under path (previous ones are forgotten).
+    void stop();                                              // Stop watching.
+
+ signals:
+    void files_changed(QStringList changed_paths,             // Files (or directories) created, modified or moved in,
+                       QStringList removed_paths);            // and the ones deleted or moved out.
+    void rescan_needed(QString dir_path);                     // Changes under dir_path can be missed, its files must be listed again.
+
+ private:
+    void start_watching(const QString &dir_path,              // Add watches in a background job.
+                        const bool    &report_files);
+    bool add_watches(const QString &dir_path,                 // Watch a directory and its subdirectories, can also
+                     const bool    &report_files);            // report audio files already in them (e.g. moved in).
+    void remove_watches(const QString &dir_path);             // Forget a directory moved out and its subdirectories.
+    void add_unwatched(const QString &dir_path);              // Keep a directory which can not be watched (rescanned periodically).
+    void rescan_unwatched();
+    void read_events();
+    void flush();
+    bool is_audio_file(const QString &name);
+};
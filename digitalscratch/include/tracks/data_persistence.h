@@ -35,13 +35,43 @@
 #include <iostream>
 #include <QObject>
 #include <QSqlDatabase>
+#include <QSqlQuery>
 #include <QMutex>
+#include <QThreadStorage>
+#include <QAtomicInt>
 #include <QSharedPointer>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
 
 #include "tracks/audio_track.h"
+#include "utils.h"
 
 using namespace std;
 
+#define TAG_POSITION_STEP 1024 // Gap between positions of tracks in the track list of a tag (a track is moved in between).
+
+// DB connection of one thread (a connection can not be shared between threads)
+// with its prepared statements.
+struct Data_persistence_connection
+{
+    QString                    name;    // Name of the connection.
+    QSqlDatabase               db;      // Opened connection.
+    QHash<QString, QSqlQuery*> queries; // Prepared statements (by SQL text).
+
+    ~Data_persistence_connection();
+};
+
+// Analysis data of a track, as loaded for the whole collection.
+struct Audio_track_data
+{
+    qint8   key;        // Camelot index (CAMELOT_UNKNOWN_KEY if not analyzed).
+    float   bpm;        // 0 if not analyzed.
+    quint32 first_beat; // Msec.
+    float   loudness;   // LUFS (0 if unknown).
+    bool    analyzed;   // Key, bpm and loudness come from an analysis (bpm may be 0).
+};
+
 class Data_persistence
 {
  public:
@@ -52,14 +82,20 @@ class Data_persistence
     bool is_initialized;
 
  private:
-    QSqlDatabase db;
-    QMutex       mutex;
+    QString                                      db_path;        // Path of the DB file.
+    QThreadStorage<Data_persistence_connection*> connections;    // DB connection of each thread.
+    QAtomicInt                                   nb_connections; // Number of connections opened (to name them).
+    QMutex                                       mutex;          // Only one thread writes at a time, readers are not blocked (WAL).
+    QAtomicInt                                   nb_legacy_tracks; // Tracks still identified by the hash of previous versions.
 
  public:
     bool rollback_transaction();
 
     bool store_audio_track(const QSharedPointer<Audio_track> &at);        // Insert (or update if exists) an audio track in DB.
     bool get_audio_track(QSharedPointer<Audio_track> &io_at);             // Get and fill the audio track specified by io_at->get_hash().
+    bool store_audio_tracks(const QList<QSharedPointer<Audio_track>> &tracks, // Insert (or update) audio tracks and their band
+                            const QList<QByteArray>                 &bands);  // energies (if not empty) in one transaction.
+    bool get_audio_tracks_data(QHash<Hash_128, Audio_track_data> &out_data);  // Get analysis data of all tracks (by hash) in one query.
 
     bool store_cue_point(const QSharedPointer<Audio_track>   &at,         // Insert (or update) a cue point in DB.
                          const unsigned int                  &number,
@@ -69,6 +105,19 @@ class Data_persistence
                        unsigned int                          &out_position_msec);
     bool delete_cue_point(const QSharedPointer<Audio_track>  &at,         // Delete the in_number cue point of an audio track.
                           const unsigned int                 &number);
+    bool get_cue_points_and_tags(QSharedPointer<Audio_track> &io_at);     // Get all cue points and tags of io_at->get_hash() in one query.
+
+    bool store_waveform_bands(const QSharedPointer<Audio_track> &at,       // Insert (or replace) frequency band energies of a track.
+                              const QByteArray                  &bands);
+    bool get_waveform_bands(const QSharedPointer<Audio_track>   &at,       // Get frequency band energies (only if computed at the
+                            QByteArray                          &out_bands); // sample rate of the decoded track).
+
+    bool get_file_identities(const QString                  &root_path,   // Get cached identity (size, mtime, inode, hash) of files
+                             QHash<QString, File_identity>  &out_identities); // under root_path (all files if empty).
+    bool store_file_identities(const QHash<QString, File_identity> &identities); // Insert (or replace) identities of files, tracks stored by a previous
+                                                                           // version are identified by the new hash (if a legacy hash is set).
+    bool delete_file_identities(const QStringList &paths);                 // Forget identities of removed files (or of all files under removed directories).
+    bool has_legacy_tracks();                                              // Some tracks are still identified by the hash of previous versions.
 
     bool store_tag(const QString &name);                                   // Insert a new tag.
     bool rename_tag(const QString &old_name,                               // Rename a tag.
@@ -82,26 +131,44 @@ class Data_persistence
                             const QString                     &tag_name);
     bool get_tags_from_track(const QSharedPointer<Audio_track> &at,        // Get the list of tags for the specified track.
                              QStringList                       &out_tags);
+    bool get_tags_of_tracks(QHash<QString, QStringList> &out_tags);        // Get tags of all tracks (by hash of track).
     bool get_tracks_from_tag(const QString                     &tag_name,  // Get the list of tracks for the specified tag.
                              QStringList                       &out_tracklist);
     bool switch_track_positions_in_tag_list(const QString &tag_name,                // In the tracklist of a specified tag,
                                             const QSharedPointer<Audio_track> &at1, // Switch position of 2 tracks.
                                             const QSharedPointer<Audio_track> &at2);
+    bool move_track_in_tag_list(const QString                     &tag_name, // In the tracklist of a specified tag, move a track
+                                const QSharedPointer<Audio_track> &at,       // just before at_next (at the end if at_next is null).
+                                const QSharedPointer<Audio_track> &at_next);
 
  private:
     bool init_db();
     bool create_db_structure();
-    bool store_track_tag(const QString &id_track,
-                         const QString &id_tag);
-    bool reorganize_track_pos_in_tag_list();                               // If track/tag association has no position in the track list
-                                                                           // of the tag, then put position to the end of the list.
-                                                                           // Reorganize also position values to have a contiguous list.
-    int get_track_pos_in_tag_list(const QSharedPointer<Audio_track> &at1,
-                                  const QString &tag_name);
-    bool set_track_position_in_tag_list(const QString &tag_name,
-                                        const QSharedPointer<Audio_track> &at,
-                                        const int &position);
+    QSqlDatabase get_db();                                                 // Get the DB connection of the calling thread.
+    QSqlQuery &get_query(const QString &sql);                              // Get a statement prepared once for the calling thread.
+    bool begin_write();                                                    // Lock the writer and start a transaction.
+    bool end_write(const bool &is_ok);                                     // Commit (or rollback) the transaction and unlock the writer.
+    int  get_track_id(const QString &hash);                                // Get id of a track (-1 if not found).
+    int  get_tag_id(const QString &name);                                  // Get id of a tag (-1 if not found).
+    bool write_audio_track(const QSharedPointer<Audio_track> &at,          // Insert (or update) a track, in a write.
+                           int                               &out_id_track);
+    bool write_waveform_bands(const QSharedPointer<Audio_track> &at,       // Insert (or replace) band energies of a track, in a write.
+                              const int                         &id_track,
+                              const QByteArray                  &bands);
+    bool store_track_tag(const int &id_track,                              // Associate a tag to a track, in a write.
+                         const int &id_tag);
+    bool renumber_track_pos_in_tag_list(const int &id_tag);                // Spread positions of the track list of a tag again, keeping
+                                                                           // the order (in a write, only when there is no room left).
+    bool get_track_pos_in_tag_list(const QSharedPointer<Audio_track> &at,  // Get position of a track in the track list of a tag.
+                                   const int                         &id_tag,
+                                   qint64                            &out_position);
+    bool set_track_position_in_tag_list(const QSharedPointer<Audio_track> &at, // Set position of a track in the track list of a tag
+                                        const int                         &id_tag, // (in a write).
+                                        const qint64                      &position);
+    bool get_new_track_pos_in_tag_list(const int    &id_tag,               // Get a position just before next_position (at the end if -1),
+                                       const qint64 &next_position,        // -1 if there is no room left.
+                                       qint64       &out_position);
 #ifndef ENABLE_TEST_MODE
-    void backup_db();
+    void backup_db();                                                   // Copy the DB file in db_backup/ (after a WAL checkpoint).
 #endif
 };
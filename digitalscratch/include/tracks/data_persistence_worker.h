@@ -0,0 +1,133 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*----------------------------------------------( data_persistence_worker.h )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: write data to DB in a dedicated thread (commands are      */
+/*                  queued and coalesced), read data of tracks to load.       */
+/*                                                                            */
+/*============================================================================*/
+
+#pragma once
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+#include <QHash>
+#include <QString>
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QFuture>
+#include <QFutureInterface>
+#include <QStringList>
+
+#include "tracks/audio_track.h"
+#include "utils.h"
+
+using namespace std;
+
+#define PERSISTENCE_DELAY_MSEC       100 // Writes of a burst wait this time to be coalesced (unless someone waits for them).
+#define PERSISTENCE_BATCH_MAX_TRACKS 256 // Tracks stored in one transaction.
+
+enum class Persistence_command_type
+{
+    STORE_AUDIO_TRACK,
+    STORE_CUE_POINT,
+    DELETE_CUE_POINT,
+    ADD_TAG_TO_TRACK,
+    REM_TAG_FROM_TRACK,
+    LOAD_CUE_POINTS_AND_TAGS,
+    LOAD_AUDIO_TRACKS,
+    STORE_FILE_IDENTITIES,
+    DELETE_FILE_IDENTITIES,
+    LOAD_FILE_IDENTITIES,
+    LOAD_TAGS
+};
+
+struct Persistence_command
+{
+    Persistence_command_type               type;
+    QSharedPointer<Audio_track>            at;       // Copy of the track metadata (filled by a load).
+    unsigned int                           number;   // Cue point number.
+    unsigned int                           position; // Cue point position (msec).
+    QByteArray                             bands;    // Band energies of the track (empty if not computed).
+    QString                                tag;
+    QList<QSharedPointer<Audio_track>>     tracks;   // Tracks to fill with data found in DB.
+    QString                                path;     // Root path of identities to load.
+    QStringList                            paths;    // Removed files.
+    QSharedPointer<QHash<QString, File_identity>> identities; // Identities to store (or filled by a load).
+    QSharedPointer<QHash<QString, QStringList>>   tags;       // Tags of all tracks (filled by a load).
+    QSharedPointer<QFutureInterface<bool>> result;   // Result of a load.
+};
+
+class Data_persistence_worker : public QThread
+{
+ private:
+    QMutex                     mutex;
+    QWaitCondition             wake;                // Commands are waiting (or the worker must stop).
+    QWaitCondition             idle;                // All commands are done.
+    QList<Persistence_command> commands;            // Waiting commands, in order.
+    QHash<QString, int>        pending;             // Index of a waiting write in commands (by what it changes).
+    bool                       is_running_commands;
+    bool                       is_urgent;           // Someone waits for the commands, do not delay them.
+    bool                       is_stopping;
+
+ public:
+    Data_persistence_worker();
+    virtual ~Data_persistence_worker();
+
+    void store_audio_track(const QSharedPointer<Audio_track> &at,          // Insert (or update) a track and its band energies
+                           const QByteArray &bands = QByteArray());       // (if not empty).
+    void store_cue_point(const QSharedPointer<Audio_track> &at,            // Insert (or update) a cue point.
+                         const unsigned int                &number,
+                         const unsigned int                &position_msec);
+    void delete_cue_point(const QSharedPointer<Audio_track> &at,           // Delete a cue point.
+                          const unsigned int                &number);
+    void add_tag_to_track(const QSharedPointer<Audio_track> &at,           // Associate a tag to a track.
+                          const QString                     &tag_name);
+    void rem_tag_from_track(const QSharedPointer<Audio_track> &at,         // Delete association between a track and a tag.
+                            const QString                     &tag_name);
+    QFuture<bool> load_cue_points_and_tags(const QSharedPointer<Audio_track> &io_at); // Get cue points and tags of io_at (after
+                                                                                      // previous writes), io_at must not be used until then.
+    QFuture<bool> load_audio_tracks(const QList<QSharedPointer<Audio_track>> &io_tracks); // Get analysis data of tracks (by hash).
+    void store_file_identities(const QHash<QString, File_identity> &identities); // Insert (or replace) identities of files.
+    void delete_file_identities(const QStringList &paths);                 // Forget identities of removed files.
+    QFuture<bool> load_file_identities(const QString                                 &root_path, // Get identities of files
+                                       QSharedPointer<QHash<QString, File_identity>>  out_identities); // under root_path.
+    QFuture<bool> load_tags(QSharedPointer<QHash<QString, QStringList>> out_tags);  // Get tags of all tracks (by hash).
+    void flush();                                                          // Wait until all queued commands are done.
+    void stop();                                                           // Run queued commands and stop the thread.
+
+ protected:
+    void run();
+
+ private:
+    void push(const Persistence_command &command,                          // Queue a command, replace the waiting one changing
+              const QString             &key);                             // the same thing (if key is not empty).
+    QFuture<bool> push_load(Persistence_command &command);                 // Queue a read, get its result with the future.
+    void run_commands(const QList<Persistence_command> &commands);
+};
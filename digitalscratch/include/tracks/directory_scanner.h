@@ -0,0 +1,120 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*----------------------------------------------------( directory_scanner.h )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: list audio files under directories with parallel          */
+/*                  workers (work stealing).                                  */
+/*                                                                            */
+/*============================================================================*/
+
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QVector>
+#include <QList>
+#include <QSet>
+#include <QPair>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QSharedPointer>
+#include <functional>
+
+#include "utils.h"
+
+using namespace std;
+
+#define SCANNER_BATCH_SIZE       256        // Files reported together by a worker.
+#define SCANNER_DENTS_BUFFER     (32*1024)  // Size of the buffer given to getdents64.
+#define SCANNER_IDLE_WAIT_MSEC   20         // A worker without directory to list is woken up by a push or at least after this time.
+#define SCANNER_REPORT_MSEC      100        // Files found are reported after this time even if the batch is not full.
+
+struct Scanned_file
+{
+    QString       name;
+    QString       path;
+    File_identity identity; // Size, modification time and inode got while listing (hash is empty).
+};
+
+struct Scanner_deque
+{
+    QMutex            mutex;
+    QList<QByteArray> dirs;  // Owner pushes and pops at the back, other workers steal at the front.
+};
+
+struct Scanner_state
+{
+    QList<QByteArray>                                 extensions;    // Lower case, with the leading dot.
+    QStringList                                       filters;       // Same as name filters (used without getdents64).
+    QVector<QSharedPointer<Scanner_deque>>            deques;        // One per worker.
+    QAtomicInt                                        nb_pending;    // Directories queued or being listed.
+    QAtomicInt                                        nb_queued;     // Directories queued only.
+    QAtomicInt                                        nb_idle;       // Workers waiting for a directory.
+    QMutex                                            idle_mutex;
+    QWaitCondition                                    work_available; // A directory was queued or the scan is over.
+    QAtomicInt                                        next_worker;   // Deque given to the next helper.
+    QMutex                                            visited_mutex;
+    QSet<QPair<quint64, quint64>>                     visited;       // Device and inode of listed directories (symlink loops).
+    QSet<QString>                                     visited_paths; // Same by canonical path (used without getdents64).
+    QMutex                                            workers_mutex;
+    QWaitCondition                                    workers_done;
+    int                                               nb_helpers;    // Helpers currently scanning.
+    bool                                              is_over;       // Late helpers must not start.
+    std::function<void(const QVector<Scanned_file>&)> report;
+    std::function<bool()>                             is_canceled;
+};
+
+class Directory_scanner
+{
+ private:
+    QStringList extensions;
+    int         nb_workers;
+
+ public:
+    Directory_scanner(const QStringList &extensions,
+                      const int         &nb_workers = 0);             // 0 means one worker per core.
+    virtual ~Directory_scanner();
+
+    void scan(const QStringList                                 &dir_paths,
+              std::function<void(const QVector<Scanned_file>&)>  report,
+              std::function<bool()>                              is_canceled); // List recursively, report is called by batches from several threads.
+
+ private:
+    static void help(QSharedPointer<Scanner_state> state);
+    static void work(Scanner_state &state, const int &index);
+    static bool pop(Scanner_state &state, const int &index, QByteArray &out_dir);
+    static void push(Scanner_state &state, const int &index, const QByteArray &dir);
+    static void wait_work(Scanner_state &state);
+    static void wake_workers(Scanner_state &state);
+    static void list_directory(Scanner_state         &state,
+                               const int             &index,
+                               const QByteArray      &dir,
+                               QVector<Scanned_file> &io_batch);
+    static bool has_extension(const Scanner_state &state, const char *name, const size_t &length);
+};
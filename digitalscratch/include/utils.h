@@ -33,11 +33,44 @@
 #pragma once
 
 #include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QtGlobal>
 
 #include "app/application_const.h"
 
 using namespace std;
 
+#define FILE_HASH_NB_REGIONS 4  // Number of regions of a file used to compute its hash.
+#define CAMELOT_NB_KEYS      24 // 1A..12A then 1B..12B.
+#define CAMELOT_UNKNOWN_KEY  -1
+
+struct File_identity
+{
+    qint64  size;  // Bytes.
+    qint64  mtime; // Last modification (nsec since epoch).
+    quint64 inode; // 0 if not available.
+    QString hash;
+    QString legacy_hash; // Hash used by previous versions, only while their tracks are migrated (not cached).
+};
+
+// Binary value of a file hash (half the size of its hexadecimal string, compared and hashed without allocation).
+struct Hash_128
+{
+    quint64 high;
+    quint64 low;
+};
+
+inline bool operator==(const Hash_128 &h1, const Hash_128 &h2)
+{
+    return (h1.high == h2.high) && (h1.low == h2.low);
+}
+
+inline uint qHash(const Hash_128 &h, uint seed = 0)
+{
+    return qHash(h.high ^ (h.low * 0x9e3779b97f4a7c15ULL), seed);
+}
+
 class Utils
 {
  public:
@@ -49,11 +82,21 @@ class Utils
 
  private:
     static void setup_keys();
+    static void hash_128(const QByteArray &data, quint64 &out_h1, quint64 &out_h2);
 
  public:
-    // Get a MD5 hash from in_kbytes bytes of the specified file.
+    // Get a 128 bits hash from the size and FILE_HASH_NB_REGIONS regions of kbytes bytes of the specified file.
     static QString get_file_hash(const QString &path, const unsigned int &kbytes = 1);
 
+    // Get the MD5 hash of kbytes bytes in the middle of the file (used by previous versions).
+    static QString get_file_legacy_hash(const QString &path, const unsigned int &kbytes = 1);
+
+    // Get the binary value of a hash (32 hexadecimal digits).
+    static bool get_hash_128(const QString &hash, Hash_128 &out_hash);
+
+    // Get size, modification time and inode of a file (a change means the hash must be computed again).
+    static bool get_file_identity(const QString &path, File_identity &out_identity);
+
     // Get full text content of a file.
     static QString file_read_all_text(const QString &path);
 
@@ -63,6 +106,10 @@ class Utils
     // Convert music key as clock number.
     static QString convert_music_key_to_clock_number(const QString &key);
 
+    // Convert music key (clock number) as a Camelot index (1A..12A are 0..11, 1B..12B are 12..23) and back.
+    static qint8   get_camelot_index(const QString &key);
+    static QString get_camelot_key(const qint8 &index);
+
     // Get next music keys (as clock number).
     static void get_next_music_keys(const QString &key,
                                     QString &next_key,
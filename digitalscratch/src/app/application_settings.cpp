@@ -48,6 +48,8 @@ Application_settings::Application_settings() : settings(APPLICATION_NAME)
     this->available_rpms << RPM_33 << RPM_45;
     this->available_nb_decks << 1 << 2 << 3;
     this->available_sample_rates << 44100 << 48000 << 96000;
+    this->available_resampling_qualities << RESAMPLING_QUALITY_BEST << RESAMPLING_QUALITY_MEDIUM
+                                         << RESAMPLING_QUALITY_FASTEST << RESAMPLING_QUALITY_LINEAR;
 
     // TODO: add hardware sound card support.
 //    this->available_sound_cards = Sound_card_control_rules::get_device_list();
@@ -91,6 +93,12 @@ Application_settings::init_settings()
     if (this->settings.contains(NB_SAMPLERS_CFG) == false) {
         this->settings.setValue(NB_SAMPLERS_CFG, this->get_nb_samplers_default());
     }
+    if (this->settings.contains(PREFETCH_POOL_SIZE_CFG) == false) {
+        this->settings.setValue(PREFETCH_POOL_SIZE_CFG, this->get_prefetch_pool_size_default());
+    }
+    if (this->settings.contains(PAUSE_ANALYSIS_WHILE_PLAYING_CFG) == false) {
+        this->settings.setValue(PAUSE_ANALYSIS_WHILE_PLAYING_CFG, this->get_pause_analysis_while_playing_default());
+    }
 
     //
     // Sound card settings.
@@ -104,6 +112,9 @@ Application_settings::init_settings()
     if (this->settings.contains(SOUND_DRIVER_CFG) == false) {
         this->settings.setValue(SOUND_DRIVER_CFG, this->get_sound_driver_default());
     }
+    if (this->settings.contains(RESAMPLING_QUALITY_CFG) == false) {
+        this->settings.setValue(RESAMPLING_QUALITY_CFG, this->get_resampling_quality_default());
+    }
 
     //
     // Timecode signal detection parameters.
@@ -370,6 +381,42 @@ Application_settings::set_nb_samplers(const unsigned short int &nb_samplers)
     this->settings.setValue(NB_SAMPLERS_CFG, nb_samplers);
 }
 
+unsigned short int
+Application_settings::get_prefetch_pool_size()
+{
+    return this->settings.value(PREFETCH_POOL_SIZE_CFG).toUInt();
+}
+
+unsigned short int
+Application_settings::get_prefetch_pool_size_default()
+{
+    return PREFETCH_POOL_SIZE_DEFAULT;
+}
+
+void
+Application_settings::set_prefetch_pool_size(const unsigned short int &pool_size)
+{
+    this->settings.setValue(PREFETCH_POOL_SIZE_CFG, pool_size);
+}
+
+bool
+Application_settings::get_pause_analysis_while_playing()
+{
+    return this->settings.value(PAUSE_ANALYSIS_WHILE_PLAYING_CFG).toBool();
+}
+
+bool
+Application_settings::get_pause_analysis_while_playing_default()
+{
+    return PAUSE_ANALYSIS_WHILE_PLAYING_DEFAULT;
+}
+
+void
+Application_settings::set_pause_analysis_while_playing(const bool &is_paused)
+{
+    this->settings.setValue(PAUSE_ANALYSIS_WHILE_PLAYING_CFG, is_paused);
+}
+
 //
 // Timecode signal detection settings.
 //
@@ -554,6 +601,38 @@ Application_settings::get_available_sample_rates()
     return this->available_sample_rates;
 }
 
+void
+Application_settings::set_resampling_quality(const QString &quality)
+{
+    this->settings.setValue(RESAMPLING_QUALITY_CFG, quality);
+}
+
+QString
+Application_settings::get_resampling_quality()
+{
+    QString quality = this->settings.value(RESAMPLING_QUALITY_CFG).toString();
+    if (this->available_resampling_qualities.contains(quality) == false)
+    {
+        return this->get_resampling_quality_default();
+    }
+    else
+    {
+        return quality;
+    }
+}
+
+QString
+Application_settings::get_resampling_quality_default()
+{
+    return RESAMPLING_QUALITY_DEFAULT;
+}
+
+QList<QString>
+Application_settings::get_available_resampling_qualities()
+{
+    return this->available_resampling_qualities;
+}
+
 void
 Application_settings::set_audio_collection_full_refresh(const bool &full_refresh)
 {
@@ -0,0 +1,335 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*------------------------------------------------------( job_scheduler.cpp )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: run background jobs (prefetch, analysis,...) with         */
+/*                  priorities, giving way to the realtime audio thread.      */
+/*                                                                            */
+/*============================================================================*/
+
+#include <QtDebug>
+#include <QRunnable>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_CLASS_IDLE  3
+#define IOPRIO_CLASS_SHIFT 13
+#endif
+
+#include "app/job_scheduler.h"
+#include "app/application_logging.h"
+
+// Job running in the current thread (used by jobs to check if they must pause).
+static thread_local const QFutureInterfaceBase *current_job_interface = nullptr;
+static thread_local Job_priority                current_job_priority  = Job_priority::USER;
+static thread_local bool                        is_idle_worker        = false;
+
+static void
+set_idle_priority()
+{
+    // Only once for each worker thread.
+    if (is_idle_worker == true)
+    {
+        return;
+    }
+    is_idle_worker = true;
+
+    // SCHED_IDLE on Linux: the thread runs only when nothing else wants the CPU.
+    QThread::currentThread()->setPriority(QThread::IdlePriority);
+
+#ifdef __linux__
+    // Also lowest nice value and idle I/O class (the disk is given to the other threads first).
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+    if (setpriority(PRIO_PROCESS, tid, 19) != 0)
+    {
+        qCDebug(DS_FILE) << "can not set nice value of background worker";
+    }
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) != 0)
+    {
+        qCDebug(DS_FILE) << "can not set I/O priority of background worker";
+    }
+#endif
+
+    return;
+}
+
+class Job_runnable : public QRunnable
+{
+ private:
+    Job_priority                priority;
+    const QFutureInterfaceBase *interface;
+    std::function<void()>       job;
+
+ public:
+    Job_runnable(const Job_priority         &priority,
+                 const QFutureInterfaceBase *interface,
+                 std::function<void()>       job)
+    {
+        this->priority  = priority;
+        this->interface = interface;
+        this->job       = job;
+    }
+
+    void run()
+    {
+        if (this->priority != Job_priority::USER)
+        {
+            set_idle_priority();
+        }
+        current_job_interface = this->interface;
+        current_job_priority  = this->priority;
+        this->job();
+        current_job_interface = nullptr;
+        current_job_priority  = Job_priority::USER;
+    }
+};
+
+Job_scheduler::Job_scheduler()
+{
+    this->budget_tight  = 0;
+    this->decks_playing = 0;
+    this->last_nb_xruns = 0;
+    this->is_watching_parked = false;
+    this->parked_pool.setMaxThreadCount(1);
+
+    // Background workers can use as many cores as user jobs (they are idle priority).
+    // Analysis has its own workers, so a paused analysis never takes the threads needed by prefetch.
+    this->prefetch_pool.setMaxThreadCount(QThreadPool::globalInstance()->maxThreadCount());
+    this->analysis_pool.setMaxThreadCount(QThreadPool::globalInstance()->maxThreadCount());
+    QObject::connect(&this->budget_timer, &QTimer::timeout, [this](){this->check_realtime_budget();});
+
+    return;
+}
+
+Job_scheduler::~Job_scheduler()
+{
+    // Do not let running jobs wait for the realtime budget.
+    this->budget_timer.stop();
+    this->budget_tight  = 0;
+    this->decks_playing = 0;
+    this->resume_parked_jobs();
+    this->parked_jobs_changed.wakeAll();
+    this->parked_pool.waitForDone();
+    this->prefetch_pool.waitForDone();
+    this->analysis_pool.waitForDone();
+
+    return;
+}
+
+void
+Job_scheduler::set_sound_card(const QSharedPointer<Audio_IO_control_rules> &sound_card)
+{
+    this->sound_card = sound_card;
+    if (this->sound_card.data() != nullptr)
+    {
+        this->last_nb_xruns = this->sound_card->get_nb_xruns();
+        this->budget_timer.start(JOB_BUDGET_CHECK_MSEC);
+    }
+
+    return;
+}
+
+void
+Job_scheduler::set_playing_check(std::function<bool()> is_playing)
+{
+    this->is_playing = is_playing;
+    if (this->budget_timer.isActive() == false)
+    {
+        this->budget_timer.start(JOB_BUDGET_CHECK_MSEC);
+    }
+
+    return;
+}
+
+void
+Job_scheduler::start(const Job_priority   &priority,
+                     QFutureInterfaceBase *interface,
+                     std::function<void()> job)
+{
+    Job_runnable *runnable = new Job_runnable(priority, interface, job);
+    switch (priority)
+    {
+        case Job_priority::USER:
+            QThreadPool::globalInstance()->start(runnable);
+            break;
+        case Job_priority::PREFETCH:
+            this->prefetch_pool.start(runnable);
+            break;
+        case Job_priority::ANALYSIS:
+            this->analysis_pool.start(runnable);
+            break;
+    }
+
+    return;
+}
+
+int
+Job_scheduler::get_max_nb_workers(const Job_priority &priority)
+{
+    switch (priority)
+    {
+        case Job_priority::USER:
+            return QThreadPool::globalInstance()->maxThreadCount();
+        case Job_priority::PREFETCH:
+            return this->prefetch_pool.maxThreadCount();
+        case Job_priority::ANALYSIS:
+            return this->analysis_pool.maxThreadCount();
+    }
+
+    return 1;
+}
+
+void
+Job_scheduler::start_map_worker(const Parked_job &worker)
+{
+    this->start(worker.priority, worker.interface.data(), [this, worker]()
+    {
+        do
+        {
+            // Give way to playback: release the thread, remaining items are taken again when the budget is back
+            // (or skipped as soon as the map is canceled, without waiting for the budget check of the GUI thread).
+            if (this->must_pause_current_job() == true)
+            {
+                this->parked_jobs_mutex.lock();
+                this->parked_jobs << worker;
+                if (this->is_watching_parked == false)
+                {
+                    this->is_watching_parked = true;
+                    this->parked_pool.start(new Job_runnable(Job_priority::USER, nullptr, [this]() { this->watch_parked_jobs(); }));
+                }
+                this->parked_jobs_mutex.unlock();
+                return;
+            }
+        }
+        while (worker.process_next() == true);
+    });
+
+    return;
+}
+
+void
+Job_scheduler::resume_parked_jobs()
+{
+    // Restart workers of maps which can continue.
+    QList<Parked_job> resumed;
+    this->parked_jobs_mutex.lock();
+    for (int i = this->parked_jobs.size() - 1; i >= 0; i--)
+    {
+        if ((this->must_pause(this->parked_jobs[i].priority) == false) || (this->parked_jobs[i].interface->isCanceled() == true))
+        {
+            resumed.prepend(this->parked_jobs.takeAt(i));
+        }
+    }
+    this->parked_jobs_mutex.unlock();
+    for (const Parked_job &worker : resumed)
+    {
+        this->start_map_worker(worker);
+    }
+
+    return;
+}
+
+void
+Job_scheduler::watch_parked_jobs()
+{
+    this->parked_jobs_mutex.lock();
+    while (this->parked_jobs.isEmpty() == false)
+    {
+        this->parked_jobs_changed.wait(&this->parked_jobs_mutex, JOB_PAUSE_MSEC);
+        this->parked_jobs_mutex.unlock();
+        this->resume_parked_jobs();
+        this->parked_jobs_mutex.lock();
+    }
+    this->is_watching_parked = false;
+    this->parked_jobs_mutex.unlock();
+
+    return;
+}
+
+bool
+Job_scheduler::must_pause(const Job_priority &priority)
+{
+    switch (priority)
+    {
+        case Job_priority::USER:
+            return false;
+        case Job_priority::PREFETCH:
+            return this->budget_tight.load() == 1;
+        case Job_priority::ANALYSIS:
+            return (this->budget_tight.load() == 1) || (this->decks_playing.load() == 1);
+    }
+
+    return false;
+}
+
+bool
+Job_scheduler::must_pause_current_job()
+{
+    // Not in a job or job canceled (it has to finish quickly).
+    if ((current_job_interface == nullptr) || (current_job_interface->isCanceled() == true))
+    {
+        return false;
+    }
+
+    return this->must_pause(current_job_priority);
+}
+
+void
+Job_scheduler::check_realtime_budget()
+{
+    bool tight = false;
+    if (this->sound_card.data() != nullptr)
+    {
+        // An xrun pauses background jobs for a while.
+        int nb_xruns = this->sound_card->get_nb_xruns();
+        if (nb_xruns != this->last_nb_xruns)
+        {
+            this->last_nb_xruns = nb_xruns;
+            this->last_xrun_timer.restart();
+        }
+
+        // Check the load of the realtime audio thread.
+        tight = (this->sound_card->get_cpu_load() > JOB_MAX_CPU_LOAD) ||
+                ((this->last_xrun_timer.isValid() == true) && (this->last_xrun_timer.elapsed() < JOB_XRUN_COOLDOWN_MSEC));
+    }
+    bool playing = this->is_playing && (this->is_playing() == true);
+
+    // Budget is back, paused jobs continue and new ones can be started.
+    bool was_paused = (this->budget_tight.load() == 1);
+    this->budget_tight  = (tight   == true) ? 1 : 0;
+    this->decks_playing = (playing == true) ? 1 : 0;
+    if ((was_paused == true) && (tight == false))
+    {
+        emit this->budget_available();
+    }
+    this->resume_parked_jobs();
+
+    return;
+}
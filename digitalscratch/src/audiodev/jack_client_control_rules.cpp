@@ -74,6 +74,16 @@ Jack_client_control_rules::error_callback(const char *msg)
     qCWarning(DS_SOUNDCARD) << "jack error: " << msg;
 }
 
+int
+Jack_client_control_rules::xrun_callback(void *data)
+{
+    // Count xruns, they are used to detect a tight realtime budget.
+    Jack_client_control_rules *jack_client = static_cast<Jack_client_control_rules*>(data);
+    jack_client->nb_xruns.fetchAndAddRelaxed(1);
+
+    return 0;
+}
+
 bool
 Jack_client_control_rules::start(void *callback_param)
 {
@@ -100,6 +110,7 @@ Jack_client_control_rules::start(void *callback_param)
         // Tell the JACK server to call "in_callback" whenever there is work to be done.
         jack_set_process_callback(this->stream, &capture_and_playback_callback, callback_param);
         jack_set_error_function(&error_callback);
+        jack_set_xrun_callback(this->stream, &xrun_callback, this);
 
         // Display the current sample rate.
         Application_settings *settings = &Singleton<Application_settings>::get_instance();
@@ -287,3 +298,14 @@ Jack_client_control_rules::get_output_buffers(const unsigned short int &nb_buffe
 
     return true;
 }
+
+float
+Jack_client_control_rules::get_cpu_load()
+{
+    if (this->running == false)
+    {
+        return 0.0;
+    }
+
+    return jack_cpu_load(this->stream);
+}
@@ -78,6 +78,12 @@ Config_dialog::Config_dialog(QWidget *parent) : QDialog(parent)
     {
         this->sample_rate_select->addItem(QString::number(available_sample_rates.at(i)));
     }
+    this->resampling_quality_select = new QComboBox(this);
+    QList<QString> available_resampling_qualities = this->settings->get_available_resampling_qualities();
+    for (int i = 0; i < available_resampling_qualities.size(); i++)
+    {
+        this->resampling_quality_select->addItem(available_resampling_qualities.at(i));
+    }
     this->device_jack_check = new QCheckBox(this);
     this->device_jack_check->setTristate(false);
     this->auto_jack_connections_check = new QCheckBox(this);
@@ -264,6 +270,15 @@ QWidget *Config_dialog::init_tab_sound_card()
     sample_rate_layout->addStretch(10);
     sound_card_layout->addLayout(sample_rate_layout);
 
+    // Select quality of sample rate conversion (used when loading a track which has not the sample rate of the sound card).
+    QLabel *resampling_quality_label = new QLabel(tr("Track resampling quality: "), this);
+    QHBoxLayout *resampling_quality_layout = new QHBoxLayout();
+    resampling_quality_label->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
+    resampling_quality_layout->addWidget(resampling_quality_label, 0, Qt::AlignLeft);
+    resampling_quality_layout->addWidget(this->resampling_quality_select, 10, Qt::AlignLeft);
+    resampling_quality_layout->addStretch(10);
+    sound_card_layout->addLayout(resampling_quality_layout);
+
     // Select sound device.
     QGridLayout *device_layout = new QGridLayout();
     device_layout->setColumnStretch(3, 10);
@@ -309,6 +324,7 @@ QWidget *Config_dialog::init_tab_sound_card()
 void Config_dialog::fill_tab_sound_card()
 {
     this->sample_rate_select->setCurrentIndex(this->sample_rate_select->findText(QString::number(this->settings->get_sample_rate())));
+    this->resampling_quality_select->setCurrentIndex(this->resampling_quality_select->findText(this->settings->get_resampling_quality()));
     this->auto_jack_connections_check->setChecked(this->settings->get_auto_jack_connections());
     if (this->settings->get_sound_driver() == SOUND_DRIVER_INTERNAL)
     {
@@ -692,6 +708,7 @@ Config_dialog::accept()
 
     // Set sound card settings.
     this->settings->set_sample_rate(this->sample_rate_select->currentText().toInt());
+    this->settings->set_resampling_quality(this->resampling_quality_select->currentText());
 //    if (this->device_internal_check->isChecked() == true)
 //    {
 //        this->settings->set_sound_driver(SOUND_DRIVER_INTERNAL);
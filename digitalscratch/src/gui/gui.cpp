@@ -56,7 +56,6 @@
 #include <QMenu>
 #include <QMimeData>
 #include <QSizePolicy>
-#include <QtConcurrentRun>
 #include <QDesktopServices>
 #include <QDateTime>
 #include <QFileDialog>
@@ -74,6 +73,8 @@
 #include "tracks/audio_collection_model.h"
 #include "tracks/playlist.h"
 #include "tracks/playlist_persistence.h"
+#include "tracks/data_persistence_worker.h"
+#include "app/job_scheduler.h"
 #include "utils.h"
 #include "singleton.h"
 
@@ -116,6 +117,46 @@ Gui::Gui(QList<QSharedPointer<Audio_track>>                        &ats,
     this->control_and_play        = control_and_playback;
     this->selected_deck           = 0;
 
+    // Background jobs give way to the audio thread, and optionally to the playing decks.
+    Job_scheduler *scheduler = &Singleton<Job_scheduler>::get_instance();
+    scheduler->set_sound_card(this->sound_card);
+    scheduler->set_playing_check([this]()
+    {
+        if (this->settings->get_pause_analysis_while_playing() == false)
+        {
+            return false;
+        }
+        for (unsigned short int i = 0; i < this->nb_decks; i++)
+        {
+            if ((this->playbacks[i]->is_track_loaded() == true) && (this->params[i]->get_speed() != 0.0f))
+            {
+                return true;
+            }
+        }
+        return false;
+    });
+
+    // Init prefetching of the tracks which are likely to be loaded.
+    this->prefetch_pool = QSharedPointer<Audio_track_prefetch_pool>(new Audio_track_prefetch_pool(this->settings->get_prefetch_pool_size(),
+                                                                                                  this->settings->get_sample_rate()));
+
+    // Init frequency band analysis of tracks loaded on decks.
+    for (unsigned short int i = 0; i < this->nb_decks; i++)
+    {
+        this->band_processes << QSharedPointer<Audio_track_band_process>();
+        this->watchers_band_process << new QFutureWatcher<bool>;
+        QObject::connect(this->watchers_band_process[i], &QFutureWatcher<bool>::finished, [this, i](){this->on_finished_band_process(i);});
+    }
+
+    // Init load of cue points and tags of tracks loaded on decks.
+    for (unsigned short int i = 0; i < this->nb_decks; i++)
+    {
+        this->loaded_track_data << QSharedPointer<Audio_track>();
+        this->edited_cue_points << QBitArray(MAX_NB_CUE_POINTS);
+        this->watchers_track_data << new QFutureWatcher<bool>;
+        QObject::connect(this->watchers_track_data[i], &QFutureWatcher<bool>::finished, [this, i](){this->on_finished_track_data_load(i);});
+    }
+
     // Init pop-up dialogs.
     this->config_dialog          = nullptr;
     this->scan_audio_keys_dialog = nullptr;
@@ -166,6 +207,24 @@ Gui::~Gui()
     this->settings->set_main_window_size(this->window->size());
     this->settings->set_browser_splitter_size(this->browser_splitter->saveState());
 
+    // Stop frequency band analysis.
+    for (unsigned short int i = 0; i < this->nb_decks; i++)
+    {
+        this->stop_band_process(i);
+        delete this->watchers_band_process[i];
+    }
+
+    // Wait for loads of cue points and tags.
+    for (unsigned short int i = 0; i < this->nb_decks; i++)
+    {
+        this->watchers_track_data[i]->waitForFinished();
+        delete this->watchers_track_data[i];
+    }
+
+    // Background jobs do not have to check the decks anymore.
+    Singleton<Job_scheduler>::get_instance().set_playing_check(nullptr);
+    Singleton<Job_scheduler>::get_instance().set_sound_card(QSharedPointer<Audio_IO_control_rules>());
+
     // Cleanup.
     this->clean_decks_area();
     this->clean_samplers_area();
@@ -199,6 +258,7 @@ Gui::apply_application_settings()
     // Change base path for tracks browser.
     if (this->file_system_model->get_root_path() != this->settings->get_tracks_base_dir_path())
     {
+        this->collection_watcher->set_root_path(this->settings->get_tracks_base_dir_path());
         this->set_folder_browser_base_path(this->settings->get_tracks_base_dir_path());
         if (this->is_window_rendered == true) // Do not do it if main window is not already displayed.
         {
@@ -331,16 +391,16 @@ Gui::file_search_string(const QString &text)
         // Store search text.
         this->last_search_string = text;
 
-        // Search text in file browser (get a list of results).
-        QModelIndexList items = this->file_system_model->search(text);
+        // Search text in the whole collection (get a list of paths).
+        QStringList items = this->file_system_model->search(text);
 
         if (this->search_from_begin == true)
         {
             // If we found file/dir name that match, return the first one.
             if (items.size() > 0)
             {
-                // Select item in file browser.
-                this->file_browser->setCurrentIndex(items[0]);
+                // Select item in file browser (its directory is enumerated in background if it is not shown yet).
+                this->file_system_model->select_path(items[0]);
                 this->file_browser_selected_index = 0;
             }
         }
@@ -359,7 +419,7 @@ Gui::file_search_string(const QString &text)
                     // Wrap search, so select first item again.
                     this->file_browser_selected_index = 0;
                 }
-                this->file_browser->setCurrentIndex(items[this->file_browser_selected_index]);
+                this->file_system_model->select_path(items[this->file_browser_selected_index]);
             }
 
             this->search_from_begin = true;
@@ -401,7 +461,7 @@ Gui::on_finished_analyze_audio_collection()
     this->progress_groupbox->hide();
 
     // Refresh file browser.
-    this->file_browser->setRootIndex(this->file_system_model->get_root_index());
+    this->file_browser->viewport()->update();
     this->scan_audio_keys_button->setEnabled(true);
     this->scan_audio_keys_button->setChecked(false);
 }
@@ -834,6 +894,7 @@ Gui::init_decks_area()
     {
         Deck *dk = new Deck(tr("Deck ") + QString::number(i+1), this->ats[i]);
         dk->init_display();
+        dk->waveform_zoom->set_playback(this->playbacks[i]);
         this->decks.push_back(dk);
         this->decks_layout->addWidget(dk);
     }
@@ -1193,6 +1254,7 @@ Gui::init_file_browser_area()
 
     // Create the file browser (track browser).
     this->file_system_model = new Audio_collection_model();
+    this->collection_watcher = QSharedPointer<Collection_watcher>(new Collection_watcher());
     this->file_browser      = new QTreeView();
     this->file_browser->setModel(this->file_system_model);
     this->file_browser->setSelectionMode(QAbstractItemView::SingleSelection);
@@ -1243,9 +1305,9 @@ Gui::init_file_browser_area()
 void
 Gui::clean_file_browser_area()
 {
-    delete this->watcher_parse_directory;
     delete this->treeview_icon_provider;
     delete this->folder_system_model;
+    this->collection_watcher.reset();
     delete this->file_system_model;
 }
 
@@ -1267,6 +1329,9 @@ Gui::connect_file_browser_area()
     this->shortcut_load_audio_file = new QShortcut(this->file_browser);
     QObject::connect(this->shortcut_load_audio_file, &QShortcut::activated, [this](){this->run_audio_file_decoding_process();});
 
+    // Prefetch selected track and the following ones.
+    QObject::connect(this->file_browser->selectionModel(), &QItemSelectionModel::currentChanged, [this](){this->update_prefetch_candidates();});
+
     // Sort track browser when clicking on header.
     QObject::connect(this->file_browser->header(), &QHeaderView::sectionClicked, [this](int logicalIndex){this->on_file_browser_header_click(logicalIndex);});
 
@@ -1338,9 +1403,26 @@ Gui::connect_file_browser_area()
     QObject::connect(this->file_system_model->concurrent_watcher_read.data(), &QFutureWatcher<void>::progressValueChanged,
                      [this](int progressValue){this->update_refresh_progress_value(progressValue);});
 
-    // Parse directory thread.
-    this->watcher_parse_directory = new QFutureWatcher<void>;
-    QObject::connect(this->watcher_parse_directory, &QFutureWatcher<void>::finished, [this](){this->run_concurrent_read_collection_from_db();});
+    // Files of the collection are listed in background, then their data are read from DB.
+    QObject::connect(this->file_system_model->concurrent_watcher_index.data(), &QFutureWatcher<Audio_collection_entry>::finished, [this](){this->run_concurrent_read_collection_from_db();});
+
+    // Files changed on disk are updated in the collection, then analyzed.
+    QObject::connect(this->collection_watcher.data(), &Collection_watcher::files_changed, this->file_system_model,
+                     [this](QStringList changed_paths, QStringList removed_paths){this->file_system_model->apply_file_changes(changed_paths, removed_paths);});
+    QObject::connect(this->collection_watcher.data(), &Collection_watcher::rescan_needed, this->file_system_model,
+                     [this](QString dir_path){this->file_system_model->rescan_directory(dir_path);});
+
+    // Items searched or of next keys are shown once their directories are enumerated.
+    QObject::connect(this->file_system_model, &Audio_collection_model::path_selected,
+                     [this](QModelIndex index){this->file_browser->setCurrentIndex(index);});
+    QObject::connect(this->file_system_model, &Audio_collection_model::directory_to_expand, [this](QModelIndex index)
+    {
+        for (QModelIndex parent = index; parent.isValid() == true; parent = parent.parent())
+        {
+            this->file_browser->expand(parent);
+        }
+    });
+    QObject::connect(this->file_system_model->concurrent_watcher_update.data(), &QFutureWatcher<void>::finished, [this](){this->file_browser->viewport()->update();});
 
     return;
 }
@@ -1717,6 +1799,7 @@ void
 Gui::display_audio_file_collection()
 {
     this->set_file_browser_base_path(this->settings->get_tracks_base_dir_path());
+    this->collection_watcher->set_root_path(this->settings->get_tracks_base_dir_path());
     this->is_window_rendered = true;
 }
 
@@ -1905,34 +1988,28 @@ Gui::set_folder_browser_base_path(const QString &path)
 bool
 Gui::set_file_browser_base_path(const QString &path)
 {
-    if (this->watcher_parse_directory->isRunning() == false)
-    {
-        // Hide file browser during directory analysis.
-        this->file_browser->setVisible(false);
-
-        // Stop any running file analysis.
-        this->file_system_model->stop_concurrent_read_collection_from_db();
-        this->file_system_model->stop_concurrent_analyse_audio_collection();
+    // Stop any running file analysis.
+    this->file_system_model->stop_concurrent_read_collection_from_db();
+    this->file_system_model->stop_concurrent_analyse_audio_collection();
 
-        // Show progress bar.
-        this->progress_label->setText(tr("Opening ") + path + "...");
-        this->progress_groupbox->show();
-        this->progress_bar->setMinimum(0);
-        this->progress_bar->setMaximum(0);
+    // Show progress bar.
+    this->progress_label->setText(tr("Opening ") + path + "...");
+    this->progress_groupbox->show();
+    this->progress_bar->setMinimum(0);
+    this->progress_bar->setMaximum(0);
 
-        // Set base path as title to file browser.
-        this->set_file_browser_title(path);
+    // Set base path as title to file browser.
+    this->set_file_browser_title(path);
 
-        // Clear file browser.
-        this->file_system_model->clear();
+    // Clear file browser.
+    this->file_system_model->clear();
 
-        // Change root path of file browser (do it in a non blocking external thread).
-        QFuture<QModelIndex> future = QtConcurrent::run(this->file_system_model, &Audio_collection_model::set_root_path, path);
-        this->watcher_parse_directory->setFuture(future);
+    // Change root path of file browser, it is shown now (directories are enumerated when they are expanded).
+    this->file_browser->setRootIndex(this->file_system_model->set_root_path(path));
+    this->file_browser->setVisible(true);
 
-        // Reset progress.
-        this->progress_bar->reset();
-    }
+    // Reset progress.
+    this->progress_bar->reset();
 
     return true;
 }
@@ -1940,8 +2017,11 @@ Gui::set_file_browser_base_path(const QString &path)
 void
 Gui::run_concurrent_read_collection_from_db()
 {
-    // Show file browser again (file were analyse on disk).
-    this->file_browser->setVisible(true);
+    // Listing of files was stopped (another directory is opened).
+    if (this->file_system_model->concurrent_watcher_index->isCanceled() == true)
+    {
+        return;
+    }
 
     // Get file info from DB.
     this->file_system_model->concurrent_read_collection_from_db(); // Run in another thread.
@@ -1953,41 +2033,28 @@ Gui::run_concurrent_read_collection_from_db()
 bool
 Gui::set_file_browser_playlist_tracks(const Playlist &playlist)
 {
-    if (this->watcher_parse_directory->isRunning() == false)
-    {
-        // Hide file browser during playlist analysis.
-        this->file_browser->setVisible(false);
-
-        // Stop any running file analysis.
-        this->file_system_model->stop_concurrent_read_collection_from_db();
-        this->file_system_model->stop_concurrent_analyse_audio_collection();
-
-        // Show progress bar.
-        this->progress_label->setText(tr("Opening ") + playlist.get_name() + "...");
-        this->progress_groupbox->show();
-        this->progress_bar->setMinimum(0);
-        this->progress_bar->setMaximum(0);
-
-        // Set base path as title to file browser.
-        this->set_file_browser_title(playlist.get_name());
+    // Stop any running file analysis.
+    this->file_system_model->stop_concurrent_read_collection_from_db();
+    this->file_system_model->stop_concurrent_analyse_audio_collection();
 
-        // Clear file browser.
-        this->file_system_model->clear();
+    // Show progress bar.
+    this->progress_label->setText(tr("Opening ") + playlist.get_name() + "...");
+    this->progress_groupbox->show();
+    this->progress_bar->setMinimum(0);
+    this->progress_bar->setMaximum(0);
 
-        // Set list of tracks to the file browser.
-        this->file_browser->setRootIndex(QModelIndex());
-        this->file_system_model->set_playlist(playlist);
+    // Set base path as title to file browser.
+    this->set_file_browser_title(playlist.get_name());
 
-        // Reset progress.
-        this->progress_bar->reset();
+    // Clear file browser.
+    this->file_system_model->clear();
 
-        // Get file info from DB.
-        this->file_system_model->concurrent_read_collection_from_db(); // Run in another thread.
-                                                                       // Call sync_file_browser_to_audio_collection() when it's done.
+    // Set list of tracks to the file browser.
+    this->file_browser->setRootIndex(QModelIndex());
+    this->file_browser->setRootIndex(this->file_system_model->set_playlist(playlist));
 
-        // Show file browser again.
-        this->file_browser->setVisible(true);
-    }
+    // Reset progress.
+    this->progress_bar->reset();
 
     return true;
 }
@@ -1995,9 +2062,8 @@ Gui::set_file_browser_playlist_tracks(const Playlist &playlist)
 void
 Gui::sync_file_browser_to_audio_collection()
 {
-    // Reset file browser root node to audio collection model's root.
-    this->file_browser->update();
-    this->file_browser->setRootIndex(this->file_system_model->get_root_index());
+    // Show data read from DB (do not reset the root node, directories expanded meanwhile stay expanded).
+    this->file_browser->viewport()->update();
     this->resize_file_browser_columns();
 
     // Hide progress bar.
@@ -2172,57 +2238,55 @@ Gui::on_file_browser_header_click(const int &index)
 void
 Gui::on_file_browser_double_click(QModelIndex in_model_index)
 {
-    if (this->watcher_parse_directory->isRunning() == false)
+    // Get path (file for a playlist, or just a directory).
+    QString path = this->folder_system_model->filePath(in_model_index);
+
+    QFileInfo file_info(path);
+    if (file_info.isFile() == true)
     {
-        // Get path (file for a playlist, or just a directory).
-        QString path = this->folder_system_model->filePath(in_model_index);
+        Playlist playlist(file_info.absolutePath(), file_info.baseName());
+        Playlist_persistence playlist_persist;
 
-        QFileInfo file_info(path);
-        if (file_info.isFile() == true)
+        // It is a m3u playlist, parse it and show track list in file browser.
+        if (file_info.suffix().compare(QString("m3u"), Qt::CaseInsensitive) == 0)
         {
-            Playlist playlist(file_info.absolutePath(), file_info.baseName());
-            Playlist_persistence playlist_persist;
-
-            // It is a m3u playlist, parse it and show track list in file browser.
-            if (file_info.suffix().compare(QString("m3u"), Qt::CaseInsensitive) == 0)
+            // Open M3U playlist
+            if (playlist_persist.read_m3u(path, playlist) == true)
             {
-                // Open M3U playlist
-                if (playlist_persist.read_m3u(path, playlist) == true)
-                {
-                    // Populate file browser.
-                    this->set_file_browser_playlist_tracks(playlist);
-                }
-                else
-                {
-                    qCWarning(DS_FILE) << "can not open m3u playlist " << qPrintable(path);
-                }
+                // Populate file browser.
+                this->set_file_browser_playlist_tracks(playlist);
             }
-            else if (file_info.suffix().compare(QString("pls"), Qt::CaseInsensitive) == 0)
+            else
             {
-                // Open PLS playlist
-                if (playlist_persist.read_pls(path, playlist) == true)
-                {
-                    // Populate file browser.
-                    this->set_file_browser_playlist_tracks(playlist);
-                }
-                else
-                {
-                    qCWarning(DS_FILE) << "can not open pls playlist " << qPrintable(path);
-                }
+                qCWarning(DS_FILE) << "can not open m3u playlist " << qPrintable(path);
             }
         }
-        else
+        else if (file_info.suffix().compare(QString("pls"), Qt::CaseInsensitive) == 0)
         {
-            // It is a directory, open selected directory in file browser.
-            this->set_file_browser_base_path(path);
+            // Open PLS playlist
+            if (playlist_persist.read_pls(path, playlist) == true)
+            {
+                // Populate file browser.
+                this->set_file_browser_playlist_tracks(playlist);
+            }
+            else
+            {
+                qCWarning(DS_FILE) << "can not open pls playlist " << qPrintable(path);
+            }
         }
     }
+    else
+    {
+        // It is a directory, open selected directory in file browser.
+        this->set_file_browser_base_path(path);
+    }
 }
 
 void
 Gui::resize_file_browser_columns()
 {
     this->file_browser->resizeColumnToContents(COLUMN_KEY);
+    this->file_browser->resizeColumnToContents(COLUMN_BPM);
     this->file_browser->resizeColumnToContents(COLUMN_FILE_NAME);
 }
 
@@ -2255,23 +2319,33 @@ Gui::run_audio_file_decoding_process()
         // Get selected deck/sampler.
         unsigned short int deck_index = this->get_selected_deck_index();
         QLabel    *deck_track_name = this->decks[deck_index]->track_name;
-        QLabel   **deck_cue_point  = this->decks[deck_index]->cue_point_labels;
         Waveform  *deck_waveform   = this->decks[deck_index]->waveform;
         QSharedPointer<Audio_file_decoding_process> decode_process = this->decs[deck_index];
 
         // Execute decoding if not trying to open the existing track.
         if (info.fileName().compare(deck_track_name->text()) != 0 )
         {
-            // Stop playback.
+            // Stop playback and analysis of the previous track.
             this->playbacks[deck_index]->stop();
+            this->stop_band_process(deck_index);
 
-            // Clear audio track and waveform.
-            decode_process->clear();
+            // Clear waveform.
             deck_waveform->reset();
             deck_waveform->update();
+            this->decks[deck_index]->waveform_zoom->reset();
 
-            // Decode track.
-            if (decode_process->run(info.absoluteFilePath(), item->get_file_hash(), item->get_data(COLUMN_KEY).toString()) == false)
+            // Get the track from the prefetched ones (pointer swap) or decode it.
+            bool is_loaded = false;
+            if (this->prefetch_pool->take(info.absoluteFilePath(), this->ats[deck_index]) == true)
+            {
+                is_loaded = decode_process->load_decoded_track(item->get_file_hash(), item->get_data(COLUMN_KEY).toString());
+            }
+            else
+            {
+                decode_process->clear();
+                is_loaded = decode_process->run(info.absoluteFilePath(), item->get_file_hash(), item->get_data(COLUMN_KEY).toString());
+            }
+            if (is_loaded == false)
             {
                 qCWarning(DS_FILE) << "can not decode " << info.absoluteFilePath();
             }
@@ -2279,37 +2353,25 @@ Gui::run_audio_file_decoding_process()
             {
                 // Track is decoded, record the name in the tracklist.
                 this->add_track_path_to_tracklist(deck_index);
+
+                // Get frequency bands to color the waveform.
+                this->run_band_process(deck_index);
+
+                // Get cue points and tags of the track.
+                this->run_track_data_load(deck_index);
             }
         }
 
         // Force waveform computation.
         deck_waveform->reset();
+        this->decks[deck_index]->waveform_zoom->reset();
 
         // Reset playback process.
         this->playbacks[deck_index]->reset();
         deck_waveform->move_slider(0.0);
 
-        // Reset cue points on Dicer.
-        dicer_t dicer_index;
-        this->get_dicer_index_from_deck_index(deck_index, dicer_index);
-        this->dicer_control->clear_dicer(dicer_index);
-
-        // Load cue points.
-        for (unsigned short int i = 0; i < MAX_NB_CUE_POINTS; i++)
-        {
-            // On GUI buttons and wavform.
-            deck_waveform->move_cue_slider(i, this->playbacks[deck_index]->get_cue_point(i));
-            deck_cue_point[i]->setText(this->playbacks[deck_index]->get_cue_point_str(i));
-
-            // On Dicer.
-            if (this->playbacks[deck_index]->is_cue_point_defined(i) == true)
-            {
-                this->lit_dicer_button_cue_point(deck_index, i);
-            }
-        }
-
-        // On Dicer, always lit the 5th button to handle the "go to begin" feature.
-        this->lit_dicer_button_cue_point(deck_index, 4);
+        // Show cue points (those of a new track are shown again once loaded).
+        this->show_cue_points(deck_index);
 
         // Update waveform.
         deck_waveform->update();
@@ -2324,6 +2386,153 @@ Gui::run_audio_file_decoding_process()
     return;
 }
 
+void
+Gui::show_cue_points(const unsigned short int &deck_index)
+{
+    // Reset cue points on Dicer.
+    dicer_t dicer_index;
+    this->get_dicer_index_from_deck_index(deck_index, dicer_index);
+    this->dicer_control->clear_dicer(dicer_index);
+
+    // Load cue points.
+    for (unsigned short int i = 0; i < MAX_NB_CUE_POINTS; i++)
+    {
+        // On GUI buttons and wavform.
+        this->decks[deck_index]->waveform->move_cue_slider(i, this->playbacks[deck_index]->get_cue_point(i));
+        this->decks[deck_index]->cue_point_labels[i]->setText(this->playbacks[deck_index]->get_cue_point_str(i));
+
+        // On Dicer.
+        if (this->playbacks[deck_index]->is_cue_point_defined(i) == true)
+        {
+            this->lit_dicer_button_cue_point(deck_index, i);
+        }
+    }
+
+    // On Dicer, always lit the 5th button to handle the "go to begin" feature.
+    this->lit_dicer_button_cue_point(deck_index, 4);
+
+    return;
+}
+
+void
+Gui::run_track_data_load(const unsigned short int &deck_index)
+{
+    QSharedPointer<Audio_track> at = this->ats[deck_index];
+    if (at->get_hash() == "")
+    {
+        return;
+    }
+
+    // Cue points and tags are read by the DB thread (after pending writes), they are applied when done.
+    QSharedPointer<Audio_track> track_data = at->get_metadata_copy();
+    this->loaded_track_data[deck_index] = track_data;
+    this->edited_cue_points[deck_index].fill(false);
+    this->watchers_track_data[deck_index]->setFuture(Singleton<Data_persistence_worker>::get_instance().load_cue_points_and_tags(track_data));
+
+    return;
+}
+
+void
+Gui::on_finished_track_data_load(const unsigned short int &deck_index)
+{
+    QSharedPointer<Audio_track> track_data = this->loaded_track_data[deck_index];
+    if ((track_data.data() == nullptr) ||
+        (this->watchers_track_data[deck_index]->isFinished() == false) ||
+        (this->watchers_track_data[deck_index]->result() == false))
+    {
+        return;
+    }
+    this->loaded_track_data[deck_index].clear();
+
+    // Keep the result only if the track is still on the deck.
+    QSharedPointer<Audio_track> at = this->ats[deck_index];
+    if (track_data->get_hash() != at->get_hash())
+    {
+        return;
+    }
+
+    // Cue points set or deleted by the user in the meantime are kept.
+    for (unsigned short int i = 0; i < MAX_NB_CUE_POINTS; i++)
+    {
+        if (this->edited_cue_points[deck_index].testBit(i) == false)
+        {
+            at->set_cue_point(i, track_data->get_cue_point(i));
+            this->playbacks[deck_index]->read_cue_point(i);
+        }
+    }
+    at->set_tags(track_data->get_tags());
+
+    // Show them.
+    this->show_cue_points(deck_index);
+    this->decks[deck_index]->waveform->update();
+
+    return;
+}
+
+void
+Gui::run_band_process(const unsigned short int &deck_index)
+{
+    QSharedPointer<Audio_track> at = this->ats[deck_index];
+    if (at->get_peaks() == nullptr)
+    {
+        return;
+    }
+
+    // Get frequency bands from DB (they are computed only once per track), otherwise analyze the track.
+    // Both are done in background, the waveform is drawn again when it is done.
+    QSharedPointer<Audio_track_band_process> process(new Audio_track_band_process(at));
+    this->band_processes[deck_index] = process;
+    this->watchers_band_process[deck_index]->setFuture(Singleton<Job_scheduler>::get_instance().run<bool>(Job_priority::PREFETCH, [process](){ return (process->load() == true) || (process->run() == true); }));
+
+    return;
+}
+
+void
+Gui::stop_band_process(const unsigned short int &deck_index)
+{
+    // The analysis reads samples of the deck, so it must be over before they change.
+    if (this->band_processes[deck_index].data() != nullptr)
+    {
+        this->band_processes[deck_index]->stop();
+        this->watchers_band_process[deck_index]->waitForFinished();
+        this->band_processes[deck_index].clear();
+    }
+
+    return;
+}
+
+void
+Gui::on_finished_band_process(const unsigned short int &deck_index)
+{
+    QSharedPointer<Audio_track_band_process> process = this->band_processes[deck_index];
+    if ((process.data() == nullptr) ||
+        (this->watchers_band_process[deck_index]->isFinished() == false) ||
+        (this->watchers_band_process[deck_index]->result() == false))
+    {
+        return;
+    }
+    this->band_processes[deck_index].clear();
+
+    // Keep the result only if the analyzed track is still on the deck.
+    QSharedPointer<Audio_track> at = this->ats[deck_index];
+    if ((process->get_hash() == at->get_hash()) &&
+        (at->get_peaks() != nullptr))
+    {
+        at->get_peaks()->set_bands(process->get_bands());
+        if (process->is_loaded_from_db() == false)
+        {
+            Singleton<Data_persistence_worker>::get_instance().store_audio_track(at, process->get_bands());
+        }
+
+        // Draw waveforms again with colors.
+        this->decks[deck_index]->waveform->reset();
+        this->decks[deck_index]->waveform->update();
+        this->decks[deck_index]->waveform_zoom->reset();
+    }
+
+    return;
+}
+
 void
 Gui::add_track_path_to_tracklist(const unsigned short int &deck_index)
 {
@@ -2699,8 +2908,9 @@ Gui::set_cue_point(const unsigned short &deck_index, const unsigned short &cue_p
     {
         if (cue_point_index < MAX_NB_CUE_POINTS)
         {
-            // Store cue point in DB.
+            // Store cue point in DB (and do not replace it by the one being loaded).
             this->playbacks[deck_index]->store_cue_point(cue_point_index);
+            this->edited_cue_points[deck_index].setBit(cue_point_index);
 
             // Display cue point on waveform and on label.
             this->decks[deck_index]->waveform->move_cue_slider(cue_point_index, this->playbacks[deck_index]->get_position());
@@ -2744,8 +2954,9 @@ Gui::del_cue_point(const unsigned short &deck_index, const unsigned short &cue_p
     {
         if (this->playbacks[deck_index]->is_cue_point_defined(cue_point_index) == true)
         {
-            // Delete cue point from DB.
+            // Delete cue point from DB (and do not restore the one being loaded).
             this->playbacks[deck_index]->delete_cue_point(cue_point_index);
+            this->edited_cue_points[deck_index].setBit(cue_point_index);
 
             // Delete cue point from waveform and label.
             this->decks[deck_index]->waveform->move_cue_slider(cue_point_index, 0.0);
@@ -2882,20 +3093,49 @@ Gui::show_next_keys()
         // Collapse all tree.
         this->file_browser->collapseAll();
 
-        // Get next keys and highlight.
+        // Get next keys and highlight, directories containing files of next keys are expanded when they are in the tree.
         QString next_key;
         QString prev_key;
         QString oppos_key;
         Utils::get_next_music_keys(deck_key, next_key, prev_key, oppos_key);
-        QList<QModelIndex> directories = this->file_system_model->set_next_keys(next_key, prev_key, oppos_key);
+        this->file_system_model->set_next_keys(next_key, prev_key, oppos_key);
+
+        // Tracks of next keys are good candidates for the next load.
+        this->next_keys_paths = this->file_system_model->get_next_keys_paths(this->settings->get_prefetch_pool_size());
+        this->update_prefetch_candidates();
+    }
 
-        // Expand directories containing file of next keys.
-        foreach (QModelIndex index, directories)
+    return;
+}
+
+void
+Gui::update_prefetch_candidates()
+{
+    QStringList paths;
+
+    // Selected track and the following ones (next entries of the directory or of the playlist).
+    QModelIndex index = this->file_browser->currentIndex();
+    while ((index.isValid() == true) && (paths.size() <= PREFETCH_NB_FOLLOWING_TRACKS))
+    {
+        Audio_collection_item *item = static_cast<Audio_collection_item*>(index.internalPointer());
+        if (item->is_directory() == false)
         {
-            this->file_browser->expand(index);
+            paths << item->get_full_path();
         }
+        index = this->file_browser->indexBelow(index);
     }
 
+    // Then tracks of compatible keys.
+    paths << this->next_keys_paths;
+
+    // Do not prefetch tracks which are already loaded on a deck.
+    for (unsigned short int i = 0; i < this->nb_decks; i++)
+    {
+        paths.removeAll(this->ats[i]->get_fullpath());
+    }
+
+    this->prefetch_pool->set_candidates(paths);
+
     return;
 }
 
@@ -2990,6 +3230,7 @@ Deck::Deck(const QString &title, const QSharedPointer<Audio_track> &at) : Playba
                                                                           thru_button           {nullptr},
                                                                           key                   {nullptr},
                                                                           waveform              {nullptr},
+                                                                          waveform_zoom         {nullptr},
                                                                           remaining_time_layout {nullptr},
                                                                           rem_time_minus        {nullptr},
                                                                           rem_time_min          {nullptr},
@@ -3023,6 +3264,7 @@ Deck::~Deck()
     delete this->thru_button;
     delete this->key;
     delete this->waveform;
+    delete this->waveform_zoom;
     delete this->remaining_time_layout;
     delete this->buttons_layout;
     delete this->speed;
@@ -3056,6 +3298,8 @@ Deck::init_display()
     this->set_key("");
     this->waveform = new Waveform(this->at);
     this->waveform->setObjectName("Waveform");
+    this->waveform_zoom = new Waveform_zoom(this->at);
+    this->waveform_zoom->setObjectName("WaveformZoom");
 
     // Create remaining time.
     this->remaining_time_layout = new QHBoxLayout;
@@ -3204,7 +3448,8 @@ Deck::init_display()
     track_layout->addWidget(this->thru_button, 5);
     sub_layout->addLayout(track_layout,                5);
     sub_layout->addLayout(this->remaining_time_layout, 5);
-    sub_layout->addWidget(this->waveform,              85);
+    sub_layout->addWidget(this->waveform_zoom,         45);
+    sub_layout->addWidget(this->waveform,              40);
     sub_layout->addLayout(this->buttons_layout,        5);
     general_layout->addLayout(sub_layout,              90);
 
@@ -34,6 +34,7 @@
 #include <QPainter>
 #include <QtDebug>
 #include <QMouseEvent>
+#include <QPaintEvent>
 #include <iostream>
 #include <math.h>
 
@@ -54,29 +55,16 @@ Waveform::Waveform(const QSharedPointer<Audio_track> &at, QWidget *parent) : QLa
     this->area_width  = 0;
     this->slider_absolute_position = 0;
 
-    // Create table of points to display.
-    this->points = new QPointF[POINTS_MAX_SIZE];
+    // Waveform is drawn at first paint.
     this->end_of_waveform = 0;
-    this->force_regenerate_polyline = true;
+    this->force_regenerate_cache = true;
 
-    // Create slider.
+    // Slider and cue sliders are painted over the waveform.
     this->slider_position_x = 0;
-    this->slider = new QLabel(this);
-    this->slider->setGeometry(0, 0, 0, 0);
-    this->slider->setObjectName("Slider");
-    this->slider->setStyleSheet("background-color: orange;");
-
-    // Create cue sliders.
     for (unsigned short int i = 0; i < MAX_NB_CUE_POINTS; i++)
     {
-        this->cue_sliders << new QLabel(this);
-        this->cue_sliders_number << new QLabel(QString::number(i + 1), this);
-        this->cue_sliders[i]->setObjectName("CueSlider");
-        this->cue_sliders[i]->setStyleSheet("background-color: white;");
-        this->cue_sliders_number[i]->setStyleSheet("background-color: white; color: black; font: 6pt; qproperty-alignment: AlignCenter;");
         this->cue_sliders_position_x << 0;
         this->cue_sliders_absolute_position << 0.0;
-        this->draw_cue_slider(i);
     }
 
     return;
@@ -84,16 +72,13 @@ Waveform::Waveform(const QSharedPointer<Audio_track> &at, QWidget *parent) : QLa
 
 Waveform::~Waveform()
 {
-    // Delete table of points.
-    delete [] this->points;
-
     return;
 }
 
 void
 Waveform::reset()
 {
-    this->force_regenerate_polyline = true;
+    this->force_regenerate_cache = true;
 
     return;
 }
@@ -110,71 +95,126 @@ Waveform::get_area_size()
     {
         this->area_height = new_height;
         this->area_width  = new_width;
-        this->force_regenerate_polyline = true;
+        this->force_regenerate_cache = true;
+
+        // Keep sliders at the same place in the track.
+        this->slider_position_x = this->slider_absolute_position * this->area_width;
+        for (int i = 0; i < this->cue_sliders_position_x.size(); i++)
+        {
+            this->cue_sliders_position_x[i] = this->cue_sliders_absolute_position[i] * this->area_width;
+        }
     }
 
     return;
 }
 
 bool
-Waveform::generate_polyline()
+Waveform::generate_lines()
 {
-    // Get audio track table of samples.
-    unsigned int j = 0;
-    short signed int *samples = this->at->get_samples();
-
-    // For each points take a sample (every 100 samples) and convert it to be
-    // displayed in painting area.
+    this->peak_lines.resize(qMax(this->area_width, 0));
+    this->rms_lines.resize(qMax(this->area_width, 0));
+    this->band_colors.clear();
     this->end_of_waveform = 0;
-    for (unsigned int i = 0; i < POINTS_MAX_SIZE; i++)
+
+    // Use the level of peaks which is the closest to the number of frames shown by a column.
+    Audio_track_peaks *peaks = this->at->get_peaks();
+    if ((peaks == nullptr) || (this->area_width <= 0))
+    {
+        return false;
+    }
+    float              nb_frames_per_pixel = (float)(this->at->get_max_nb_samples() / 2) / (float)this->area_width;
+    unsigned short int level               = peaks->get_level(nb_frames_per_pixel);
+    unsigned int       bin_size            = peaks->get_bin_size(level);
+    unsigned int       nb_frames           = this->at->get_end_of_samples() / 2;
+    int                middle              = this->area_height / 2;
+    if (peaks->has_bands() == true)
     {
-        // Get sample.
-        short signed int current_sample = samples[j];
+        this->band_colors.resize(this->area_width);
+    }
 
-        // Adapt value to paiting area.
-        float x = (float)(this->area_width * i) / (float)POINTS_MAX_SIZE;
-        float y = 0.0;
-        if (j <= this->at->get_end_of_samples())
+    for (int x = 0; x < this->area_width; x++)
+    {
+        unsigned int first_frame = (unsigned int)(x * nb_frames_per_pixel);
+        if (first_frame < nb_frames)
         {
-            y = (float)(((float)(current_sample - SHRT_MAX) * this->area_height) / (float)(SHRT_MAX * -1 * 2));
-            this->end_of_waveform = i;
+            // Summary of all bins of the column.
+            unsigned int first_bin = first_frame / bin_size;
+            unsigned int last_bin  = qMax(first_bin + 1, (unsigned int)((x + 1) * nb_frames_per_pixel) / bin_size);
+            Audio_peak   peak      = peaks->get_peak(level, first_bin, last_bin);
+
+            // Adapt values to painting area.
+            int y_max = (int)(((float)(peak.max - SHRT_MAX) * this->area_height) / (float)(SHRT_MAX * -1 * 2));
+            int y_min = (int)(((float)(peak.min - SHRT_MAX) * this->area_height) / (float)(SHRT_MAX * -1 * 2));
+            int y_rms = (int)((peak.rms * this->area_height) / (float)(SHRT_MAX * 2));
+            this->peak_lines[x].setLine(x, y_max, x, y_min);
+            this->rms_lines[x].setLine(x, middle - y_rms, x, middle + y_rms);
+            this->end_of_waveform = x;
+
+            // Color from the frequency bands of the column.
+            if (this->band_colors.size() > 0)
+            {
+                this->band_colors[x] = Waveform::get_band_color(peaks->get_bands(first_frame, (unsigned int)((x + 1) * nb_frames_per_pixel)));
+            }
         }
         else
         {
-            // There is no more sample (track is finish), set polyline to 0.
-            y = (float)(this->area_height / 2);
+            // There is no more sample (track is finish), draw a flat line.
+            this->peak_lines[x].setLine(x, middle, x, middle);
+            this->rms_lines[x].setLine(x, middle, x, middle);
+            if (this->band_colors.size() > 0)
+            {
+                this->band_colors[x] = QColor("grey");
+            }
         }
+    }
 
-        this->points[i].setX(x);
-        this->points[i].setY(y);
+    return true;
+}
 
-        // Next sample.
-        j += 100;
+QColor
+Waveform::get_band_color(const Audio_bands &bands)
+{
+    // Hue shows the balance between bands, the brightest component is always at full scale.
+    int max = qMax(qMax(bands.low, bands.mid), bands.high);
+    if (max == 0)
+    {
+        return QColor("grey");
     }
 
-    this->force_regenerate_polyline = false;
-
-    return true;
+    return QColor(bands.low * 255 / max, bands.mid * 255 / max, bands.high * 255 / max);
 }
 
 void
-Waveform::paintEvent(QPaintEvent *)
+Waveform::generate_cache()
 {
-    // Get area size.
-    this->get_area_size();
+    this->generate_lines();
 
-    // Generate list of points to draw if size of the waveform changed.
-    if (this->force_regenerate_polyline == true)
-    {
-        this->generate_polyline();
-    }
+    // Draw the waveform and minute separators once in an off screen pixmap.
+    this->cache = QPixmap(this->area_width + 1, this->area_height + 1);
+    this->cache.fill(Qt::transparent);
 
     QPainter painter;
-    painter.begin(this);
+    painter.begin(&this->cache);
 
-    // Draw polyline on current area.
-    painter.setPen(QColor("grey"));
-    painter.drawPolyline(this->points, POINTS_MAX_SIZE); // waveform from track
+    // Draw waveform from track (peaks, then rms inside).
+    if (this->band_colors.size() > 0)
+    {
+        // Colored by frequency bands, one column at a time.
+        for (int x = 0; x < this->peak_lines.size(); x++)
+        {
+            painter.setPen(this->band_colors[x].darker(150));
+            painter.drawLine(this->peak_lines[x]);
+            painter.setPen(this->band_colors[x]);
+            painter.drawLine(this->rms_lines[x]);
+        }
+    }
+    else
+    {
+        painter.setPen(QColor("grey"));
+        painter.drawLines(this->peak_lines);
+        painter.setPen(QColor("lightgrey"));
+        painter.drawLines(this->rms_lines);
+    }
 
     // Draw minute separators.
     painter.setPen(QColor(0, 102, 0)); // kind of green
@@ -185,11 +225,63 @@ Waveform::paintEvent(QPaintEvent *)
         painter.drawLine(qRound(x), 0, qRound(x), this->area_height);
     }
 
+    painter.end();
+    this->force_regenerate_cache = false;
+
+    return;
+}
+
+void
+Waveform::paintEvent(QPaintEvent *event)
+{
+    // Get area size.
+    this->get_area_size();
+
+    // Draw the waveform again only if size of the widget or track changed.
+    if (this->force_regenerate_cache == true)
+    {
+        this->generate_cache();
+    }
+
+    QPainter painter;
+    painter.begin(this);
+    painter.setClipRegion(event->region());
+
+    // Static part.
+    painter.drawPixmap(0, 0, this->cache);
+
+    // Cue sliders (with their number).
+    QFont font = painter.font();
+    font.setPointSize(6);
+    painter.setFont(font);
+    for (int i = 0; i < this->cue_sliders_position_x.size(); i++)
+    {
+        int x = this->cue_sliders_position_x[i];
+        if (x > 0) // Cue point not defined (= 0) are not shown.
+        {
+            painter.fillRect(x, 0, 1, this->area_height, Qt::white);
+            painter.fillRect(x, 0, 10, 10, Qt::white);
+            painter.setPen(Qt::black);
+            painter.drawText(QRect(x, 0, 10, 10), Qt::AlignCenter, QString::number(i + 1));
+        }
+    }
+
+    // Slider.
+    painter.fillRect(this->slider_position_x, 0, 2, this->area_height, QColor("orange"));
+
     painter.end();
 
     return;
 }
 
+void
+Waveform::update_column(const int &x_pos, const int &width)
+{
+    this->update(QRect(x_pos, 0, width, this->area_height + 1));
+
+    return;
+}
+
 bool
 Waveform::jump_slider(const int &x_pos)
 {
@@ -200,12 +292,11 @@ Waveform::jump_slider(const int &x_pos)
     }
 
     // Move slider to new position if possible.
-    unsigned int x_index = floor(((float)x_pos * (float)this->at->get_max_nb_samples())
-                                   / ((float)this->area_width * 100.0));
-    if (x_index <= this->end_of_waveform)
+    if (x_pos <= this->end_of_waveform)
     {
+        this->update_column(this->slider_position_x, 2);
         this->slider_position_x = x_pos;
-        this->slider->setGeometry(this->slider_position_x, 0, 2, this->area_height);
+        this->update_column(this->slider_position_x, 2);
 
         // Emit signal to change position in track.
         emit slider_position_changed((float)x_pos / (float)this->area_width);
@@ -238,9 +329,14 @@ Waveform::move_slider(const float &position)
     // Store absolute position.
     this->slider_absolute_position = position;
 
-    // Move slider to new position.
-    this->slider_position_x = position * this->area_width;
-    this->slider->setGeometry(this->slider_position_x, 0, 2, this->area_height);
+    // Move slider to new position, repaint only if it moved at least by one pixel.
+    int x_pos = position * this->area_width;
+    if (x_pos != this->slider_position_x)
+    {
+        this->update_column(this->slider_position_x, 2);
+        this->slider_position_x = x_pos;
+        this->update_column(this->slider_position_x, 2);
+    }
 
     return true;
 }
@@ -258,28 +354,10 @@ Waveform::move_cue_slider(const unsigned short int &cue_point_num,
     // Store absolute position.
     this->cue_sliders_absolute_position[cue_point_num] = position;
 
-    // Move slider to new position.
+    // Move slider to new position (repaint its old and new place, including the number).
+    this->update_column(this->cue_sliders_position_x[cue_point_num], 10);
     this->cue_sliders_position_x[cue_point_num] = position * this->area_width;
-    this->draw_cue_slider(cue_point_num);
+    this->update_column(this->cue_sliders_position_x[cue_point_num], 10);
 
     return true;
 }
-
-void
-Waveform::draw_cue_slider(const unsigned short int &cue_point_num)
-{
-    // Show cue slider if defined.
-    if (this->cue_sliders_position_x[cue_point_num] > 0)
-    {
-        this->cue_sliders[cue_point_num]->setGeometry(this->cue_sliders_position_x[cue_point_num], 0, 1, this->area_height);
-        this->cue_sliders_number[cue_point_num]->setGeometry(this->cue_sliders_position_x[cue_point_num], 0, 10, 10);
-        this->cue_sliders[cue_point_num]->show();
-        this->cue_sliders_number[cue_point_num]->show();
-    }
-    else
-    {
-        // Cue point not defined (= 0), so hide it.
-        this->cue_sliders[cue_point_num]->hide();
-        this->cue_sliders_number[cue_point_num]->hide();
-    }
-}
@@ -0,0 +1,228 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*------------------------------------------------------( waveform_zoom.cpp )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Display class: zoomed waveform scrolling around the playback position.    */
+/*                                                                            */
+/*============================================================================*/
+
+#include <QPainter>
+#include <QPaintEvent>
+#include <QResizeEvent>
+#include <QtDebug>
+#include <climits>
+
+#include "gui/waveform_zoom.h"
+#include "gui/waveform.h"
+#include "app/application_logging.h"
+
+Waveform_zoom::Waveform_zoom(const QSharedPointer<Audio_track> &at, QWidget *parent) : QWidget(parent)
+{
+    // Get audio track.
+    if (at.data() == nullptr)
+    {
+        qCCritical(DS_OBJECTLIFE) << "audio track can not be null";
+    }
+    this->at = at;
+
+    // Init.
+    this->nb_frames_per_pixel = 1.0;
+    this->position_x          = 0;
+
+    // Follow the playback position at display rate.
+    this->refresh_timer.setTimerType(Qt::PreciseTimer);
+    this->refresh_timer.setInterval(WAVEFORM_ZOOM_REFRESH_MSEC);
+    QObject::connect(&this->refresh_timer, &QTimer::timeout, [this](){this->refresh();});
+
+    return;
+}
+
+Waveform_zoom::~Waveform_zoom()
+{
+    this->refresh_timer.stop();
+
+    return;
+}
+
+void
+Waveform_zoom::set_playback(const QSharedPointer<Deck_playback_process> &playback)
+{
+    this->playback = playback;
+    this->refresh_timer.start();
+
+    return;
+}
+
+void
+Waveform_zoom::reset()
+{
+    this->tiles.clear();
+    this->update();
+
+    return;
+}
+
+void
+Waveform_zoom::resizeEvent(QResizeEvent *event)
+{
+    // Same duration is always shown, so the scale changes with the width.
+    if (event->size().width() > 0)
+    {
+        this->nb_frames_per_pixel = (float)(2 * WAVEFORM_ZOOM_SEC * this->at->get_sample_rate()) / (float)event->size().width();
+    }
+    this->tiles.clear();
+
+    return;
+}
+
+void
+Waveform_zoom::refresh()
+{
+    if ((this->playback.data() == nullptr) || (this->isVisible() == false))
+    {
+        return;
+    }
+
+    // Position is read without lock (snapshot written by the playback thread).
+    qint64 position_x = (qint64)((this->playback->get_position_snapshot() / 2) / this->nb_frames_per_pixel);
+    if (position_x != this->position_x)
+    {
+        this->position_x = position_x;
+        this->update();
+    }
+
+    return;
+}
+
+const QImage&
+Waveform_zoom::get_tile(const qint64 &index)
+{
+    QHash<qint64, QImage>::iterator tile = this->tiles.find(index);
+    if (tile == this->tiles.end())
+    {
+        // Forget tiles far from the current one.
+        if (this->tiles.size() >= WAVEFORM_ZOOM_MAX_NB_TILES)
+        {
+            QHash<qint64, QImage>::iterator it = this->tiles.begin();
+            while (it != this->tiles.end())
+            {
+                if (qAbs(it.key() - index) > WAVEFORM_ZOOM_MAX_NB_TILES / 4)
+                {
+                    it = this->tiles.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+
+        // Draw the new tile.
+        tile = this->tiles.insert(index, QImage(WAVEFORM_ZOOM_TILE_WIDTH, this->height(), QImage::Format_ARGB32_Premultiplied));
+        this->draw_tile(index, tile.value());
+    }
+
+    return tile.value();
+}
+
+void
+Waveform_zoom::draw_tile(const qint64 &index, QImage &tile)
+{
+    tile.fill(Qt::transparent);
+    Audio_track_peaks *peaks = this->at->get_peaks();
+    if ((peaks == nullptr) || (this->at->get_end_of_samples() == 0))
+    {
+        return;
+    }
+
+    // Use the level of peaks which is the closest to the number of frames shown by a column.
+    unsigned short int level     = peaks->get_level(this->nb_frames_per_pixel);
+    unsigned int       bin_size  = peaks->get_bin_size(level);
+    unsigned int       nb_frames = this->at->get_end_of_samples() / 2;
+    int                height    = tile.height() - 1;
+    int                middle    = height / 2;
+
+    QPainter painter;
+    painter.begin(&tile);
+    for (int x = 0; x < WAVEFORM_ZOOM_TILE_WIDTH; x++)
+    {
+        qint64 column      = index * WAVEFORM_ZOOM_TILE_WIDTH + x;
+        qint64 first_frame = (qint64)(column * this->nb_frames_per_pixel);
+        if ((first_frame < 0) || (first_frame >= nb_frames))
+        {
+            continue;
+        }
+
+        // Summary of all bins of the column.
+        unsigned int first_bin = first_frame / bin_size;
+        unsigned int last_bin  = qMax(first_bin + 1, (unsigned int)((column + 1) * this->nb_frames_per_pixel) / bin_size);
+        Audio_peak   peak      = peaks->get_peak(level, first_bin, last_bin);
+
+        // Adapt values to painting area.
+        int y_max = (int)(((float)(peak.max - SHRT_MAX) * height) / (float)(SHRT_MAX * -1 * 2));
+        int y_min = (int)(((float)(peak.min - SHRT_MAX) * height) / (float)(SHRT_MAX * -1 * 2));
+        int y_rms = (int)((peak.rms * height) / (float)(SHRT_MAX * 2));
+        QColor peak_color("grey");
+        QColor rms_color("lightgrey");
+        if (peaks->has_bands() == true)
+        {
+            // Colored by frequency bands.
+            rms_color  = Waveform::get_band_color(peaks->get_bands(first_frame, (unsigned int)((column + 1) * this->nb_frames_per_pixel)));
+            peak_color = rms_color.darker(150);
+        }
+        painter.setPen(peak_color);
+        painter.drawLine(x, y_max, x, y_min);
+        painter.setPen(rms_color);
+        painter.drawLine(x, middle - y_rms, x, middle + y_rms);
+    }
+    painter.end();
+
+    return;
+}
+
+void
+Waveform_zoom::paintEvent(QPaintEvent *)
+{
+    QPainter painter;
+    painter.begin(this);
+
+    // Draw tiles which are visible, the playback position is in the middle.
+    qint64 left_x     = this->position_x - this->width() / 2;
+    qint64 first_tile = left_x >= 0 ? left_x / WAVEFORM_ZOOM_TILE_WIDTH : (left_x - WAVEFORM_ZOOM_TILE_WIDTH + 1) / WAVEFORM_ZOOM_TILE_WIDTH;
+    qint64 last_tile  = (left_x + this->width()) / WAVEFORM_ZOOM_TILE_WIDTH;
+    for (qint64 i = qMax(first_tile, (qint64)0); i <= last_tile; i++)
+    {
+        painter.drawImage(QPoint((int)(i * WAVEFORM_ZOOM_TILE_WIDTH - left_x), 0), this->get_tile(i));
+    }
+
+    // Playback position.
+    painter.fillRect(this->width() / 2, 0, 2, this->height(), QColor("orange"));
+
+    painter.end();
+
+    return;
+}
@@ -51,6 +51,7 @@
 #include "audiodev/jack_client_control_rules.h"
 #include "control/timecode_control_process.h"
 #include "control/dicer_control_process.h"
+#include "tracks/data_persistence_worker.h"
 #include "singleton.h"
 
 int main(int argc, char *argv[])
@@ -194,5 +195,8 @@ int main(int argc, char *argv[])
     control_and_playback_thread->start();
     app.exec();
 
+    // Write data still waiting for the DB.
+    Singleton<Data_persistence_worker>::get_instance().stop();
+
     return 0;
 }
@@ -39,7 +39,7 @@
 #include "utils.h"
 #include "singleton.h"
 #include "player/deck_playback_process.h"
-#include "tracks/data_persistence.h"
+#include "tracks/data_persistence_worker.h"
 #include "app/application_logging.h"
 
 #define SPEED_MIN_TO_GO_DOWN 0.2
@@ -383,6 +383,9 @@ Deck_playback_process::run(float io_playback_buf_1[], float io_playback_buf_2[],
         this->update_samplers_remaining_time();
     }
 
+    // Publish position for displays.
+    this->position_snapshot.storeRelease(this->current_sample);
+
     return true;
 }
 
@@ -583,14 +586,8 @@ Deck_playback_process::get_cue_point(const unsigned short int &cue_point_number)
 bool
 Deck_playback_process::read_cue_point(const unsigned short int &cue_point_number)
 {
-    // Get cue point from DB.
-    Data_persistence *data_persist = &Singleton<Data_persistence>::get_instance();
-    if (this->at->get_hash() != "")
-    {
-        unsigned int position = 0;
-        data_persist->get_cue_point(this->at, cue_point_number, position);
-        this->cue_points[cue_point_number] = this->msec_to_sample_index(position);
-    }
+    // Get cue point loaded with the track (no DB access here).
+    this->cue_points[cue_point_number] = this->msec_to_sample_index(this->at->get_cue_point(cue_point_number));
 
     return true;
 }
@@ -600,13 +597,16 @@ Deck_playback_process::store_cue_point(const unsigned short int &cue_point_numbe
 {
     // Store cue point.
     this->cue_points[cue_point_number] = this->current_sample;
+    unsigned int position_msec = this->sample_index_to_msec(this->cue_points[cue_point_number]);
+    this->at->set_cue_point(cue_point_number, position_msec);
 
-    // Store it also to DB.
-    Data_persistence *data_persist = &Singleton<Data_persistence>::get_instance();
+    // Store it also to DB (in background).
+    if (this->at->get_hash() != "")
+    {
+        Singleton<Data_persistence_worker>::get_instance().store_cue_point(this->at, cue_point_number, position_msec);
+    }
 
-    return data_persist->store_cue_point(this->at,
-                                         cue_point_number,
-                                         this->sample_index_to_msec(this->cue_points[cue_point_number]));
+    return true;
 }
 
 bool
@@ -623,10 +623,15 @@ Deck_playback_process::delete_cue_point(const unsigned short int &cue_point_numb
 {
     // Delete cue point from playback process list.
     this->cue_points[cue_point_number] = 0;
+    this->at->set_cue_point(cue_point_number, 0);
 
-    // Delete cue point from database.
-    Data_persistence *data_persist = &Singleton<Data_persistence>::get_instance();
-    return data_persist->delete_cue_point(this->at, cue_point_number);
+    // Delete cue point from database (in background).
+    if (this->at->get_hash() != "")
+    {
+        Singleton<Data_persistence_worker>::get_instance().delete_cue_point(this->at, cue_point_number);
+    }
+
+    return true;
 }
 
 float
@@ -635,6 +640,12 @@ Deck_playback_process::get_position()
     return this->sample_index_to_float(this->current_sample);
 }
 
+unsigned int
+Deck_playback_process::get_position_snapshot()
+{
+    return (unsigned int)this->position_snapshot.loadAcquire();
+}
+
 QString
 Deck_playback_process::get_cue_point_str(const unsigned short &cue_point_number) const
 {
@@ -35,37 +35,73 @@
 #include <QTextCodec>
 #include <iostream>
 #include <QPixmap>
-#include <QtConcurrentMap>
 #include <QMimeData>
 #include <QCoreApplication>
+#include <QThreadStorage>
+#include <QAtomicInt>
+#include <QCollator>
+#include <QSet>
+#include <algorithm>
+#include <vector>
 
 #include "app/application_settings.h"
 #include "app/application_const.h"
 #include "app/application_logging.h"
+#include "app/job_scheduler.h"
 #include "tracks/audio_collection_model.h"
 #include "tracks/audio_track.h"
 #include "tracks/data_persistence.h"
+#include "tracks/data_persistence_worker.h"
+#include "tracks/audio_file_analysis_process.h"
+#include "tracks/audio_track_key_process.h"
+#include "tracks/audio_track_bpm_process.h"
+#include "tracks/audio_track_loudness_process.h"
+#include "tracks/audio_track_band_process.h"
+#include "tracks/directory_scanner.h"
 #include "utils.h"
 #include "singleton.h"
 
+// Sort key of a text, numbers are compared by value (a collator by thread, they are not thread safe).
+static QCollatorSortKey get_collator_sort_key(const QString &in_text)
+{
+    static thread_local QCollator *collator = nullptr;
+    if (collator == nullptr)
+    {
+        collator = new QCollator();
+        collator->setNumericMode(true);
+        collator->setCaseSensitivity(Qt::CaseInsensitive);
+    }
+
+    return collator->sortKey(in_text);
+}
+
 Audio_collection_item::Audio_collection_item(const QList<QVariant> &in_data,
-                                             QString                in_file_hash,
                                              QString                in_full_path,
-                                             bool                   in_is_directory,
                                              Audio_collection_item *in_parent)
 {
-    this->parentItem     = in_parent;
-    this->fileHash       = in_file_hash;
-    this->itemData       = in_data;
-    this->fullPath       = in_full_path;
-    this->directoryFlag  = in_is_directory;
-    this->next_key       = false;
-    this->next_major_key = false;
+    this->parentItem    = in_parent;
+    this->store         = nullptr;
+    this->file_id       = -1;
+    this->itemData      = in_data;
+    this->fullPath      = in_full_path;
+    this->directoryFlag = true;
+    this->fetched       = false;
+}
+
+Audio_collection_item::Audio_collection_item(Audio_collection_store *in_store,
+                                             int                     in_file_id,
+                                             Audio_collection_item  *in_parent)
+{
+    this->parentItem    = in_parent;
+    this->store         = in_store;
+    this->file_id       = in_file_id;
+    this->directoryFlag = false;
+    this->fetched       = false;
 }
 
 Audio_collection_item::~Audio_collection_item()
 {
-    qDeleteAll(this->childItems);
+    this->clear_children();
 }
 
 void Audio_collection_item::append_child(Audio_collection_item *in_item)
@@ -73,6 +109,29 @@ void Audio_collection_item::append_child(Audio_collection_item *in_item)
     this->childItems.append(in_item);
 }
 
+void Audio_collection_item::set_parent(Audio_collection_item *in_parent)
+{
+    this->parentItem = in_parent;
+}
+
+void Audio_collection_item::clear_children()
+{
+    // Files are owned by the collection index, they are only detached from the tree.
+    foreach (Audio_collection_item *child, this->childItems)
+    {
+        if (child->is_directory() == true)
+        {
+            delete child;
+        }
+        else
+        {
+            child->set_parent(nullptr);
+        }
+    }
+    this->childItems.clear();
+    this->fetched = false;
+}
+
 Audio_collection_item *Audio_collection_item::get_child(int in_row)
 {
     return this->childItems.value(in_row);
@@ -85,17 +144,54 @@ int Audio_collection_item::get_child_count() const
 
 int Audio_collection_item::get_column_count() const
 {
+    if (this->store != nullptr)
+    {
+        return COLUMN_PATH + 1;
+    }
+
     return this->itemData.count();
 }
 
 QVariant Audio_collection_item::get_data(int in_column) const
 {
+    // Data of a file are in the collection store.
+    if (this->store != nullptr)
+    {
+        switch (in_column)
+        {
+            case COLUMN_FILE_NAME:
+                return this->store->get_name(this->file_id);
+            case COLUMN_KEY:
+                return Utils::get_camelot_key(this->store->get_key(this->file_id));
+            case COLUMN_BPM:
+            {
+                float bpm = this->store->get_bpm(this->file_id);
+                return bpm > 0.0 ? QString::number(bpm, 'f', 1) : "";
+            }
+            case COLUMN_PATH:
+                return this->store->get_dir_path(this->file_id);
+            default:
+                return QVariant();
+        }
+    }
+
     return this->itemData.value(in_column);
 }
 
 void Audio_collection_item::set_data(int in_column, QVariant in_data)
 {
-    if (in_column < this->itemData.size())
+    if (this->store != nullptr)
+    {
+        if (in_column == COLUMN_KEY)
+        {
+            this->store->set_key(this->file_id, Utils::get_camelot_index(in_data.toString()));
+        }
+        else if (in_column == COLUMN_BPM)
+        {
+            this->store->set_bpm(this->file_id, in_data.toFloat());
+        }
+    }
+    else if (in_column < this->itemData.size())
     {
         this->itemData.replace(in_column, in_data);
     }
@@ -118,12 +214,30 @@ int Audio_collection_item::get_row() const
 
 QString Audio_collection_item::get_full_path()
 {
+    if (this->store != nullptr)
+    {
+        return this->store->get_full_path(this->file_id);
+    }
+
     return this->fullPath;
 }
 
 QString Audio_collection_item::get_file_hash()
 {
-    return this->fileHash;
+    if (this->store != nullptr)
+    {
+        return this->store->get_hash(this->file_id);
+    }
+
+    return "";
+}
+
+void Audio_collection_item::set_file_hash(QString in_file_hash)
+{
+    if (this->store != nullptr)
+    {
+        this->store->set_hash(this->file_id, in_file_hash);
+    }
 }
 
 bool Audio_collection_item::is_directory()
@@ -131,104 +245,229 @@ bool Audio_collection_item::is_directory()
     return this->directoryFlag;
 }
 
-bool Audio_collection_item::is_a_next_key()
+int Audio_collection_item::get_file_id() const
 {
-    return this->next_key;
+    return this->file_id;
 }
 
-bool Audio_collection_item::is_a_next_major_key()
+bool Audio_collection_item::is_fetched()
 {
-    return this->next_major_key;
+    return this->fetched;
 }
 
-void Audio_collection_item::set_next_key(bool is_a_next_key)
+void Audio_collection_item::set_fetched(bool in_fetched)
 {
-    this->next_key = is_a_next_key;
+    this->fetched = in_fetched;
 }
 
-void Audio_collection_item::set_next_major_key(bool is_a_next_major_key)
+bool Audio_collection_item::is_a_next_key()
 {
-    this->next_major_key = is_a_next_major_key;
+    return (this->store != nullptr) && (this->store->is_next_key(this->file_id) == true);
 }
 
-void Audio_collection_item::read_from_db()
+bool Audio_collection_item::is_a_next_major_key()
 {
-    // Init.
-    Data_persistence *data_persist = &Singleton<Data_persistence>::get_instance();
-    QSharedPointer<Audio_track> at(new Audio_track(44100));
+    return (this->store != nullptr) && (this->store->is_next_major_key(this->file_id) == true);
+}
 
-    // Get the hash of audio file.
-    at->reset();
-    at->set_hash(this->get_file_hash());
+void Audio_collection_item::read_from_track(const QSharedPointer<Audio_track> &in_at)
+{
+    // Only if the file did not change since the track was read (data are empty if it was not in DB).
+    if (in_at->get_hash() == this->get_file_hash())
+    {
+        this->store->set_key(this->file_id, Utils::get_camelot_index(in_at->get_music_key()));
+        this->store->set_bpm(this->file_id, in_at->get_bpm());
+        this->store->set_first_beat(this->file_id, in_at->get_first_beat());
+        this->store->set_loudness(this->file_id, in_at->get_loudness());
+        this->store->set_flag(this->file_id, COLLECTION_FILE_ANALYZED, in_at->is_analyzed());
+        this->store->set_flag(this->file_id, COLLECTION_FILE_DB_READ, true);
+    }
+}
+
+void Audio_collection_item::read_from_data(const QHash<Hash_128, Audio_track_data> &in_data)
+{
+    // Already read (its directory was shown before all files were listed).
+    if (this->is_read_from_db() == true)
+    {
+        return;
+    }
 
-    // Get audio data from db and put it back to the item.
-    if (data_persist->get_audio_track(at) == true)
+    // Look for the file in data of all tracks and put them back to the item.
+    Hash_128 hash;
+    if (this->store->get_hash_128(this->file_id, hash) == true)
     {
-        // File found in DB, put data back to item.
-        this->set_data(COLUMN_KEY, at->get_music_key());
+        QHash<Hash_128, Audio_track_data>::const_iterator data = in_data.constFind(hash);
+        if (data != in_data.constEnd())
+        {
+            this->store->set_key(this->file_id, data->key);
+            this->store->set_bpm(this->file_id, data->bpm);
+            this->store->set_first_beat(this->file_id, data->first_beat);
+            this->store->set_loudness(this->file_id, data->loudness);
+            this->store->set_flag(this->file_id, COLLECTION_FILE_ANALYZED, data->analyzed);
+        }
+        this->store->set_flag(this->file_id, COLLECTION_FILE_DB_READ, true);
     }
 }
 
+bool Audio_collection_item::is_read_from_db()
+{
+    return this->store->has_flag(this->file_id, COLLECTION_FILE_DB_READ);
+}
+
+bool Audio_collection_item::is_analyzed()
+{
+    return this->store->has_flag(this->file_id, COLLECTION_FILE_ANALYZED);
+}
+
 void Audio_collection_item::compute_and_store_to_db()
 {
     Application_settings *settings = &Singleton<Application_settings>::get_instance();
 
-    // Check in application settings if we should analyze only files with missing data.
+    // Check in application settings if we should analyze only files not analyzed yet (a bpm of 0 can be a valid result).
     if ((settings->get_audio_collection_full_refresh() == true) ||
-        ((settings->get_audio_collection_full_refresh() == false) && (this->get_data(COLUMN_KEY) == "")))
+        ((settings->get_audio_collection_full_refresh() == false) && (this->is_analyzed() == false)))
     {
         // Calculate things (music key, bpm, etc...)
-        this->calculate_audio_data();
+        QByteArray waveform_bands;
+        this->calculate_audio_data(waveform_bands);
 
         // Store audio collection to DB.
-        this->store_to_db();
+        this->store_to_db(waveform_bands);
     }
 }
 
-void Audio_collection_item::calculate_audio_data()
+// Analyzers of the collection, one set by thread of the pool so their buffers are reused from a file to another.
+struct Audio_collection_analyzers
+{
+    Audio_track_key_process      key;
+    Audio_track_bpm_process      bpm;
+    Audio_track_loudness_process loudness;
+    Audio_track_band_process     bands;
+    Audio_file_analysis_process  process;
+
+    Audio_collection_analyzers()
+    {
+        this->process.add_analyzer(&this->key);
+        this->process.add_analyzer(&this->bpm);
+        this->process.add_analyzer(&this->loudness);
+        this->process.add_analyzer(&this->bands);
+    }
+};
+static QThreadStorage<Audio_collection_analyzers*> collection_analyzers;
+
+void Audio_collection_item::calculate_audio_data(QByteArray &out_waveform_bands)
 {
-    // Calculate data and put them back in current audio item.
-    this->set_data(COLUMN_KEY, Utils::get_file_music_key(this->fullPath));
+    if (collection_analyzers.hasLocalData() == false)
+    {
+        collection_analyzers.setLocalData(new Audio_collection_analyzers());
+    }
+    Audio_collection_analyzers *analyzers = collection_analyzers.localData();
+
+    // Calculate data (decoding the file only once, without storing it) and put them back in current audio item.
+    QSharedPointer<Audio_track> at(new Audio_track(ANALYSIS_SAMPLE_RATE));
+    at->set_hash(this->get_file_hash());
+    at->set_fullpath(this->get_full_path());
+    out_waveform_bands.clear();
+    if (analyzers->process.run(this->get_full_path(), at) == true)
+    {
+        at->set_analyzed(true);
+        if (analyzers->bands.get_hash() == at->get_hash())
+        {
+            out_waveform_bands = analyzers->bands.get_bands();
+        }
+    }
+    this->store->set_key(this->file_id, Utils::get_camelot_index(at->get_music_key()));
+    this->store->set_bpm(this->file_id, at->get_bpm());
+    this->store->set_first_beat(this->file_id, at->get_first_beat());
+    this->store->set_loudness(this->file_id, at->get_loudness());
+    this->store->set_flag(this->file_id, COLLECTION_FILE_ANALYZED, at->is_analyzed());
 }
 
-void Audio_collection_item::store_to_db()
+void Audio_collection_item::store_to_db(const QByteArray &waveform_bands)
 {
     // Init.
-    Data_persistence *data_persist = &Singleton<Data_persistence>::get_instance();
-    QSharedPointer<Audio_track> at(new Audio_track(44100));
+    QSharedPointer<Audio_track> at(new Audio_track(ANALYSIS_SAMPLE_RATE));
 
-    // Get a hash, set audio data to an Audio_track and persist it.
+    // Get a hash, set audio data to an Audio_track and persist it (analysis threads do not wait for the DB).
     at->reset();
     at->set_hash(this->get_file_hash());
     at->set_fullpath(this->get_full_path());
-    at->set_music_key(this->get_data(COLUMN_KEY).toString());
-    if (data_persist->store_audio_track(at) == false)
-    {
-        qCWarning(DS_DB) << "can not store" << this->get_full_path() << "to DB";
-    }
+    at->set_music_key(Utils::get_camelot_key(this->store->get_key(this->file_id)));
+    at->set_bpm(this->store->get_bpm(this->file_id));
+    at->set_first_beat(this->store->get_first_beat(this->file_id));
+    at->set_loudness(this->store->get_loudness(this->file_id));
+    at->set_analyzed(this->is_analyzed());
+    // Colored waveform is ready when the track is loaded (if the sound card runs at the analysis sample rate).
+    Singleton<Data_persistence_worker>::get_instance().store_audio_track(at, waveform_bands);
 }
 
-Audio_collection_model::Audio_collection_model(QObject *in_parent) : QAbstractItemModel(in_parent)
+Audio_collection_model::Audio_collection_model(QObject *in_parent) : QAbstractItemModel(in_parent), search_index(&this->store)
 {
     this->rootItem = nullptr;
     this->create_header("", false);
     this->audio_item_list.clear();
-    this->root_path = "";
+    this->root_path   = "";
+    this->is_playlist = false;
+    this->sort_column = -1;
+    this->sort_order  = Qt::AscendingOrder;
 
     // Init thread tools.
     this->concurrent_future = QSharedPointer<QFuture<void>>(new QFuture<void>);
     this->concurrent_watcher_read  = QSharedPointer<QFutureWatcher<void>>(new QFutureWatcher<void>);
     this->concurrent_watcher_store = QSharedPointer<QFutureWatcher<void>>(new QFutureWatcher<void>);
+    this->concurrent_watcher_index = QSharedPointer<QFutureWatcher<Audio_collection_entry>>(new QFutureWatcher<Audio_collection_entry>);
+    this->concurrent_watcher_update = QSharedPointer<QFutureWatcher<void>>(new QFutureWatcher<void>);
+
+    // Files listed in background are added to the flat index by batches.
+    QObject::connect(this->concurrent_watcher_index.data(), &QFutureWatcher<Audio_collection_entry>::resultsReadyAt, this, [this](int begin, int end)
+    {
+        // Skip results of a canceled listing (its events can arrive after the next one started).
+        QFuture<Audio_collection_entry> future = this->concurrent_watcher_index->future();
+        if ((future.isCanceled() == true) || (end > future.resultCount()))
+        {
+            return;
+        }
+        QVector<Audio_collection_entry> entries;
+        for (int i = begin; i < end; i++)
+        {
+            entries << future.resultAt(i);
+        }
+        this->add_to_index(entries);
+    });
+
+    // Files changed during the analysis of previous ones are analyzed next.
+    QObject::connect(this->concurrent_watcher_update.data(), &QFutureWatcher<void>::finished, this, [this]()
+    {
+        this->concurrent_analyse_items(QList<Audio_collection_item*>());
+    });
+
+    // Files indexed before their tags were read are indexed again.
+    this->concurrent_watcher_tags = QSharedPointer<QFutureWatcher<bool>>(new QFutureWatcher<bool>);
+    QObject::connect(this->concurrent_watcher_tags.data(), &QFutureWatcher<bool>::finished, this, [this]()
+    {
+        if (this->loaded_tags.isNull() == true)
+        {
+            return;
+        }
+        this->tags_by_hash = *this->loaded_tags;
+        this->loaded_tags.clear();
+        foreach (Audio_collection_item *item, this->audio_item_list)
+        {
+            QHash<QString, QStringList>::const_iterator tags = this->tags_by_hash.constFind(item->get_file_hash());
+            if (tags != this->tags_by_hash.constEnd())
+            {
+                this->search_index.set_file(item->get_file_id(), *tags);
+            }
+        }
+    });
 }
 
 Audio_collection_model::~Audio_collection_model()
 {
-    if (this->rootItem != nullptr)
-    {
-        delete this->rootItem;
-    }
-
     // Stop running threads.
+    this->stop_fetches();
+    this->stop_concurrent_update();
+    this->stop_concurrent_index_collection();
     if (this->concurrent_watcher_store->isStarted() == true)
     {
         this->concurrent_watcher_store->cancel();
@@ -239,6 +478,14 @@ Audio_collection_model::~Audio_collection_model()
         this->concurrent_watcher_read->cancel();
         this->concurrent_watcher_read->waitForFinished();
     }
+
+    // Delete the tree and the files.
+    if (this->rootItem != nullptr)
+    {
+        delete this->rootItem;
+    }
+    qDeleteAll(this->audio_item_list);
+    qDeleteAll(this->removed_items);
 }
 
 void Audio_collection_model::set_icons(QPixmap in_audio_file_icon,
@@ -252,7 +499,7 @@ void Audio_collection_model::create_header(QString in_path, bool in_show_path)
 {
     // Create root item which is the collection header.
     QList<QVariant> rootData;
-    rootData << tr("Track") << tr("Key");
+    rootData << tr("Track") << tr("Key") << tr("BPM");
     if (in_show_path == true)
     {
         rootData << tr("Path");
@@ -263,26 +510,30 @@ void Audio_collection_model::create_header(QString in_path, bool in_show_path)
         delete this->rootItem;
     }
 
-    this->rootItem = new Audio_collection_item(rootData, "", in_path, false, 0);
+    // The root is the base directory, its entries are enumerated when they are shown.
+    this->rootItem = new Audio_collection_item(rootData, in_path, 0);
 }
 
 QModelIndex Audio_collection_model::set_root_path(QString in_root_path)
 {
     // Clean collection.
-    this->beginResetModel();
-    this->endResetModel();
+    this->clear();
 
     // Create root item which is the collection header.
-    this->create_header(in_root_path, false);
-
-    // Reset internal list of audio files (item pointers).
-    this->audio_item_list.clear();
-
-    // Fill the model.
-    this->setup_model_data(in_root_path, this->rootItem);
+    QString dir_path = QDir(in_root_path).absolutePath();
+    this->beginResetModel();
+    this->create_header(dir_path, false);
+    this->endResetModel();
 
     // Store root path.
-    this->root_path = in_root_path;
+    this->root_path      = in_root_path;
+    this->shown_dir_path = dir_path;
+
+    // Directories are enumerated only when they are shown (see fetchMore()),
+    // all files are listed in background for analysis and search (only new or changed files are hashed).
+    this->load_file_identities(dir_path);
+    this->load_tags();
+    this->start_concurrent_index_collection(QStringList() << dir_path);
 
     return this->get_root_index();
 }
@@ -295,17 +546,21 @@ QString Audio_collection_model::get_root_path()
 QModelIndex Audio_collection_model::set_playlist(const Playlist &playlist)
 {
     // Clean collection.
-    this->beginResetModel();
-    this->endResetModel();
+    this->clear();
 
     // Create root item which is the collection header.
+    this->beginResetModel();
     this->create_header(playlist.get_basepath(), true);
+    this->endResetModel();
+    this->shown_dir_path     = "";
+    this->is_playlist        = true;
+    this->playlist_tracklist = playlist.get_tracklist();
 
-    // Reset internal list of audio files (item pointers).
-    this->audio_item_list.clear();
-
-    // Fill the model.
-    this->setup_model_data_from_tracklist(playlist.get_tracklist(), this->rootItem);
+    // Tracks of the playlist (they can be anywhere) are listed and hashed in background like the entries of a directory,
+    // then files of its directories are indexed (see fetchMore()).
+    this->load_file_identities("");
+    this->load_tags();
+    this->fetchMore(this->get_root_index());
 
     return this->get_root_index();
 }
@@ -324,180 +579,192 @@ QModelIndex Audio_collection_model::get_root_index()
 
 int Audio_collection_model::columnCount(const QModelIndex &in_parent) const
 {
-    if (in_parent.isValid() == true)
+    Q_UNUSED(in_parent);
+
+    // Items always have the path column, it is shown only for playlists (see create_header()).
+    return rootItem->get_column_count();
+}
+
+// Key of an item computed once before sorting (items do not keep sort keys, they are only needed while sorting).
+struct Audio_collection_sort_entry
+{
+    bool                   is_file;   // Directories are first.
+    bool                   is_known;  // Items without key or bpm are last.
+    float                  number;    // Key (1A, 1B, 2A...) or bpm.
+    QCollatorSortKey       path;      // Only items of playlists are sorted by path (empty otherwise).
+    QCollatorSortKey       name;
+    Audio_collection_item *item;
+};
+
+static Audio_collection_sort_entry get_sort_entry(Audio_collection_item *in_item, int in_column)
+{
+    bool  is_known = true;
+    float number   = 0.0;
+    if (in_column == COLUMN_KEY)
     {
-        return static_cast<Audio_collection_item*>(in_parent.internalPointer())->get_column_count();
+        qint8 key = Utils::get_camelot_index(in_item->get_data(COLUMN_KEY).toString());
+        is_known  = key != CAMELOT_UNKNOWN_KEY;
+        number    = (key % 12) * 2 + key / 12;
     }
-    else
+    else if (in_column == COLUMN_BPM)
     {
-        return rootItem->get_column_count();
+        number   = in_item->get_data(COLUMN_BPM).toFloat();
+        is_known = number > 0.0;
     }
+
+    return { in_item->is_directory() == false,
+             is_known,
+             number,
+             get_collator_sort_key((in_column == COLUMN_PATH) ? in_item->get_data(COLUMN_PATH).toString() : QString()),
+             get_collator_sort_key(in_item->get_data(COLUMN_FILE_NAME).toString()),
+             in_item };
 }
 
-struct Audio_collection_item_key_comparer
+static bool is_sorted_before(const Audio_collection_sort_entry &a, const Audio_collection_sort_entry &b, int in_column, Qt::SortOrder in_order)
 {
-    bool operator()(const Audio_collection_item *in_item_a, const Audio_collection_item *in_item_b) const
+    if (a.is_file != b.is_file)
     {
-        QString key       = in_item_a->get_data(COLUMN_KEY).toString();
-        QString other_key = in_item_b->get_data(COLUMN_KEY).toString();
-
-        if ((key.size() >= 2) && (other_key.size() >= 2))
-        {
-            // First compare one or 2 first number digits. If there are same, Compare the last letter.
-            int     key_digits = 0;
-            QString key_letter = "";
-            if (key.size() == 2)
-            {
-                // Like "2B".
-                key_digits = key.left(1).toInt();
-                key_letter = key.right(1);
-            }
-            if (key.size() == 3)
-            {
-                // Like "11A".
-                key_digits = key.left(2).toInt();
-                key_letter = key.right(1);
-            }
+        return a.is_file == false;
+    }
+    if (a.is_known != b.is_known)
+    {
+        return a.is_known == true;
+    }
+    int result = 0;
+    if ((in_column == COLUMN_KEY) || (in_column == COLUMN_BPM))
+    {
+        result = (a.number < b.number) ? -1 : ((a.number > b.number) ? 1 : 0);
+    }
+    else if (in_column == COLUMN_PATH)
+    {
+        result = a.path.compare(b.path);
+    }
+    if (result == 0)
+    {
+        result = a.name.compare(b.name);
+    }
 
-            int     other_key_digits = 0;
-            QString other_key_letter = "";
-            if (other_key.size() == 2)
-            {
-                // Like "2B".
-                other_key_digits = other_key.left(1).toInt();
-                other_key_letter = other_key.right(1);
-            }
-            if (other_key.size() == 3)
-            {
-                // Like "11A".
-                other_key_digits = other_key.left(2).toInt();
-                other_key_letter = other_key.right(1);
-            }
+    return (in_order == Qt::AscendingOrder) ? (result < 0) : (result > 0);
+}
 
-            if (key_digits != other_key_digits)
-            {
-                // Digits are different, compare on it.
-                return key_digits < other_key_digits;
-            }
-            else
-            {
-                // Digits are same, compare letter.
-                return key_letter < other_key_letter;
-            }
+// Row where an item goes in the sorted children of a directory (after equal ones), found by binary search.
+static int get_sorted_row(Audio_collection_item *in_directory, Audio_collection_item *in_item, int in_column, Qt::SortOrder in_order)
+{
+    Audio_collection_sort_entry entry = get_sort_entry(in_item, in_column);
+    int first = 0;
+    int last  = in_directory->childItems.size();
+    while (first < last)
+    {
+        int middle = first + (last - first) / 2;
+        if (is_sorted_before(entry, get_sort_entry(in_directory->childItems[middle], in_column), in_column, in_order) == true)
+        {
+            last = middle;
         }
         else
         {
-            return key < other_key;
+            first = middle + 1;
         }
     }
-};
 
-struct Audio_collection_item_name_comparer
+    return first;
+}
+
+static void sort_children(Audio_collection_item *in_directory, int in_column, Qt::SortOrder in_order)
 {
-    bool operator()(const Audio_collection_item *in_item_a, const Audio_collection_item *in_item_b) const
+    std::vector<Audio_collection_sort_entry> entries;
+    entries.reserve(in_directory->childItems.size());
+    foreach (Audio_collection_item *item, in_directory->childItems)
     {
-        QString name       = in_item_a->get_data(COLUMN_FILE_NAME).toString();
-        QString other_name = in_item_b->get_data(COLUMN_FILE_NAME).toString();
-
-        return name < other_name;
+        entries.push_back(get_sort_entry(item, in_column));
     }
-};
+    std::stable_sort(entries.begin(), entries.end(),
+                     [in_column, in_order](const Audio_collection_sort_entry &a, const Audio_collection_sort_entry &b)
+                     {
+                         return is_sorted_before(a, b, in_column, in_order);
+                     });
+
+    in_directory->childItems.clear();
+    for (const Audio_collection_sort_entry &entry : entries)
+    {
+        in_directory->childItems.append(entry.item);
+    }
+}
 
-struct Audio_collection_item_path_comparer
+void Audio_collection_model::sort(int in_column, Qt::SortOrder in_order)
 {
-    bool operator()(const Audio_collection_item *in_item_a, const Audio_collection_item *in_item_b) const
+    // Keep the order, children of directories listed later are sorted the same way.
+    this->sort_column = in_column;
+    this->sort_order  = in_order;
+
+    // Sort children of each listed directory (directory per directory).
+    QList<Audio_collection_item*> directories;
+    QList<Audio_collection_item*> to_visit;
+    to_visit << this->rootItem;
+    while (to_visit.isEmpty() == false)
     {
-        QString path       = in_item_a->get_data(COLUMN_PATH).toString();
-        QString other_path = in_item_b->get_data(COLUMN_PATH).toString();
-
-        // Extract common part of both paths.
-        QString common_path("");
-        int     i = 1;
-        bool    end_of_common = false;
-        while ((i <= path.length()) && (i <= other_path.length()) && (end_of_common == false))
+        Audio_collection_item *directory = to_visit.takeLast();
+        if (directory->childItems.isEmpty() == false)
         {
-            if (path.left(i) == other_path.left(i))
-            {
-                // Common part of 2 paths.
-                common_path = path.left(i);
-            }
-            else
-            {
-                // End of common part.
-                end_of_common = true;
-            }
-            i++;
+            directories << directory;
         }
-
-        // If common part is the full part for one of the path, then the full path is higher.
-        // It results that file in dir are placed after files in subdirs.
-        if (common_path.length() > 0)
+        foreach (Audio_collection_item *child, directory->childItems)
         {
-            if (common_path == path)
+            if (child->is_directory() == true)
             {
-                return false;
+                to_visit << child;
             }
-            else if (common_path == other_path)
-            {
-                return true;
-            }
-
         }
-
-        // In all other cases we are doing a basic paths compare.
-        return path < other_path;
     }
-};
+    this->sort_directories(directories);
+}
 
-void Audio_collection_model::sort(int in_column, Qt::SortOrder in_order)
+void Audio_collection_model::sort_directories(const QList<Audio_collection_item*> &in_directories)
 {
-    // FIXME sort keys directory per directory (and not for the full list), actually sort childItems recursively
-    // Then rebuild the full structure with parents and childs.
-    // So for the moment, do not sort if there are item with childs.
-    bool do_sort = true;
-    foreach (Audio_collection_item *item, this->rootItem->childItems)
+    if ((this->sort_column < 0) || (in_directories.isEmpty() == true))
     {
-        if (item->get_child_count() > 0)
-        {
-            do_sort = false;
-        }
+        return;
     }
 
-    // Sort audio item list.
-    if (do_sort == true)
+    // Rows move but items stay, so persistent indexes (selection, expanded directories) follow their item.
+    emit this->layoutAboutToBeChanged();
+    QModelIndexList               old_indexes = this->persistentIndexList();
+    QList<Audio_collection_item*> old_items;
+    foreach (const QModelIndex &index, old_indexes)
     {
-        if (in_column == COLUMN_KEY)
-        {
-            qSort(this->audio_item_list.begin(), this->audio_item_list.end(), Audio_collection_item_key_comparer());
-        }
-        else if (in_column == COLUMN_FILE_NAME)
-        {
-            qSort(this->audio_item_list.begin(), this->audio_item_list.end(), Audio_collection_item_name_comparer());
-        }
-        else if (in_column == COLUMN_PATH)
-        {
-            qSort(this->audio_item_list.begin(), this->audio_item_list.end(), Audio_collection_item_path_comparer());
-        }
+        old_items << static_cast<Audio_collection_item*>(index.internalPointer());
+    }
 
-        // Clean and populate rows based on audio item list.
-        this->beginRemoveRows(this->get_root_index(), 1, this->rowCount());
-        this->endRemoveRows();
-        this->rootItem->childItems.clear();
-        if (in_order == Qt::AscendingOrder)
+    // Large directories are sorted in parallel, the other ones here.
+    int                           column = this->sort_column;
+    Qt::SortOrder                 order  = this->sort_order;
+    QList<Audio_collection_item*> large_directories;
+    foreach (Audio_collection_item *directory, in_directories)
+    {
+        if (directory->get_child_count() >= COLLECTION_SORT_PARALLEL_MIN_ITEMS)
         {
-            foreach (Audio_collection_item *item, this->audio_item_list)
-            {
-                this->rootItem->append_child(item);
-            }
+            large_directories << directory;
         }
         else
         {
-            for (int i = (this->audio_item_list.count() - 1); i >= 0; i--)
-            {
-                this->rootItem->append_child(this->audio_item_list.at(i));
-            }
+            sort_children(directory, column, order);
         }
     }
+    if (large_directories.isEmpty() == false)
+    {
+        Singleton<Job_scheduler>::get_instance().map(Job_priority::USER, large_directories,
+                                                     [column, order](Audio_collection_item *directory)
+                                                     {
+                                                         sort_children(directory, column, order);
+                                                     }).waitForFinished();
+    }
+
+    QModelIndexList new_indexes;
+    for (int i = 0; i < old_indexes.size(); i++)
+    {
+        new_indexes << this->createIndex(old_items[i]->get_row(), old_indexes[i].column(), old_items[i]);
+    }
+    this->changePersistentIndexList(old_indexes, new_indexes);
+    emit this->layoutChanged();
 }
 
 QStringList
@@ -662,7 +929,7 @@ QModelIndex Audio_collection_model::parent_from_item(Audio_collection_item &in_i
 {
     Audio_collection_item *parent_item = in_item.get_parent();
 
-    if (parent_item == this->rootItem)
+    if ((parent_item == this->rootItem) || (parent_item == nullptr))
     {
         return QModelIndex();
     }
@@ -690,117 +957,918 @@ int Audio_collection_model::rowCount(const QModelIndex &in_parent) const
     return parentItem->get_child_count();
 }
 
-void Audio_collection_model::setup_model_data(QString in_path, Audio_collection_item *in_item)
+bool Audio_collection_model::hasChildren(const QModelIndex &in_parent) const
 {
-    // Create a Qdir based on input path.
-    QStringList filters;
-    for (int i = 0; i < Utils::audio_file_extensions.size(); i++)
+    Audio_collection_item *item = this->rootItem;
+    if (in_parent.isValid() == true)
     {
-        filters << (QString("*.") + Utils::audio_file_extensions.at(i));
+        item = static_cast<Audio_collection_item*>(in_parent.internalPointer());
     }
-    QDir dir(in_path);
-    dir.setNameFilters(filters);
-    dir.setFilter(QDir::AllDirs | QDir::Files | QDir::NoDotAndDotDot);
-    dir.setSorting(QDir::DirsFirst);
 
-    // Iterate in directory.
-    QFileInfoList file_info_list = dir.entryInfoList();
-    foreach (QFileInfo file_info, file_info_list)
+    // A directory which is not enumerated yet can be expanded.
+    if ((item == nullptr) || (item->is_directory() == false))
     {
-        // Prepare data to show for the item.
-        QString displayed_path(file_info.fileName());
-        QList<QVariant> line;
-        line << displayed_path << "";
-
-        // Add a child item.
-        if (file_info.isDir() == false)
-        {
-            // It is a file, add the item.
-            Audio_collection_item *file_item = new Audio_collection_item(line,
-                                                                         Utils::get_file_hash(file_info.absoluteFilePath()),
-                                                                         file_info.absoluteFilePath(),
-                                                                         false,
-                                                                         in_item);
-            in_item->append_child(file_item);
+        return false;
+    }
 
-            // Add the item's reference to a list (useful for future parsing).
-            this->audio_item_list << file_item;
-        }
-        else
-        {
-            // It is a directory, add the item and analyze file under it.
-            Audio_collection_item *dir_item = new Audio_collection_item(line,
-                                                                        "",
-                                                                        file_info.absoluteFilePath(),
-                                                                        true,
-                                                                        in_item);
-            in_item->append_child(dir_item);
+    return (item->is_fetched() == false) || (item->get_child_count() > 0);
+}
 
-            this->setup_model_data(file_info.absoluteFilePath(), dir_item);
-        }
+bool Audio_collection_model::canFetchMore(const QModelIndex &in_parent) const
+{
+    Audio_collection_item *item = this->rootItem;
+    if (in_parent.isValid() == true)
+    {
+        item = static_cast<Audio_collection_item*>(in_parent.internalPointer());
     }
+
+    return (item != nullptr)                  &&
+           (item->is_directory() == true)     &&
+           (item->is_fetched()   == false)    &&
+           (this->fetches.contains(item) == false);
 }
 
-void Audio_collection_model::setup_model_data_from_tracklist(QStringList in_tracklist, Audio_collection_item *in_item)
+void Audio_collection_model::fetchMore(const QModelIndex &in_parent)
 {
-    // Iterate over tracklist.
-    for (int i = 0; i < in_tracklist.size(); i++)
+    if (this->canFetchMore(in_parent) == false)
     {
-        QFileInfo file_info(in_tracklist.at(i));
-        if (file_info.exists() == true)
+        return;
+    }
+    Audio_collection_item *item = this->rootItem;
+    if (in_parent.isValid() == true)
+    {
+        item = static_cast<Audio_collection_item*>(in_parent.internalPointer());
+    }
+
+    // Entries are inserted by batches while the directory is enumerated in background.
+    QFutureWatcher<Audio_collection_entry> *watcher = new QFutureWatcher<Audio_collection_entry>();
+    this->fetches.insert(item, watcher);
+    QObject::connect(watcher, &QFutureWatcher<Audio_collection_entry>::resultsReadyAt, this, [this, item, watcher](int begin, int end)
+    {
+        QVector<Audio_collection_entry> entries;
+        for (int i = begin; i < end; i++)
         {
-            // Prepare data to show for the item.
-            QString displayed_path(file_info.fileName());
-            QList<QVariant> line;
-            line << displayed_path << "" << file_info.absolutePath();
+            entries << watcher->resultAt(i);
+        }
+        this->insert_children(item, entries);
 
-            // Add a child item.
-            if (file_info.isDir() == false)
+        // Data of shown files are read now (not after the listing of the whole collection).
+        QList<Audio_collection_item*> files;
+        foreach (const Audio_collection_entry &entry, entries)
+        {
+            Audio_collection_item *file = (entry.is_directory == true) ? nullptr : this->items_by_path.value(entry.path, nullptr);
+            if ((file != nullptr) && (file->is_read_from_db() == false))
             {
-                if (Utils::audio_file_extensions.contains(file_info.suffix(), Qt::CaseInsensitive) == true)
-                {
-                    // It is a file (mp3 or flac), add the item.
-                    Audio_collection_item *file_item = new Audio_collection_item(line,
-                                                                                 Utils::get_file_hash(file_info.absoluteFilePath()),
-                                                                                 file_info.absoluteFilePath(),
-                                                                                 false,
-                                                                                 in_item);
-                    in_item->append_child(file_item);
-
-                    // Add the item's reference to a list (useful for future parsing).
-                    this->audio_item_list << file_item;
-                }
+                files << file;
             }
-            else
+        }
+        this->read_items_from_db(files, false);
+    });
+    QObject::connect(watcher, &QFutureWatcher<Audio_collection_entry>::finished, this, [this, item, watcher]()
+    {
+        item->set_fetched(true);
+        this->fetches.remove(item);
+        watcher->deleteLater();
+
+        // Files of directories of a playlist are indexed once the playlist is listed.
+        if ((item == this->rootItem) && (this->is_playlist == true))
+        {
+            QStringList dir_paths;
+            foreach (Audio_collection_item *child, this->rootItem->childItems)
+            {
+                if (child->is_directory() == true)
+                {
+                    dir_paths << child->get_full_path();
+                }
+            }
+            this->start_concurrent_index_collection(dir_paths);
+        }
+
+        // Go on with paths waiting for this directory.
+        this->process_requested_paths();
+    });
+
+    // The user is waiting for it (the root of a playlist lists its tracks).
+    bool        is_playlist = (item == this->rootItem) && (this->is_playlist == true);
+    QString     path        = item->get_full_path();
+    QStringList tracklist   = (is_playlist == true) ? this->playlist_tracklist : QStringList();
+    watcher->setFuture(Singleton<Job_scheduler>::get_instance().run_stream<Audio_collection_entry>(Job_priority::USER,
+                                                                                                   [this, path, tracklist, is_playlist](QFutureInterface<Audio_collection_entry> &interface)
+    {
+        if (is_playlist == true)
+        {
+            this->enumerate_tracklist(tracklist,
+                                      [&interface](const QVector<Audio_collection_entry> &entries){ interface.reportResults(entries); },
+                                      [&interface](){ return interface.isCanceled(); });
+        }
+        else
+        {
+            this->enumerate_directory(path,
+                                      [&interface](const QVector<Audio_collection_entry> &entries){ interface.reportResults(entries); },
+                                      [&interface](){ return interface.isCanceled(); });
+        }
+    }));
+}
+
+void Audio_collection_model::stop_fetches()
+{
+    foreach (QFutureWatcher<Audio_collection_entry> *watcher, this->fetches)
+    {
+        watcher->cancel();
+        watcher->waitForFinished();
+        delete watcher;
+    }
+    this->fetches.clear();
+}
+
+QModelIndex Audio_collection_model::index_from_item(Audio_collection_item *in_item)
+{
+    if (in_item == this->rootItem)
+    {
+        return this->get_root_index();
+    }
+
+    return createIndex(in_item->get_row(), 0, in_item);
+}
+
+void Audio_collection_model::insert_children(Audio_collection_item                 *in_item,
+                                             const QVector<Audio_collection_entry> &in_entries)
+{
+    if (in_entries.isEmpty() == true)
+    {
+        return;
+    }
+
+    QList<Audio_collection_item*> children;
+    foreach (const Audio_collection_entry &entry, in_entries)
+    {
+        Audio_collection_item *child = nullptr;
+        if (entry.is_directory == true)
+        {
+            // It is a directory, its entries are enumerated when it is expanded.
+            QList<QVariant> line;
+            line << entry.name << "" << "" << entry.path.left(entry.path.lastIndexOf('/'));
+            child = new Audio_collection_item(line, entry.path, in_item);
+        }
+        else
+        {
+            // It is a file, use the item of the flat index (data read from DB are already there).
+            child = this->get_indexed_item(entry);
+            child->set_parent(in_item);
+        }
+        children << child;
+    }
+
+    // No order chosen by the user: rows are appended in the order of the listing.
+    QModelIndex parent = this->index_from_item(in_item);
+    if (this->sort_column < 0)
+    {
+        int first = in_item->get_child_count();
+        this->beginInsertRows(parent, first, first + children.size() - 1);
+        in_item->childItems.append(children);
+        this->endInsertRows();
+        return;
+    }
+
+    // Keep the order chosen by the user: each row is inserted at its place in the children inserted before (already sorted),
+    // so other rows do not move.
+    foreach (Audio_collection_item *child, children)
+    {
+        int row = get_sorted_row(in_item, child, this->sort_column, this->sort_order);
+        this->beginInsertRows(parent, row, row);
+        in_item->childItems.insert(row, child);
+        this->endInsertRows();
+    }
+}
+
+void Audio_collection_model::add_to_index(const QVector<Audio_collection_entry> &in_entries)
+{
+    foreach (const Audio_collection_entry &entry, in_entries)
+    {
+        this->get_indexed_item(entry);
+    }
+}
+
+Audio_collection_item *Audio_collection_model::get_indexed_item(const Audio_collection_entry &in_entry)
+{
+    // The same file is shown only once in the tree (but it can be listed twice in a playlist).
+    // A second item of a file shares its data in the store.
+    Audio_collection_item *item = this->items_by_path.value(in_entry.path, nullptr);
+    if ((item == nullptr) || (item->get_parent() != nullptr))
+    {
+        int file_id = -1;
+        if (item == nullptr)
+        {
+            file_id = this->store.add_file(in_entry.path.left(in_entry.path.lastIndexOf('/')), in_entry.name, in_entry.hash);
+            this->search_index.set_file(file_id, this->tags_by_hash.value(in_entry.hash));
+        }
+        else
+        {
+            file_id = item->get_file_id();
+        }
+        item = new Audio_collection_item(&this->store, file_id, nullptr);
+        this->audio_item_list << item;
+        if (this->items_by_path.contains(in_entry.path) == false)
+        {
+            this->items_by_path.insert(in_entry.path, item);
+        }
+    }
+
+    return item;
+}
+
+void Audio_collection_model::enumerate_directory(const QString &in_path,
+                                                 std::function<void(const QVector<Audio_collection_entry>&)> in_report,
+                                                 std::function<bool()> in_is_canceled)
+{
+    // Create a Qdir based on input path.
+    QStringList filters;
+    for (int i = 0; i < Utils::audio_file_extensions.size(); i++)
+    {
+        filters << (QString("*.") + Utils::audio_file_extensions.at(i));
+    }
+    QDir dir(in_path);
+    dir.setNameFilters(filters);
+    dir.setFilter(QDir::AllDirs | QDir::Files | QDir::NoDotAndDotDot);
+    dir.setSorting(QDir::DirsFirst);
+
+    // Iterate in directory, hash files and report entries by batches.
+    QHash<QString, File_identity>   new_identities;
+    QVector<Audio_collection_entry> batch;
+    QFileInfoList file_info_list = dir.entryInfoList();
+    foreach (QFileInfo file_info, file_info_list)
+    {
+        if (in_is_canceled() == true)
+        {
+            break;
+        }
+        Audio_collection_entry entry;
+        entry.name         = file_info.fileName();
+        entry.path         = file_info.absoluteFilePath();
+        entry.is_directory = file_info.isDir();
+        if (entry.is_directory == false)
+        {
+            entry.hash = this->get_file_hash(entry.path, new_identities);
+        }
+        batch << entry;
+        if (batch.size() == COLLECTION_FETCH_BATCH_SIZE)
+        {
+            in_report(batch);
+            batch.clear();
+        }
+    }
+    if (batch.isEmpty() == false)
+    {
+        in_report(batch);
+    }
+    this->store_file_identities(new_identities);
+}
+
+void Audio_collection_model::index_directories(const QStringList &in_dir_paths,
+                                               std::function<void(const QVector<Audio_collection_entry>&)> in_report,
+                                               std::function<bool()> in_is_canceled)
+{
+    // List all audio files under the directories with parallel workers.
+    // Each batch is hashed by the worker which found it, then reported and its new identities stored (a canceled listing is not lost).
+    Directory_scanner scanner(Utils::audio_file_extensions);
+    scanner.scan(in_dir_paths,
+                 [this, &in_report, &in_is_canceled](const QVector<Scanned_file> &in_files)
+    {
+        QHash<QString, File_identity>   new_identities;
+        QVector<Audio_collection_entry> batch;
+        batch.reserve(in_files.size());
+        foreach (const Scanned_file &file, in_files)
+        {
+            if (in_is_canceled() == true)
+            {
+                break;
+            }
+            Audio_collection_entry entry;
+            entry.name         = file.name;
+            entry.path         = file.path;
+            entry.is_directory = false;
+            entry.hash         = this->get_file_hash(entry.path, file.identity, new_identities);
+            batch << entry;
+        }
+        if (batch.isEmpty() == false)
+        {
+            in_report(batch);
+        }
+        this->store_file_identities(new_identities);
+    },
+    in_is_canceled);
+}
+
+void Audio_collection_model::start_concurrent_index_collection(const QStringList &in_dir_paths)
+{
+    // Lowest priority listing, it gives way to the enumeration of directories shown by the user.
+    QFuture<Audio_collection_entry> future = Singleton<Job_scheduler>::get_instance().run_stream<Audio_collection_entry>(Job_priority::PREFETCH,
+                                                                                                                        [this, in_dir_paths](QFutureInterface<Audio_collection_entry> &interface)
+    {
+        this->index_directories(in_dir_paths,
+                                [&interface](const QVector<Audio_collection_entry> &entries){ interface.reportResults(entries); },
+                                [&interface](){ return interface.isCanceled(); });
+    });
+    this->concurrent_watcher_index->setFuture(future);
+}
+
+void Audio_collection_model::stop_concurrent_index_collection()
+{
+    if (this->concurrent_watcher_index->isRunning() == true)
+    {
+        this->concurrent_watcher_index->cancel();
+        this->concurrent_watcher_index->waitForFinished();
+    }
+}
+
+void Audio_collection_model::select_path(const QString &in_path)
+{
+    // Only the last selection is kept.
+    QMutableListIterator<QPair<QString, bool>> i(this->requested_paths);
+    while (i.hasNext() == true)
+    {
+        if (i.next().second == false)
+        {
+            i.remove();
+        }
+    }
+    this->request_path(in_path, false);
+}
+
+void Audio_collection_model::request_path(const QString &in_path,
+                                          const bool    &in_expand)
+{
+    this->requested_paths << qMakePair(in_path, in_expand);
+    this->process_requested_paths();
+}
+
+void Audio_collection_model::process_requested_paths()
+{
+    // Items are emitted after the walk (a receiver can request other paths).
+    QList<QPair<QModelIndex, bool>> found;
+    QMutableListIterator<QPair<QString, bool>> i(this->requested_paths);
+    while (i.hasNext() == true)
+    {
+        QPair<QString, bool> request = i.next();
+        Audio_collection_item *item = this->find_item(request.first, true);
+        if ((item != nullptr) && (item->get_full_path() != request.first))
+        {
+            // A directory on the way is enumerated in background, this request is processed again when it is done.
+            this->fetchMore(this->index_from_item(item));
+            continue;
+        }
+        if ((item != nullptr) && (item != this->rootItem))
+        {
+            found << qMakePair(this->index_from_item(item), request.second);
+        }
+        i.remove();
+    }
+
+    for (int f = 0; f < found.size(); f++)
+    {
+        if (found[f].second == true)
+        {
+            emit this->directory_to_expand(found[f].first);
+        }
+        else
+        {
+            emit this->path_selected(found[f].first);
+        }
+    }
+}
+
+Audio_collection_item *Audio_collection_model::find_item(const QString &in_path,
+                                                         const bool    &in_get_not_fetched)
+{
+    // Walk down from the root.
+    Audio_collection_item *item = this->rootItem;
+    while ((item != nullptr) && (item->get_full_path() != in_path))
+    {
+        if (item->is_fetched() == false)
+        {
+            return (in_get_not_fetched == true) ? item : nullptr;
+        }
+        Audio_collection_item *next = nullptr;
+        foreach (Audio_collection_item *child, item->childItems)
+        {
+            if ((child->get_full_path() == in_path) ||
+                ((child->is_directory() == true) && (in_path.startsWith(child->get_full_path() + "/") == true)))
             {
-                // It is a directory, add the item and analyze file under it.
-                Audio_collection_item *dir_item = new Audio_collection_item(line,
-                                                                            "",
-                                                                            file_info.absoluteFilePath(),
-                                                                            true,
-                                                                            in_item);
-                in_item->append_child(dir_item);
-
-                this->setup_model_data(file_info.absoluteFilePath(), dir_item);
+                next = child;
+                break;
             }
         }
+        item = next;
     }
+
+    return item;
 }
 
-void external_read_from_db(Audio_collection_item *&in_audio_item)
+void Audio_collection_model::apply_file_changes(const QStringList &in_changed_paths,
+                                                const QStringList &in_removed_paths)
 {
-    // Only a wrapper to get data from DB for an audio item object.
-    in_audio_item->read_from_db();
+    // Removed files are forgotten in DB (their data are kept, they are identified by the hash of the file).
+    Singleton<Data_persistence_worker>::get_instance().delete_file_identities(in_removed_paths);
+    this->identities_mutex.lock();
+    foreach (const QString &path, in_removed_paths)
+    {
+        this->file_identities.remove(path);
+    }
+    this->identities_mutex.unlock();
+
+    // Only the shown directory is updated (a playlist is not).
+    if (this->shown_dir_path.isEmpty() == true)
+    {
+        return;
+    }
+    QString shown_prefix = this->shown_dir_path + "/";
+
+    // Remove deleted files and directories from the tree.
+    QStringList removed_paths;
+    foreach (const QString &path, in_removed_paths)
+    {
+        if (path.startsWith(shown_prefix) == true)
+        {
+            removed_paths << path;
+            Audio_collection_item *item = this->find_item(path, false);
+            if ((item != nullptr) && (item != this->rootItem))
+            {
+                this->remove_item(item);
+            }
+        }
+    }
+
+    // Remove them from the index, items are deleted later (they can be used by a running read or analysis).
+    if (removed_paths.isEmpty() == false)
+    {
+        QMutableListIterator<Audio_collection_item*> i(this->audio_item_list);
+        while (i.hasNext() == true)
+        {
+            Audio_collection_item *item = i.next();
+            QString item_path = item->get_full_path();
+            foreach (const QString &path, removed_paths)
+            {
+                if ((item_path == path) || (item_path.startsWith(path + "/") == true))
+                {
+                    if (this->items_by_path.value(item_path) == item)
+                    {
+                        this->items_by_path.remove(item_path);
+                    }
+                    this->pending_analysis.removeAll(item);
+                    this->store.set_flag(item->get_file_id(), COLLECTION_FILE_REMOVED, true);
+                    this->removed_items << item;
+                    i.remove();
+                    break;
+                }
+            }
+        }
+    }
+
+    // Hash changed files in background, then insert or update them.
+    QStringList changed_paths;
+    foreach (const QString &path, in_changed_paths)
+    {
+        if (path.startsWith(shown_prefix) == true)
+        {
+            changed_paths << path;
+        }
+    }
+    if (changed_paths.isEmpty() == true)
+    {
+        return;
+    }
+    QFutureWatcher<Audio_collection_entry> *watcher = new QFutureWatcher<Audio_collection_entry>();
+    this->updates << watcher;
+    QObject::connect(watcher, &QFutureWatcher<Audio_collection_entry>::finished, this, [this, watcher]()
+    {
+        if (watcher->isCanceled() == false)
+        {
+            this->update_files(watcher->future().results().toVector());
+        }
+        this->updates.removeAll(watcher);
+        watcher->deleteLater();
+    });
+    watcher->setFuture(Singleton<Job_scheduler>::get_instance().run_stream<Audio_collection_entry>(Job_priority::PREFETCH,
+                                                                                                   [this, changed_paths](QFutureInterface<Audio_collection_entry> &interface)
+    {
+        QHash<QString, File_identity>   new_identities;
+        QVector<Audio_collection_entry> entries;
+        foreach (const QString &path, changed_paths)
+        {
+            QFileInfo file_info(path);
+            if ((interface.isCanceled() == true) || (file_info.exists() == false))
+            {
+                continue;
+            }
+            Audio_collection_entry entry;
+            entry.name         = file_info.fileName();
+            entry.path         = path;
+            entry.is_directory = file_info.isDir();
+            if (entry.is_directory == false)
+            {
+                entry.hash = this->get_file_hash(entry.path, new_identities);
+            }
+            entries << entry;
+        }
+        interface.reportResults(entries);
+        this->store_file_identities(new_identities);
+    }));
 }
 
+void Audio_collection_model::rescan_directory(const QString &in_dir_path)
+{
+    // Only the shown directory is updated (a playlist is not).
+    if ((this->shown_dir_path.isEmpty() == true) ||
+        ((in_dir_path != this->shown_dir_path) && (in_dir_path.startsWith(this->shown_dir_path + "/") == false)))
+    {
+        return;
+    }
+
+    // List files again in background (only changed ones are hashed), then files of the index which are not there anymore are removed.
+    QFutureWatcher<Audio_collection_entry> *watcher = new QFutureWatcher<Audio_collection_entry>();
+    this->updates << watcher;
+    QObject::connect(watcher, &QFutureWatcher<Audio_collection_entry>::finished, this, [this, watcher, in_dir_path]()
+    {
+        if (watcher->isCanceled() == false)
+        {
+            QVector<Audio_collection_entry> entries = watcher->future().results().toVector();
+            QSet<QString> listed_paths;
+            foreach (const Audio_collection_entry &entry, entries)
+            {
+                listed_paths.insert(entry.path);
+            }
+            QString     prefix = in_dir_path + "/";
+            QStringList removed_paths;
+            foreach (Audio_collection_item *item, this->audio_item_list)
+            {
+                QString path = item->get_full_path();
+                if ((path.startsWith(prefix) == true) && (listed_paths.contains(path) == false))
+                {
+                    removed_paths << path;
+                }
+            }
+            if (removed_paths.isEmpty() == false)
+            {
+                this->apply_file_changes(QStringList(), removed_paths);
+            }
+            this->update_files(entries);
+        }
+        this->updates.removeAll(watcher);
+        watcher->deleteLater();
+    });
+    watcher->setFuture(Singleton<Job_scheduler>::get_instance().run_stream<Audio_collection_entry>(Job_priority::PREFETCH,
+                                                                                                   [this, in_dir_path](QFutureInterface<Audio_collection_entry> &interface)
+    {
+        this->index_directories(QStringList() << in_dir_path,
+                                [&interface](const QVector<Audio_collection_entry> &entries){ interface.reportResults(entries); },
+                                [&interface](){ return interface.isCanceled(); });
+    }));
+}
+
+void Audio_collection_model::remove_item(Audio_collection_item *in_item)
+{
+    // Stop enumerations of removed directories (they reference their items).
+    QString prefix = in_item->get_full_path() + "/";
+    QMutableHashIterator<Audio_collection_item*, QFutureWatcher<Audio_collection_entry>*> i(this->fetches);
+    while (i.hasNext() == true)
+    {
+        i.next();
+        if ((i.key() == in_item) || (i.key()->get_full_path().startsWith(prefix) == true))
+        {
+            i.value()->cancel();
+            i.value()->waitForFinished();
+            delete i.value();
+            i.remove();
+        }
+    }
+
+    // Remove the row, a directory is deleted with its sub-directories (files are owned by the index).
+    Audio_collection_item *parent = in_item->get_parent();
+    int row = in_item->get_row();
+    this->beginRemoveRows(this->index_from_item(parent), row, row);
+    parent->childItems.removeAt(row);
+    this->endRemoveRows();
+    if (in_item->is_directory() == true)
+    {
+        delete in_item;
+    }
+    else
+    {
+        in_item->set_parent(nullptr);
+    }
+}
+
+void Audio_collection_model::update_files(const QVector<Audio_collection_entry> &in_entries)
+{
+    QList<Audio_collection_item*> items;
+    foreach (const Audio_collection_entry &entry, in_entries)
+    {
+        // Insert it in the tree only if its directory is shown (otherwise it is enumerated later).
+        Audio_collection_item *parent = this->find_item(entry.path.left(entry.path.lastIndexOf('/')), false);
+        bool is_shown = (parent != nullptr) && (parent->is_fetched() == true);
+        if (entry.is_directory == true)
+        {
+            if ((is_shown == true) && (this->find_item(entry.path, false) == nullptr))
+            {
+                this->insert_children(parent, QVector<Audio_collection_entry>() << entry);
+            }
+            continue;
+        }
+
+        Audio_collection_item *item = this->items_by_path.value(entry.path, nullptr);
+        if (item == nullptr)
+        {
+            // New file (or moved), data are already in DB if it was only moved.
+            if (is_shown == true)
+            {
+                this->insert_children(parent, QVector<Audio_collection_entry>() << entry);
+            }
+            else
+            {
+                this->add_to_index(QVector<Audio_collection_entry>() << entry);
+            }
+            item = this->items_by_path.value(entry.path, nullptr);
+        }
+        else if (item->get_file_hash() != entry.hash)
+        {
+            // Modified file, forget its previous data.
+            item->set_file_hash(entry.hash);
+            this->search_index.set_file(item->get_file_id(), this->tags_by_hash.value(entry.hash));
+            item->set_data(COLUMN_KEY, "");
+            item->set_data(COLUMN_BPM, "");
+        }
+        else
+        {
+            continue;
+        }
+
+        // Data of a new or modified file are read from DB.
+        items << item;
+    }
+    this->read_items_from_db(items, true);
+}
+
+void Audio_collection_model::read_items_from_db(const QList<Audio_collection_item*> &in_items,
+                                                const bool                          &in_analyze_missing)
+{
+    if (in_items.isEmpty() == true)
+    {
+        return;
+    }
+    QList<QSharedPointer<Audio_track>> tracks;
+    foreach (Audio_collection_item *item, in_items)
+    {
+        QSharedPointer<Audio_track> at(new Audio_track(44100));
+        at->set_hash(item->get_file_hash());
+        tracks << at;
+    }
+
+    // Read by the DB thread, then shown, files which are not in DB are analyzed (if asked).
+    QList<Audio_collection_item*> items           = in_items;
+    bool                          analyze_missing = in_analyze_missing;
+    QFutureWatcher<bool> *watcher = new QFutureWatcher<bool>();
+    this->db_reads << watcher;
+    QObject::connect(watcher, &QFutureWatcher<bool>::finished, this, [this, watcher, items, tracks, analyze_missing]()
+    {
+        QList<Audio_collection_item*> to_analyze;
+        for (int i = 0; i < items.size(); i++)
+        {
+            Audio_collection_item *item = items[i];
+            if (this->removed_items.contains(item) == true)
+            {
+                continue;
+            }
+            item->read_from_track(tracks[i]);
+            if (item->get_parent() != nullptr)
+            {
+                QModelIndex index = this->index_from_item(item);
+                emit this->dataChanged(index, index.sibling(index.row(), COLUMN_BPM));
+            }
+            if ((analyze_missing == true) && (item->is_analyzed() == false))
+            {
+                to_analyze << item;
+            }
+        }
+        this->db_reads.removeAll(watcher);
+        watcher->deleteLater();
+        this->concurrent_analyse_items(to_analyze);
+    });
+    watcher->setFuture(Singleton<Data_persistence_worker>::get_instance().load_audio_tracks(tracks));
+}
+
+void Audio_collection_model::enumerate_tracklist(const QStringList &in_tracklist,
+                                                 std::function<void(const QVector<Audio_collection_entry>&)> in_report,
+                                                 std::function<bool()> in_is_canceled)
+{
+    // Iterate over tracklist, hash files and report entries by batches.
+    QHash<QString, File_identity>   new_identities;
+    QVector<Audio_collection_entry> batch;
+    for (int i = 0; i < in_tracklist.size(); i++)
+    {
+        if (in_is_canceled() == true)
+        {
+            break;
+        }
+        QFileInfo file_info(in_tracklist.at(i));
+        if (file_info.exists() == true)
+        {
+            Audio_collection_entry entry;
+            entry.name         = file_info.fileName();
+            entry.path         = file_info.absoluteFilePath();
+            entry.is_directory = file_info.isDir();
+
+            if (entry.is_directory == false)
+            {
+                if (Utils::audio_file_extensions.contains(file_info.suffix(), Qt::CaseInsensitive) == true)
+                {
+                    // It is an audio file, add the item.
+                    entry.hash = this->get_file_hash(entry.path, new_identities);
+                    batch << entry;
+                }
+            }
+            else
+            {
+                // It is a directory, files under it are shown when it is expanded.
+                batch << entry;
+            }
+        }
+        if (batch.size() == COLLECTION_FETCH_BATCH_SIZE)
+        {
+            in_report(batch);
+            batch.clear();
+        }
+    }
+    if (batch.isEmpty() == false)
+    {
+        in_report(batch);
+    }
+    this->store_file_identities(new_identities);
+}
+
+void Audio_collection_model::load_file_identities(const QString &in_root_path)
+{
+    this->identities_mutex.lock();
+    this->file_identities.clear();
+    this->loaded_identities  = QSharedPointer<QHash<QString, File_identity>>(new QHash<QString, File_identity>());
+    this->identities_loading = Singleton<Data_persistence_worker>::get_instance().load_file_identities(in_root_path, this->loaded_identities);
+    this->identities_mutex.unlock();
+}
+
+void Audio_collection_model::wait_file_identities()
+{
+    // Only called by background jobs (listings and hashing), never by the GUI thread.
+    QSharedPointer<QHash<QString, File_identity>> loaded;
+    QFuture<bool>                                 loading;
+    {
+        QMutexLocker locker(&this->identities_mutex);
+        loaded  = this->loaded_identities;
+        loading = this->identities_loading;
+    }
+    if (loaded.isNull() == true)
+    {
+        return;
+    }
+
+    // Identities stored since they were asked are newer than the loaded ones (the mutex is released when returning).
+    loading.waitForFinished();
+    QMutexLocker locker(&this->identities_mutex);
+    if (this->loaded_identities == loaded)
+    {
+        QHashIterator<QString, File_identity> i(*loaded);
+        while (i.hasNext() == true)
+        {
+            i.next();
+            if (this->file_identities.contains(i.key()) == false)
+            {
+                this->file_identities.insert(i.key(), i.value());
+            }
+        }
+        this->loaded_identities.clear();
+    }
+}
+
+void Audio_collection_model::load_tags()
+{
+    // Tags of all tracks in one query, files are searchable by their tags when they are indexed.
+    this->tags_by_hash.clear();
+    this->loaded_tags = QSharedPointer<QHash<QString, QStringList>>(new QHash<QString, QStringList>());
+    this->concurrent_watcher_tags->setFuture(Singleton<Data_persistence_worker>::get_instance().load_tags(this->loaded_tags));
+}
+
+void Audio_collection_model::store_file_identities(const QHash<QString, File_identity> &in_new_identities)
+{
+    if (in_new_identities.isEmpty() == true)
+    {
+        return;
+    }
+
+    // Store them (by the DB thread) and keep them in the cache (a directory can be listed by the tree and by the index).
+    Singleton<Data_persistence_worker>::get_instance().store_file_identities(in_new_identities);
+    this->identities_mutex.lock();
+    QHashIterator<QString, File_identity> i(in_new_identities);
+    while (i.hasNext() == true)
+    {
+        i.next();
+        this->file_identities.insert(i.key(), i.value());
+    }
+    this->identities_mutex.unlock();
+}
+
+QString Audio_collection_model::get_file_hash(const QString                 &in_path,
+                                              QHash<QString, File_identity> &io_new_identities)
+{
+    // Get size, modification time and inode of the file (the file itself is not read).
+    File_identity identity;
+    if (Utils::get_file_identity(in_path, identity) == false)
+    {
+        return Utils::get_file_hash(in_path);
+    }
+
+    return this->get_file_hash(in_path, identity, io_new_identities);
+}
+
+QString Audio_collection_model::get_file_hash(const QString                 &in_path,
+                                              File_identity                  in_identity,
+                                              QHash<QString, File_identity> &io_new_identities)
+{
+    // The cached hash is still valid if the file did not change.
+    this->wait_file_identities();
+    bool is_known = false;
+    this->identities_mutex.lock();
+    QHash<QString, File_identity>::const_iterator cached = this->file_identities.constFind(in_path);
+    if (cached != this->file_identities.constEnd())
+    {
+        is_known = true;
+        if ((cached->size  == in_identity.size)  &&
+            (cached->mtime == in_identity.mtime) &&
+            (cached->inode == in_identity.inode))
+        {
+            QString hash = cached->hash;
+            this->identities_mutex.unlock();
+            return hash;
+        }
+    }
+    this->identities_mutex.unlock();
+
+    // New or changed file, hash it.
+    in_identity.hash = Utils::get_file_hash(in_path);
+    if (in_identity.hash.isEmpty() == false)
+    {
+        // First time this file is seen, data stored by a previous version are identified by the legacy hash
+        // (migrated with the identities, only read while such tracks remain).
+        if ((is_known == false) &&
+            (Singleton<Data_persistence>::get_instance().has_legacy_tracks() == true))
+        {
+            in_identity.legacy_hash = Utils::get_file_legacy_hash(in_path);
+        }
+        io_new_identities.insert(in_path, in_identity);
+    }
+
+    return in_identity.hash;
+}
+
+// Data of all tracks in DB, loaded by the first job reading the collection.
+struct Audio_collection_db_data
+{
+    QMutex                            mutex;
+    QAtomicInt                        is_loaded;
+    QHash<Hash_128, Audio_track_data> tracks;    // Read-only once loaded.
+};
+
 void Audio_collection_model::concurrent_read_collection_from_db()
 {
     // Just be sure DB was init.
     Data_persistence *data_persist = &Singleton<Data_persistence>::get_instance();
     if (data_persist->is_initialized == true)
     {
-        // Read audio item from database for the whole collection.
-        QFuture<void> future = QtConcurrent::map(this->audio_item_list, &external_read_from_db);
+        // Read data of all tracks with one query instead of one query by file,
+        // then join them with files of the collection by chunks.
+        QList<QList<Audio_collection_item*>> chunks;
+        for (int i = 0; i < this->audio_item_list.size(); i += COLLECTION_READ_CHUNK_SIZE)
+        {
+            chunks << this->audio_item_list.mid(i, COLLECTION_READ_CHUNK_SIZE);
+        }
+        QSharedPointer<Audio_collection_db_data> db_data(new Audio_collection_db_data());
+        QFuture<void> future = Singleton<Job_scheduler>::get_instance().map(Job_priority::PREFETCH, chunks,
+                                                                            [db_data](QList<Audio_collection_item*> &in_items)
+        {
+            if (db_data->is_loaded.loadAcquire() == 0)
+            {
+                db_data->mutex.lock();
+                if (db_data->is_loaded.loadAcquire() == 0)
+                {
+                    // Get analysis results still waiting to be written.
+                    Singleton<Data_persistence_worker>::get_instance().flush();
+                    Singleton<Data_persistence>::get_instance().get_audio_tracks_data(db_data->tracks);
+                    db_data->is_loaded.storeRelease(1);
+                }
+                db_data->mutex.unlock();
+            }
+            foreach (Audio_collection_item *item, in_items)
+            {
+                item->read_from_data(db_data->tracks);
+            }
+        });
         this->concurrent_watcher_read->setFuture(future);
     }
 }
@@ -830,8 +1898,8 @@ void Audio_collection_model::concurrent_analyse_audio_collection()
         if ((this->concurrent_watcher_read->isRunning()  == false) &&
             (this->concurrent_watcher_store->isRunning() == false))
         {
-            // Analyze item and store to DB (for the whole collection).
-            QFuture<void> future = QtConcurrent::map(this->audio_item_list, &external_analyze_audio_collection);
+            // Analyze item and store to DB (for the whole collection), this is the lowest priority background work.
+            QFuture<void> future = Singleton<Job_scheduler>::get_instance().map(Job_priority::ANALYSIS, this->audio_item_list, &external_analyze_audio_collection);
             this->concurrent_watcher_store->setFuture(future);
         }
     }
@@ -846,86 +1914,153 @@ void Audio_collection_model::stop_concurrent_analyse_audio_collection()
     }
 }
 
-int Audio_collection_model::get_nb_items()
+void Audio_collection_model::concurrent_analyse_items(const QList<Audio_collection_item*> &in_items)
 {
-    return this->audio_item_list.length();
+    // Queue them, only one analysis of changed files at a time.
+    foreach (Audio_collection_item *item, in_items)
+    {
+        if (this->pending_analysis.contains(item) == false)
+        {
+            this->pending_analysis << item;
+        }
+    }
+    Data_persistence *data_persist = &Singleton<Data_persistence>::get_instance();
+    if ((this->pending_analysis.isEmpty()                 == true)  ||
+        (this->concurrent_watcher_update->isRunning()     == true)  ||
+        (data_persist->is_initialized                     == false))
+    {
+        return;
+    }
+
+    // Analyze and store them in background (lowest priority, paused while playing if configured).
+    QList<Audio_collection_item*> items = this->pending_analysis;
+    this->pending_analysis.clear();
+    QFuture<void> future = Singleton<Job_scheduler>::get_instance().map(Job_priority::ANALYSIS, items, &external_analyze_audio_collection);
+    this->concurrent_watcher_update->setFuture(future);
 }
 
-int Audio_collection_model::get_nb_new_items()
+void Audio_collection_model::stop_concurrent_update()
 {
-    int nb_items = 0;
-    foreach (Audio_collection_item *item, this->audio_item_list)
+    foreach (QFutureWatcher<Audio_collection_entry> *watcher, this->updates)
     {
-        if (item->get_data(COLUMN_KEY) == "")
-        {
-            // This file does not have been analyzed, let's consider it as a new one.
-            nb_items++;
-        }
+        watcher->cancel();
+        watcher->waitForFinished();
+        delete watcher;
+    }
+    this->updates.clear();
+    qDeleteAll(this->db_reads); // Results of reads still running are dropped.
+    this->db_reads.clear();
+    this->pending_analysis.clear();
+    if (this->concurrent_watcher_update->isRunning() == true)
+    {
+        this->concurrent_watcher_update->cancel();
+        this->concurrent_watcher_update->waitForFinished();
     }
+}
+
+int Audio_collection_model::get_nb_items()
+{
+    return this->audio_item_list.length();
+}
 
-    return nb_items;
+int Audio_collection_model::get_nb_new_items()
+{
+    // Files which have not been analyzed are considered as new ones.
+    return this->store.get_nb_missing_data();
 }
 
-QList<QModelIndex>
+void
 Audio_collection_model::set_next_keys(QString in_next_key,
                                       QString in_previous_key,
                                       QString in_next_major_key)
 {
-    // Init list of QModelIndex which contains next/previous/opposite key.
-    QList<QModelIndex> dir_list;
+    QVector<int> dir_ids;
 
-    // Iterate over all items and set flags to true if they are of next/previous/major keys.
-    foreach (Audio_collection_item *item, this->audio_item_list)
-    {
-        // Reset.
-        item->set_next_key(false);
-        item->set_next_major_key(false);
+    // Select next/previous/major keys, directories come from the index of keys of the store.
+    this->store.set_next_keys(Utils::get_camelot_index(in_next_key),
+                              Utils::get_camelot_index(in_previous_key),
+                              Utils::get_camelot_index(in_next_major_key),
+                              dir_ids);
 
-        if ((item->get_data(COLUMN_KEY) == in_next_key) ||
-            (item->get_data(COLUMN_KEY) == in_previous_key))
+    // Directories to expand replace the previous ones, they are enumerated in background if they are not shown yet.
+    QMutableListIterator<QPair<QString, bool>> i(this->requested_paths);
+    while (i.hasNext() == true)
+    {
+        if (i.next().second == true)
         {
-            // The item is a next or previous key.
-            item->set_next_key(true);
-
-            // Add parent QModelIndex (the dir) to the result list.
-            dir_list.append(this->parent_from_item(*item));
-
+            i.remove();
         }
-        else if (item->get_data(COLUMN_KEY) == in_next_major_key)
-        {
-            // The item is a next major or minor key.
-            item->set_next_major_key(true);
+    }
+    foreach (int dir_id, dir_ids)
+    {
+        this->request_path(this->store.get_dir(dir_id), true);
+    }
+}
 
-            // Add parent QModelIndex (the dir) to the result list.
-            dir_list.append(this->parent_from_item(*item));
-        }
+QStringList
+Audio_collection_model::get_next_keys_paths(const int &max_nb_items)
+{
+    QStringList paths;
+
+    // First next and previous keys, then next major/minor keys.
+    foreach (int id, this->store.get_next_key_files(false, max_nb_items))
+    {
+        paths << this->store.get_full_path(id);
+    }
+    foreach (int id, this->store.get_next_key_files(true, max_nb_items - paths.size()))
+    {
+        paths << this->store.get_full_path(id);
     }
 
-    return dir_list;
+    return paths;
 }
 
-QModelIndexList
+QStringList
 Audio_collection_model::search(QString in_text)
 {
-    // Get elements that matches with in_text.
-    QModelIndexList items = this->match(this->index(0, 0),
-                                        Qt::DisplayRole,
-                                        QVariant::fromValue(in_text),
-                                        -1,
-                                        Qt::MatchFlags(Qt::MatchStartsWith | Qt::MatchWrap));
+    QStringList paths;
+
+    // Top directories which name starts with in_text.
+    foreach (Audio_collection_item *item, this->rootItem->childItems)
+    {
+        if ((item->is_directory() == true) &&
+            (item->get_data(COLUMN_FILE_NAME).toString().startsWith(in_text, Qt::CaseInsensitive) == true))
+        {
+            paths << item->get_full_path();
+        }
+    }
+
+    // Files of the whole collection (even if their directory is not shown yet).
+    foreach (int id, this->search_index.search(in_text))
+    {
+        paths << this->store.get_full_path(id);
+    }
 
-    return items;
+    return paths;
 }
 
 void
 Audio_collection_model::clear()
 {
+    // Stop background listings and updates (they reference items).
+    this->requested_paths.clear();
+    this->is_playlist = false;
+    this->playlist_tracklist.clear();
+    this->stop_fetches();
+    this->stop_concurrent_update();
+    this->stop_concurrent_index_collection();
+
     if (this->rootItem != nullptr)
     {
-        this->beginRemoveRows(this->get_root_index(), 0, this->rowCount());
-        this->endRemoveRows();
-        this->rootItem->childItems.clear();
+        this->beginResetModel();
+        this->rootItem->clear_children();
         qDeleteAll(this->audio_item_list);
         this->audio_item_list.clear();
+        this->items_by_path.clear();
+        qDeleteAll(this->removed_items);
+        this->removed_items.clear();
+        this->search_index.clear();
+        this->store.clear();
+        this->endResetModel();
     }
 }
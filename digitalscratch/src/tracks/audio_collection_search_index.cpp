@@ -0,0 +1,491 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*--------------------------------------( audio_collection_search_index.cpp )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: search index of the audio collection (trigrams of names,  */
+/*                  paths and tags, key and bpm, typo tolerant).              */
+/*                                                                            */
+/*============================================================================*/
+
+#include <QElapsedTimer>
+#include <QPair>
+#include <algorithm>
+
+#include "tracks/audio_collection_search_index.h"
+#include "utils.h"
+
+Audio_collection_search_index::Audio_collection_search_index(const Audio_collection_store *store)
+{
+    this->store           = store;
+    this->last_nb_changes = 0;
+
+    return;
+}
+
+Audio_collection_search_index::~Audio_collection_search_index()
+{
+    return;
+}
+
+void
+Audio_collection_search_index::clear()
+{
+    this->file_texts.clear();
+    this->name_lengths.clear();
+    this->dir_texts.clear();
+    this->files_by_dir.clear();
+    this->files_by_trigram.clear();
+    this->dirs_by_trigram.clear();
+    this->counts.clear();
+    this->last_text.clear();
+    this->last_file_ids.clear();
+
+    return;
+}
+
+QString
+Audio_collection_search_index::normalize(const QString &text)
+{
+    // Decompose accented letters to drop their marks, keep letters and digits (lower case) separated by one space.
+    QString decomposed = text.normalized(QString::NormalizationForm_KD);
+    QString result;
+    result.reserve(decomposed.length());
+    bool is_space = true;
+    foreach (const QChar &c, decomposed)
+    {
+        if (c.isLetterOrNumber() == true)
+        {
+            result += c.toLower();
+            is_space = false;
+        }
+        else if ((c.isMark() == false) && (is_space == false))
+        {
+            result += ' ';
+            is_space = true;
+        }
+    }
+    if (result.endsWith(' ') == true)
+    {
+        result.chop(1);
+    }
+
+    return result;
+}
+
+void
+Audio_collection_search_index::get_trigrams(const QString &text, QVector<quint64> &out_trigrams)
+{
+    out_trigrams.clear();
+    for (int i = 0; i + 3 <= text.length(); i++)
+    {
+        quint64 trigram = ((quint64)text.at(i).unicode()     << 32) |
+                          ((quint64)text.at(i + 1).unicode() << 16) |
+                           (quint64)text.at(i + 2).unicode();
+        if (out_trigrams.contains(trigram) == false)
+        {
+            out_trigrams << trigram;
+        }
+    }
+
+    return;
+}
+
+void
+Audio_collection_search_index::set_file(const int         &id,
+                                        const QStringList &tags)
+{
+    // Grow tables.
+    if (id >= this->file_texts.size())
+    {
+        this->file_texts.resize(id + 1);
+        this->name_lengths.resize(id + 1);
+        this->counts.resize(id + 1);
+    }
+    bool is_new = this->file_texts[id].isEmpty();
+
+    // Text of the file, only its new trigrams are added (the other ones are filtered when the text is checked).
+    QString name = normalize(this->store->get_name(id));
+    QString text = name;
+    if (tags.isEmpty() == false)
+    {
+        text += ' ' + normalize(tags.join(' '));
+    }
+    QVector<quint64> old_trigrams;
+    QVector<quint64> new_trigrams;
+    get_trigrams(this->file_texts[id], old_trigrams);
+    get_trigrams(text, new_trigrams);
+    foreach (quint64 trigram, new_trigrams)
+    {
+        if (old_trigrams.contains(trigram) == false)
+        {
+            this->files_by_trigram[trigram] << id;
+        }
+    }
+    this->file_texts[id]   = text;
+    this->name_lengths[id] = name.length();
+
+    // Text of its directory (indexed once for all its files).
+    int dir_id = this->store->get_dir_id(id);
+    if (dir_id >= this->dir_texts.size())
+    {
+        this->dir_texts.resize(dir_id + 1);
+        this->files_by_dir.resize(dir_id + 1);
+    }
+    if (this->dir_texts[dir_id].isEmpty() == true)
+    {
+        this->dir_texts[dir_id] = normalize(this->store->get_dir(dir_id));
+        QVector<quint64> dir_trigrams;
+        get_trigrams(this->dir_texts[dir_id], dir_trigrams);
+        foreach (quint64 trigram, dir_trigrams)
+        {
+            this->dirs_by_trigram[trigram] << dir_id;
+        }
+    }
+    if (is_new == true)
+    {
+        this->files_by_dir[dir_id] << id;
+    }
+
+    // Results of the last search are not valid anymore.
+    this->last_text.clear();
+
+    return;
+}
+
+int
+Audio_collection_search_index::get_distance(const QString &word,
+                                            const QString &text,
+                                            const int     &max_errors)
+{
+    // Edit distance where the match can start and end anywhere in text (one column of the matrix is kept).
+    int          length = word.length();
+    QVector<int> column(length + 1);
+    for (int i = 0; i <= length; i++)
+    {
+        column[i] = i;
+    }
+    int best = length;
+    foreach (const QChar &c, text)
+    {
+        int diagonal = column[0];
+        for (int i = 1; i <= length; i++)
+        {
+            int up    = column[i];
+            column[i] = qMin(diagonal + ((word.at(i - 1) == c) ? 0 : 1), qMin(up, column[i - 1]) + 1);
+            diagonal  = up;
+        }
+        best = qMin(best, column[length]);
+        if (best == 0)
+        {
+            break;
+        }
+    }
+
+    return qMin(best, max_errors + 1);
+}
+
+void
+Audio_collection_search_index::get_candidates(const Search_word &word,
+                                              const int         &min_nb_trigrams,
+                                              QVector<int>      &out_ids)
+{
+    out_ids.clear();
+
+    // Count trigrams of the word found in each file.
+    QVector<int> found_ids;
+    foreach (quint64 trigram, word.trigrams)
+    {
+        QHash<quint64, QVector<int>>::const_iterator files = this->files_by_trigram.constFind(trigram);
+        if (files != this->files_by_trigram.constEnd())
+        {
+            foreach (int id, files.value())
+            {
+                if (this->counts[id]++ == 0)
+                {
+                    found_ids << id;
+                }
+            }
+        }
+    }
+    foreach (int id, found_ids)
+    {
+        if (this->counts[id] >= min_nb_trigrams)
+        {
+            out_ids << id;
+        }
+        this->counts[id] = 0;
+    }
+
+    // Same for directories, all their files are candidates.
+    QHash<int, int> dir_counts;
+    foreach (quint64 trigram, word.trigrams)
+    {
+        foreach (int dir_id, this->dirs_by_trigram.value(trigram))
+        {
+            dir_counts[dir_id]++;
+        }
+    }
+    for (QHash<int, int>::const_iterator dir = dir_counts.constBegin(); dir != dir_counts.constEnd(); ++dir)
+    {
+        if (dir.value() >= min_nb_trigrams)
+        {
+            out_ids << this->files_by_dir[dir.key()];
+        }
+    }
+
+    // In order of id, once.
+    std::sort(out_ids.begin(), out_ids.end());
+    out_ids.erase(std::unique(out_ids.begin(), out_ids.end()), out_ids.end());
+
+    return;
+}
+
+int
+Audio_collection_search_index::match(const int         &id,
+                                     const Search_word &word,
+                                     const bool        &is_typo_allowed,
+                                     bool              &out_is_in_name)
+{
+    out_is_in_name = false;
+    if (this->store->has_flag(id, COLLECTION_FILE_REMOVED) == true)
+    {
+        return -1;
+    }
+
+    // Substring of the name, of tags or of the path.
+    int position = this->file_texts[id].indexOf(word.text);
+    if (position >= 0)
+    {
+        out_is_in_name = position < this->name_lengths[id];
+        return 0;
+    }
+    const QString &dir_text = this->dir_texts[this->store->get_dir_id(id)];
+    if (dir_text.contains(word.text) == true)
+    {
+        return 0;
+    }
+
+    // Key or bpm.
+    if ((word.key != CAMELOT_UNKNOWN_KEY) && (this->store->get_key(id) == word.key))
+    {
+        return 0;
+    }
+    if ((word.bpm > 0) && (qRound(this->store->get_bpm(id)) == word.bpm))
+    {
+        return 0;
+    }
+
+    // Typos.
+    if ((is_typo_allowed == true) && (word.max_errors > 0))
+    {
+        int nb_errors = qMin(get_distance(word.text, this->file_texts[id], word.max_errors),
+                             get_distance(word.text, dir_text,             word.max_errors));
+        if (nb_errors <= word.max_errors)
+        {
+            return nb_errors;
+        }
+    }
+
+    return -1;
+}
+
+QVector<int>
+Audio_collection_search_index::search(const QString &text)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Split the search in words.
+    QString              normalized = normalize(text);
+    QVector<Search_word> words;
+    foreach (const QString &word_text, normalized.split(' ', QString::SkipEmptyParts))
+    {
+        Search_word word;
+        bool        is_number = false;
+        word.text = word_text;
+        word.key  = Utils::get_camelot_index(word_text.toUpper());
+        word.bpm  = word_text.toInt(&is_number);
+        if ((is_number == false) || (word.bpm <= 0))
+        {
+            word.bpm = 0;
+        }
+        word.max_errors = 0;
+        if ((word.key == CAMELOT_UNKNOWN_KEY) && (is_number == false))
+        {
+            word.max_errors = (word_text.length() >= 8) ? 2 : ((word_text.length() >= 4) ? 1 : 0);
+        }
+        get_trigrams(word_text, word.trigrams);
+        words << word;
+    }
+    if (words.isEmpty() == true)
+    {
+        this->last_text.clear();
+        return QVector<int>();
+    }
+
+    // The longest word which is neither a key nor a bpm selects candidates.
+    const Search_word *filter          = nullptr;
+    bool               has_key_or_bpm = false;
+    for (int i = 0; i < words.size(); i++)
+    {
+        const Search_word &word = words.at(i);
+        if ((word.trigrams.isEmpty() == false) && (word.key == CAMELOT_UNKNOWN_KEY) && (word.bpm == 0) &&
+            ((filter == nullptr) || (word.text.length() > filter->text.length())))
+        {
+            filter = &word;
+        }
+        has_key_or_bpm = has_key_or_bpm || (word.key != CAMELOT_UNKNOWN_KEY) || (word.bpm > 0);
+    }
+
+    // Exact matches, a search which only adds characters to the last one filters its results.
+    // Not if a word is a key or a bpm ("12" does not match a track at 120 bpm which matches "120"),
+    // or if the store changed since (e.g. keys and bpms set by the analysis).
+    QVector<int> candidates;
+    if ((this->last_text.isEmpty() == false) && (normalized.startsWith(this->last_text) == true) &&
+        (has_key_or_bpm == false) && (this->last_nb_changes == this->store->get_nb_changes()))
+    {
+        candidates = this->last_file_ids;
+    }
+    else if (filter != nullptr)
+    {
+        this->get_candidates(*filter, filter->trigrams.size(), candidates);
+    }
+    else
+    {
+        candidates.reserve(this->file_texts.size());
+        for (int id = 0; id < this->file_texts.size(); id++)
+        {
+            if (this->file_texts[id].isEmpty() == false)
+            {
+                candidates << id;
+            }
+        }
+    }
+    int          nb_changes  = this->store->get_nb_changes();
+    bool         is_complete = true;
+    QVector<int> exact_ids;
+    QVector<int> name_ids;
+    QVector<int> other_ids;
+    for (int c = 0; c < candidates.size(); c++)
+    {
+        // Stop when the time budget is elapsed (checked only from time to time).
+        if (((c % 256) == 255) && (timer.elapsed() >= SEARCH_MAX_MSEC))
+        {
+            is_complete = false;
+            break;
+        }
+        int  id         = candidates[c];
+        bool is_match   = true;
+        bool is_in_name = true;
+        foreach (const Search_word &word, words)
+        {
+            bool is_word_in_name = false;
+            if (this->match(id, word, false, is_word_in_name) != 0)
+            {
+                is_match = false;
+                break;
+            }
+            is_in_name = is_in_name && is_word_in_name;
+        }
+        if (is_match == true)
+        {
+            exact_ids << id;
+            if (is_in_name == true)
+            {
+                name_ids << id;
+            }
+            else
+            {
+                other_ids << id;
+            }
+        }
+    }
+
+    // Partial results can not be filtered by the next search.
+    this->last_text       = (is_complete == true) ? normalized : QString();
+    this->last_file_ids   = exact_ids;
+    this->last_nb_changes = nb_changes;
+
+    // Matches in names first.
+    QVector<int> results = name_ids;
+    results << other_ids;
+    if (results.size() >= SEARCH_MAX_NB_RESULTS)
+    {
+        results.resize(SEARCH_MAX_NB_RESULTS);
+        return results;
+    }
+
+    // Then matches with typos (one typo can change up to 3 trigrams), fewest typos first, within the time budget.
+    filter = nullptr;
+    for (int i = 0; i < words.size(); i++)
+    {
+        const Search_word &word = words.at(i);
+        if ((word.max_errors > 0) && ((filter == nullptr) || (word.text.length() > filter->text.length())))
+        {
+            filter = &word;
+        }
+    }
+    if (filter != nullptr)
+    {
+        this->get_candidates(*filter, qMax(1, filter->trigrams.size() - 3 * filter->max_errors), candidates);
+        QVector<QPair<int, int>> typo_ids; // Number of typos, id.
+        foreach (int id, candidates)
+        {
+            if (timer.elapsed() >= SEARCH_MAX_MSEC)
+            {
+                break;
+            }
+            if (std::binary_search(exact_ids.constBegin(), exact_ids.constEnd(), id) == true)
+            {
+                continue;
+            }
+            int nb_errors = 0;
+            foreach (const Search_word &word, words)
+            {
+                bool is_in_name = false;
+                int  nb_word_errors = this->match(id, word, true, is_in_name);
+                if (nb_word_errors < 0)
+                {
+                    nb_errors = -1;
+                    break;
+                }
+                nb_errors += nb_word_errors;
+            }
+            if (nb_errors >= 0)
+            {
+                typo_ids << qMakePair(nb_errors, id);
+            }
+        }
+        std::stable_sort(typo_ids.begin(), typo_ids.end());
+        for (int i = 0; (i < typo_ids.size()) && (results.size() < SEARCH_MAX_NB_RESULTS); i++)
+        {
+            results << typo_ids[i].second;
+        }
+    }
+
+    return results;
+}
@@ -0,0 +1,519 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*---------------------------------------------( audio_collection_store.cpp )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: compact storage of the files of the audio collection      */
+/*                  (one array by field, interned directories).               */
+/*                                                                            */
+/*============================================================================*/
+
+#include <QtDebug>
+
+#include "tracks/audio_collection_store.h"
+#include "app/application_logging.h"
+
+Audio_collection_store::Audio_collection_store()
+{
+    this->file_chunks = new Audio_collection_file_chunk*[COLLECTION_STORE_MAX_CHUNKS]();
+    this->dir_chunks  = new Audio_collection_dir_chunk*[COLLECTION_STORE_MAX_CHUNKS]();
+    this->nb_files        = 0;
+    this->nb_dirs         = 0;
+    this->next_keys       = 0;
+    this->next_major_keys = 0;
+    this->nb_changes      = 0;
+
+    return;
+}
+
+Audio_collection_store::~Audio_collection_store()
+{
+    this->clear();
+    delete [] this->file_chunks;
+    delete [] this->dir_chunks;
+
+    return;
+}
+
+int
+Audio_collection_store::add_file(const QString &dir_path,
+                                 const QString &name,
+                                 const QString &hash)
+{
+    // Allocate a new chunk when the last one is full.
+    int id = this->nb_files.load();
+    if ((id % COLLECTION_STORE_CHUNK_SIZE) == 0)
+    {
+        if ((id / COLLECTION_STORE_CHUNK_SIZE) >= COLLECTION_STORE_MAX_CHUNKS)
+        {
+            qCWarning(DS_FILE) << "too many files in the audio collection";
+            return -1;
+        }
+        this->file_chunks[id / COLLECTION_STORE_CHUNK_SIZE] = new Audio_collection_file_chunk();
+    }
+
+    Audio_collection_file_chunk *chunk = this->get_chunk(id);
+    int i = id % COLLECTION_STORE_CHUNK_SIZE;
+    chunk->dir_id[i]     = this->intern_dir(dir_path);
+    chunk->name[i]       = name;
+    chunk->key[i]        = CAMELOT_UNKNOWN_KEY;
+    chunk->flags[i]      = 0;
+    chunk->bpm[i]        = 0.0;
+    chunk->loudness[i]   = 0.0;
+    chunk->first_beat[i] = 0;
+    this->set_hash(id, hash);
+    this->nb_files.storeRelease(id + 1);
+    this->nb_changes.ref();
+
+    return id;
+}
+
+void
+Audio_collection_store::clear()
+{
+    for (int i = 0; i < COLLECTION_STORE_MAX_CHUNKS; i++)
+    {
+        delete this->file_chunks[i];
+        delete this->dir_chunks[i];
+        this->file_chunks[i] = nullptr;
+        this->dir_chunks[i]  = nullptr;
+    }
+    this->nb_files.store(0);
+    this->nb_dirs  = 0;
+    this->dir_ids.clear();
+    this->nb_changes.ref();
+
+    // Empty the index of keys.
+    QMutexLocker locker(&this->key_index_mutex);
+    for (int k = 0; k < CAMELOT_NB_KEYS; k++)
+    {
+        this->files_by_key[k].clear();
+        this->nb_files_by_dir[k].clear();
+        this->dirs_by_key[k].clear();
+    }
+    this->next_keys.store(0);
+    this->next_major_keys.store(0);
+
+    return;
+}
+
+int
+Audio_collection_store::get_nb_files() const
+{
+    return this->nb_files.loadAcquire();
+}
+
+int
+Audio_collection_store::get_nb_changes() const
+{
+    return this->nb_changes.load();
+}
+
+Audio_collection_file_chunk *
+Audio_collection_store::get_chunk(const int &id) const
+{
+    return this->file_chunks[id / COLLECTION_STORE_CHUNK_SIZE];
+}
+
+qint32
+Audio_collection_store::intern_dir(const QString &dir_path)
+{
+    // Files of a directory share its path.
+    QHash<QString, qint32>::const_iterator found = this->dir_ids.constFind(dir_path);
+    if (found != this->dir_ids.constEnd())
+    {
+        return found.value();
+    }
+
+    int id = this->nb_dirs;
+    if ((id % COLLECTION_STORE_CHUNK_SIZE) == 0)
+    {
+        this->dir_chunks[id / COLLECTION_STORE_CHUNK_SIZE] = new Audio_collection_dir_chunk();
+    }
+    this->dir_chunks[id / COLLECTION_STORE_CHUNK_SIZE]->path[id % COLLECTION_STORE_CHUNK_SIZE] = dir_path;
+    this->dir_ids.insert(dir_path, id);
+    this->nb_dirs++;
+
+    return id;
+}
+
+QString
+Audio_collection_store::get_dir(const int &dir_id) const
+{
+    return this->dir_chunks[dir_id / COLLECTION_STORE_CHUNK_SIZE]->path[dir_id % COLLECTION_STORE_CHUNK_SIZE];
+}
+
+QString
+Audio_collection_store::get_name(const int &id) const
+{
+    return this->get_chunk(id)->name[id % COLLECTION_STORE_CHUNK_SIZE];
+}
+
+QString
+Audio_collection_store::get_dir_path(const int &id) const
+{
+    return this->get_dir(this->get_chunk(id)->dir_id[id % COLLECTION_STORE_CHUNK_SIZE]);
+}
+
+int
+Audio_collection_store::get_dir_id(const int &id) const
+{
+    return this->get_chunk(id)->dir_id[id % COLLECTION_STORE_CHUNK_SIZE];
+}
+
+QString
+Audio_collection_store::get_full_path(const int &id) const
+{
+    return this->get_dir_path(id) + "/" + this->get_name(id);
+}
+
+QString
+Audio_collection_store::get_hash(const int &id) const
+{
+    Audio_collection_file_chunk *chunk = this->get_chunk(id);
+    int i = id % COLLECTION_STORE_CHUNK_SIZE;
+    if ((chunk->flags[i] & COLLECTION_FILE_HAS_HASH) == 0)
+    {
+        return "";
+    }
+
+    return QString("%1%2").arg(chunk->hash_high[i], 16, 16, QChar('0')).arg(chunk->hash_low[i], 16, 16, QChar('0'));
+}
+
+bool
+Audio_collection_store::get_hash_128(const int &id, Hash_128 &out_hash) const
+{
+    Audio_collection_file_chunk *chunk = this->get_chunk(id);
+    int i = id % COLLECTION_STORE_CHUNK_SIZE;
+    out_hash.high = chunk->hash_high[i];
+    out_hash.low  = chunk->hash_low[i];
+
+    return (chunk->flags[i] & COLLECTION_FILE_HAS_HASH) != 0;
+}
+
+void
+Audio_collection_store::set_hash(const int &id, const QString &hash)
+{
+    // Hashes are 32 hexadecimal digits (an unreadable file has no hash), flags are changed under the same lock as set_flag().
+    Hash_128 value;
+    bool     is_valid = Utils::get_hash_128(hash, value);
+    QMutexLocker locker(&this->key_index_mutex);
+    Audio_collection_file_chunk *chunk = this->get_chunk(id);
+    int      i = id % COLLECTION_STORE_CHUNK_SIZE;
+    if (is_valid == true)
+    {
+        chunk->flags[i] |= COLLECTION_FILE_HAS_HASH;
+    }
+    else
+    {
+        chunk->flags[i] &= ~COLLECTION_FILE_HAS_HASH;
+    }
+    chunk->hash_high[i] = value.high;
+    chunk->hash_low[i]  = value.low;
+
+    return;
+}
+
+qint8
+Audio_collection_store::get_key(const int &id) const
+{
+    return this->get_chunk(id)->key[id % COLLECTION_STORE_CHUNK_SIZE];
+}
+
+void
+Audio_collection_store::set_key(const int &id, const qint8 &key)
+{
+    // Move the file to the bucket of its new key (removed files are not indexed).
+    QMutexLocker locker(&this->key_index_mutex);
+    Audio_collection_file_chunk *chunk = this->get_chunk(id);
+    int i = id % COLLECTION_STORE_CHUNK_SIZE;
+    if ((chunk->flags[i] & COLLECTION_FILE_REMOVED) == 0)
+    {
+        this->remove_from_key_index(id, chunk->key[i]);
+        this->add_to_key_index(id, key);
+    }
+    chunk->key[i] = key;
+    this->nb_changes.ref();
+
+    return;
+}
+
+void
+Audio_collection_store::add_to_key_index(const int &id, const qint8 &key)
+{
+    if ((key < 0) || (key >= CAMELOT_NB_KEYS))
+    {
+        return;
+    }
+
+    // Bitsets grow by chunk.
+    QBitArray &files = this->files_by_key[key];
+    if (id >= files.size())
+    {
+        files.resize((id / COLLECTION_STORE_CHUNK_SIZE + 1) * COLLECTION_STORE_CHUNK_SIZE);
+    }
+    files.setBit(id);
+
+    // The directory contains a file of this key.
+    int           dir_id = this->get_chunk(id)->dir_id[id % COLLECTION_STORE_CHUNK_SIZE];
+    QVector<int> &counts = this->nb_files_by_dir[key];
+    QBitArray    &dirs   = this->dirs_by_key[key];
+    if (dir_id >= counts.size())
+    {
+        counts.resize((dir_id / COLLECTION_STORE_CHUNK_SIZE + 1) * COLLECTION_STORE_CHUNK_SIZE);
+        dirs.resize(counts.size());
+    }
+    if (counts[dir_id]++ == 0)
+    {
+        dirs.setBit(dir_id);
+    }
+
+    return;
+}
+
+void
+Audio_collection_store::remove_from_key_index(const int &id, const qint8 &key)
+{
+    if ((key < 0) || (key >= CAMELOT_NB_KEYS) ||
+        (id >= this->files_by_key[key].size()) || (this->files_by_key[key].testBit(id) == false))
+    {
+        return;
+    }
+    this->files_by_key[key].clearBit(id);
+
+    // Last file of this key in the directory.
+    int dir_id = this->get_chunk(id)->dir_id[id % COLLECTION_STORE_CHUNK_SIZE];
+    if (--this->nb_files_by_dir[key][dir_id] == 0)
+    {
+        this->dirs_by_key[key].clearBit(dir_id);
+    }
+
+    return;
+}
+
+float
+Audio_collection_store::get_bpm(const int &id) const
+{
+    return this->get_chunk(id)->bpm[id % COLLECTION_STORE_CHUNK_SIZE];
+}
+
+void
+Audio_collection_store::set_bpm(const int &id, const float &bpm)
+{
+    this->get_chunk(id)->bpm[id % COLLECTION_STORE_CHUNK_SIZE] = bpm;
+    this->nb_changes.ref();
+
+    return;
+}
+
+float
+Audio_collection_store::get_loudness(const int &id) const
+{
+    return this->get_chunk(id)->loudness[id % COLLECTION_STORE_CHUNK_SIZE];
+}
+
+void
+Audio_collection_store::set_loudness(const int &id, const float &loudness)
+{
+    this->get_chunk(id)->loudness[id % COLLECTION_STORE_CHUNK_SIZE] = loudness;
+
+    return;
+}
+
+quint32
+Audio_collection_store::get_first_beat(const int &id) const
+{
+    return this->get_chunk(id)->first_beat[id % COLLECTION_STORE_CHUNK_SIZE];
+}
+
+void
+Audio_collection_store::set_first_beat(const int &id, const quint32 &first_beat)
+{
+    this->get_chunk(id)->first_beat[id % COLLECTION_STORE_CHUNK_SIZE] = first_beat;
+
+    return;
+}
+
+bool
+Audio_collection_store::has_flag(const int &id, const quint8 &flag) const
+{
+    return (this->get_chunk(id)->flags[id % COLLECTION_STORE_CHUNK_SIZE] & flag) != 0;
+}
+
+void
+Audio_collection_store::set_flag(const int &id, const quint8 &flag, const bool &value)
+{
+    QMutexLocker locker(&this->key_index_mutex);
+    Audio_collection_file_chunk *chunk = this->get_chunk(id);
+    int     i     = id % COLLECTION_STORE_CHUNK_SIZE;
+    quint8 &flags = chunk->flags[i];
+
+    // A removed file leaves the index of keys.
+    if ((flag & COLLECTION_FILE_REMOVED) != 0)
+    {
+        bool is_removed = (flags & COLLECTION_FILE_REMOVED) != 0;
+        if ((value == true) && (is_removed == false))
+        {
+            this->remove_from_key_index(id, chunk->key[i]);
+        }
+        else if ((value == false) && (is_removed == true))
+        {
+            this->add_to_key_index(id, chunk->key[i]);
+        }
+        this->nb_changes.ref();
+    }
+
+    if (value == true)
+    {
+        flags |= flag;
+    }
+    else
+    {
+        flags &= ~flag;
+    }
+
+    return;
+}
+
+int
+Audio_collection_store::get_nb_missing_data() const
+{
+    // Linear scan of the flags array.
+    int nb_missing = 0;
+    int nb_files   = this->nb_files.loadAcquire();
+    for (int c = 0; c * COLLECTION_STORE_CHUNK_SIZE < nb_files; c++)
+    {
+        const Audio_collection_file_chunk *chunk = this->file_chunks[c];
+        int nb = qMin(COLLECTION_STORE_CHUNK_SIZE, nb_files - c * COLLECTION_STORE_CHUNK_SIZE);
+        for (int i = 0; i < nb; i++)
+        {
+            if ((chunk->flags[i] & (COLLECTION_FILE_REMOVED | COLLECTION_FILE_ANALYZED)) == 0)
+            {
+                nb_missing++;
+            }
+        }
+    }
+
+    return nb_missing;
+}
+
+void
+Audio_collection_store::set_next_keys(const qint8  &next_key,
+                                      const qint8  &prev_key,
+                                      const qint8  &next_major_key,
+                                      QVector<int> &out_dir_ids)
+{
+    // Select keys (a key which is both a next and a next major one is a next one).
+    quint32 keys       = 0;
+    quint32 major_keys = 0;
+    if ((next_key >= 0) && (next_key < CAMELOT_NB_KEYS))
+    {
+        keys |= (1 << next_key);
+    }
+    if ((prev_key >= 0) && (prev_key < CAMELOT_NB_KEYS))
+    {
+        keys |= (1 << prev_key);
+    }
+    if ((next_major_key >= 0) && (next_major_key < CAMELOT_NB_KEYS))
+    {
+        major_keys = (1 << next_major_key) & ~keys;
+    }
+
+    // Publish them and make the union of the directories of these keys.
+    QMutexLocker locker(&this->key_index_mutex);
+    this->next_keys.store(keys);
+    this->next_major_keys.store(major_keys);
+    QBitArray dirs;
+    for (int k = 0; k < CAMELOT_NB_KEYS; k++)
+    {
+        if (((keys | major_keys) & (1 << k)) != 0)
+        {
+            dirs |= this->dirs_by_key[k];
+        }
+    }
+    out_dir_ids.clear();
+    for (int d = 0; d < dirs.size(); d++)
+    {
+        if (dirs.testBit(d) == true)
+        {
+            out_dir_ids << d;
+        }
+    }
+
+    return;
+}
+
+bool
+Audio_collection_store::is_next_key(const int &id) const
+{
+    Audio_collection_file_chunk *chunk = this->get_chunk(id);
+    int   i   = id % COLLECTION_STORE_CHUNK_SIZE;
+    qint8 key = chunk->key[i];
+
+    return (key != CAMELOT_UNKNOWN_KEY) &&
+           ((chunk->flags[i] & COLLECTION_FILE_REMOVED) == 0) &&
+           ((this->next_keys.load() & (1 << key)) != 0);
+}
+
+bool
+Audio_collection_store::is_next_major_key(const int &id) const
+{
+    Audio_collection_file_chunk *chunk = this->get_chunk(id);
+    int   i   = id % COLLECTION_STORE_CHUNK_SIZE;
+    qint8 key = chunk->key[i];
+
+    return (key != CAMELOT_UNKNOWN_KEY) &&
+           ((chunk->flags[i] & COLLECTION_FILE_REMOVED) == 0) &&
+           ((this->next_major_keys.load() & (1 << key)) != 0);
+}
+
+QVector<int>
+Audio_collection_store::get_next_key_files(const bool &is_major,
+                                           const int  &max_nb_files)
+{
+    // Union of the files of selected keys.
+    QMutexLocker locker(&this->key_index_mutex);
+    quint32   keys = (is_major == true) ? this->next_major_keys.load() : this->next_keys.load();
+    QBitArray files;
+    for (int k = 0; k < CAMELOT_NB_KEYS; k++)
+    {
+        if ((keys & (1 << k)) != 0)
+        {
+            files |= this->files_by_key[k];
+        }
+    }
+
+    QVector<int> ids;
+    for (int id = 0; (id < files.size()) && (ids.size() < max_nb_files); id++)
+    {
+        if (files.testBit(id) == true)
+        {
+            ids << id;
+        }
+    }
+
+    return ids;
+}
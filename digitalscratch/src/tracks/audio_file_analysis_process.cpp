@@ -0,0 +1,123 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*----------------------------------------( audio_file_analysis_process.cpp )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: decode an audio file once and give it chunk by chunk to   */
+/*                  several analyzers (music key, tempo, loudness,...).       */
+/*                                                                            */
+/*============================================================================*/
+
+#include <QtDebug>
+#include <QFile>
+
+extern "C"
+{
+    #include "libavformat/avformat.h"
+}
+
+#include "tracks/audio_file_analysis_process.h"
+#include "tracks/audio_file_decoding_process.h"
+#include "tracks/audio_file_decoding_segment.h"
+#include "app/application_settings.h"
+#include "app/application_logging.h"
+#include "app/job_scheduler.h"
+#include "singleton.h"
+
+Audio_file_analysis_process::Audio_file_analysis_process()
+{
+    // Analysis does not need a high quality resampling.
+    this->resampler_type = Audio_file_decoding_process::get_resampler_type(RESAMPLING_QUALITY_FASTEST);
+
+    // Some libav decoder init.
+    av_register_all();
+    av_log_set_level(AV_LOG_QUIET);
+
+    return;
+}
+
+Audio_file_analysis_process::~Audio_file_analysis_process()
+{
+    return;
+}
+
+void
+Audio_file_analysis_process::add_analyzer(Audio_stream_analyzer *analyzer)
+{
+    this->analyzers << analyzer;
+
+    return;
+}
+
+bool
+Audio_file_analysis_process::run(const QString                     &path,
+                                 const QSharedPointer<Audio_track> &io_at)
+{
+    // Check if file exists.
+    if (QFile::exists(path) == false)
+    {
+        qCWarning(DS_FILE) << "file does not exist: " << path;
+        return false;
+    }
+
+    // Open the file (decoding gives way to playback when it runs as a background job).
+    Audio_file_decoding_segment segment(path, io_at, true, this->resampler_type, []()
+    {
+        return Singleton<Job_scheduler>::get_instance().must_pause_current_job();
+    });
+    if (segment.open() == false)
+    {
+        return false;
+    }
+
+    // Decoded chunks are directly given to all analyzers, so the file is never stored in memory.
+    for (Audio_stream_analyzer *analyzer : this->analyzers)
+    {
+        analyzer->start(io_at->get_sample_rate());
+    }
+    segment.set_output_sink([this](const short signed int *samples, const unsigned int &nb_frames)
+    {
+        for (Audio_stream_analyzer *analyzer : this->analyzers)
+        {
+            analyzer->process(samples, nb_frames);
+        }
+        return true;
+    });
+    int64_t max_nb_frames = (int64_t)ANALYSIS_MAX_MINUTES * 60 * segment.get_decoded_sample_rate();
+    if ((segment.decode(0, max_nb_frames) == false) || (segment.get_output_end() == 0))
+    {
+        qCWarning(DS_FILE) << "cannot decode " << path;
+        return false;
+    }
+
+    // Get results (an analyzer can fail without preventing the others to give a result).
+    for (Audio_stream_analyzer *analyzer : this->analyzers)
+    {
+        analyzer->finish(io_at);
+    }
+
+    return true;
+}
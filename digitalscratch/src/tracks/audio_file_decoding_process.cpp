@@ -31,21 +31,22 @@
 /*============================================================================*/
 
 #include <QtDebug>
+#include <QThread>
+#include <QFuture>
+#include <QtConcurrentRun>
 #include <algorithm>
 
 #include <samplerate.h>
 extern "C"
 {
-    #include "libavcodec/avcodec.h"
     #include "libavformat/avformat.h"
 }
 
-#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(55,28,1)
-#define av_frame_alloc avcodec_alloc_frame
-#endif
-
 #include "app/application_logging.h"
+#include "app/application_settings.h"
 #include "tracks/audio_file_decoding_process.h"
+#include "tracks/audio_file_pcm_mapping.h"
+#include "singleton.h"
 
 Audio_file_decoding_process::Audio_file_decoding_process(const QSharedPointer<Audio_track> &at,
                                                          const bool &do_resample)
@@ -59,6 +60,8 @@ Audio_file_decoding_process::Audio_file_decoding_process(const QSharedPointer<Au
         this->at = at;
         this->do_resample = do_resample;
         this->decoded_sample_rate = this->at->get_sample_rate();
+        this->resampler_type = get_resampler_type(Singleton<Application_settings>::get_instance().get_resampling_quality());
+        this->max_nb_threads = QThread::idealThreadCount();
 
         // Some libav decoder init.
         av_register_all();
@@ -100,9 +103,27 @@ Audio_file_decoding_process::run(const QString &path,
         return false;
     }
 
+    // Summarize the track for the waveform (most of it was done while decoding).
+    if (this->at->get_peaks() != nullptr)
+    {
+        this->at->get_peaks()->finish(this->at->get_samples(), this->at->get_end_of_samples() / 2);
+    }
+
     // Set name of the track which is for the moment the name of the file.
     QFileInfo file_info = QFileInfo(this->file);
     this->at->set_name(file_info.fileName());
+
+    // Set file path.
+    this->at->set_fullpath(file_info.absoluteFilePath());
+
+    return this->load_decoded_track(file_hash, music_key);
+}
+
+bool
+Audio_file_decoding_process::load_decoded_track(const QString &file_hash,
+                                                const QString &music_key)
+{
+    // Show name of the track.
     if (this->at->get_name() == "")
     {
         emit name_changed("--");
@@ -112,9 +133,6 @@ Audio_file_decoding_process::run(const QString &path,
         emit name_changed("[" + this->at->get_length_str() + "]  " + this->at->get_name());
     }
 
-    // Set file path.
-    this->at->set_fullpath(file_info.absoluteFilePath());
-
     // Set also the music key.
     this->at->set_music_key(music_key);
     emit key_changed(this->at->get_music_key());
@@ -126,217 +144,187 @@ Audio_file_decoding_process::run(const QString &path,
 }
 
 void
-Audio_file_decoding_process::resample_track()
+Audio_file_decoding_process::set_pause_check(std::function<bool()> must_pause)
 {
-    if ((this->do_resample == true) && (at->get_sample_rate() != this->decoded_sample_rate))
-    {
-        // Copy decoded samples in a temp buffer.
-        unsigned int input_nb_samples = at->get_end_of_samples();
-        float *input_samples = new float[input_nb_samples];
-        src_short_to_float_array(at->get_samples(), input_samples, input_nb_samples);
-
-        // Resample temp buffer.
-        int   output_nb_samples = (at->get_end_of_samples() * (float)at->get_sample_rate() / (float)this->decoded_sample_rate) + 2;
-        float *output_samples = new float[output_nb_samples];
-        SRC_DATA src_data;
-        src_data.data_in       = input_samples;
-        src_data.data_out      = output_samples;
-        src_data.end_of_input  = 0;
-        src_data.input_frames  = input_nb_samples / 2;
-        src_data.output_frames = output_nb_samples / 2;
-        src_data.src_ratio     = (float)at->get_sample_rate() / (float)this->decoded_sample_rate;
-        src_simple(&src_data, SRC_LINEAR, 2);
-
-        // Copy resampled sampler back to original table of samples.
-        src_float_to_short_array(output_samples, at->get_samples(), src_data.output_frames_gen * 2);
-        at->set_end_of_samples(src_data.output_frames_gen * 2);
-
-        // Cleanup.
-        delete [] input_samples;
-        delete [] output_samples;
-    }
+    this->must_pause = must_pause;
 
     return;
 }
 
-bool
-Audio_file_decoding_process::decode()
+void
+Audio_file_decoding_process::set_cancel_check(std::function<bool()> is_canceled)
+{
+    this->is_canceled = is_canceled;
+
+    return;
+}
+
+void
+Audio_file_decoding_process::set_max_nb_threads(const int &max_nb_threads)
 {
-    // Get file name to decode.
-    QByteArray        filename_array = this->file.fileName().toUtf8();
-    char             *filename       = (char*)filename_array.constData();
+    this->max_nb_threads = qMax(1, max_nb_threads);
 
-    // Get output table of decoded samples.
-    short signed int *output_samples = this->at->get_samples();
+    return;
+}
 
-    // Allocate a frame.
-    AVFrame* frame = av_frame_alloc();
-    if (!frame)
+int
+Audio_file_decoding_process::get_resampler_type(const QString &quality)
+{
+    if (quality == RESAMPLING_QUALITY_BEST)
     {
-        return false;
+        return SRC_SINC_BEST_QUALITY;
+    }
+    else if (quality == RESAMPLING_QUALITY_FASTEST)
+    {
+        return SRC_SINC_FASTEST;
+    }
+    else if (quality == RESAMPLING_QUALITY_LINEAR)
+    {
+        return SRC_LINEAR;
     }
+    else
+    {
+        return SRC_SINC_MEDIUM_QUALITY;
+    }
+}
 
-    // Open file.
-    AVFormatContext* format_context = nullptr;
-    if (avformat_open_input(&format_context, filename, nullptr, nullptr) != 0)
+bool
+Audio_file_decoding_process::decode()
+{
+    // Uncompressed files (WAV, AIFF) do not need to be decoded.
+    Audio_file_pcm_mapping pcm_file;
+    if ((pcm_file.open(this->file.fileName()) == true) && (pcm_file.load(this->at, this->do_resample) == true))
     {
-        av_free(frame);
-        qCWarning(DS_FILE) << "error opening file" << qPrintable(filename);
-        return false;
+        this->decoded_sample_rate = pcm_file.get_sample_rate();
+        return true;
     }
 
-    // Get audio format.
-    if (avformat_find_stream_info(format_context, nullptr) < 0)
+    // Open the file a first time to know its format.
+    Audio_file_decoding_segment probe(this->file.fileName(), this->at, this->do_resample, this->resampler_type, this->must_pause, this->is_canceled);
+    if (probe.open() == false)
     {
-        av_free(frame);
-        avformat_close_input(&format_context);
-        qCWarning(DS_FILE) << "error finding the stream info" << qPrintable(filename);
         return false;
     }
+    this->decoded_sample_rate = probe.get_decoded_sample_rate();
 
-    // Find the audio stream (some container files can have multiple streams in them).
-    AVStream* audio_stream = nullptr;
-    for (unsigned int i = 0; i < format_context->nb_streams; ++i)
+    // Formats where seeking is sample exact are split in regions decoded in parallel.
+    // Others (mp3, aac,...) are decoded sequentially: their decoder needs what comes before.
+    int nb_segments = 1;
+    if ((this->max_nb_threads > 1) && (probe.is_sample_exact_seekable() == true))
     {
-        if (format_context->streams[i]->codec->codec_type == AVMEDIA_TYPE_AUDIO)
-        {
-            audio_stream = format_context->streams[i];
-            break;
-        }
+        int64_t nb_frames = probe.get_nb_frames();
+        nb_segments = qMin((int64_t)this->max_nb_threads,
+                           nb_frames / (DECODING_MIN_SEGMENT_SEC * (int64_t)this->decoded_sample_rate));
     }
-    if (audio_stream == nullptr)
+
+    if (nb_segments > 1)
     {
-        av_free(frame);
-        avformat_close_input(&format_context);
-        qCWarning(DS_FILE) << "could not find any audio stream in the file" << qPrintable(filename);
-        return false;
+        if (this->decode_segments(probe, nb_segments) == true)
+        {
+            return true;
+        }
+
+        // Some segments did not join, decode again from the beginning.
+        qCWarning(DS_FILE) << "segmented decoding failed, decode sequentially" << qPrintable(this->file.fileName());
+        this->at->reset();
+
+        return this->decode_sequential();
     }
 
-    // Get codec of the audio file.
-    AVCodecContext* codec_context = audio_stream->codec;
-    codec_context->codec = avcodec_find_decoder(codec_context->codec_id);
-    if (codec_context->codec == nullptr)
+    // Decode the whole file with the already opened decoder.
+    if (probe.decode(0, -1) == false)
     {
-        av_free(frame);
-        avformat_close_input(&format_context);
-        qCWarning(DS_FILE) << "couldn't find a proper decoder" << qPrintable(filename);
         return false;
     }
-    else if (avcodec_open2(codec_context, codec_context->codec, nullptr) != 0)
+    this->at->set_end_of_samples(probe.get_output_end() * 2);
+
+    return true;
+}
+
+bool
+Audio_file_decoding_process::decode_sequential()
+{
+    Audio_file_decoding_segment segment(this->file.fileName(), this->at, this->do_resample, this->resampler_type, this->must_pause, this->is_canceled);
+    if ((segment.open() == false) || (segment.decode(0, -1) == false))
     {
-        av_free(frame);
-        avformat_close_input(&format_context);
-        qCWarning(DS_FILE) << "couldn't open the context with the decoder" << qPrintable(filename);
         return false;
     }
+    this->at->set_end_of_samples(segment.get_output_end() * 2);
 
-    // Store decoded sample rate.
-    this->decoded_sample_rate = codec_context->sample_rate;
-
-    // Show audio format.
-    qCDebug(DS_FILE) << qPrintable(this->file.fileName()) << ":"
-                     << codec_context->sample_rate << "Hz,"
-                     << codec_context->channels << "ch,"
-                     << av_get_sample_fmt_name(codec_context->sample_fmt);
+    return true;
+}
 
-    // Create a packet.
-    AVPacket packet;
-    av_init_packet(&packet);
+bool
+Audio_file_decoding_process::decode_segments(Audio_file_decoding_segment &probe,
+                                             const int                   &nb_segments)
+{
+    // Do not decode more than what the audio track can store.
+    int64_t max_nb_output_frames = this->at->get_max_nb_samples() / 2;
+    int64_t nb_frames            = probe.get_nb_frames();
+    int64_t max_nb_input_frames  = max_nb_output_frames;
+    if (this->do_resample == true)
+    {
+        max_nb_input_frames = max_nb_output_frames * this->decoded_sample_rate / this->at->get_sample_rate();
+    }
+    nb_frames = qMin(nb_frames, max_nb_input_frames);
+
+    // Segment boundaries (in input frames), aligned so they give an exact output position.
+    int64_t          alignment = probe.get_alignment();
+    QVector<int64_t> boundaries(nb_segments + 1);
+    boundaries[0]           = 0;
+    boundaries[nb_segments] = -1;
+    for (int i = 1; i < nb_segments; i++)
+    {
+        boundaries[i] = ((nb_frames * i / nb_segments) / alignment) * alignment;
+    }
 
-    // Read the packets in a loop
-    bool decoding_done = false;
-    while ((decoding_done == false) && (av_read_frame(format_context, &packet) == 0))
+    // Decode all segments except the first one in other threads.
+    QList<QSharedPointer<Audio_file_decoding_segment>> segments;
+    QList<QFuture<bool>>                               results;
+    for (int i = 1; i < nb_segments; i++)
     {
-        if (packet.stream_index == audio_stream->index)
-        {
-            // Try to decode the packet into a frame.
-            int frame_finished = 0;
-            avcodec_decode_audio4(codec_context, frame, &frame_finished, &packet);
-
-            // Some frames rely on multiple packets, so we have to make sure the frame is finished before
-            // we can use it
-            if (frame_finished == 1)
-            {
-                // Frame now has usable audio data in it.
-                if (codec_context->sample_fmt == AV_SAMPLE_FMT_S16) // Interleaved data.
-                {
-                    int total_nb_samples = frame->nb_samples * codec_context->channels;
-                    if ((this->at->get_end_of_samples() + total_nb_samples) > this->at->get_max_nb_samples())
-                    {
-                        // We reached the end of the audio track buffer.
-                        total_nb_samples = this->at->get_max_nb_samples() - this->at->get_end_of_samples();
-                        decoding_done = true;
-                    }
-                    int data_size = total_nb_samples * sizeof(short signed int);
-                    memcpy(output_samples, frame->data[0], data_size);
-                    output_samples += total_nb_samples;
-                    this->at->set_end_of_samples(this->at->get_end_of_samples() + total_nb_samples);
-                }
-                else if (codec_context->sample_fmt == AV_SAMPLE_FMT_S16P) // Planar data (one data table per channels).
-                {
-                    int total_nb_samples = frame->nb_samples * codec_context->channels;
-                    if ((this->at->get_end_of_samples() + total_nb_samples) > this->at->get_max_nb_samples())
-                    {
-                        // We reached the end of the audio track buffer.
-                        total_nb_samples = this->at->get_max_nb_samples() - this->at->get_end_of_samples();
-                        decoding_done = true;
-                    }
-                    short signed int *channel_0 = (short signed int *)frame->data[0];
-                    short signed int *channel_1 = (short signed int *)frame->data[1];
-                    for (int i = 0; i < frame->nb_samples; i++)
-                    {
-                        if (channel_0 != nullptr)
-                        {
-                            output_samples[i*2] = channel_0[i];
-                        }
-                        else
-                        {
-                            output_samples[i*2] = 0;
-                        }
-                        if (channel_1 != nullptr)
-                        {
-                            output_samples[i*2+1] = channel_1[i];
-                        }
-                        else
-                        {
-                            output_samples[i*2+1] = 0;
-                        }
-                    }
-                    output_samples += total_nb_samples;
-                    this->at->set_end_of_samples(this->at->get_end_of_samples() + total_nb_samples);
-                }
-                else // Non recognized byte format.
-                {
-                    decoding_done = true;
-                    qCWarning(DS_FILE) << "audio byte format not supported" << qPrintable(filename);
-                }
-            }
-        }
+        QSharedPointer<Audio_file_decoding_segment> segment(
+                    new Audio_file_decoding_segment(this->file.fileName(), this->at, this->do_resample, this->resampler_type, this->must_pause, this->is_canceled));
+        int64_t first_frame = boundaries[i];
+        int64_t last_frame  = boundaries[i + 1];
+        segments << segment;
+        results << QtConcurrent::run([segment, first_frame, last_frame]()
+                                     {
+                                         return (segment->open() == true) && (segment->decode(first_frame, last_frame) == true);
+                                     });
+    }
 
-        // Cleanup packet.
-        av_free_packet(&packet);
+    // First segment is decoded in the current thread.
+    bool result = probe.decode(0, boundaries[1]);
+    for (int i = 0; i < results.size(); i++)
+    {
+        results[i].waitForFinished();
+        result = result && (results[i].result() == true);
     }
 
-    // Some codecs will cause frames to be buffered up in the decoding process. If the CODEC_CAP_DELAY flag
-    // is set, there can be buffered up frames that need to be flushed, so we'll do that
-    if (codec_context->codec->capabilities & CODEC_CAP_DELAY)
+    // Check that each segment reached the beginning of the next one.
+    if (probe.get_output_end() < qMin(probe.get_output_frame(boundaries[1]), max_nb_output_frames))
+    {
+        result = false;
+    }
+    int64_t max_output_end = probe.get_output_end();
+    for (int i = 0; i < segments.size(); i++)
     {
-        av_init_packet(&packet);
-        // Decode all the remaining frames in the buffer, until the end is reached
-        int frame_finished = 0;
-        while (avcodec_decode_audio4(codec_context, frame, &frame_finished, &packet) >= 0 && frame_finished)
+        if ((i < segments.size() - 1) &&
+            (segments[i]->get_output_end() < qMin(probe.get_output_frame(boundaries[i + 2]), max_nb_output_frames)))
         {
+            result = false;
         }
+        max_output_end = qMax(max_output_end, segments[i]->get_output_end());
     }
 
-    // Cleanup.
-    av_free(frame);
-    avcodec_close(codec_context);
-    avformat_close_input(&format_context);
-
-    // Maybe the sample rate used by the sound card to play the file is not the same as
-    // the one of the audio file, so convert it if necessary.
-    this->resample_track();
+    // On failure the track is still marked as used up to the last written sample, so it is fully cleared.
+    if (result == false)
+    {
+        this->at->set_end_of_samples(max_output_end * 2);
+        return false;
+    }
+    this->at->set_end_of_samples(segments.last()->get_output_end() * 2);
 
     return true;
 }
@@ -0,0 +1,681 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*----------------------------------------( audio_file_decoding_segment.cpp )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: decode (and resample) a part of an audio file into its    */
+/*                  own region of an audio track.                             */
+/*                                                                            */
+/*============================================================================*/
+
+#include <QtDebug>
+#include <QThread>
+#include <cstring>
+
+extern "C"
+{
+    #include "libavcodec/avcodec.h"
+    #include "libavformat/avformat.h"
+    #include "libavutil/mathematics.h"
+}
+
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(55,28,1)
+#define av_frame_alloc avcodec_alloc_frame
+#endif
+
+#include "app/application_logging.h"
+#include "tracks/audio_file_decoding_segment.h"
+
+Audio_file_decoding_segment::Audio_file_decoding_segment(const QString                     &path,
+                                                         const QSharedPointer<Audio_track> &at,
+                                                         const bool                        &do_resample,
+                                                         const int                         &resampler_type,
+                                                         std::function<bool()>              must_pause,
+                                                         std::function<bool()>              is_canceled)
+{
+    this->path                = path;
+    this->at                  = at;
+    this->do_resample         = do_resample;
+    this->resampler_type      = resampler_type;
+    this->must_pause          = must_pause;
+    this->is_canceled         = is_canceled;
+    this->format_context      = nullptr;
+    this->codec_context       = nullptr;
+    this->audio_stream        = nullptr;
+    this->frame               = nullptr;
+    this->src_state           = nullptr;
+    this->src_ratio           = 1.0;
+    this->decoded_sample_rate = at->get_sample_rate();
+    this->warmup_frame        = 0;
+    this->output_first_frame  = 0;
+    this->output_last_frame   = -1;
+    this->output_position     = 0;
+    this->output_end          = 0;
+    this->peaks_position      = 0;
+
+    return;
+}
+
+Audio_file_decoding_segment::~Audio_file_decoding_segment()
+{
+    this->close();
+
+    return;
+}
+
+void
+Audio_file_decoding_segment::set_output_sink(std::function<bool(const short signed int*,
+                                                                const unsigned int&)> sink)
+{
+    this->output_sink = sink;
+
+    return;
+}
+
+void
+Audio_file_decoding_segment::close()
+{
+    if (this->src_state != nullptr)
+    {
+        src_delete(this->src_state);
+        this->src_state = nullptr;
+    }
+    if (this->frame != nullptr)
+    {
+        av_free(this->frame);
+        this->frame = nullptr;
+    }
+    if (this->codec_context != nullptr)
+    {
+        avcodec_close(this->codec_context);
+        this->codec_context = nullptr;
+    }
+    if (this->format_context != nullptr)
+    {
+        avformat_close_input(&this->format_context);
+        this->format_context = nullptr;
+    }
+
+    return;
+}
+
+bool
+Audio_file_decoding_segment::open()
+{
+    // Get file name to decode.
+    QByteArray  filename_array = this->path.toUtf8();
+    const char *filename       = filename_array.constData();
+
+    // Allocate a frame.
+    this->frame = av_frame_alloc();
+    if (this->frame == nullptr)
+    {
+        return false;
+    }
+
+    // Open file.
+    if (avformat_open_input(&this->format_context, filename, nullptr, nullptr) != 0)
+    {
+        qCWarning(DS_FILE) << "error opening file" << qPrintable(filename);
+        this->close();
+        return false;
+    }
+
+    // Get audio format.
+    if (avformat_find_stream_info(this->format_context, nullptr) < 0)
+    {
+        qCWarning(DS_FILE) << "error finding the stream info" << qPrintable(filename);
+        this->close();
+        return false;
+    }
+
+    // Find the audio stream (some container files can have multiple streams in them).
+    for (unsigned int i = 0; i < this->format_context->nb_streams; ++i)
+    {
+        if (this->format_context->streams[i]->codec->codec_type == AVMEDIA_TYPE_AUDIO)
+        {
+            this->audio_stream = this->format_context->streams[i];
+            break;
+        }
+    }
+    if (this->audio_stream == nullptr)
+    {
+        qCWarning(DS_FILE) << "could not find any audio stream in the file" << qPrintable(filename);
+        this->close();
+        return false;
+    }
+
+    // Get codec of the audio file.
+    AVCodecContext *codec_context = this->audio_stream->codec;
+    codec_context->codec = avcodec_find_decoder(codec_context->codec_id);
+    if (codec_context->codec == nullptr)
+    {
+        qCWarning(DS_FILE) << "couldn't find a proper decoder" << qPrintable(filename);
+        this->close();
+        return false;
+    }
+    else if (avcodec_open2(codec_context, codec_context->codec, nullptr) != 0)
+    {
+        qCWarning(DS_FILE) << "couldn't open the context with the decoder" << qPrintable(filename);
+        this->close();
+        return false;
+    }
+    this->codec_context = codec_context;
+
+    // Store decoded sample rate.
+    this->decoded_sample_rate = this->codec_context->sample_rate;
+
+    // Show audio format.
+    qCDebug(DS_FILE) << qPrintable(this->path) << ":"
+                     << this->codec_context->sample_rate << "Hz,"
+                     << this->codec_context->channels << "ch,"
+                     << av_get_sample_fmt_name(this->codec_context->sample_fmt);
+
+    return true;
+}
+
+bool
+Audio_file_decoding_segment::is_sample_exact_seekable()
+{
+    if (this->codec_context == nullptr)
+    {
+        return false;
+    }
+
+    // Uncompressed PCM and FLAC: every packet has an exact timestamp and there is no decoder delay.
+    AVCodecID codec_id = this->codec_context->codec_id;
+    return ((codec_id >= AV_CODEC_ID_FIRST_AUDIO) && (codec_id < AV_CODEC_ID_ADPCM_IMA_QT)) ||
+           (codec_id == AV_CODEC_ID_FLAC);
+}
+
+unsigned int
+Audio_file_decoding_segment::get_decoded_sample_rate()
+{
+    return this->decoded_sample_rate;
+}
+
+int64_t
+Audio_file_decoding_segment::get_nb_frames()
+{
+    if (this->audio_stream == nullptr)
+    {
+        return 0;
+    }
+
+    AVRational frame_time_base = { 1, (int)this->decoded_sample_rate };
+    if (this->audio_stream->duration != AV_NOPTS_VALUE)
+    {
+        return av_rescale_q(this->audio_stream->duration, this->audio_stream->time_base, frame_time_base);
+    }
+    else if (this->format_context->duration != AV_NOPTS_VALUE)
+    {
+        return av_rescale(this->format_context->duration, this->decoded_sample_rate, AV_TIME_BASE);
+    }
+
+    return 0;
+}
+
+bool
+Audio_file_decoding_segment::is_resampling()
+{
+    return (this->do_resample == true) && (this->at->get_sample_rate() != this->decoded_sample_rate);
+}
+
+int64_t
+Audio_file_decoding_segment::get_alignment()
+{
+    if (this->is_resampling() == false)
+    {
+        return 1;
+    }
+
+    // Smallest number of input frames which gives an integer number of output frames.
+    int64_t a = this->decoded_sample_rate;
+    int64_t b = this->at->get_sample_rate();
+    while (b != 0)
+    {
+        int64_t r = a % b;
+        a = b;
+        b = r;
+    }
+
+    return this->decoded_sample_rate / a;
+}
+
+int64_t
+Audio_file_decoding_segment::get_output_frame(const int64_t &input_frame)
+{
+    if (this->is_resampling() == false)
+    {
+        return input_frame;
+    }
+
+    return input_frame * this->at->get_sample_rate() / this->decoded_sample_rate;
+}
+
+int64_t
+Audio_file_decoding_segment::get_output_end()
+{
+    return this->output_end;
+}
+
+bool
+Audio_file_decoding_segment::seek(const int64_t &input_frame)
+{
+    // Seek to the packet containing (or before) the input frame.
+    AVRational frame_time_base = { 1, (int)this->decoded_sample_rate };
+    int64_t    timestamp       = av_rescale_q(input_frame, frame_time_base, this->audio_stream->time_base);
+    if (this->audio_stream->start_time != AV_NOPTS_VALUE)
+    {
+        timestamp += this->audio_stream->start_time;
+    }
+    if (av_seek_frame(this->format_context, this->audio_stream->index, timestamp, AVSEEK_FLAG_BACKWARD) < 0)
+    {
+        qCWarning(DS_FILE) << "can not seek in" << qPrintable(this->path);
+        return false;
+    }
+    avcodec_flush_buffers(this->codec_context);
+
+    return true;
+}
+
+bool
+Audio_file_decoding_segment::decode(const int64_t &first_frame,
+                                    const int64_t &last_frame)
+{
+    if (this->codec_context == nullptr)
+    {
+        return false;
+    }
+
+    // Prepare resampling if the sample rate of the sound card is not the one of the file.
+    if (this->is_resampling() == true)
+    {
+        int error = 0;
+        this->src_state = src_new(this->resampler_type, 2, &error);
+        if (this->src_state == nullptr)
+        {
+            qCWarning(DS_FILE) << "can not create resampler:" << src_strerror(error);
+            return false;
+        }
+        this->src_ratio = (double)this->at->get_sample_rate() / (double)this->decoded_sample_rate;
+        if (src_is_valid_ratio(this->src_ratio) == 0)
+        {
+            qCWarning(DS_FILE) << "can not resample from" << this->decoded_sample_rate << "Hz to" << this->at->get_sample_rate() << "Hz";
+            return false;
+        }
+        this->src_input_buffer.resize(RESAMPLING_CHUNK_FRAMES * 2);
+        this->src_output_buffer.resize(RESAMPLING_CHUNK_FRAMES * 2);
+        this->src_s16_output_buffer.resize(RESAMPLING_CHUNK_FRAMES * 2);
+    }
+
+    // A segment which does not start at the beginning starts to decode a bit before (to prime the resampler),
+    // what is produced before the segment is dropped. The filter of the resampler is wider when downsampling.
+    this->warmup_frame = 0;
+    if (first_frame > 0)
+    {
+        int64_t overlap   = 0;
+        if (this->src_state != nullptr)
+        {
+            overlap = SEGMENT_OVERLAP_FRAMES * qMax((int64_t)1, (int64_t)((this->decoded_sample_rate + this->at->get_sample_rate() - 1) / this->at->get_sample_rate()));
+        }
+        int64_t alignment = this->get_alignment();
+        this->warmup_frame = qMax((int64_t)0, ((first_frame - overlap) / alignment) * alignment);
+        if (this->seek(this->warmup_frame) == false)
+        {
+            return false;
+        }
+    }
+    this->output_first_frame = this->get_output_frame(first_frame);
+    this->output_last_frame  = (last_frame < 0) ? -1 : this->get_output_frame(last_frame);
+    this->output_position    = this->get_output_frame(this->warmup_frame);
+    this->output_end         = this->output_first_frame;
+    this->peaks_position     = this->output_first_frame;
+
+    // Segments decoded in parallel must not share the same dither noise.
+    this->converter.set_dither_seed(this->output_first_frame);
+
+    // Position of the next decoded frame (given by the first timestamp after a seek).
+    int64_t    input_position  = (first_frame > 0) ? -1 : 0;
+    AVRational frame_time_base = { 1, (int)this->decoded_sample_rate };
+    int64_t    start_time      = (this->audio_stream->start_time != AV_NOPTS_VALUE) ? this->audio_stream->start_time : 0;
+
+    // Create a packet.
+    AVPacket packet;
+    av_init_packet(&packet);
+
+    // Read the packets in a loop
+    bool decoding_done = false;
+    bool result        = true;
+    while ((decoding_done == false) && (av_read_frame(this->format_context, &packet) == 0))
+    {
+        // Background decoding: wait while the realtime budget is tight, stop if the track is not needed anymore.
+        bool is_canceled = this->is_canceled && (this->is_canceled() == true);
+        while ((is_canceled == false) && this->must_pause && (this->must_pause() == true))
+        {
+            QThread::msleep(DECODING_PAUSE_MSEC);
+            is_canceled = this->is_canceled && (this->is_canceled() == true);
+        }
+        if (is_canceled == true)
+        {
+            decoding_done = true;
+            result        = false;
+        }
+
+        if (packet.stream_index == this->audio_stream->index)
+        {
+            // After a seek, get the exact position from the timestamp of the packet.
+            if (input_position < 0)
+            {
+                if (packet.pts == AV_NOPTS_VALUE)
+                {
+                    qCWarning(DS_FILE) << "no timestamp after seeking in" << qPrintable(this->path);
+                    decoding_done = true;
+                    result        = false;
+                }
+                else
+                {
+                    input_position = av_rescale_q(packet.pts - start_time, this->audio_stream->time_base, frame_time_base);
+                    if (input_position > this->warmup_frame)
+                    {
+                        qCWarning(DS_FILE) << "seek went too far in" << qPrintable(this->path);
+                        decoding_done = true;
+                        result        = false;
+                    }
+                }
+            }
+
+            // Try to decode the packet into a frame.
+            int frame_finished = 0;
+            if (decoding_done == false)
+            {
+                avcodec_decode_audio4(this->codec_context, this->frame, &frame_finished, &packet);
+            }
+
+            // Some frames rely on multiple packets, so we have to make sure the frame is finished before
+            // we can use it
+            if (frame_finished == 1)
+            {
+                // Frame now has usable audio data in it.
+                if (this->store_frame(input_position) == false)
+                {
+                    decoding_done = true;
+                }
+                input_position += this->frame->nb_samples;
+            }
+        }
+
+        // Cleanup packet.
+        av_free_packet(&packet);
+    }
+
+    // Some codecs will cause frames to be buffered up in the decoding process. If the CODEC_CAP_DELAY flag
+    // is set, there can be buffered up frames that need to be flushed, so we'll do that
+    if ((decoding_done == false) && (this->codec_context->codec->capabilities & CODEC_CAP_DELAY))
+    {
+        av_init_packet(&packet);
+        // Decode all the remaining frames in the buffer, until the end is reached
+        int frame_finished = 0;
+        while ((decoding_done == false) &&
+               (avcodec_decode_audio4(this->codec_context, this->frame, &frame_finished, &packet) >= 0) && frame_finished)
+        {
+            if (this->store_frame(input_position) == false)
+            {
+                decoding_done = true;
+            }
+            input_position += this->frame->nb_samples;
+        }
+    }
+
+    // Get last samples kept by the resampler.
+    if ((this->src_state != nullptr) && (decoding_done == false))
+    {
+        this->resample(nullptr, 0, true);
+    }
+
+    // Cleanup.
+    this->close();
+
+    return result;
+}
+
+bool
+Audio_file_decoding_segment::store_frame(const int64_t &input_position)
+{
+    // Drop samples decoded before the requested start (seeking gives the packet before it).
+    unsigned int nb_frames = this->frame->nb_samples;
+    unsigned int skip      = 0;
+    if (input_position + nb_frames <= this->warmup_frame)
+    {
+        return true;
+    }
+    if (input_position < this->warmup_frame)
+    {
+        skip = this->warmup_frame - input_position;
+    }
+
+    // Most of the time (not resampling, in the segment, enough space), convert directly in the track.
+    if ((!this->output_sink) &&
+        (this->src_state == nullptr) &&
+        (skip == 0) &&
+        (this->output_position >= this->output_first_frame) &&
+        ((this->output_last_frame < 0) || (this->output_position + nb_frames <= this->output_last_frame)) &&
+        ((this->output_position + nb_frames) * 2 <= this->at->get_max_nb_samples()))
+    {
+        if (this->convert_frame(nb_frames, &this->at->get_samples()[this->output_position * 2]) == false)
+        {
+            return false;
+        }
+        this->output_position += nb_frames;
+        this->output_end       = this->output_position;
+        this->update_peaks();
+
+        return true;
+    }
+
+    // Otherwise convert it in a temporary buffer.
+    if ((unsigned int)this->s16_buffer.size() < nb_frames * 2)
+    {
+        this->s16_buffer.resize(nb_frames * 2);
+    }
+    if (this->convert_frame(nb_frames, this->s16_buffer.data()) == false)
+    {
+        return false;
+    }
+
+    if (this->src_state == nullptr)
+    {
+        return this->write_output(&this->s16_buffer.data()[skip * 2], nb_frames - skip);
+    }
+    else
+    {
+        return this->resample(&this->s16_buffer.data()[skip * 2], nb_frames - skip, false);
+    }
+}
+
+bool
+Audio_file_decoding_segment::write_output(const short signed int *samples,
+                                          const unsigned int     &nb_frames)
+{
+    // Streamed output: give frames of the segment to the sink, nothing is stored in the track.
+    if (this->output_sink)
+    {
+        int64_t begin = qMax(this->output_position, this->output_first_frame);
+        int64_t end   = this->output_position + nb_frames;
+        if ((this->output_last_frame >= 0) && (end > this->output_last_frame))
+        {
+            end = this->output_last_frame;
+        }
+        bool result = true;
+        if (end > begin)
+        {
+            result = this->output_sink(&samples[(begin - this->output_position) * 2], end - begin);
+            this->output_end = end;
+        }
+        this->output_position += nb_frames;
+
+        return (result == true) &&
+               ((this->output_last_frame < 0) || (this->output_position < this->output_last_frame));
+    }
+
+    // Keep only frames which are in the segment and in the audio track buffer.
+    int64_t begin = qMax(this->output_position, this->output_first_frame);
+    int64_t end   = this->output_position + nb_frames;
+    int64_t limit = this->at->get_max_nb_samples() / 2;
+    if ((this->output_last_frame >= 0) && (this->output_last_frame < limit))
+    {
+        limit = this->output_last_frame;
+    }
+    if (end > limit)
+    {
+        end = limit;
+    }
+    if (end > begin)
+    {
+        memcpy(&this->at->get_samples()[begin * 2],
+               &samples[(begin - this->output_position) * 2],
+               (end - begin) * 2 * sizeof(short signed int));
+        this->output_end = end;
+        this->update_peaks();
+    }
+    this->output_position += nb_frames;
+
+    // Stop when the end of the segment (or of the audio track buffer) is reached.
+    return this->output_position < limit;
+}
+
+void
+Audio_file_decoding_segment::update_peaks()
+{
+    if (this->at->get_peaks() != nullptr)
+    {
+        this->peaks_position = this->at->get_peaks()->compute_bins(this->at->get_samples(), this->peaks_position, this->output_end);
+    }
+
+    return;
+}
+
+bool
+Audio_file_decoding_segment::resample(const short signed int *input,
+                                      const unsigned int     &nb_frames,
+                                      const bool             &end_of_input)
+{
+    // Resample by chunks, so the working set stays small whatever the size of the decoded frame.
+    unsigned int nb_remaining_frames = nb_frames;
+    do
+    {
+        // Prepare input chunk.
+        unsigned int nb_input_frames = qMin(nb_remaining_frames, (unsigned int)RESAMPLING_CHUNK_FRAMES);
+        src_short_to_float_array(input, this->src_input_buffer.data(), nb_input_frames * 2);
+
+        // Resample it, several passes can be necessary to consume all input samples.
+        SRC_DATA src_data;
+        src_data.data_in      = this->src_input_buffer.data();
+        src_data.input_frames = nb_input_frames;
+        src_data.src_ratio    = this->src_ratio;
+        src_data.end_of_input = ((end_of_input == true) && (nb_input_frames == nb_remaining_frames)) ? 1 : 0;
+        do
+        {
+            src_data.data_out      = this->src_output_buffer.data();
+            src_data.output_frames = RESAMPLING_CHUNK_FRAMES;
+            int error = src_process(this->src_state, &src_data);
+            if (error != 0)
+            {
+                qCWarning(DS_FILE) << "resampling failed:" << src_strerror(error);
+                return false;
+            }
+
+            // Append resampled samples to the track.
+            this->converter.flt_to_s16(this->src_output_buffer.data(), 2, src_data.output_frames_gen,
+                                       this->src_s16_output_buffer.data());
+            if (this->write_output(this->src_s16_output_buffer.data(), src_data.output_frames_gen) == false)
+            {
+                return false;
+            }
+
+            // The resampler must always progress, otherwise stop instead of looping forever.
+            if ((src_data.input_frames_used == 0) && (src_data.output_frames_gen == 0) && (src_data.end_of_input == 0))
+            {
+                qCWarning(DS_FILE) << "resampler is stuck";
+                return false;
+            }
+
+            src_data.data_in      += src_data.input_frames_used * 2;
+            src_data.input_frames -= src_data.input_frames_used;
+        }
+        while ((src_data.input_frames > 0) || ((src_data.end_of_input == 1) && (src_data.output_frames_gen > 0)));
+
+        if (input != nullptr)
+        {
+            input += nb_input_frames * 2;
+        }
+        nb_remaining_frames -= nb_input_frames;
+    }
+    while (nb_remaining_frames > 0);
+
+    return true;
+}
+
+bool
+Audio_file_decoding_segment::convert_frame(const unsigned int &nb_frames,
+                                           short signed int   *output_samples)
+{
+    const uint8_t * const    *planes      = this->frame->extended_data;
+    const unsigned short int  nb_channels = this->codec_context->channels;
+
+    switch (this->codec_context->sample_fmt)
+    {
+        case AV_SAMPLE_FMT_S16: // Interleaved data.
+            this->converter.s16_to_s16((const int16_t*)planes[0], nb_channels, nb_frames, output_samples);
+            break;
+        case AV_SAMPLE_FMT_S16P: // Planar data (one data table per channels).
+            this->converter.s16_planar_to_s16((const int16_t* const*)planes, nb_channels, nb_frames, output_samples);
+            break;
+        case AV_SAMPLE_FMT_S32:
+            this->converter.s32_to_s16((const int32_t*)planes[0], nb_channels, nb_frames, output_samples);
+            break;
+        case AV_SAMPLE_FMT_S32P:
+            this->converter.s32_planar_to_s16((const int32_t* const*)planes, nb_channels, nb_frames, output_samples);
+            break;
+        case AV_SAMPLE_FMT_FLT:
+            this->converter.flt_to_s16((const float*)planes[0], nb_channels, nb_frames, output_samples);
+            break;
+        case AV_SAMPLE_FMT_FLTP: // Output of most of the lossy decoders (mp3, aac, vorbis, opus).
+            this->converter.flt_planar_to_s16((const float* const*)planes, nb_channels, nb_frames, output_samples);
+            break;
+        case AV_SAMPLE_FMT_DBL:
+            this->converter.dbl_to_s16((const double*)planes[0], nb_channels, nb_frames, output_samples);
+            break;
+        case AV_SAMPLE_FMT_DBLP:
+            this->converter.dbl_planar_to_s16((const double* const*)planes, nb_channels, nb_frames, output_samples);
+            break;
+        default: // Non recognized byte format.
+            qCWarning(DS_FILE) << "audio byte format not supported" << qPrintable(this->path);
+            return false;
+    }
+
+    return true;
+}
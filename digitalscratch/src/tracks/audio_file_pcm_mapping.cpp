@@ -0,0 +1,369 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*---------------------------------------------( audio_file_pcm_mapping.cpp )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: read uncompressed audio files (WAV, AIFF) without         */
+/*                  decoding, samples are mapped or converted in one pass.    */
+/*                                                                            */
+/*============================================================================*/
+
+#include <QtDebug>
+#include <QtEndian>
+#include <cmath>
+#include <cstring>
+#include <climits>
+
+#include "app/application_logging.h"
+#include "tracks/audio_file_pcm_mapping.h"
+
+#define WAVE_FORMAT_PCM        0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+Audio_file_pcm_mapping::Audio_file_pcm_mapping()
+{
+    this->file_data     = nullptr;
+    this->sample_format = Pcm_sample_format::UNSUPPORTED;
+    this->nb_channels   = 0;
+    this->sample_rate   = 0;
+    this->nb_frames     = 0;
+    this->data_offset   = 0;
+
+    return;
+}
+
+Audio_file_pcm_mapping::~Audio_file_pcm_mapping()
+{
+    this->close();
+
+    return;
+}
+
+void
+Audio_file_pcm_mapping::close()
+{
+    // The file is unmapped when the last user (this object or an audio track) releases it.
+    this->file.clear();
+    this->file_data = nullptr;
+
+    return;
+}
+
+bool
+Audio_file_pcm_mapping::open(const QString &path)
+{
+    this->close();
+
+    // Only look at files with a RIFF/WAVE or AIFF header.
+    this->file = QSharedPointer<QFile>(new QFile(path));
+    if (this->file->open(QIODevice::ReadOnly) == false)
+    {
+        this->close();
+        return false;
+    }
+    QByteArray magic = this->file->peek(12);
+    bool is_wav  = magic.startsWith("RIFF") && (magic.mid(8, 4) == "WAVE");
+    bool is_aiff = magic.startsWith("FORM") && ((magic.mid(8, 4) == "AIFF") || (magic.mid(8, 4) == "AIFC"));
+    if ((is_wav == false) && (is_aiff == false))
+    {
+        this->close();
+        return false;
+    }
+
+    // Map the file (pages are only read when used, private so the mapping can never change the file).
+    qint64 file_size = this->file->size();
+    this->file_data  = this->file->map(0, file_size, QFileDevice::MapPrivateOption);
+    if (this->file_data == nullptr)
+    {
+        qCWarning(DS_FILE) << "can not map" << qPrintable(path);
+        this->close();
+        return false;
+    }
+
+    bool result = false;
+    if (is_wav == true)
+    {
+        result = this->parse_wav(file_size);
+    }
+    else
+    {
+        result = this->parse_aiff(file_size);
+    }
+    if (result == false)
+    {
+        this->close();
+        return false;
+    }
+
+    qCDebug(DS_FILE) << qPrintable(path) << ":" << this->sample_rate << "Hz," << this->nb_channels << "ch, not decoded";
+
+    return true;
+}
+
+unsigned int
+Audio_file_pcm_mapping::get_sample_rate()
+{
+    return this->sample_rate;
+}
+
+bool
+Audio_file_pcm_mapping::parse_wav(const qint64 &file_size)
+{
+    unsigned short int format_tag      = 0;
+    unsigned short int nb_channels     = 0;
+    unsigned int       sample_rate     = 0;
+    unsigned short int bits_per_sample = 0;
+    unsigned short int block_align     = 0;
+    bool               has_format      = false;
+
+    // Little endian chunks (id, size, data) after "RIFF" size "WAVE".
+    qint64 position = 12;
+    while (position + 8 <= file_size)
+    {
+        const uchar *chunk      = &this->file_data[position];
+        qint64       chunk_size = qFromLittleEndian<quint32>(&chunk[4]);
+        position += 8;
+
+        if ((memcmp(chunk, "fmt ", 4) == 0) && (chunk_size >= 16) && (position + chunk_size <= file_size))
+        {
+            const uchar *format = &chunk[8];
+            format_tag      = qFromLittleEndian<quint16>(&format[0]);
+            nb_channels     = qFromLittleEndian<quint16>(&format[2]);
+            sample_rate     = qFromLittleEndian<quint32>(&format[4]);
+            block_align     = qFromLittleEndian<quint16>(&format[12]);
+            bits_per_sample = qFromLittleEndian<quint16>(&format[14]);
+            if ((format_tag == WAVE_FORMAT_EXTENSIBLE) && (chunk_size >= 40))
+            {
+                // Real format is the beginning of the sub format GUID.
+                format_tag = qFromLittleEndian<quint16>(&format[24]);
+            }
+            has_format = true;
+        }
+        else if ((memcmp(chunk, "data", 4) == 0) && (has_format == true))
+        {
+            // Size can be wrong (or unknown) for files which were recorded in a stream.
+            qint64 data_size = qMin(chunk_size, file_size - position);
+            if ((nb_channels == 0) || (block_align != nb_channels * (bits_per_sample / 8)))
+            {
+                return false;
+            }
+
+            Pcm_sample_format sample_format = Pcm_sample_format::UNSUPPORTED;
+            if (format_tag == WAVE_FORMAT_PCM)
+            {
+                switch (bits_per_sample)
+                {
+                    case 16: sample_format = Pcm_sample_format::S16;        break;
+                    case 24: sample_format = Pcm_sample_format::S24_PACKED; break;
+                    case 32: sample_format = Pcm_sample_format::S32;        break;
+                }
+            }
+            else if (format_tag == WAVE_FORMAT_IEEE_FLOAT)
+            {
+                switch (bits_per_sample)
+                {
+                    case 32: sample_format = Pcm_sample_format::FLOAT;  break;
+                    case 64: sample_format = Pcm_sample_format::DOUBLE; break;
+                }
+            }
+
+            return this->set_format(sample_format, nb_channels, sample_rate, position, data_size);
+        }
+
+        // Chunks are word aligned.
+        position += chunk_size + (chunk_size & 1);
+    }
+
+    return false;
+}
+
+bool
+Audio_file_pcm_mapping::parse_aiff(const qint64 &file_size)
+{
+    bool               is_aifc         = (memcmp(&this->file_data[8], "AIFC", 4) == 0);
+    unsigned short int nb_channels     = 0;
+    unsigned int       nb_frames       = 0;
+    unsigned short int bits_per_sample = 0;
+    unsigned int       sample_rate     = 0;
+    bool               is_swapped      = true;
+    bool               has_format      = false;
+
+    // Big endian chunks (id, size, data) after "FORM" size "AIFF".
+    qint64 position = 12;
+    while (position + 8 <= file_size)
+    {
+        const uchar *chunk      = &this->file_data[position];
+        qint64       chunk_size = qFromBigEndian<quint32>(&chunk[4]);
+        position += 8;
+
+        if ((memcmp(chunk, "COMM", 4) == 0) && (chunk_size >= 18) && (position + chunk_size <= file_size))
+        {
+            const uchar *common = &chunk[8];
+            nb_channels     = qFromBigEndian<quint16>(&common[0]);
+            nb_frames       = qFromBigEndian<quint32>(&common[2]);
+            bits_per_sample = qFromBigEndian<quint16>(&common[6]);
+
+            // Sample rate is a 80 bits extended float: 15 bits exponent and 64 bits mantissa.
+            int     exponent = (qFromBigEndian<quint16>(&common[8]) & 0x7FFF) - 16383 - 63;
+            quint64 mantissa = qFromBigEndian<quint64>(&common[10]);
+            sample_rate = (unsigned int)ldexp((double)mantissa, exponent);
+
+            // AIFF-C: only uncompressed formats.
+            if ((is_aifc == true) && (chunk_size >= 22))
+            {
+                if (memcmp(&common[18], "sowt", 4) == 0)
+                {
+                    is_swapped = false; // Little endian samples.
+                }
+                else if (memcmp(&common[18], "NONE", 4) != 0)
+                {
+                    return false;
+                }
+            }
+            has_format = true;
+        }
+        else if ((memcmp(chunk, "SSND", 4) == 0) && (has_format == true) && (chunk_size >= 8))
+        {
+            // Samples start after an offset and block size.
+            qint64 offset    = qFromBigEndian<quint32>(&chunk[8]);
+            qint64 data_size = qMin(chunk_size - 8 - offset, file_size - position - 8 - offset);
+            data_size = qMin(data_size, (qint64)nb_frames * nb_channels * (bits_per_sample / 8));
+
+            Pcm_sample_format sample_format = Pcm_sample_format::UNSUPPORTED;
+            if (bits_per_sample == 16)
+            {
+                sample_format = (is_swapped == true) ? Pcm_sample_format::S16_SWAPPED : Pcm_sample_format::S16;
+            }
+
+            return this->set_format(sample_format, nb_channels, sample_rate, position + 8 + offset, data_size);
+        }
+
+        // Chunks are word aligned.
+        position += chunk_size + (chunk_size & 1);
+    }
+
+    return false;
+}
+
+bool
+Audio_file_pcm_mapping::set_format(const Pcm_sample_format  &sample_format,
+                                   const unsigned short int &nb_channels,
+                                   const unsigned int       &sample_rate,
+                                   const qint64             &data_offset,
+                                   const qint64             &data_size)
+{
+    // Other formats (8 bits, big endian 24 bits, compressed AIFF-C,...) are decoded.
+    if ((sample_format == Pcm_sample_format::UNSUPPORTED) || (nb_channels == 0) || (sample_rate == 0) || (data_size <= 0))
+    {
+        return false;
+    }
+
+    // Samples must be aligned to be read as numbers.
+    unsigned int sample_size = 2;
+    switch (sample_format)
+    {
+        case Pcm_sample_format::S24_PACKED: sample_size = 1; break;
+        case Pcm_sample_format::S32:
+        case Pcm_sample_format::FLOAT:      sample_size = 4; break;
+        case Pcm_sample_format::DOUBLE:     sample_size = 8; break;
+        default:                            sample_size = 2; break;
+    }
+    if ((quintptr)&this->file_data[data_offset] % sample_size != 0)
+    {
+        return false;
+    }
+
+    unsigned int frame_size = nb_channels * ((sample_format == Pcm_sample_format::S24_PACKED) ? 3 : sample_size);
+    this->sample_format = sample_format;
+    this->nb_channels   = nb_channels;
+    this->sample_rate   = sample_rate;
+    this->data_offset   = data_offset;
+    this->nb_frames     = (unsigned int)qMin(data_size / frame_size, (qint64)UINT_MAX);
+
+    return true;
+}
+
+bool
+Audio_file_pcm_mapping::load(const QSharedPointer<Audio_track> &at,
+                             const bool                        &do_resample)
+{
+    if (this->file_data == nullptr)
+    {
+        return false;
+    }
+
+    // Resampling is done by the decoding process.
+    if ((do_resample == true) && (this->sample_rate != at->get_sample_rate()))
+    {
+        return false;
+    }
+
+    unsigned int nb_frames = qMin(this->nb_frames, at->get_max_nb_samples() / 2);
+    const uchar *data      = &this->file_data[this->data_offset];
+
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    // Same format as the internal one: the track directly uses samples of the file.
+    if ((this->sample_format == Pcm_sample_format::S16) && (this->nb_channels == 2))
+    {
+        bool result = at->set_mapped_samples(this->file, (short signed int*)data, nb_frames * 2);
+        this->close();
+        return result;
+    }
+#endif
+
+    // Otherwise convert all samples in the track in one pass.
+    short signed int *samples = at->get_samples();
+    switch (this->sample_format)
+    {
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        case Pcm_sample_format::S16:
+            this->converter.s16_to_s16((const int16_t*)data, this->nb_channels, nb_frames, samples);
+            break;
+        case Pcm_sample_format::S16_SWAPPED:
+            this->converter.s16_swapped_to_s16((const int16_t*)data, this->nb_channels, nb_frames, samples);
+            break;
+        case Pcm_sample_format::S24_PACKED:
+            this->converter.s24_packed_to_s16((const uint8_t*)data, this->nb_channels, nb_frames, samples);
+            break;
+        case Pcm_sample_format::S32:
+            this->converter.s32_to_s16((const int32_t*)data, this->nb_channels, nb_frames, samples);
+            break;
+        case Pcm_sample_format::FLOAT:
+            this->converter.flt_to_s16((const float*)data, this->nb_channels, nb_frames, samples);
+            break;
+        case Pcm_sample_format::DOUBLE:
+            this->converter.dbl_to_s16((const double*)data, this->nb_channels, nb_frames, samples);
+            break;
+#endif
+        default:
+            this->close();
+            return false;
+    }
+    this->close();
+
+    return at->set_end_of_samples(nb_frames * 2);
+}
@@ -0,0 +1,461 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*---------------------------------------------( audio_sample_converter.cpp )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: convert decoded samples (planar or interleaved, integer   */
+/*                  or floating point) to the internal interleaved stereo     */
+/*                  16 bits format.                                           */
+/*                                                                            */
+/*============================================================================*/
+
+#include <cstring>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "tracks/audio_sample_converter.h"
+
+#define SCALE_FLOAT_TO_S16 32768.0f               // [-1.0, 1.0] floating point samples to 16 bits.
+#define SCALE_S32_TO_S16   (1.0f / 65536.0f)      // 32 bits integer samples to 16 bits.
+#define SCALE_S24_TO_S16   (1.0f / 256.0f)        // 24 bits integer samples to 16 bits.
+#define DITHER_UNIT        (1.0f / 16777216.0f)   // 24 random bits to [0.0, 1.0[.
+
+#ifdef __SSE2__
+// Load 4 samples as float.
+static inline __m128 load_4_as_float(const float *in)
+{
+    return _mm_loadu_ps(in);
+}
+
+static inline __m128 load_4_as_float(const int32_t *in)
+{
+    return _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)));
+}
+
+static inline __m128 load_4_as_float(const double *in)
+{
+    return _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(in)), _mm_cvtpd_ps(_mm_loadu_pd(in + 2)));
+}
+
+// Xorshift random generator on 4 lanes.
+static inline __m128i xorshift_4(__m128i state)
+{
+    state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+    state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+    state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+
+    return state;
+}
+
+// Triangular noise (sum of 2 uniform noises) in [-1.0, 1.0[.
+static inline __m128 tpdf_4(__m128i &state)
+{
+    state = xorshift_4(state);
+    __m128 noise_1 = _mm_cvtepi32_ps(_mm_srli_epi32(state, 8));
+    state = xorshift_4(state);
+    __m128 noise_2 = _mm_cvtepi32_ps(_mm_srli_epi32(state, 8));
+
+    return _mm_mul_ps(_mm_sub_ps(noise_1, noise_2), _mm_set1_ps(DITHER_UNIT));
+}
+
+// Put NaN to 0 and saturate 4 samples to 16 bits (as the scalar path, _mm_cvtps_epi32() would give INT_MIN for them).
+static inline __m128 clamp_4_to_s16(__m128 a)
+{
+    a = _mm_and_ps(a, _mm_cmpord_ps(a, a));
+
+    return _mm_min_ps(_mm_max_ps(a, _mm_set1_ps(-32768.0f)), _mm_set1_ps(32767.0f));
+}
+
+// Round and saturate 8 samples (already scaled to 16 bits) and store them.
+static inline void store_8_as_s16(__m128 a, __m128 b, const bool &do_dither, __m128i &state, int16_t *out)
+{
+    if (do_dither == true)
+    {
+        a = _mm_add_ps(a, tpdf_4(state));
+        b = _mm_add_ps(b, tpdf_4(state));
+    }
+    a = clamp_4_to_s16(a);
+    b = clamp_4_to_s16(b);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+}
+#endif
+
+Audio_sample_converter::Audio_sample_converter()
+{
+    // Seeds of the dither generators (must not be 0).
+    this->dither_state[0] = 0x9E3779B9;
+    this->dither_state[1] = 0x7F4A7C15;
+    this->dither_state[2] = 0x85EBCA6B;
+    this->dither_state[3] = 0xC2B2AE35;
+    this->do_dither       = true;
+
+    return;
+}
+
+Audio_sample_converter::~Audio_sample_converter()
+{
+    return;
+}
+
+void
+Audio_sample_converter::set_dither(const bool &do_dither)
+{
+    this->do_dither = do_dither;
+
+    return;
+}
+
+void
+Audio_sample_converter::set_dither_seed(const uint64_t &seed)
+{
+    // Splitmix64, so close seeds (e.g. positions in the track) give unrelated generators.
+    uint64_t value = seed;
+    for (unsigned short int i = 0; i < 4; i++)
+    {
+        value += 0x9E3779B97F4A7C15ULL;
+        uint64_t z = value;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        z = z ^ (z >> 31);
+        this->dither_state[i] = (uint32_t)z;
+        if (this->dither_state[i] == 0) // Xorshift would stay at 0.
+        {
+            this->dither_state[i] = 0x9E3779B9;
+        }
+    }
+
+    return;
+}
+
+float
+Audio_sample_converter::next_dither()
+{
+    uint32_t state = this->dither_state[0];
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    float noise_1 = (float)(state >> 8);
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    float noise_2 = (float)(state >> 8);
+    this->dither_state[0] = state;
+
+    return (noise_1 - noise_2) * DITHER_UNIT;
+}
+
+int16_t
+Audio_sample_converter::to_s16(const float &value)
+{
+    float sample = value;
+    if (this->do_dither == true)
+    {
+        sample += this->next_dither();
+    }
+    if (sample != sample) // NaN (same result as the SIMD path).
+    {
+        return 0;
+    }
+    sample = nearbyintf(sample);
+
+    if (sample > 32767.0f)
+    {
+        return 32767;
+    }
+    else if (sample < -32768.0f)
+    {
+        return -32768;
+    }
+
+    return (int16_t)sample;
+}
+
+template <typename T>
+void
+Audio_sample_converter::interleaved_to_s16(const T                  *in_samples,
+                                           const unsigned short int &nb_channels,
+                                           const unsigned int       &nb_frames,
+                                           const float              &scale,
+                                           int16_t                  *out_samples)
+{
+    unsigned int i = 0;
+
+    if (nb_channels == 2)
+    {
+        // Interleaved stereo: it is only a conversion of a flat table of samples.
+        unsigned int nb_samples = nb_frames * 2;
+#ifdef __SSE2__
+        __m128  scale_4 = _mm_set1_ps(scale);
+        __m128i state   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(this->dither_state));
+        for (; i + 8 <= nb_samples; i += 8)
+        {
+            store_8_as_s16(_mm_mul_ps(load_4_as_float(&in_samples[i]),     scale_4),
+                           _mm_mul_ps(load_4_as_float(&in_samples[i + 4]), scale_4),
+                           this->do_dither, state, &out_samples[i]);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(this->dither_state), state);
+#endif
+        for (; i < nb_samples; i++)
+        {
+            out_samples[i] = this->to_s16((float)in_samples[i] * scale);
+        }
+    }
+    else
+    {
+        // Mono or multichannel: keep 2 first channels.
+        unsigned short int right = (nb_channels > 1) ? 1 : 0;
+        for (; i < nb_frames; i++)
+        {
+            out_samples[i * 2]     = this->to_s16((float)in_samples[i * nb_channels] * scale);
+            out_samples[i * 2 + 1] = this->to_s16((float)in_samples[i * nb_channels + right] * scale);
+        }
+    }
+
+    return;
+}
+
+template <typename T>
+void
+Audio_sample_converter::planar_to_s16(const T * const          *in_planes,
+                                      const unsigned short int &nb_channels,
+                                      const unsigned int       &nb_frames,
+                                      const float              &scale,
+                                      int16_t                  *out_samples)
+{
+    // Mono is duplicated on both channels.
+    const T *left  = in_planes[0];
+    const T *right = (nb_channels > 1) ? in_planes[1] : in_planes[0];
+    unsigned int i = 0;
+
+#ifdef __SSE2__
+    // Convert 4 frames of each channel and interleave them.
+    __m128  scale_4 = _mm_set1_ps(scale);
+    __m128i state   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(this->dither_state));
+    for (; i + 4 <= nb_frames; i += 4)
+    {
+        __m128 left_4  = _mm_mul_ps(load_4_as_float(&left[i]),  scale_4);
+        __m128 right_4 = _mm_mul_ps(load_4_as_float(&right[i]), scale_4);
+        store_8_as_s16(_mm_unpacklo_ps(left_4, right_4),
+                       _mm_unpackhi_ps(left_4, right_4),
+                       this->do_dither, state, &out_samples[i * 2]);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(this->dither_state), state);
+#endif
+    for (; i < nb_frames; i++)
+    {
+        out_samples[i * 2]     = this->to_s16((float)left[i]  * scale);
+        out_samples[i * 2 + 1] = this->to_s16((float)right[i] * scale);
+    }
+
+    return;
+}
+
+void
+Audio_sample_converter::s16_to_s16(const int16_t            *in_samples,
+                                   const unsigned short int &nb_channels,
+                                   const unsigned int       &nb_frames,
+                                   int16_t                  *out_samples)
+{
+    if (nb_channels == 2)
+    {
+        // Already in the internal format.
+        memcpy(out_samples, in_samples, nb_frames * 2 * sizeof(int16_t));
+    }
+    else
+    {
+        // Mono or multichannel: keep 2 first channels.
+        unsigned short int right = (nb_channels > 1) ? 1 : 0;
+        for (unsigned int i = 0; i < nb_frames; i++)
+        {
+            out_samples[i * 2]     = in_samples[i * nb_channels];
+            out_samples[i * 2 + 1] = in_samples[i * nb_channels + right];
+        }
+    }
+
+    return;
+}
+
+void
+Audio_sample_converter::s16_planar_to_s16(const int16_t * const    *in_planes,
+                                          const unsigned short int &nb_channels,
+                                          const unsigned int       &nb_frames,
+                                          int16_t                  *out_samples)
+{
+    // Mono is duplicated on both channels.
+    const int16_t *left  = in_planes[0];
+    const int16_t *right = (nb_channels > 1) ? in_planes[1] : in_planes[0];
+    unsigned int i = 0;
+
+#ifdef __SSE2__
+    // Interleave 8 frames at a time.
+    for (; i + 8 <= nb_frames; i += 8)
+    {
+        __m128i left_8  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&left[i]));
+        __m128i right_8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&right[i]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&out_samples[i * 2]),     _mm_unpacklo_epi16(left_8, right_8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&out_samples[i * 2 + 8]), _mm_unpackhi_epi16(left_8, right_8));
+    }
+#endif
+    for (; i < nb_frames; i++)
+    {
+        out_samples[i * 2]     = left[i];
+        out_samples[i * 2 + 1] = right[i];
+    }
+
+    return;
+}
+
+void
+Audio_sample_converter::s16_swapped_to_s16(const int16_t            *in_samples,
+                                           const unsigned short int &nb_channels,
+                                           const unsigned int       &nb_frames,
+                                           int16_t                  *out_samples)
+{
+    unsigned int i = 0;
+
+    if (nb_channels == 2)
+    {
+        // Interleaved stereo: only swap bytes of a flat table of samples.
+        unsigned int nb_samples = nb_frames * 2;
+#ifdef __SSE2__
+        for (; i + 8 <= nb_samples; i += 8)
+        {
+            __m128i samples_8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in_samples[i]));
+            samples_8 = _mm_or_si128(_mm_slli_epi16(samples_8, 8), _mm_srli_epi16(samples_8, 8));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(&out_samples[i]), samples_8);
+        }
+#endif
+        for (; i < nb_samples; i++)
+        {
+            uint16_t sample = (uint16_t)in_samples[i];
+            out_samples[i]  = (int16_t)((sample << 8) | (sample >> 8));
+        }
+    }
+    else
+    {
+        // Mono or multichannel: keep 2 first channels.
+        unsigned short int right = (nb_channels > 1) ? 1 : 0;
+        for (; i < nb_frames; i++)
+        {
+            uint16_t left_sample  = (uint16_t)in_samples[i * nb_channels];
+            uint16_t right_sample = (uint16_t)in_samples[i * nb_channels + right];
+            out_samples[i * 2]     = (int16_t)((left_sample << 8)  | (left_sample >> 8));
+            out_samples[i * 2 + 1] = (int16_t)((right_sample << 8) | (right_sample >> 8));
+        }
+    }
+
+    return;
+}
+
+void
+Audio_sample_converter::s24_packed_to_s16(const uint8_t            *in_samples,
+                                          const unsigned short int &nb_channels,
+                                          const unsigned int       &nb_frames,
+                                          int16_t                  *out_samples)
+{
+    // Keep 2 first channels (mono is duplicated).
+    unsigned int frame_size = nb_channels * 3;
+    unsigned int right      = (nb_channels > 1) ? 3 : 0;
+    for (unsigned int i = 0; i < nb_frames; i++)
+    {
+        const uint8_t *frame = &in_samples[i * frame_size];
+        int32_t left_sample  = (int32_t)(((uint32_t)frame[0] << 8) | ((uint32_t)frame[1] << 16) | ((uint32_t)frame[2] << 24)) >> 8;
+        int32_t right_sample = (int32_t)(((uint32_t)frame[right] << 8) | ((uint32_t)frame[right + 1] << 16) | ((uint32_t)frame[right + 2] << 24)) >> 8;
+        out_samples[i * 2]     = this->to_s16((float)left_sample  * SCALE_S24_TO_S16);
+        out_samples[i * 2 + 1] = this->to_s16((float)right_sample * SCALE_S24_TO_S16);
+    }
+
+    return;
+}
+
+void
+Audio_sample_converter::s32_to_s16(const int32_t            *in_samples,
+                                   const unsigned short int &nb_channels,
+                                   const unsigned int       &nb_frames,
+                                   int16_t                  *out_samples)
+{
+    this->interleaved_to_s16(in_samples, nb_channels, nb_frames, SCALE_S32_TO_S16, out_samples);
+
+    return;
+}
+
+void
+Audio_sample_converter::s32_planar_to_s16(const int32_t * const    *in_planes,
+                                          const unsigned short int &nb_channels,
+                                          const unsigned int       &nb_frames,
+                                          int16_t                  *out_samples)
+{
+    this->planar_to_s16(in_planes, nb_channels, nb_frames, SCALE_S32_TO_S16, out_samples);
+
+    return;
+}
+
+void
+Audio_sample_converter::flt_to_s16(const float              *in_samples,
+                                   const unsigned short int &nb_channels,
+                                   const unsigned int       &nb_frames,
+                                   int16_t                  *out_samples)
+{
+    this->interleaved_to_s16(in_samples, nb_channels, nb_frames, SCALE_FLOAT_TO_S16, out_samples);
+
+    return;
+}
+
+void
+Audio_sample_converter::flt_planar_to_s16(const float * const      *in_planes,
+                                          const unsigned short int &nb_channels,
+                                          const unsigned int       &nb_frames,
+                                          int16_t                  *out_samples)
+{
+    this->planar_to_s16(in_planes, nb_channels, nb_frames, SCALE_FLOAT_TO_S16, out_samples);
+
+    return;
+}
+
+void
+Audio_sample_converter::dbl_to_s16(const double             *in_samples,
+                                   const unsigned short int &nb_channels,
+                                   const unsigned int       &nb_frames,
+                                   int16_t                  *out_samples)
+{
+    this->interleaved_to_s16(in_samples, nb_channels, nb_frames, SCALE_FLOAT_TO_S16, out_samples);
+
+    return;
+}
+
+void
+Audio_sample_converter::dbl_planar_to_s16(const double * const     *in_planes,
+                                          const unsigned short int &nb_channels,
+                                          const unsigned int       &nb_frames,
+                                          int16_t                  *out_samples)
+{
+    this->planar_to_s16(in_planes, nb_channels, nb_frames, SCALE_FLOAT_TO_S16, out_samples);
+
+    return;
+}
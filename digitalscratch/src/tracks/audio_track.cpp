@@ -32,12 +32,18 @@
 
 
 #include <iostream>
+#include <utility>
+#include <cstdlib>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <QFileInfo>
 #include <QtDebug>
 #include <QDir>
 
 #include "tracks/audio_track.h"
+#include "app/job_scheduler.h"
 #include "app/application_logging.h"
+#include "singleton.h"
 #include "utils.h"
 
 Audio_track::Audio_track(const unsigned int &sample_rate)
@@ -46,6 +52,10 @@ Audio_track::Audio_track(const unsigned int &sample_rate)
     this->sample_rate = sample_rate;
     this->max_nb_samples = 0;
     this->samples = nullptr;
+    this->mapped_samples = nullptr;
+    this->mapped_nb_samples = 0;
+    this->max_used_samples = 0;
+    this->peaks = nullptr;
     this->reset();
 
     return;
@@ -58,7 +68,13 @@ Audio_track::Audio_track(const short unsigned int &max_minutes,
     this->sample_rate = sample_rate;
     this->max_nb_samples = max_minutes * 2 * 60 * this->sample_rate;
     // Add also several seconds more, which is used to put more infos in decoding step.
-    this->samples = new short signed int[this->max_nb_samples + this->get_security_nb_samples()];
+    // The table is zeroed by the system page by page when first used, so only the memory needed
+    // by the decoded track is really taken (a table of MAX_MINUTES_TRACK is kept by each deck and prefetch slot).
+    this->samples = static_cast<short signed int*>(calloc(this->max_nb_samples + this->get_security_nb_samples(), sizeof(short signed int)));
+    this->mapped_samples = nullptr;
+    this->mapped_nb_samples = 0;
+    this->max_used_samples = 0;
+    this->peaks = new Audio_track_peaks(this->max_nb_samples / 2);
     this->reset();
 
     return;
@@ -66,7 +82,8 @@ Audio_track::Audio_track(const short unsigned int &max_minutes,
 
 Audio_track::~Audio_track()
 {
-    delete [] this->samples;
+    free(this->samples);
+    delete this->peaks;
 
     return;
 }
@@ -82,17 +99,84 @@ Audio_track::reset()
     this->filename       = "";
     this->music_key      = "";
     this->music_key_tag  = "";
+    this->bpm            = 0.0;
+    this->first_beat     = 0;
+    this->loudness       = 0.0;
+    this->analyzed       = false;
+    for (int i = 0; i < MAX_NB_CUE_POINTS; i++)
+    {
+        this->cue_points[i] = 0;
+    }
+    this->tags.clear();
+
+    // Release mapped file.
+    if (this->mapped_samples != nullptr)
+    {
+        this->unlock_mapped_samples();
+    }
+    this->mapped_samples = nullptr;
+    this->mapped_nb_samples = 0;
+    this->mapped_file.clear();
+
+    // Clear only the part of the table used by the previous track (and the security area after it).
     if (this->samples != nullptr)
     {
-        memset(&this->samples[0], 0, (this->max_nb_samples + this->get_security_nb_samples()) * sizeof this->samples[0]);
+        memset(&this->samples[0], 0, (this->max_used_samples + this->get_security_nb_samples()) * sizeof this->samples[0]);
+    }
+    this->max_used_samples = 0;
+    if (this->peaks != nullptr)
+    {
+        this->peaks->reset();
     }
 
     return;
 }
 
+bool
+Audio_track::swap(Audio_track &other)
+{
+    // Both tracks must be able to hold the same amount of samples.
+    if ((this->samples == nullptr) || (other.samples == nullptr) ||
+        (this->max_nb_samples != other.max_nb_samples) ||
+        (this->sample_rate != other.sample_rate))
+    {
+        qCWarning(DS_PLAYBACK) << "can not swap tracks of different size";
+        return false;
+    }
+
+    // Exchange table of samples (no copy) and all track infos.
+    std::swap(this->samples,          other.samples);
+    std::swap(this->mapped_samples,   other.mapped_samples);
+    std::swap(this->mapped_file,      other.mapped_file);
+    std::swap(this->mapped_nb_samples, other.mapped_nb_samples);
+    std::swap(this->end_of_samples,   other.end_of_samples);
+    std::swap(this->max_used_samples, other.max_used_samples);
+    std::swap(this->peaks,            other.peaks);
+    std::swap(this->length,         other.length);
+    std::swap(this->name,           other.name);
+    std::swap(this->path,           other.path);
+    std::swap(this->filename,       other.filename);
+    std::swap(this->hash,           other.hash);
+    std::swap(this->music_key,      other.music_key);
+    std::swap(this->music_key_tag,  other.music_key_tag);
+    std::swap(this->bpm,            other.bpm);
+    std::swap(this->first_beat,     other.first_beat);
+    std::swap(this->loudness,       other.loudness);
+    std::swap(this->analyzed,       other.analyzed);
+    std::swap(this->cue_points,     other.cue_points);
+    std::swap(this->tags,           other.tags);
+
+    return true;
+}
+
 short signed int*
 Audio_track::get_samples() const
 {
+    if (this->mapped_samples != nullptr)
+    {
+        return this->mapped_samples;
+    }
+
     return this->samples;
 }
 
@@ -116,6 +200,10 @@ Audio_track::set_end_of_samples(const unsigned int &end_of_samples)
         {
             // Set end of sample index.
             this->end_of_samples = end_of_samples;
+            if ((this->mapped_samples == nullptr) && (end_of_samples > this->max_used_samples))
+            {
+                this->max_used_samples = end_of_samples;
+            }
 
             // Set length of the track.
             this->length = (unsigned int)(1000.0 * ((float)this->end_of_samples + 1.0) / (2.0 * (float)this->sample_rate));
@@ -129,6 +217,117 @@ Audio_track::set_end_of_samples(const unsigned int &end_of_samples)
     return true;
 }
 
+bool
+Audio_track::set_mapped_samples(const QSharedPointer<QFile> &file,
+                                short signed int            *samples,
+                                const unsigned int          &nb_samples)
+{
+    if ((this->samples == nullptr) || (samples == nullptr))
+    {
+        return false;
+    }
+
+    unsigned int nb_used_samples = qMin(nb_samples, this->max_nb_samples);
+
+    // The playback thread must never wait for a page fault (or get a SIGBUS if the file changes on disk).
+    // All pages are loaded and locked now. The mapping is private and writable, so locking it gives
+    // the process its own copy of each page.
+    // Samples are not copied, the file stays mapped until next reset.
+    this->mapped_samples    = samples;
+    this->mapped_nb_samples = nb_used_samples;
+    this->mapped_file       = file;
+    if (this->lock_mapped_samples(nb_used_samples) == false)
+    {
+        // Not allowed to lock that much memory (RLIMIT_MEMLOCK, see INSTALL): lock only the beginning of the track,
+        // where playback starts, and load the other pages in background (they are not locked, so they can
+        // be swapped out under memory pressure).
+        unsigned int nb_head_samples = qMin(nb_used_samples, MAPPED_LOCKED_HEAD_SEC * 2 * this->sample_rate);
+        if (this->lock_mapped_samples(nb_head_samples) == false)
+        {
+            nb_head_samples = 0;
+        }
+        qCWarning(DS_PLAYBACK) << "can not lock all mapped samples (memlock limit too low), locked:"
+                               << nb_head_samples / (2 * this->sample_rate) << "sec of" << nb_used_samples / (2 * this->sample_rate);
+        this->fault_mapped_samples(nb_head_samples);
+    }
+
+    return this->set_end_of_samples(nb_used_samples);
+}
+
+bool
+Audio_track::lock_mapped_samples(const unsigned int &nb_samples)
+{
+    // Lock whole pages containing the samples.
+    uintptr_t page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t begin     = (uintptr_t)this->mapped_samples & ~(page_size - 1);
+    uintptr_t end       = (uintptr_t)(this->mapped_samples + nb_samples);
+
+    return mlock((void*)begin, end - begin) == 0;
+}
+
+void
+Audio_track::fault_mapped_samples(const unsigned int &from_sample)
+{
+    if (from_sample >= this->mapped_nb_samples)
+    {
+        return;
+    }
+
+    // Write each page once (with its own value) to get the private copy of the page, as mlock would do.
+    // The job only keeps a weak reference on the file: it stops as soon as the track releases the mapping.
+    QWeakPointer<QFile> weak_file = this->mapped_file.toWeakRef();
+    uintptr_t           page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t           begin     = (uintptr_t)(this->mapped_samples + from_sample) & ~(page_size - 1);
+    uintptr_t           end       = (uintptr_t)(this->mapped_samples + this->mapped_nb_samples);
+    Singleton<Job_scheduler>::get_instance().run<bool>(Job_priority::PREFETCH, [weak_file, page_size, begin, end]()
+    {
+        for (uintptr_t page = begin; page < end; page += page_size * MAPPED_FAULT_NB_PAGES)
+        {
+            while (Singleton<Job_scheduler>::get_instance().must_pause_current_job() == true)
+            {
+                QThread::msleep(JOB_PAUSE_MSEC);
+            }
+            QSharedPointer<QFile> file = weak_file.toStrongRef();
+            if (file.isNull() == true)
+            {
+                return false;
+            }
+            for (uintptr_t p = page; (p < end) && (p < page + page_size * MAPPED_FAULT_NB_PAGES); p += page_size)
+            {
+                volatile char *c = (volatile char*)p;
+                *c = *c;
+            }
+        }
+
+        return true;
+    });
+
+    return;
+}
+
+void
+Audio_track::unlock_mapped_samples()
+{
+    uintptr_t page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t begin     = (uintptr_t)this->mapped_samples & ~(page_size - 1);
+    uintptr_t end       = (uintptr_t)(this->mapped_samples + this->mapped_nb_samples);
+    munlock((void*)begin, end - begin);
+
+    return;
+}
+
+bool
+Audio_track::is_mapped() const
+{
+    return this->mapped_samples != nullptr;
+}
+
+Audio_track_peaks*
+Audio_track::get_peaks() const
+{
+    return this->peaks;
+}
+
 unsigned int
 Audio_track::get_max_nb_samples() const
 {
@@ -255,3 +454,127 @@ Audio_track::set_music_key_tag(const QString &key_tag)
     return true;
 }
 
+
+float
+Audio_track::get_bpm() const
+{
+    return this->bpm;
+}
+
+bool
+Audio_track::set_bpm(const float &bpm)
+{
+    if (bpm < 0.0)
+    {
+        qCWarning(DS_MUSICKEY) << "bpm can not be negative";
+        return false;
+    }
+    this->bpm = bpm;
+
+    return true;
+}
+
+unsigned int
+Audio_track::get_first_beat() const
+{
+    return this->first_beat;
+}
+
+bool
+Audio_track::set_first_beat(const unsigned int &first_beat_msec)
+{
+    this->first_beat = first_beat_msec;
+
+    return true;
+}
+
+float
+Audio_track::get_loudness() const
+{
+    return this->loudness;
+}
+
+bool
+Audio_track::set_loudness(const float &loudness)
+{
+    this->loudness = loudness;
+
+    return true;
+}
+
+bool
+Audio_track::is_analyzed() const
+{
+    return this->analyzed;
+}
+
+void
+Audio_track::set_analyzed(const bool &analyzed)
+{
+    this->analyzed = analyzed;
+
+    return;
+}
+
+unsigned int
+Audio_track::get_cue_point(const unsigned int &number) const
+{
+    if (number >= MAX_NB_CUE_POINTS)
+    {
+        return 0;
+    }
+
+    return this->cue_points[number];
+}
+
+bool
+Audio_track::set_cue_point(const unsigned int &number,
+                           const unsigned int &position_msec)
+{
+    if (number >= MAX_NB_CUE_POINTS)
+    {
+        qCWarning(DS_PLAYBACK) << "wrong cue point number";
+        return false;
+    }
+    this->cue_points[number] = position_msec;
+
+    return true;
+}
+
+QStringList
+Audio_track::get_tags() const
+{
+    return this->tags;
+}
+
+void
+Audio_track::set_tags(const QStringList &tags)
+{
+    this->tags = tags;
+
+    return;
+}
+
+QSharedPointer<Audio_track>
+Audio_track::get_metadata_copy() const
+{
+    QSharedPointer<Audio_track> copy(new Audio_track(this->sample_rate));
+    copy->length        = this->length;
+    copy->name          = this->name;
+    copy->path          = this->path;
+    copy->filename      = this->filename;
+    copy->hash          = this->hash;
+    copy->music_key     = this->music_key;
+    copy->music_key_tag = this->music_key_tag;
+    copy->bpm           = this->bpm;
+    copy->first_beat    = this->first_beat;
+    copy->loudness      = this->loudness;
+    copy->analyzed      = this->analyzed;
+    for (int i = 0; i < MAX_NB_CUE_POINTS; i++)
+    {
+        copy->cue_points[i] = this->cue_points[i];
+    }
+    copy->tags          = this->tags;
+
+    return copy;
+}
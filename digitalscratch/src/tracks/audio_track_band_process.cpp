@@ -0,0 +1,391 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*-------------------------------------------( audio_track_band_process.cpp )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: compute low/mid/high energies of a decoded track with a   */
+/*                  3 bands crossover filter bank.                            */
+/*                                                                            */
+/*============================================================================*/
+
+#include <QtDebug>
+#include <QVector>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "tracks/audio_track_band_process.h"
+#include "tracks/data_persistence.h"
+#include "app/application_logging.h"
+#include "singleton.h"
+
+Audio_track_band_process::Audio_track_band_process()
+{
+    this->must_stop.storeRelease(0);
+    this->is_loaded = false;
+    this->start(44100);
+
+    return;
+}
+
+Audio_track_band_process::Audio_track_band_process(const QSharedPointer<Audio_track> &at)
+{
+    if (at.data() == nullptr)
+    {
+        qCWarning(DS_FILE) << "audio track is null";
+    }
+    else
+    {
+        this->at = at;
+    }
+    this->must_stop.storeRelease(0);
+    this->is_loaded = false;
+    this->start(44100);
+
+    return;
+}
+
+Audio_track_band_process::~Audio_track_band_process()
+{
+    return;
+}
+
+void
+Audio_track_band_process::init_filters(const unsigned int &sample_rate)
+{
+    // Butterworth low pass and high pass biquads (RBJ cookbook, Q = 1/sqrt(2)).
+    const float frequencies[BAND_NB_FILTER_BANKS] = { BAND_LOW_CROSSOVER_HZ, BAND_HIGH_CROSSOVER_HZ };
+    for (unsigned short int b = 0; b < BAND_NB_FILTER_BANKS; b++)
+    {
+        float w0    = 2.0f * (float)M_PI * frequencies[b] / (float)sample_rate;
+        float cos0  = cosf(w0);
+        float alpha = sinf(w0) / (2.0f * (float)M_SQRT1_2);
+        float a0    = 1.0f + alpha;
+        for (unsigned short int i = 0; i < BAND_NB_LANES; i++)
+        {
+            if (i < 2)
+            {
+                this->coefs[b][0][i] = (1.0f - cos0) / 2.0f / a0;
+                this->coefs[b][1][i] = (1.0f - cos0) / a0;
+            }
+            else
+            {
+                this->coefs[b][0][i] = (1.0f + cos0) / 2.0f / a0;
+                this->coefs[b][1][i] = -(1.0f + cos0) / a0;
+            }
+            this->coefs[b][2][i] = this->coefs[b][0][i];
+            this->coefs[b][3][i] = -2.0f * cos0 / a0;
+            this->coefs[b][4][i] = (1.0f - alpha) / a0;
+        }
+
+        // Filters start from silence.
+        for (unsigned short int s = 0; s < BAND_NB_FILTER_STAGES; s++)
+        {
+            for (unsigned short int i = 0; i < BAND_NB_LANES; i++)
+            {
+                this->states[b][s][0][i] = 0.0f;
+                this->states[b][s][1][i] = 0.0f;
+            }
+        }
+    }
+
+    return;
+}
+
+void
+Audio_track_band_process::filter_bin(const short signed int *samples,
+                                     const unsigned int     &nb_frames,
+                                     float                  *energies)
+{
+    // Lanes of first bank are [low left, low right, upper left, upper right],
+    // second bank gets the upper part on all lanes and gives [mid left, mid right, high left, high right].
+#ifdef __SSE2__
+    __m128 c[BAND_NB_FILTER_BANKS][5];
+    __m128 z1[BAND_NB_FILTER_BANKS][BAND_NB_FILTER_STAGES];
+    __m128 z2[BAND_NB_FILTER_BANKS][BAND_NB_FILTER_STAGES];
+    for (unsigned short int b = 0; b < BAND_NB_FILTER_BANKS; b++)
+    {
+        for (unsigned short int k = 0; k < 5; k++)
+        {
+            c[b][k] = _mm_loadu_ps(this->coefs[b][k]);
+        }
+        for (unsigned short int s = 0; s < BAND_NB_FILTER_STAGES; s++)
+        {
+            z1[b][s] = _mm_loadu_ps(this->states[b][s][0]);
+            z2[b][s] = _mm_loadu_ps(this->states[b][s][1]);
+        }
+    }
+    __m128 sum_low      = _mm_setzero_ps();
+    __m128 sum_mid_high = _mm_setzero_ps();
+    for (unsigned int i = 0; i < nb_frames; i++)
+    {
+        float  left  = samples[i * 2];
+        float  right = samples[i * 2 + 1];
+        __m128 y     = _mm_set_ps(right, left, right, left);
+        for (unsigned short int b = 0; b < BAND_NB_FILTER_BANKS; b++)
+        {
+            if (b > 0)
+            {
+                // Upper part of previous bank goes to all lanes.
+                y = _mm_movehl_ps(y, y);
+            }
+            for (unsigned short int s = 0; s < BAND_NB_FILTER_STAGES; s++)
+            {
+                // Transposed direct form II.
+                __m128 in = y;
+                y        = _mm_add_ps(_mm_mul_ps(c[b][0], in), z1[b][s]);
+                z1[b][s] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(c[b][1], in), _mm_mul_ps(c[b][3], y)), z2[b][s]);
+                z2[b][s] = _mm_sub_ps(_mm_mul_ps(c[b][2], in), _mm_mul_ps(c[b][4], y));
+            }
+            if (b == 0)
+            {
+                sum_low = _mm_add_ps(sum_low, _mm_mul_ps(y, y));
+            }
+        }
+        sum_mid_high = _mm_add_ps(sum_mid_high, _mm_mul_ps(y, y));
+    }
+    for (unsigned short int b = 0; b < BAND_NB_FILTER_BANKS; b++)
+    {
+        for (unsigned short int s = 0; s < BAND_NB_FILTER_STAGES; s++)
+        {
+            _mm_storeu_ps(this->states[b][s][0], z1[b][s]);
+            _mm_storeu_ps(this->states[b][s][1], z2[b][s]);
+        }
+    }
+    float lows[BAND_NB_LANES];
+    float mid_highs[BAND_NB_LANES];
+    _mm_storeu_ps(lows, sum_low);
+    _mm_storeu_ps(mid_highs, sum_mid_high);
+#else
+    float lows[BAND_NB_LANES]      = { 0.0f, 0.0f, 0.0f, 0.0f };
+    float mid_highs[BAND_NB_LANES] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (unsigned int i = 0; i < nb_frames; i++)
+    {
+        float y[BAND_NB_LANES] = { (float)samples[i * 2], (float)samples[i * 2 + 1], (float)samples[i * 2], (float)samples[i * 2 + 1] };
+        for (unsigned short int b = 0; b < BAND_NB_FILTER_BANKS; b++)
+        {
+            if (b > 0)
+            {
+                // Upper part of previous bank goes to all lanes.
+                y[0] = y[2];
+                y[1] = y[3];
+            }
+            for (unsigned short int s = 0; s < BAND_NB_FILTER_STAGES; s++)
+            {
+                float *z1 = this->states[b][s][0];
+                float *z2 = this->states[b][s][1];
+                for (unsigned short int j = 0; j < BAND_NB_LANES; j++)
+                {
+                    float in = y[j];
+                    y[j]  = this->coefs[b][0][j] * in + z1[j];
+                    z1[j] = this->coefs[b][1][j] * in - this->coefs[b][3][j] * y[j] + z2[j];
+                    z2[j] = this->coefs[b][2][j] * in - this->coefs[b][4][j] * y[j];
+                }
+            }
+            if (b == 0)
+            {
+                for (unsigned short int j = 0; j < BAND_NB_LANES; j++)
+                {
+                    lows[j] += y[j] * y[j];
+                }
+            }
+        }
+        for (unsigned short int j = 0; j < BAND_NB_LANES; j++)
+        {
+            mid_highs[j] += y[j] * y[j];
+        }
+    }
+#endif
+    energies[0] = lows[0] + lows[1];
+    energies[1] = mid_highs[0] + mid_highs[1];
+    energies[2] = mid_highs[2] + mid_highs[3];
+
+    return;
+}
+
+void
+Audio_track_band_process::start(const unsigned int &sample_rate)
+{
+    this->init_filters(sample_rate);
+    this->rms.resize(0);
+    for (unsigned short int b = 0; b < PEAKS_NB_BANDS; b++)
+    {
+        this->bin_energies[b] = 0.0f;
+    }
+    this->bin_nb_frames = 0;
+
+    return;
+}
+
+void
+Audio_track_band_process::process(const short signed int *samples,
+                                  const unsigned int     &nb_frames)
+{
+#ifdef __SSE2__
+    // Flush denormals to zero (filters fade out on silent parts).
+    unsigned int csr = _mm_getcsr();
+    _mm_setcsr(csr | 0x8040);
+#endif
+
+    // Fill bins, the last one of the chunk is continued by the next chunk.
+    unsigned int position = 0;
+    while (position < nb_frames)
+    {
+        unsigned int size = qMin(PEAKS_BAND_BIN_SIZE - this->bin_nb_frames, nb_frames - position);
+        float        energies[PEAKS_NB_BANDS];
+        this->filter_bin(&samples[position * 2], size, energies);
+        for (unsigned short int b = 0; b < PEAKS_NB_BANDS; b++)
+        {
+            this->bin_energies[b] += energies[b];
+        }
+        this->bin_nb_frames += size;
+        position            += size;
+
+        if (this->bin_nb_frames == PEAKS_BAND_BIN_SIZE)
+        {
+            for (unsigned short int b = 0; b < PEAKS_NB_BANDS; b++)
+            {
+                this->rms << sqrtf(this->bin_energies[b] / (float)(PEAKS_BAND_BIN_SIZE * 2));
+                this->bin_energies[b] = 0.0f;
+            }
+            this->bin_nb_frames = 0;
+        }
+    }
+
+#ifdef __SSE2__
+    _mm_setcsr(csr);
+#endif
+
+    return;
+}
+
+bool
+Audio_track_band_process::finish(const QSharedPointer<Audio_track> &io_at)
+{
+    // Last bin is not full.
+    if (this->bin_nb_frames > 0)
+    {
+        for (unsigned short int b = 0; b < PEAKS_NB_BANDS; b++)
+        {
+            this->rms << sqrtf(this->bin_energies[b] / (float)(this->bin_nb_frames * 2));
+        }
+        this->bin_nb_frames = 0;
+    }
+    if (this->rms.size() == 0)
+    {
+        return false;
+    }
+    this->hash = io_at->get_hash();
+
+    // Scale each band to its loudest bin, so the balance between bands is visible on any track.
+    float max_rms[PEAKS_NB_BANDS] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < this->rms.size(); i++)
+    {
+        max_rms[i % PEAKS_NB_BANDS] = qMax(max_rms[i % PEAKS_NB_BANDS], this->rms[i]);
+    }
+    this->bands.resize(this->rms.size());
+    for (int i = 0; i < this->rms.size(); i++)
+    {
+        float max = max_rms[i % PEAKS_NB_BANDS];
+        this->bands[i] = (char)(max > 0.0f ? qRound(this->rms[i] * 255.0f / max) : 0);
+    }
+
+    return true;
+}
+
+bool
+Audio_track_band_process::load()
+{
+    if (this->at.data() == nullptr)
+    {
+        return false;
+    }
+
+    // Frequency bands are computed only once per track.
+    QByteArray bands;
+    if (Singleton<Data_persistence>::get_instance().get_waveform_bands(this->at, bands) == false)
+    {
+        return false;
+    }
+    this->hash      = this->at->get_hash();
+    this->bands     = bands;
+    this->is_loaded = true;
+
+    return true;
+}
+
+bool
+Audio_track_band_process::run()
+{
+    // Check if there are decoded audio data in audio track.
+    if ((this->at.data() == nullptr) || (this->at->get_end_of_samples() == 0))
+    {
+        return false;
+    }
+
+    // Give the track bin by bin, so the analysis can be stopped.
+    const short signed int *samples   = this->at->get_samples();
+    unsigned int            nb_frames = this->at->get_end_of_samples() / 2;
+    this->start(this->at->get_sample_rate());
+    for (unsigned int first_frame = 0; first_frame < nb_frames; first_frame += PEAKS_BAND_BIN_SIZE)
+    {
+        if (this->must_stop.loadAcquire() == 1)
+        {
+            return false;
+        }
+        this->process(&samples[first_frame * 2], qMin((unsigned int)PEAKS_BAND_BIN_SIZE, nb_frames - first_frame));
+    }
+
+    return this->finish(this->at);
+}
+
+void
+Audio_track_band_process::stop()
+{
+    this->must_stop.storeRelease(1);
+
+    return;
+}
+
+const QString&
+Audio_track_band_process::get_hash() const
+{
+    return this->hash;
+}
+
+const QByteArray&
+Audio_track_band_process::get_bands() const
+{
+    return this->bands;
+}
+
+bool
+Audio_track_band_process::is_loaded_from_db() const
+{
+    return this->is_loaded;
+}
@@ -0,0 +1,301 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*--------------------------------------------( audio_track_bpm_process.cpp )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: estimate tempo and beat grid of a decoded track.          */
+/*                                                                            */
+/*============================================================================*/
+
+#include <QtDebug>
+#include <cmath>
+
+#include "tracks/audio_track_bpm_process.h"
+#include "app/application_logging.h"
+
+Audio_track_bpm_process::Audio_track_bpm_process()
+{
+    this->start(0);
+
+    return;
+}
+
+Audio_track_bpm_process::Audio_track_bpm_process(const QSharedPointer<Audio_track> &at)
+{
+    if (at.data() == nullptr)
+    {
+        qCWarning(DS_MUSICKEY) << "audio track is null";
+    }
+    else
+    {
+        this->at = at;
+    }
+    this->start(0);
+
+    return;
+}
+
+Audio_track_bpm_process::~Audio_track_bpm_process()
+{
+    return;
+}
+
+void
+Audio_track_bpm_process::start(const unsigned int &sample_rate)
+{
+    // Mono signal is decimated by averaging (also a low pass filter), then its log energy is computed by hop.
+    this->decimation      = qMax(1u, sample_rate / BPM_DOWNSAMPLED_RATE);
+    float ds_rate         = (float)sample_rate / (float)this->decimation;
+    this->hop             = qMax(1u, (unsigned int)qRound(ds_rate / (float)BPM_ENVELOPE_RATE));
+    this->envelope_rate   = ds_rate / (float)this->hop;
+    this->mono_sum        = 0;
+    this->nb_mono_frames  = 0;
+    this->hop_energy      = 0.0f;
+    this->nb_hop_values   = 0;
+    this->previous_energy = 0.0f;
+    this->onsets.resize(0);
+
+    return;
+}
+
+void
+Audio_track_bpm_process::process(const short signed int *samples,
+                                 const unsigned int     &nb_frames)
+{
+    for (unsigned int i = 0; i < nb_frames; i++)
+    {
+        // Downsampled mono value.
+        this->mono_sum += samples[i * 2] + samples[i * 2 + 1];
+        if (++this->nb_mono_frames < this->decimation)
+        {
+            continue;
+        }
+        float value = (float)this->mono_sum / (float)(this->decimation * 2);
+        this->hop_energy    += value * value;
+        this->mono_sum       = 0;
+        this->nb_mono_frames = 0;
+
+        // Onset strength is the increase of energy.
+        if (++this->nb_hop_values == this->hop)
+        {
+            float energy = logf(1.0f + this->hop_energy / (float)this->hop);
+            this->onsets << qMax(0.0f, energy - this->previous_energy);
+            this->previous_energy = energy;
+            this->hop_energy      = 0.0f;
+            this->nb_hop_values   = 0;
+        }
+    }
+
+    return;
+}
+
+void
+Audio_track_bpm_process::smooth_onsets()
+{
+    int nb_hops = this->onsets.size();
+    if (nb_hops == 0)
+    {
+        return;
+    }
+
+    // Smooth onsets (triangular window) and remove the mean, so autocorrelation shows periodicity only.
+    float sum = 0.0f;
+    for (int h = 0; h < nb_hops; h++)
+    {
+        sum += this->onsets[h];
+    }
+    float          mean = sum / (float)nb_hops;
+    QVector<float> raw  = this->onsets;
+    for (int h = 0; h < nb_hops; h++)
+    {
+        float value  = 0.0f;
+        float weight = 0.0f;
+        for (int k = -BPM_ONSET_SMOOTHING; k <= BPM_ONSET_SMOOTHING; k++)
+        {
+            if ((h + k >= 0) && (h + k < nb_hops))
+            {
+                float w = (float)(BPM_ONSET_SMOOTHING + 1 - qAbs(k));
+                value  += raw[h + k] * w;
+                weight += w;
+            }
+        }
+        this->onsets[h] = value / weight - mean;
+    }
+
+    return;
+}
+
+float
+Audio_track_bpm_process::get_comb_score(const QVector<float> &ac,
+                                        const float          &period)
+{
+    // Sum of autocorrelation at multiples of the period (linear interpolation between lags).
+    float score = 0.0f;
+    for (unsigned short int k = 1; k <= BPM_NB_HARMONICS; k++)
+    {
+        float        lag      = period * k;
+        unsigned int lag_int  = (unsigned int)lag;
+        float        fraction = lag - (float)lag_int;
+        if (lag_int + 1 < (unsigned int)ac.size())
+        {
+            score += ac[lag_int] * (1.0f - fraction) + ac[lag_int + 1] * fraction;
+        }
+    }
+
+    // Tempo prior (log normal, one octave wide) to prefer the usual tempo over its half or double.
+    float bpm    = 60.0f * this->envelope_rate / period;
+    float octave = log2f(bpm / BPM_PREFERRED);
+
+    return score * expf(-0.5f * octave * octave);
+}
+
+float
+Audio_track_bpm_process::get_beat_period(const QVector<float> &ac)
+{
+    float min_period = 60.0f * this->envelope_rate / BPM_MAX;
+    float max_period = 60.0f * this->envelope_rate / BPM_MIN;
+
+    // Coarse search on integer periods.
+    float best_period = 0.0f;
+    float best_score  = 0.0f;
+    for (unsigned int period = (unsigned int)ceilf(min_period); period <= (unsigned int)max_period; period++)
+    {
+        float score = this->get_comb_score(ac, (float)period);
+        if ((best_period == 0.0f) || (score > best_score))
+        {
+            best_period = (float)period;
+            best_score  = score;
+        }
+    }
+
+    // Refine around the best one (multiples of the period give sub lag precision).
+    float coarse_period = best_period;
+    for (float period = coarse_period - 1.0f; period <= coarse_period + 1.0f; period += 0.02f)
+    {
+        float score = this->get_comb_score(ac, period);
+        if (score > best_score)
+        {
+            best_period = period;
+            best_score  = score;
+        }
+    }
+
+    return best_period;
+}
+
+float
+Audio_track_bpm_process::get_beat_phase(const float &period,
+                                        float       &out_score)
+{
+    // Phase for which beat grid hits the strongest onsets.
+    float        best_phase = 0.0f;
+    float        best_score = 0.0f;
+    unsigned int nb_onsets  = this->onsets.size();
+    for (unsigned int phase = 0; phase < (unsigned int)ceilf(period); phase++)
+    {
+        float score = 0.0f;
+        for (float position = (float)phase; position < (float)nb_onsets; position += period)
+        {
+            score += this->onsets[qMin((unsigned int)qRound(position), nb_onsets - 1)];
+        }
+        if ((phase == 0) || (score > best_score))
+        {
+            best_phase = (float)phase;
+            best_score = score;
+        }
+    }
+    out_score = best_score;
+
+    return best_phase;
+}
+
+bool
+Audio_track_bpm_process::run()
+{
+    // Check if there are decoded audio data in audio track.
+    if ((this->at.data() == nullptr) || (this->at->get_end_of_samples() == 0))
+    {
+        return false;
+    }
+
+    // The whole track is one chunk of the stream.
+    this->start(this->at->get_sample_rate());
+    this->process(this->at->get_samples(), this->at->get_end_of_samples() / 2);
+
+    return this->finish(this->at);
+}
+
+bool
+Audio_track_bpm_process::finish(const QSharedPointer<Audio_track> &io_at)
+{
+    // Onset strength envelope of the downsampled mono signal.
+    this->smooth_onsets();
+    int max_lag = (int)(BPM_NB_HARMONICS * 60.0f * this->envelope_rate / BPM_MIN) + 2;
+    if (this->onsets.size() < max_lag * 2)
+    {
+        qCWarning(DS_MUSICKEY) << "track is too short to compute bpm";
+        return false;
+    }
+    // Autocorrelation of the envelope (only lags needed by the comb filter).
+    QVector<float> ac(max_lag);
+    for (int lag = 0; lag < max_lag; lag++)
+    {
+        float sum = 0.0f;
+        for (int i = lag; i < this->onsets.size(); i++)
+        {
+            sum += this->onsets[i] * this->onsets[i - lag];
+        }
+        ac[lag] = sum;
+    }
+    if (ac[0] <= 0.0f)
+    {
+        // No onset (silence).
+        return false;
+    }
+
+    // Tempo from the comb filter, then refined with the beat grid which fits best on the whole track
+    // (a small error on the period would make the grid drift away from the beats).
+    float coarse_period = this->get_beat_period(ac);
+    float period        = coarse_period;
+    float phase         = 0.0f;
+    float best_score    = 0.0f;
+    for (int step = -BPM_REFINE_NB_STEPS / 2; step <= BPM_REFINE_NB_STEPS / 2; step++)
+    {
+        float candidate       = coarse_period * (1.0f + BPM_REFINE_RANGE * 2.0f * (float)step / (float)BPM_REFINE_NB_STEPS);
+        float score           = 0.0f;
+        float candidate_phase = this->get_beat_phase(candidate, score);
+        if ((step == -BPM_REFINE_NB_STEPS / 2) || (score > best_score))
+        {
+            period     = candidate;
+            phase      = candidate_phase;
+            best_score = score;
+        }
+    }
+    io_at->set_bpm(60.0f * this->envelope_rate / period);
+    io_at->set_first_beat((unsigned int)qRound(phase * 1000.0f / this->envelope_rate));
+
+    return true;
+}
@@ -31,12 +31,23 @@
 /*============================================================================*/
 
 #include <QtDebug>
+#include <cmath>
+#include <cstring>
 
 #include "tracks/audio_track_key_process.h"
 #include "tracks/audio_track.h"
 #include "app/application_logging.h"
 #include "utils.h"
 
+Audio_track_key_process::Audio_track_key_process()
+{
+    this->nb_windows  = KEY_NB_WINDOWS;
+    this->window_msec = KEY_WINDOW_MSEC;
+    this->start(44100);
+
+    return;
+}
+
 Audio_track_key_process::Audio_track_key_process(const QSharedPointer<Audio_track> &at)
 {
     if (at.data() == nullptr)
@@ -47,6 +58,9 @@ Audio_track_key_process::Audio_track_key_process(const QSharedPointer<Audio_trac
     {
         this->at = at;
     }
+    this->nb_windows  = KEY_NB_WINDOWS;
+    this->window_msec = KEY_WINDOW_MSEC;
+    this->start(44100);
 
     return;
 }
@@ -60,27 +74,146 @@ bool
 Audio_track_key_process::run()
 {
     // Check if there are decoded audio data in audio track.
-    if (this->at->get_end_of_samples() == 0)
+    if ((this->at.data() == nullptr) || (this->at->get_end_of_samples() == 0))
+    {
+        return false;
+    }
+
+    // The whole track is one chunk of the stream.
+    this->start(this->at->get_sample_rate());
+    this->process(this->at->get_samples(), this->at->get_end_of_samples() / 2);
+
+    return this->finish(this->at);
+}
+
+void
+Audio_track_key_process::set_windows(const unsigned short int &nb_windows,
+                                     const unsigned int       &window_msec)
+{
+    this->nb_windows  = nb_windows;
+    this->window_msec = window_msec;
+
+    return;
+}
+
+void
+Audio_track_key_process::init_filter(const unsigned int &input_sample_rate)
+{
+    // Cascade of Butterworth biquads (RBJ cookbook low pass, Q of each pole pair of the 8th order filter).
+    float w0   = 2.0f * (float)M_PI * qMin(KEY_LOWPASS_HZ, 0.45f * input_sample_rate) / (float)input_sample_rate;
+    float cos0 = cosf(w0);
+    for (unsigned short int s = 0; s < KEY_FILTER_NB_STAGES; s++)
+    {
+        float q     = 1.0f / (2.0f * cosf((float)M_PI * (2 * s + 1) / (4.0f * KEY_FILTER_NB_STAGES)));
+        float alpha = sinf(w0) / (2.0f * q);
+        float a0    = 1.0f + alpha;
+        this->coefs[s][0] = (1.0f - cos0) / 2.0f / a0;
+        this->coefs[s][1] = (1.0f - cos0) / a0;
+        this->coefs[s][2] = this->coefs[s][0];
+        this->coefs[s][3] = -2.0f * cos0 / a0;
+        this->coefs[s][4] = (1.0f - alpha) / a0;
+        this->states[s][0] = 0.0f;
+        this->states[s][1] = 0.0f;
+    }
+
+    return;
+}
+
+void
+Audio_track_key_process::start(const unsigned int &sample_rate)
+{
+    // Key does not depend on stereo image nor on high frequencies: keep a low pass filtered and decimated mono mix.
+    this->decimation          = qMax(1u, sample_rate / KEY_DOWNSAMPLED_RATE);
+    this->sample_rate         = sample_rate / this->decimation;
+    this->nb_decimated_frames = 0;
+    this->init_filter(sample_rate);
+    this->mono_samples.resize(0);
+
+    return;
+}
+
+void
+Audio_track_key_process::process(const short signed int *samples,
+                                 const unsigned int     &nb_frames)
+{
+    // Only 1 mono sample every decimation frames is kept, but the filter runs on all of them.
+    int position = this->mono_samples.size();
+    this->mono_samples.resize(position + (this->nb_decimated_frames + nb_frames) / this->decimation);
+    short signed int *mono = &this->mono_samples.data()[position];
+    for (unsigned int i = 0; i < nb_frames; i++)
+    {
+        float y = ((float)samples[i * 2] + (float)samples[i * 2 + 1]) * 0.5f;
+        for (unsigned short int s = 0; s < KEY_FILTER_NB_STAGES; s++)
+        {
+            // Transposed direct form II.
+            float in = y;
+            y                  = this->coefs[s][0] * in + this->states[s][0];
+            this->states[s][0] = this->coefs[s][1] * in - this->coefs[s][3] * y + this->states[s][1];
+            this->states[s][1] = this->coefs[s][2] * in - this->coefs[s][4] * y;
+        }
+        if (++this->nb_decimated_frames == this->decimation)
+        {
+            *mono++ = (short signed int)qBound(-32768.0f, y, 32767.0f);
+            this->nb_decimated_frames = 0;
+        }
+    }
+
+    return;
+}
+
+unsigned int
+Audio_track_key_process::select_windows()
+{
+    // Whole track if it is shorter than the windows.
+    unsigned int nb_samples  = this->mono_samples.size();
+    unsigned int window_size = (unsigned int)((quint64)this->window_msec * this->sample_rate / 1000);
+    if ((this->nb_windows == 0) || (window_size == 0) || ((quint64)this->nb_windows * window_size >= nb_samples))
+    {
+        return nb_samples;
+    }
+
+    // Windows evenly spread from the beginning to the end, moved one after the other (never overlapping the next ones).
+    short signed int *mono = this->mono_samples.data();
+    for (unsigned short int w = 0; w < this->nb_windows; w++)
+    {
+        unsigned int begin = (this->nb_windows == 1) ? (nb_samples - window_size) / 2 :
+                             (unsigned int)((quint64)(nb_samples - window_size) * w / (this->nb_windows - 1));
+        memmove(&mono[w * window_size], &mono[begin], window_size * sizeof(short signed int));
+    }
+
+    return this->nb_windows * window_size;
+}
+
+bool
+Audio_track_key_process::finish(const QSharedPointer<Audio_track> &io_at)
+{
+    unsigned int nb_samples = this->select_windows();
+    if (nb_samples == 0)
     {
         return false;
     }
 
     // Compute the musical key.
-    QString key = kfinder_get_key(at->get_samples(),
-                                  at->get_end_of_samples(),
-                                  at->get_sample_rate(),
-                                  2);
+    QString key = kfinder_get_key(this->mono_samples.data(),
+                                  nb_samples,
+                                  this->sample_rate,
+                                  1);
+
+    return this->set_key(key, io_at);
+}
+
+bool
+Audio_track_key_process::set_key(const QString                     &key,
+                                 const QSharedPointer<Audio_track> &io_at)
+{
     if (key != "")
     {
-        // Transform music key to a clock number.
-        key = Utils::convert_music_key_to_clock_number(key);
-
-        // Set music key to the audio track.
-        this->at->set_music_key(key);
+        // Set music key (as a clock number) to the audio track.
+        io_at->set_music_key(Utils::convert_music_key_to_clock_number(key));
     }
     else
     {
-        qCWarning(DS_MUSICKEY) << "no music key found" << this->at->get_path();
+        qCWarning(DS_MUSICKEY) << "no music key found" << io_at->get_path();
         return false;
     }
 
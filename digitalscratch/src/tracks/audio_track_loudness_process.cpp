@@ -0,0 +1,166 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*---------------------------------------( audio_track_loudness_process.cpp )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: measure integrated loudness of a track (ITU-R BS.1770     */
+/*                  K-weighting and gating).                                  */
+/*                                                                            */
+/*============================================================================*/
+
+#include <QtDebug>
+#include <cmath>
+
+#include "tracks/audio_track_loudness_process.h"
+#include "app/application_logging.h"
+
+Audio_track_loudness_process::Audio_track_loudness_process()
+{
+    this->start(44100);
+
+    return;
+}
+
+Audio_track_loudness_process::~Audio_track_loudness_process()
+{
+    return;
+}
+
+void
+Audio_track_loudness_process::start(const unsigned int &sample_rate)
+{
+    // Stage 1: high shelf (+4 dB above ~1.5 kHz, head effect).
+    double k  = tan(M_PI * 1681.974450955533 / (double)sample_rate);
+    double q  = 0.7071752369554196;
+    double vh = pow(10.0, 3.999843853973347 / 20.0);
+    double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    this->coefs[0][0] = (vh + vb * k / q + k * k) / a0;
+    this->coefs[0][1] = 2.0 * (k * k - vh) / a0;
+    this->coefs[0][2] = (vh - vb * k / q + k * k) / a0;
+    this->coefs[0][3] = 2.0 * (k * k - 1.0) / a0;
+    this->coefs[0][4] = (1.0 - k / q + k * k) / a0;
+
+    // Stage 2: high pass (~38 Hz, RLB weighting).
+    k  = tan(M_PI * 38.13547087602444 / (double)sample_rate);
+    q  = 0.5003270373238773;
+    a0 = 1.0 + k / q + k * k;
+    this->coefs[1][0] = 1.0;
+    this->coefs[1][1] = -2.0;
+    this->coefs[1][2] = 1.0;
+    this->coefs[1][3] = 2.0 * (k * k - 1.0) / a0;
+    this->coefs[1][4] = (1.0 - k / q + k * k) / a0;
+
+    // Filters start from silence.
+    for (unsigned short int s = 0; s < 2; s++)
+    {
+        for (unsigned short int c = 0; c < 2; c++)
+        {
+            this->states[s][c][0] = 0.0;
+            this->states[s][c][1] = 0.0;
+        }
+    }
+    this->step_size      = qMax(1u, sample_rate * LOUDNESS_STEP_MSEC / 1000);
+    this->step_sum       = 0.0;
+    this->step_nb_frames = 0;
+    this->step_powers.resize(0);
+
+    return;
+}
+
+void
+Audio_track_loudness_process::process(const short signed int *samples,
+                                      const unsigned int     &nb_frames)
+{
+    for (unsigned int i = 0; i < nb_frames; i++)
+    {
+        // K-weighting of each channel (transposed direct form II), samples are normalized to [-1, 1].
+        for (unsigned short int c = 0; c < 2; c++)
+        {
+            double y = (double)samples[i * 2 + c] / 32768.0;
+            for (unsigned short int s = 0; s < 2; s++)
+            {
+                double  in = y;
+                double *z  = this->states[s][c];
+                y    = this->coefs[s][0] * in + z[0];
+                z[0] = this->coefs[s][1] * in - this->coefs[s][3] * y + z[1];
+                z[1] = this->coefs[s][2] * in - this->coefs[s][4] * y;
+            }
+            this->step_sum += y * y;
+        }
+
+        // Power of the step (sum of channels).
+        if (++this->step_nb_frames == this->step_size)
+        {
+            this->step_powers << (float)(this->step_sum / (double)this->step_size);
+            this->step_sum       = 0.0;
+            this->step_nb_frames = 0;
+        }
+    }
+
+    return;
+}
+
+float
+Audio_track_loudness_process::get_gated_power(const double &threshold)
+{
+    double       sum       = 0.0;
+    unsigned int nb_blocks = 0;
+    for (int b = 0; b + LOUDNESS_NB_STEPS_BY_BLOCK <= this->step_powers.size(); b++)
+    {
+        double power = 0.0;
+        for (unsigned short int s = 0; s < LOUDNESS_NB_STEPS_BY_BLOCK; s++)
+        {
+            power += this->step_powers[b + s];
+        }
+        power /= (double)LOUDNESS_NB_STEPS_BY_BLOCK;
+        if (power > threshold)
+        {
+            sum += power;
+            nb_blocks++;
+        }
+    }
+
+    return (nb_blocks > 0) ? (float)(sum / (double)nb_blocks) : 0.0f;
+}
+
+bool
+Audio_track_loudness_process::finish(const QSharedPointer<Audio_track> &io_at)
+{
+    // Blocks above absolute gate, then the ones above relative gate (in power, loudness = -0.691 + 10 * log10(power)).
+    double absolute_threshold = pow(10.0, (LOUDNESS_ABSOLUTE_GATE + 0.691) / 10.0);
+    float  power              = this->get_gated_power(absolute_threshold);
+    if (power <= 0.0f)
+    {
+        // Silence or track shorter than a block.
+        return false;
+    }
+    double relative_threshold = power * pow(10.0, LOUDNESS_RELATIVE_GATE / 10.0);
+    power = this->get_gated_power(qMax(absolute_threshold, relative_threshold));
+    io_at->set_loudness((float)(-0.691 + 10.0 * log10((double)power)));
+
+    return true;
+}
@@ -0,0 +1,283 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*--------------------------------------------------( audio_track_peaks.cpp )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: min/max/RMS summary of an audio track at several          */
+/*                  resolutions (used to draw waveforms).                     */
+/*                                                                            */
+/*============================================================================*/
+
+#include <QtGlobal>
+#include <algorithm>
+#include <cmath>
+#include <climits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "tracks/audio_track_peaks.h"
+
+Audio_track_peaks::Audio_track_peaks(const unsigned int &max_nb_frames)
+{
+    // Allocate all levels once (they are filled while decoding).
+    this->max_nb_frames = max_nb_frames;
+    unsigned int bin_size = PEAKS_BASE_BIN_SIZE;
+    for (unsigned short int i = 0; i < PEAKS_NB_LEVELS; i++)
+    {
+        this->levels[i].resize((max_nb_frames + bin_size - 1) / bin_size);
+        bin_size *= PEAKS_LEVEL_FACTOR;
+    }
+    this->reset();
+
+    return;
+}
+
+Audio_track_peaks::~Audio_track_peaks()
+{
+    return;
+}
+
+void
+Audio_track_peaks::reset()
+{
+    // A bin which is not summarized yet has min > max (bins of a failed decoding may be anywhere, so clear all).
+    Audio_peak empty_peak = { SHRT_MAX, SHRT_MIN, 0.0f };
+    for (unsigned short int i = 0; i < PEAKS_NB_LEVELS; i++)
+    {
+        std::fill(this->levels[i].begin(), this->levels[i].end(), empty_peak);
+        this->nb_bins[i] = 0;
+    }
+    this->bands.clear();
+
+    return;
+}
+
+void
+Audio_track_peaks::summarize_bin(const short signed int *samples,
+                                 const unsigned int     &nb_frames,
+                                 Audio_peak             &peak)
+{
+    // Both channels are summarized together.
+    unsigned int nb_samples = nb_frames * 2;
+    unsigned int i          = 0;
+    short signed int min    = SHRT_MAX;
+    short signed int max    = SHRT_MIN;
+    float            sum    = 0.0f;
+
+#ifdef __SSE2__
+    __m128i min_8 = _mm_set1_epi16(SHRT_MAX);
+    __m128i max_8 = _mm_set1_epi16(SHRT_MIN);
+    __m128  sum_4 = _mm_setzero_ps();
+    for (; i + 8 <= nb_samples; i += 8)
+    {
+        __m128i samples_8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&samples[i]));
+        min_8 = _mm_min_epi16(min_8, samples_8);
+        max_8 = _mm_max_epi16(max_8, samples_8);
+
+        // Sign extend to 32 bits and accumulate squares as float.
+        __m128 low_4  = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(samples_8, samples_8), 16));
+        __m128 high_4 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(samples_8, samples_8), 16));
+        sum_4 = _mm_add_ps(sum_4, _mm_add_ps(_mm_mul_ps(low_4, low_4), _mm_mul_ps(high_4, high_4)));
+    }
+    short signed int mins[8];
+    short signed int maxs[8];
+    float            sums[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(mins), min_8);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(maxs), max_8);
+    _mm_storeu_ps(sums, sum_4);
+    for (unsigned short int j = 0; j < 8; j++)
+    {
+        min = qMin(min, mins[j]);
+        max = qMax(max, maxs[j]);
+    }
+    sum = sums[0] + sums[1] + sums[2] + sums[3];
+#endif
+    for (; i < nb_samples; i++)
+    {
+        min  = qMin(min, samples[i]);
+        max  = qMax(max, samples[i]);
+        sum += (float)samples[i] * (float)samples[i];
+    }
+
+    peak.min = min;
+    peak.max = max;
+    peak.rms = (nb_samples > 0) ? sqrtf(sum / (float)nb_samples) : 0.0f;
+
+    return;
+}
+
+unsigned int
+Audio_track_peaks::compute_bins(const short signed int *samples,
+                                const unsigned int     &first_frame,
+                                const unsigned int     &last_frame)
+{
+    // Only complete bins, the ones shared with another decoded region are done by finish().
+    unsigned int bin     = (first_frame + PEAKS_BASE_BIN_SIZE - 1) / PEAKS_BASE_BIN_SIZE;
+    unsigned int end_bin = qMin(last_frame / PEAKS_BASE_BIN_SIZE, (unsigned int)this->levels[0].size());
+    if (bin >= end_bin)
+    {
+        return first_frame;
+    }
+    for (; bin < end_bin; bin++)
+    {
+        this->summarize_bin(&samples[bin * PEAKS_BASE_BIN_SIZE * 2], PEAKS_BASE_BIN_SIZE, this->levels[0][bin]);
+    }
+
+    return end_bin * PEAKS_BASE_BIN_SIZE;
+}
+
+void
+Audio_track_peaks::finish(const short signed int *samples,
+                          const unsigned int     &nb_frames)
+{
+    // Summarize first level bins which were not done while decoding (including the last incomplete one).
+    unsigned int frames = qMin(nb_frames, this->max_nb_frames);
+    this->nb_bins[0] = (frames + PEAKS_BASE_BIN_SIZE - 1) / PEAKS_BASE_BIN_SIZE;
+    for (unsigned int bin = 0; bin < this->nb_bins[0]; bin++)
+    {
+        Audio_peak &peak = this->levels[0][bin];
+        if (peak.min > peak.max)
+        {
+            unsigned int first_frame = bin * PEAKS_BASE_BIN_SIZE;
+            this->summarize_bin(&samples[first_frame * 2], qMin((unsigned int)PEAKS_BASE_BIN_SIZE, frames - first_frame), peak);
+        }
+    }
+
+    // Each other level is built from the previous one.
+    for (unsigned short int i = 1; i < PEAKS_NB_LEVELS; i++)
+    {
+        this->nb_bins[i] = (this->nb_bins[i - 1] + PEAKS_LEVEL_FACTOR - 1) / PEAKS_LEVEL_FACTOR;
+        for (unsigned int bin = 0; bin < this->nb_bins[i]; bin++)
+        {
+            unsigned int first_bin = bin * PEAKS_LEVEL_FACTOR;
+            this->levels[i][bin] = this->get_peak(i - 1, first_bin, qMin(first_bin + PEAKS_LEVEL_FACTOR, this->nb_bins[i - 1]));
+        }
+    }
+
+    return;
+}
+
+unsigned short int
+Audio_track_peaks::get_level(const float &nb_frames_per_pixel) const
+{
+    unsigned short int level    = 0;
+    unsigned int       bin_size = PEAKS_BASE_BIN_SIZE * PEAKS_LEVEL_FACTOR;
+    while ((level + 1 < PEAKS_NB_LEVELS) && (bin_size <= nb_frames_per_pixel))
+    {
+        level++;
+        bin_size *= PEAKS_LEVEL_FACTOR;
+    }
+
+    return level;
+}
+
+unsigned int
+Audio_track_peaks::get_bin_size(const unsigned short int &level) const
+{
+    unsigned int bin_size = PEAKS_BASE_BIN_SIZE;
+    for (unsigned short int i = 0; i < level; i++)
+    {
+        bin_size *= PEAKS_LEVEL_FACTOR;
+    }
+
+    return bin_size;
+}
+
+unsigned int
+Audio_track_peaks::get_nb_bins(const unsigned short int &level) const
+{
+    return this->nb_bins[level];
+}
+
+const Audio_peak*
+Audio_track_peaks::get_bins(const unsigned short int &level) const
+{
+    return this->levels[level].constData();
+}
+
+Audio_peak
+Audio_track_peaks::get_peak(const unsigned short int &level,
+                            const unsigned int       &first_bin,
+                            const unsigned int       &last_bin) const
+{
+    Audio_peak peak    = { SHRT_MAX, SHRT_MIN, 0.0f };
+    float      sum     = 0.0f;
+    unsigned int end   = qMin(last_bin, this->nb_bins[level]);
+    for (unsigned int bin = first_bin; bin < end; bin++)
+    {
+        const Audio_peak &current = this->levels[level][bin];
+        peak.min = qMin(peak.min, current.min);
+        peak.max = qMax(peak.max, current.max);
+        sum     += current.rms * current.rms;
+    }
+    if (end > first_bin)
+    {
+        peak.rms = sqrtf(sum / (float)(end - first_bin));
+    }
+
+    return peak;
+}
+
+void
+Audio_track_peaks::set_bands(const QByteArray &bands)
+{
+    this->bands = bands;
+
+    return;
+}
+
+const QByteArray&
+Audio_track_peaks::get_bands() const
+{
+    return this->bands;
+}
+
+bool
+Audio_track_peaks::has_bands() const
+{
+    return this->bands.size() > 0;
+}
+
+Audio_bands
+Audio_track_peaks::get_bands(const unsigned int &first_frame,
+                             const unsigned int &last_frame) const
+{
+    Audio_bands          result    = { 0, 0, 0 };
+    const unsigned char *energies  = reinterpret_cast<const unsigned char*>(this->bands.constData());
+    unsigned int         nb_bins   = this->bands.size() / PEAKS_NB_BANDS;
+    unsigned int         first_bin = first_frame / PEAKS_BAND_BIN_SIZE;
+    unsigned int         last_bin  = qMin(qMax(first_bin + 1, last_frame / PEAKS_BAND_BIN_SIZE), nb_bins);
+    for (unsigned int bin = first_bin; bin < last_bin; bin++)
+    {
+        result.low  = qMax(result.low,  energies[bin * PEAKS_NB_BANDS]);
+        result.mid  = qMax(result.mid,  energies[bin * PEAKS_NB_BANDS + 1]);
+        result.high = qMax(result.high, energies[bin * PEAKS_NB_BANDS + 2]);
+    }
+
+    return result;
+}
@@ -0,0 +1,305 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*------------------------------------------( audio_track_prefetch_pool.cpp )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: speculative decoding of the tracks which are likely to    */
+/*                  be loaded next, kept in a bounded pool of audio tracks.   */
+/*                                                                            */
+/*============================================================================*/
+
+#include <QtDebug>
+
+#include "tracks/audio_track_prefetch_pool.h"
+#include "app/job_scheduler.h"
+#include "app/application_logging.h"
+#include "singleton.h"
+
+Audio_track_prefetch_pool::Audio_track_prefetch_pool(const unsigned short int &nb_slots,
+                                                     const unsigned int       &sample_rate)
+{
+    this->max_nb_slots  = nb_slots;
+    this->sample_rate   = sample_rate;
+    this->decoding_slot = -1;
+    this->decoding_canceled = 0;
+    this->use_counter   = 0;
+
+    // Only one background decoding at a time, it must not compete with the playback.
+    QObject::connect(&this->decoding_watcher, &QFutureWatcher<bool>::finished, [this](){this->on_decoding_finished();});
+
+    // Start decoding only when the list of candidates is stable (e.g. not while scrolling in the file browser).
+    this->start_timer.setSingleShot(true);
+    this->start_timer.setInterval(PREFETCH_START_DELAY_MSEC);
+    QObject::connect(&this->start_timer, &QTimer::timeout, [this](){this->schedule_next();});
+
+    // Realtime budget is back, continue prefetching.
+    QObject::connect(&Singleton<Job_scheduler>::get_instance(), &Job_scheduler::budget_available, this, [this]()
+    {
+        if ((this->decoding_slot < 0) && (this->start_timer.isActive() == false))
+        {
+            this->schedule_next();
+        }
+    });
+
+    return;
+}
+
+Audio_track_prefetch_pool::~Audio_track_prefetch_pool()
+{
+    // Stop a running decoding (it does not wait for the realtime budget anymore).
+    this->start_timer.stop();
+    this->decoding_canceled = 1;
+    this->decoding_watcher.waitForFinished();
+
+    return;
+}
+
+void
+Audio_track_prefetch_pool::set_candidates(const QStringList &paths)
+{
+    // Keep only the most probable tracks, the pool can not hold more.
+    this->candidates.clear();
+    foreach (QString path, paths)
+    {
+        if ((this->candidates.size() < this->max_nb_slots) &&
+            (path != "") && (this->candidates.contains(path) == false))
+        {
+            this->candidates << path;
+        }
+    }
+    this->failed_paths.clear();
+
+    // Decode them a bit later.
+    if (this->max_nb_slots > 0)
+    {
+        this->start_timer.start();
+    }
+
+    return;
+}
+
+bool
+Audio_track_prefetch_pool::take(const QString                     &path,
+                                const QSharedPointer<Audio_track> &deck_at)
+{
+    int index = this->find_slot(path);
+    if (index < 0)
+    {
+        return false;
+    }
+
+    // The track is still being decoded at idle priority (and maybe paused), do not wait for it:
+    // it is canceled and the caller decodes the track itself at full speed.
+    if (this->pool_slots[index].state == Prefetch_state::DECODING)
+    {
+        this->decoding_canceled = 1;
+        this->candidates.removeAll(path);
+        qCDebug(DS_FILE) << "prefetch of track canceled:" << qPrintable(path);
+        return false;
+    }
+    if (this->pool_slots[index].state != Prefetch_state::READY)
+    {
+        return false;
+    }
+
+    // Exchange buffers, the slot gets the old deck buffer which is now free.
+    Prefetch_slot &slot = this->pool_slots[index];
+    if (deck_at->swap(*slot.at) == false)
+    {
+        return false;
+    }
+    slot.state = Prefetch_state::FREE;
+    slot.path  = "";
+    this->candidates.removeAll(path);
+    qCDebug(DS_FILE) << "prefetched track loaded:" << qPrintable(path);
+
+    // A slot is free again, use it.
+    this->start_timer.start();
+
+    return true;
+}
+
+void
+Audio_track_prefetch_pool::schedule_next()
+{
+    // Only one decoding at a time and only if the audio thread is at ease.
+    if ((this->max_nb_slots == 0) ||
+        (this->decoding_slot >= 0) ||
+        (Singleton<Job_scheduler>::get_instance().must_pause(Job_priority::PREFETCH) == true))
+    {
+        return;
+    }
+
+    // Get the most probable candidate which is not yet in the pool.
+    foreach (QString path, this->candidates)
+    {
+        if ((this->find_slot(path) >= 0) || (this->failed_paths.contains(path) == true))
+        {
+            continue;
+        }
+
+        // Get a slot for it.
+        int index = this->get_victim_slot();
+        if (index < 0)
+        {
+            return;
+        }
+        Prefetch_slot &slot = this->pool_slots[index];
+        slot.path  = path;
+        slot.state = Prefetch_state::DECODING;
+        this->decoding_slot     = index;
+        this->decoding_canceled = 0;
+
+        // Decode it in background at idle priority.
+        QSharedPointer<Audio_file_decoding_process> decoder = slot.decoder;
+        this->decoding_watcher.setFuture(Singleton<Job_scheduler>::get_instance().run<bool>(Job_priority::PREFETCH, [decoder, path]()
+        {
+            return decoder->run(path);
+        }));
+
+        return;
+    }
+
+    return;
+}
+
+int
+Audio_track_prefetch_pool::find_slot(const QString &path)
+{
+    for (int i = 0; i < this->pool_slots.size(); i++)
+    {
+        if ((this->pool_slots[i].state != Prefetch_state::FREE) && (this->pool_slots[i].path == path))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+int
+Audio_track_prefetch_pool::get_victim_slot()
+{
+    // Use a free slot.
+    for (int i = 0; i < this->pool_slots.size(); i++)
+    {
+        if (this->pool_slots[i].state == Prefetch_state::FREE)
+        {
+            return i;
+        }
+    }
+
+    // Create a new slot (tracks are allocated only when needed).
+    if (this->pool_slots.size() < this->max_nb_slots)
+    {
+        Prefetch_slot slot;
+        slot.at       = QSharedPointer<Audio_track>(new Audio_track(MAX_MINUTES_TRACK, this->sample_rate));
+        slot.decoder  = QSharedPointer<Audio_file_decoding_process>(new Audio_file_decoding_process(slot.at));
+        slot.state    = Prefetch_state::FREE;
+        slot.last_use = 0;
+        slot.decoder->set_pause_check([this]()
+        {
+            return (Singleton<Job_scheduler>::get_instance().must_pause_current_job() == true) && (this->decoding_canceled.load() == 0);
+        });
+        slot.decoder->set_cancel_check([this]()
+        {
+            return this->decoding_canceled.load() == 1;
+        });
+        slot.decoder->set_max_nb_threads(1); // Background decoding stays on one core.
+        this->pool_slots << slot;
+
+        return this->pool_slots.size() - 1;
+    }
+
+    // Otherwise evict the least recently used track which is not a candidate anymore.
+    int victim = -1;
+    for (int i = 0; i < this->pool_slots.size(); i++)
+    {
+        if ((this->pool_slots[i].state == Prefetch_state::READY) &&
+            (this->candidates.contains(this->pool_slots[i].path) == false) &&
+            ((victim < 0) || (this->pool_slots[i].last_use < this->pool_slots[victim].last_use)))
+        {
+            victim = i;
+        }
+    }
+    if (victim >= 0)
+    {
+        this->pool_slots[victim].state = Prefetch_state::FREE;
+        this->pool_slots[victim].path  = "";
+    }
+
+    return victim;
+}
+
+bool
+Audio_track_prefetch_pool::is_prefetched(const QString &path)
+{
+    int index = this->find_slot(path);
+
+    return (index >= 0) && (this->pool_slots[index].state == Prefetch_state::READY);
+}
+
+void
+Audio_track_prefetch_pool::on_decoding_finished()
+{
+    this->publish_decoded_slot();
+
+    // Continue with next candidate.
+    this->schedule_next();
+
+    return;
+}
+
+void
+Audio_track_prefetch_pool::publish_decoded_slot()
+{
+    if (this->decoding_slot >= 0)
+    {
+        Prefetch_slot &slot = this->pool_slots[this->decoding_slot];
+        if (this->decoding_canceled.load() == 1)
+        {
+            // Canceled by take(), the slot is free again (the track did not fail).
+            slot.state = Prefetch_state::FREE;
+            slot.path  = "";
+        }
+        else if (this->decoding_watcher.result() == true)
+        {
+            slot.state    = Prefetch_state::READY;
+            slot.last_use = ++this->use_counter;
+            qCDebug(DS_FILE) << "track prefetched:" << qPrintable(slot.path);
+        }
+        else
+        {
+            qCWarning(DS_FILE) << "can not prefetch" << qPrintable(slot.path);
+            this->failed_paths << slot.path;
+            slot.state = Prefetch_state::FREE;
+            slot.path  = "";
+        }
+        this->decoding_slot = -1;
+    }
+
+    return;
+}
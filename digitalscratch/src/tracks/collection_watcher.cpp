@@ -0,0 +1,403 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*-------------------------------------------------( collection_watcher.cpp )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: watch the tracks base directory (inotify) and report      */
+/*                  changed and removed audio files.                          */
+/*                                                                            */
+/*============================================================================*/
+
+#include <QtDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+
+#ifdef __linux__
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#define WATCHER_DIR_EVENTS (IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR)
+#define WATCHER_BUFFER     (64*1024)
+#endif
+
+#include "tracks/collection_watcher.h"
+#include "app/job_scheduler.h"
+#include "app/application_logging.h"
+#include "utils.h"
+#include "singleton.h"
+
+Collection_watcher::Collection_watcher()
+{
+    this->fd            = -1;
+    this->notifier      = nullptr;
+    this->is_stopping   = 0;
+    this->limit_reached = false;
+
+    // Report changes only when the file system is quiet (e.g. at the end of an album copy).
+    this->flush_timer.setSingleShot(true);
+    this->flush_timer.setInterval(WATCHER_FLUSH_DELAY_MSEC);
+    QObject::connect(&this->flush_timer, &QTimer::timeout, [this](){this->flush();});
+
+    // Subtrees which can not be watched are polled.
+    this->rescan_timer.setInterval(WATCHER_RESCAN_MSEC);
+    QObject::connect(&this->rescan_timer, &QTimer::timeout, [this](){this->rescan_unwatched();});
+
+    return;
+}
+
+Collection_watcher::~Collection_watcher()
+{
+    this->stop();
+
+    return;
+}
+
+bool
+Collection_watcher::set_root_path(const QString &path)
+{
+    this->stop();
+    this->root_path = QDir(path).absolutePath();
+
+#ifdef __linux__
+    // One inotify instance, events are read in the GUI thread.
+    this->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (this->fd < 0)
+    {
+        qCWarning(DS_FILE) << "can not watch the audio collection:" << strerror(errno);
+        return false;
+    }
+    this->notifier = new QSocketNotifier(this->fd, QSocketNotifier::Read);
+    QObject::connect(this->notifier, &QSocketNotifier::activated, [this](){this->read_events();});
+
+    // Watch the whole tree in background (there can be thousands of directories).
+    this->start_watching(this->root_path, false);
+
+    return true;
+#else
+    qCDebug(DS_FILE) << "watching the audio collection is not supported on this system";
+
+    return false;
+#endif
+}
+
+void
+Collection_watcher::stop()
+{
+    // Wait for background listings, they use the inotify instance.
+    this->is_stopping = 1;
+    this->watches_jobs.waitForFinished();
+    this->watches_jobs.clearFutures();
+    this->is_stopping = 0;
+    this->flush_timer.stop();
+    this->rescan_timer.stop();
+
+    if (this->notifier != nullptr)
+    {
+        delete this->notifier;
+        this->notifier = nullptr;
+    }
+#ifdef __linux__
+    if (this->fd >= 0)
+    {
+        close(this->fd);
+        this->fd = -1;
+    }
+#endif
+
+    this->mutex.lock();
+    this->dir_by_watch.clear();
+    this->changed_paths.clear();
+    this->removed_paths.clear();
+    this->unwatched_dirs.clear();
+    this->mutex.unlock();
+    this->limit_reached = false;
+
+    return;
+}
+
+void
+Collection_watcher::start_watching(const QString &dir_path,
+                                   const bool    &report_files)
+{
+    this->watches_jobs.addFuture(Singleton<Job_scheduler>::get_instance().run<bool>(Job_priority::PREFETCH, [this, dir_path, report_files]()
+    {
+        return this->add_watches(dir_path, report_files);
+    }));
+
+    return;
+}
+
+bool
+Collection_watcher::add_watches(const QString &dir_path,
+                                const bool    &report_files)
+{
+#ifdef __linux__
+    // Watch the directory first, so files created meanwhile in it are not missed.
+    QStringList dirs;
+    dirs << dir_path;
+    QDirIterator i(dir_path, QDir::AllDirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories | QDirIterator::FollowSymlinks);
+    while (i.hasNext() == true)
+    {
+        dirs << i.next();
+    }
+
+    foreach (const QString &dir, dirs)
+    {
+        if (this->is_stopping.load() == 1)
+        {
+            return false;
+        }
+        int watch = inotify_add_watch(this->fd, QFile::encodeName(dir).constData(), WATCHER_DIR_EVENTS);
+        if (watch < 0)
+        {
+            // Only one warning when the limit of watches is reached.
+            bool is_limit = (errno == ENOSPC);
+            this->mutex.lock();
+            bool was_reached = this->limit_reached;
+            this->limit_reached = this->limit_reached || is_limit;
+            this->mutex.unlock();
+            if ((was_reached == false) && (is_limit == true))
+            {
+                qCWarning(DS_FILE) << "too many directories to watch, increase fs.inotify.max_user_watches (others are listed every" << WATCHER_RESCAN_MSEC / 1000 << "sec)";
+            }
+            if (is_limit == true)
+            {
+                this->add_unwatched(dir);
+            }
+            continue;
+        }
+        this->mutex.lock();
+        this->dir_by_watch.insert(watch, dir);
+        this->mutex.unlock();
+
+        // Files which are already there (e.g. a directory moved in the collection).
+        if (report_files == true)
+        {
+            QDir qdir(dir);
+            qdir.setFilter(QDir::Files);
+            this->mutex.lock();
+            foreach (const QString &name, qdir.entryList())
+            {
+                if (this->is_audio_file(name) == true)
+                {
+                    this->changed_paths.insert(qdir.absoluteFilePath(name));
+                }
+            }
+            this->mutex.unlock();
+        }
+    }
+
+    // Report them from the GUI thread.
+    if (report_files == true)
+    {
+        QMetaObject::invokeMethod(&this->flush_timer, "start", Qt::QueuedConnection);
+    }
+
+    return true;
+#else
+    Q_UNUSED(dir_path);
+    Q_UNUSED(report_files);
+
+    return false;
+#endif
+}
+
+void
+Collection_watcher::remove_watches(const QString &dir_path)
+{
+#ifdef __linux__
+    // The directory is not under the root anymore, its watches would report wrong paths.
+    this->mutex.lock();
+    QMutableHashIterator<int, QString> i(this->dir_by_watch);
+    while (i.hasNext() == true)
+    {
+        i.next();
+        if ((i.value() == dir_path) || (i.value().startsWith(dir_path + "/") == true))
+        {
+            inotify_rm_watch(this->fd, i.key());
+            i.remove();
+        }
+    }
+    this->mutex.unlock();
+#else
+    Q_UNUSED(dir_path);
+#endif
+
+    return;
+}
+
+void
+Collection_watcher::add_unwatched(const QString &dir_path)
+{
+    // Subdirectories of an unwatched directory are rescanned with it.
+    this->mutex.lock();
+    bool is_new = true;
+    foreach (const QString &dir, this->unwatched_dirs)
+    {
+        if ((dir == dir_path) || (dir_path.startsWith(dir + "/") == true))
+        {
+            is_new = false;
+            break;
+        }
+    }
+    if (is_new == true)
+    {
+        this->unwatched_dirs << dir_path;
+    }
+    bool is_first = (this->unwatched_dirs.size() == 1);
+    this->mutex.unlock();
+
+    // Start polling from the GUI thread.
+    if ((is_new == true) && (is_first == true))
+    {
+        QMetaObject::invokeMethod(&this->rescan_timer, "start", Qt::QueuedConnection);
+    }
+
+    return;
+}
+
+void
+Collection_watcher::rescan_unwatched()
+{
+    this->mutex.lock();
+    QStringList dirs = this->unwatched_dirs;
+    this->mutex.unlock();
+
+    foreach (const QString &dir, dirs)
+    {
+        emit this->rescan_needed(dir);
+    }
+
+    return;
+}
+
+void
+Collection_watcher::read_events()
+{
+#ifdef __linux__
+    char buffer[WATCHER_BUFFER] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t nb_bytes;
+    while ((nb_bytes = read(this->fd, buffer, sizeof(buffer))) > 0)
+    {
+        for (char *pos = buffer; pos < buffer + nb_bytes;)
+        {
+            struct inotify_event *event = (struct inotify_event *)pos;
+            pos += sizeof(struct inotify_event) + event->len;
+
+            // Events were dropped by the kernel: list the whole tree again, and watch directories created meanwhile.
+            if ((event->mask & IN_Q_OVERFLOW) != 0)
+            {
+                qCWarning(DS_FILE) << "too many changes in the audio collection, listing it again";
+                emit this->rescan_needed(this->root_path);
+                this->start_watching(this->root_path, false);
+                continue;
+            }
+
+            // Directory deleted (or its file system unmounted).
+            this->mutex.lock();
+            if ((event->mask & IN_IGNORED) != 0)
+            {
+                this->dir_by_watch.remove(event->wd);
+                this->mutex.unlock();
+                continue;
+            }
+            QString dir = this->dir_by_watch.value(event->wd);
+            this->mutex.unlock();
+            if ((dir.isEmpty() == true) || (event->len == 0) || (event->name[0] == '.'))
+            {
+                continue;
+            }
+            QString path = dir + "/" + QFile::decodeName(event->name);
+
+            if ((event->mask & IN_ISDIR) != 0)
+            {
+                if ((event->mask & (IN_CREATE | IN_MOVED_TO)) != 0)
+                {
+                    // New directory: watch it and report the files it already contains.
+                    this->mutex.lock();
+                    this->removed_paths.remove(path);
+                    this->changed_paths.insert(path);
+                    this->mutex.unlock();
+                    this->start_watching(path, true);
+                }
+                else if ((event->mask & (IN_DELETE | IN_MOVED_FROM)) != 0)
+                {
+                    this->remove_watches(path);
+                    this->mutex.lock();
+                    this->changed_paths.remove(path);
+                    this->removed_paths.insert(path);
+                    this->mutex.unlock();
+                }
+            }
+            else if (this->is_audio_file(path) == true)
+            {
+                // A file is reported once it is written (not at creation).
+                this->mutex.lock();
+                if ((event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) != 0)
+                {
+                    this->removed_paths.remove(path);
+                    this->changed_paths.insert(path);
+                }
+                else if ((event->mask & (IN_DELETE | IN_MOVED_FROM)) != 0)
+                {
+                    this->changed_paths.remove(path);
+                    this->removed_paths.insert(path);
+                }
+                this->mutex.unlock();
+            }
+        }
+    }
+    this->flush_timer.start();
+#endif
+
+    return;
+}
+
+void
+Collection_watcher::flush()
+{
+    this->mutex.lock();
+    QStringList changed = this->changed_paths.toList();
+    QStringList removed = this->removed_paths.toList();
+    this->changed_paths.clear();
+    this->removed_paths.clear();
+    this->mutex.unlock();
+
+    if ((changed.isEmpty() == false) || (removed.isEmpty() == false))
+    {
+        emit this->files_changed(changed, removed);
+    }
+
+    return;
+}
+
+bool
+Collection_watcher::is_audio_file(const QString &name)
+{
+    return Utils::audio_file_extensions.contains(QFileInfo(name).suffix(), Qt::CaseInsensitive);
+}
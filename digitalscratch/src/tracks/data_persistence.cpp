@@ -36,6 +36,7 @@
 #include <QDir>
 #include <QSqlQuery>
 #include <QDateTime>
+#include <QMap>
 #include <QStandardPaths>
 
 #include "utils.h"
@@ -43,6 +44,21 @@
 #include "app/application_logging.h"
 #include "tracks/data_persistence.h"
 
+Data_persistence_connection::~Data_persistence_connection()
+{
+    // Statements must be released before the connection.
+    qDeleteAll(this->queries);
+    this->queries.clear();
+    if (this->db.isValid() == true)
+    {
+        this->db.close();
+    }
+    this->db = QSqlDatabase();
+    QSqlDatabase::removeDatabase(this->name);
+
+    return;
+}
+
 Data_persistence::Data_persistence() // FIXME: rename to Audio_track_persistence ?
 {
     this->is_initialized = this->init_db();
@@ -52,11 +68,9 @@ Data_persistence::Data_persistence() // FIXME: rename to Audio_track_persistence
 
 Data_persistence::~Data_persistence()
 {
+    // Close the connection of this thread (others are closed when their thread ends).
     this->mutex.lock();
-    if (this->db.isValid() == true)
-    {
-        this->db.close();
-    }
+    this->connections.setLocalData(nullptr);
     this->mutex.unlock();
 
     return;
@@ -64,42 +78,38 @@ Data_persistence::~Data_persistence()
 
 bool Data_persistence::init_db()
 {
-    // Create DB.
-    this->mutex.lock();
-    this->db = QSqlDatabase::addDatabase("QSQLITE");
+    // Path of the DB.
     QFileInfo path_info(QStandardPaths::writableLocation(QStandardPaths::DataLocation) + "/digitalscratch.sqlite");
-    this->db.setDatabaseName(path_info.absoluteFilePath());
+    this->db_path = path_info.absoluteFilePath();
 
     // Make sure path exists, if not create it.
     QDir dir;
     dir.mkpath(path_info.absolutePath());
-
-#ifndef ENABLE_TEST_MODE
-    // Backup previous DB file if it exists.
-    this->backup_db();
-#endif
+    bool is_existing_db = path_info.exists();
 
     // Open DB.
-    if (this->db.open() == false)
+    QSqlDatabase db = this->get_db();
+    if (db.isOpen() == false)
     {
-        qCWarning(DS_DB) << "cannot open DB:" << this->db.lastError().text();
         return false;
     }
-    else
+
+    // Readers do not wait for the writer and the writer does not wait for readers (kept in the DB file).
+    QSqlQuery query(db);
+    if (query.exec("PRAGMA journal_mode = WAL") == false)
     {
-        // Enable foreign key support.
-        QSqlQuery query;
-        if (query.exec("PRAGMA foreign_keys = ON") == false)
-        {
-            return false;
-        }
+        qCWarning(DS_DB) << "cannot enable WAL:" << query.lastError().text();
+        return false;
+    }
+    query.finish();
 
-        // Disable wait on write (on hdd).
-        if (query.exec("PRAGMA synchronous = OFF") == false)
-        {
-            return false;
-        }
-    }    
+#ifndef ENABLE_TEST_MODE
+    // Backup previous DB file if it exists.
+    if (is_existing_db == true)
+    {
+        this->backup_db();
+    }
+#endif
 
     // Create DB structure if needed.
     if (this->create_db_structure() == false)
@@ -108,15 +118,13 @@ bool Data_persistence::init_db()
         return false;
     }
 
-    this->mutex.unlock();
-
     return true;
 }
 
 #ifndef ENABLE_TEST_MODE
 void Data_persistence::backup_db()
 {
-    QFileInfo db_file(this->db.databaseName());
+    QFileInfo db_file(this->db_path);
     QString db_dir(db_file.absolutePath());
     QString db_name(db_file.fileName());
     QString timestamp(QDateTime::currentDateTime().toString("yyyyMMdd-HH:mm:ss"));
@@ -125,6 +133,16 @@ void Data_persistence::backup_db()
 
     if (db_file.exists() == true)
     {
+        // Changes committed by a previous session which did not end cleanly can still be in the WAL file:
+        // move them in the DB file (and empty the WAL file) before copying it.
+        QSqlQuery query(this->get_db());
+        if (query.exec("PRAGMA wal_checkpoint(TRUNCATE)") == false)
+        {
+            qCWarning(DS_DB) << "cannot checkpoint WAL before backup:" << query.lastError().text();
+            return;
+        }
+        query.finish();
+
         // Create a backup directory if it does not exists.
         QDir dir;
         dir.mkpath(db_backup_dir);
@@ -148,15 +166,121 @@ void Data_persistence::backup_db()
 }
 #endif
 
+QSqlDatabase Data_persistence::get_db()
+{
+    // Open a connection for the calling thread the first time it needs one.
+    if (this->connections.hasLocalData() == false)
+    {
+        Data_persistence_connection *connection = new Data_persistence_connection();
+        connection->name = "digitalscratch_" + QString::number(this->nb_connections.fetchAndAddOrdered(1));
+        connection->db   = QSqlDatabase::addDatabase("QSQLITE", connection->name);
+        connection->db.setDatabaseName(this->db_path);
+        this->connections.setLocalData(connection);
+
+        if (connection->db.open() == false)
+        {
+            qCWarning(DS_DB) << "cannot open DB:" << connection->db.lastError().text();
+        }
+        else
+        {
+            // Enable foreign key support, disable wait on write (on hdd)
+            // and wait for a writer of another process instead of failing.
+            QSqlQuery query(connection->db);
+            if ((query.exec("PRAGMA foreign_keys = ON")  == false) ||
+                (query.exec("PRAGMA synchronous = OFF")  == false) ||
+                (query.exec("PRAGMA busy_timeout = 5000") == false))
+            {
+                qCWarning(DS_DB) << "cannot configure DB connection:" << query.lastError().text();
+            }
+        }
+    }
+
+    return this->connections.localData()->db;
+}
+
+QSqlQuery &Data_persistence::get_query(const QString &sql)
+{
+    // Get the statement, prepare it only the first time it is used by this thread.
+    this->get_db();
+    Data_persistence_connection *connection = this->connections.localData();
+    QSqlQuery *query = connection->queries.value(sql, nullptr);
+    if (query == nullptr)
+    {
+        query = new QSqlQuery(connection->db);
+        query->setForwardOnly(true);
+        if (query->prepare(sql) == false)
+        {
+            qCWarning(DS_DB) << "cannot prepare statement:" << query->lastError().text();
+        }
+        connection->queries.insert(sql, query);
+    }
+    else
+    {
+        // Reset the statement previously used.
+        query->finish();
+    }
+
+    return *query;
+}
+
+bool Data_persistence::begin_write()
+{
+    // SQLite allows only one writer, changes of a write are committed together.
+    this->mutex.lock();
+    QSqlDatabase db = this->get_db();
+    if (db.transaction() == false)
+    {
+        qCWarning(DS_DB) << "cannot start transaction:" << db.lastError().text();
+        this->mutex.unlock();
+        return false;
+    }
+
+    return true;
+}
+
+bool Data_persistence::end_write(const bool &is_ok)
+{
+    // Init result.
+    bool result = is_ok;
+
+    // Statements still reading prevent the commit.
+    foreach (QSqlQuery *query, this->connections.localData()->queries)
+    {
+        query->finish();
+    }
+
+    // Commit or rollback changes.
+    QSqlDatabase db = this->get_db();
+    if (is_ok == true)
+    {
+        if (db.commit() == false)
+        {
+            qCWarning(DS_DB) << "COMMIT failed: " << db.lastError().text();
+            db.rollback();
+            result = false;
+        }
+    }
+    else
+    {
+        db.rollback();
+    }
+
+    // Release the writer.
+    this->mutex.unlock();
+
+    return result;
+}
+
 bool Data_persistence::create_db_structure()
 {
     // Init.
     bool result = true;
+    QSqlDatabase db = this->get_db();
 
     // Create DB structure
-    if (this->db.isOpen() == true)
+    if (db.isOpen() == true)
     {
-        QSqlQuery query;
+        QSqlQuery query(db);
 
         // Create TRACK table
         result = query.exec("CREATE TABLE IF NOT EXISTS \"TRACK\" "
@@ -166,7 +290,56 @@ bool Data_persistence::create_db_structure()
                             " \"key\" VARCHAR, "
                             " \"key_tag\" VARCHAR, "
                             " \"path\" VARCHAR, "
-                            " \"filename\" VARCHAR);");
+                            " \"filename\" VARCHAR, "
+                            " \"first_beat\" INTEGER, "
+                            " \"loudness\" REAL, "
+                            " \"is_legacy_hash\" INTEGER NOT NULL DEFAULT 0, "
+                            " \"is_analyzed\" INTEGER NOT NULL DEFAULT 0);");
+
+        // Add columns missing in TRACK table created by previous versions.
+        if (result == true)
+        {
+            QMap<QString, QString> new_columns;
+            new_columns.insert("first_beat",     "INTEGER");
+            new_columns.insert("loudness",       "REAL");
+            new_columns.insert("is_legacy_hash", "INTEGER NOT NULL DEFAULT 0");
+            new_columns.insert("is_analyzed",    "INTEGER NOT NULL DEFAULT 0");
+            QSqlQuery query_columns("PRAGMA table_info(TRACK)", db);
+            while (query_columns.next() == true)
+            {
+                new_columns.remove(query_columns.value(1).toString());
+            }
+            query_columns.finish();
+            QMapIterator<QString, QString> column(new_columns);
+            while ((result == true) && (column.hasNext() == true))
+            {
+                column.next();
+                result = query.exec("ALTER TABLE TRACK ADD COLUMN \"" + column.key() + "\" " + column.value() + ";");
+            }
+
+            // All tracks stored by previous versions are identified by the legacy hash.
+            if ((result == true) && (new_columns.contains("is_legacy_hash") == true))
+            {
+                result = query.exec("UPDATE TRACK SET is_legacy_hash = 1;");
+            }
+
+            // Previous versions always stored a key once a track was analyzed.
+            if ((result == true) && (new_columns.contains("is_analyzed") == true))
+            {
+                result = query.exec("UPDATE TRACK SET is_analyzed = 1 WHERE key IS NOT NULL AND key != '';");
+            }
+        }
+
+        // Legacy hashes of files are only computed while some tracks are not migrated.
+        if (result == true)
+        {
+            result = query.exec("SELECT COUNT(*) FROM TRACK WHERE is_legacy_hash = 1;");
+            if ((result == true) && (query.next() == true))
+            {
+                this->nb_legacy_tracks.store(query.value(0).toInt());
+            }
+            query.finish();
+        }
 
         // Add an index on TRACK.hash which will be the main key to search a track.
         if (result == true)
@@ -204,6 +377,34 @@ bool Data_persistence::create_db_structure()
                                 " FOREIGN KEY(id_track) REFERENCES TRACK(id_track), "
                                 " FOREIGN KEY(id_tag) REFERENCES TAG(id_tag));");
         }
+
+        // Add an index on TRACK_TAG (id_tag, position), the track list of a tag is read (and appended) in order.
+        if (result == true)
+        {
+            result = query.exec("CREATE INDEX IF NOT EXISTS index_TRACK_TAG_id_tag_position on TRACK_TAG (id_tag, position);");
+        }
+
+        // Create TRACK_WAVEFORM table (frequency band energies, depends on the sample rate of decoded track).
+        if (result == true)
+        {
+            result = query.exec("CREATE TABLE IF NOT EXISTS \"TRACK_WAVEFORM\" "
+                                "(\"id_waveform\" INTEGER PRIMARY KEY  AUTOINCREMENT  NOT NULL  UNIQUE , "
+                                " \"id_track\" INTEGER  NOT NULL  UNIQUE, "
+                                " \"sample_rate\" INTEGER  NOT NULL, "
+                                " \"bands\" BLOB  NOT NULL, "
+                                " FOREIGN KEY(id_track) REFERENCES TRACK(id_track));");
+        }
+
+        // Create FILE_IDENTITY table (cache of file hashes, computed again only if the file changed).
+        if (result == true)
+        {
+            result = query.exec("CREATE TABLE IF NOT EXISTS \"FILE_IDENTITY\" "
+                                "(\"path\" VARCHAR PRIMARY KEY  NOT NULL , "
+                                " \"size\" INTEGER  NOT NULL, "
+                                " \"mtime\" INTEGER  NOT NULL, "
+                                " \"inode\" INTEGER  NOT NULL, "
+                                " \"hash\" VARCHAR  NOT NULL);");
+        }
     }
     else
     {
@@ -217,7 +418,45 @@ bool Data_persistence::create_db_structure()
 
 bool Data_persistence::rollback_transaction()
 {
-    return this->db.rollback();
+    return this->get_db().rollback();
+}
+
+int Data_persistence::get_track_id(const QString &hash)
+{
+    int id_track = -1;
+
+    QSqlQuery &query = this->get_query("SELECT id_track FROM TRACK WHERE hash = :hash");
+    query.bindValue(":hash", hash);
+    if (query.exec() == false)
+    {
+        qCWarning(DS_DB) << "SELECT track failed: " << query.lastError().text();
+    }
+    else if (query.next() == true) // Check if there is a record.
+    {
+        id_track = query.value(0).toInt();
+    }
+    query.finish();
+
+    return id_track;
+}
+
+int Data_persistence::get_tag_id(const QString &name)
+{
+    int id_tag = -1;
+
+    QSqlQuery &query = this->get_query("SELECT id_tag FROM TAG WHERE name = :name");
+    query.bindValue(":name", name);
+    if (query.exec() == false)
+    {
+        qCWarning(DS_DB) << "SELECT tag failed: " << query.lastError().text();
+    }
+    else if (query.next() == true) // Check if there is a record.
+    {
+        id_tag = query.value(0).toInt();
+    }
+    query.finish();
+
+    return id_tag;
 }
 
 bool Data_persistence::store_audio_track(const QSharedPointer<Audio_track> &at)
@@ -236,68 +475,157 @@ bool Data_persistence::store_audio_track(const QSharedPointer<Audio_track> &at)
     if ((result == true) &&
         (this->is_initialized == true))
     {
-        // Ensure no other thread can access the DB connection.
-        this->mutex.lock();
+        if (this->begin_write() == false)
+        {
+            result = false;
+        }
+        else
+        {
+            int id_track = -1;
+            result = this->end_write(this->write_audio_track(at, id_track));
+        }
+    }
+    else
+    {
+        // Db not open.
+        qCWarning(DS_DB) << "can not store audio track: db not open";
+        result = false;
+    }
+
+    return result;
+}
+
+bool Data_persistence::store_audio_tracks(const QList<QSharedPointer<Audio_track>> &tracks,
+                                          const QList<QByteArray>                 &bands)
+{
+    // Init result.
+    bool result = true;
+
+    // Check input parameters.
+    if (bands.size() != tracks.size())
+    {
+        qCWarning(DS_DB) << "can not store audio tracks: wrong params.";
+        result = false;
+    }
+    for (int i = 0; (result == true) && (i < tracks.size()); i++)
+    {
+        if ((tracks[i].data() == nullptr) ||
+            (tracks[i]->get_hash().size() == 0))
+        {
+            qCWarning(DS_DB) << "can not store audio tracks: wrong params.";
+            result = false;
+        }
+    }
 
-        // Try to get audio track from Db.
-        QSqlQuery query = this->db.exec("SELECT id_track, path, filename, key, key_tag FROM TRACK WHERE hash=\"" + at->get_hash() + "\"");
-        if (query.lastError().isValid())
+    // Insert or update all tracks in one transaction (much faster than one per track).
+    if ((result == true) &&
+        (tracks.size() > 0) &&
+        (this->is_initialized == true))
+    {
+        if (this->begin_write() == false)
         {
-            qCWarning(DS_DB) << "SELECT track failed: " << query.lastError().text();
             result = false;
         }
-        else if (query.next() == true) // Check if there is a record.
+        else
         {
-            // An audio track with same hash already exists, update it if at least one element changed.
-            if ((query.value(1) != at->get_path()) ||
-                (query.value(2) != at->get_filename()) ||
-                (query.value(3) != at->get_music_key()) ||
-                (query.value(4) != at->get_music_key_tag()))
+            for (int i = 0; (result == true) && (i < tracks.size()); i++)
             {
-                int existing_id = query.value(0).toInt();
-                query.prepare("UPDATE TRACK SET path = :path, filename = :filename, key = :key, key_tag = :key_tag "
-                              "WHERE id_track = :id_track");
-                query.bindValue(":path",     at->get_path());
-                query.bindValue(":filename", at->get_filename());
-                query.bindValue(":key",      at->get_music_key());
-                query.bindValue(":key_tag",  at->get_music_key_tag());
-                query.bindValue(":id_track", QString::number(existing_id));
-                query.exec();
-
-                if (query.lastError().isValid())
+                int id_track = -1;
+                result = this->write_audio_track(tracks[i], id_track);
+                if ((result == true) && (bands[i].size() > 0))
                 {
-                    qCWarning(DS_DB) << "UPDATE track failed: " << query.lastError().text();
-                    result = false;
+                    result = this->write_waveform_bands(tracks[i], id_track, bands[i]);
                 }
             }
+            result = this->end_write(result);
         }
-        else
+    }
+    else if (this->is_initialized == false)
+    {
+        result = false;
+    }
+
+    return result;
+}
+
+bool Data_persistence::write_audio_track(const QSharedPointer<Audio_track> &at,
+                                         int                               &out_id_track)
+{
+    // Init result.
+    bool result = true;
+    out_id_track = -1;
+
+    // Try to get audio track from Db.
+    QSqlQuery &query = this->get_query("SELECT id_track, path, filename, key, key_tag, bpm, first_beat, loudness, is_analyzed FROM TRACK WHERE hash = :hash");
+    query.bindValue(":hash", at->get_hash());
+    if (query.exec() == false)
+    {
+        qCWarning(DS_DB) << "SELECT track failed: " << query.lastError().text();
+        result = false;
+    }
+    else if (query.next() == true) // Check if there is a record.
+    {
+        // An audio track with same hash already exists, update it if at least one element changed.
+        // A track without bpm keeps the stored bpm and beat grid, a track once analyzed stays analyzed.
+        out_id_track = query.value(0).toInt();
+        bool is_bpm_changed = (at->get_bpm() > 0.0) &&
+                              ((query.value(5).toFloat() != at->get_bpm()) ||
+                               (query.value(6).toUInt()  != at->get_first_beat()));
+        bool is_loudness_changed = (at->get_loudness() != 0.0) && (query.value(7).toFloat() != at->get_loudness());
+        bool is_analyzed_changed = (at->is_analyzed() == true) && (query.value(8).toBool() == false);
+        bool is_changed = (query.value(1) != at->get_path()) ||
+                          (query.value(2) != at->get_filename()) ||
+                          (query.value(3) != at->get_music_key()) ||
+                          (query.value(4) != at->get_music_key_tag()) ||
+                          (is_bpm_changed == true) ||
+                          (is_loudness_changed == true) ||
+                          (is_analyzed_changed == true);
+        query.finish();
+        if (is_changed == true)
         {
-            // No existing audio track found, insert it in DB.
-            query.prepare("INSERT INTO TRACK (hash, path, filename, key, key_tag) "
-                          "VALUES (:hash, :path, :filename, :key, :key_tag)");
-            query.bindValue(":hash",     at->get_hash());
-            query.bindValue(":path",     at->get_path());
-            query.bindValue(":filename", at->get_filename());
-            query.bindValue(":key",      at->get_music_key());
-            query.bindValue(":key_tag",  at->get_music_key_tag());
-            query.exec();
-
-            if (query.lastError().isValid())
+            QSqlQuery &query_update = this->get_query("UPDATE TRACK SET path = :path, filename = :filename, key = :key, key_tag = :key_tag, "
+                                                      "bpm = COALESCE(:bpm, bpm), first_beat = COALESCE(:first_beat, first_beat), "
+                                                      "loudness = COALESCE(:loudness, loudness), is_analyzed = MAX(is_analyzed, :is_analyzed) "
+                                                      "WHERE id_track = :id_track");
+            query_update.bindValue(":path",        at->get_path());
+            query_update.bindValue(":filename",    at->get_filename());
+            query_update.bindValue(":key",         at->get_music_key());
+            query_update.bindValue(":key_tag",     at->get_music_key_tag());
+            query_update.bindValue(":bpm",         at->get_bpm() > 0.0 ? QVariant(at->get_bpm())        : QVariant(QVariant::Double));
+            query_update.bindValue(":first_beat",  at->get_bpm() > 0.0 ? QVariant(at->get_first_beat()) : QVariant(QVariant::UInt));
+            query_update.bindValue(":loudness",    at->get_loudness() != 0.0 ? QVariant(at->get_loudness()) : QVariant(QVariant::Double));
+            query_update.bindValue(":is_analyzed", at->is_analyzed() == true ? 1 : 0);
+            query_update.bindValue(":id_track",    out_id_track);
+            if (query_update.exec() == false)
             {
-                qCWarning(DS_DB) << "INSERT track failed: " << query.lastError().text();
+                qCWarning(DS_DB) << "UPDATE track failed: " << query_update.lastError().text();
                 result = false;
             }
         }
-
-        // Release the DB connection.
-        this->mutex.unlock();
     }
     else
     {
-        // Db not open.
-        qCWarning(DS_DB) << "can not store audio track: db not open";
-        result = false;
+        // No existing audio track found, insert it in DB.
+        QSqlQuery &query_insert = this->get_query("INSERT INTO TRACK (hash, path, filename, key, key_tag, bpm, first_beat, loudness, is_analyzed) "
+                                                  "VALUES (:hash, :path, :filename, :key, :key_tag, :bpm, :first_beat, :loudness, :is_analyzed)");
+        query_insert.bindValue(":hash",        at->get_hash());
+        query_insert.bindValue(":path",        at->get_path());
+        query_insert.bindValue(":filename",    at->get_filename());
+        query_insert.bindValue(":key",         at->get_music_key());
+        query_insert.bindValue(":key_tag",     at->get_music_key_tag());
+        query_insert.bindValue(":bpm",         at->get_bpm() > 0.0 ? QVariant(at->get_bpm())        : QVariant(QVariant::Double));
+        query_insert.bindValue(":first_beat",  at->get_bpm() > 0.0 ? QVariant(at->get_first_beat()) : QVariant(QVariant::UInt));
+        query_insert.bindValue(":loudness",    at->get_loudness() != 0.0 ? QVariant(at->get_loudness()) : QVariant(QVariant::Double));
+        query_insert.bindValue(":is_analyzed", at->is_analyzed() == true ? 1 : 0);
+        if (query_insert.exec() == false)
+        {
+            qCWarning(DS_DB) << "INSERT track failed: " << query_insert.lastError().text();
+            result = false;
+        }
+        else
+        {
+            out_id_track = query_insert.lastInsertId().toInt();
+        }
     }
 
     return result;
@@ -320,11 +648,9 @@ bool Data_persistence::get_audio_track(QSharedPointer<Audio_track> &io_at)
     if ((result == true) &&
         (this->is_initialized == true))
     {
-        // Ensure no other thread can access the DB connection.
-        this->mutex.lock();
-
-        QSqlQuery query = this->db.exec("SELECT key, key_tag, path, filename FROM TRACK WHERE hash=\"" + io_at->get_hash() + "\"");
-        if (query.lastError().isValid())
+        QSqlQuery &query = this->get_query("SELECT key, key_tag, path, filename, bpm, first_beat, loudness, is_analyzed FROM TRACK WHERE hash = :hash");
+        query.bindValue(":hash", io_at->get_hash());
+        if (query.exec() == false)
         {
             qCWarning(DS_DB) << "SELECT track failed: " << query.lastError().text();
             result = false;
@@ -335,15 +661,59 @@ bool Data_persistence::get_audio_track(QSharedPointer<Audio_track> &io_at)
             io_at->set_music_key(query.value(0).toString());
             io_at->set_music_key_tag(query.value(1).toString());
             io_at->set_fullpath(query.value(2).toString() + "/" + query.value(3).toString());
+            io_at->set_bpm(query.value(4).toFloat());
+            io_at->set_first_beat(query.value(5).toUInt());
+            io_at->set_loudness(query.value(6).toFloat());
+            io_at->set_analyzed(query.value(7).toBool());
         }
         else
         {
             // Audio track not found.
             result = false;
         }
+        query.finish();
+    }
 
-        // Release the DB connection.
-        this->mutex.unlock();
+    return result;
+}
+
+bool Data_persistence::get_audio_tracks_data(QHash<Hash_128, Audio_track_data> &out_data)
+{
+    // Init result.
+    bool result = true;
+    out_data.clear();
+
+    // Read all tracks in one pass (rows are not kept by the query).
+    if (this->is_initialized == true)
+    {
+        QSqlQuery &query = this->get_query("SELECT hash, key, bpm, first_beat, loudness, is_analyzed FROM TRACK");
+        if (query.exec() == false)
+        {
+            qCWarning(DS_DB) << "SELECT tracks data failed: " << query.lastError().text();
+            result = false;
+        }
+        else
+        {
+            Hash_128         hash;
+            Audio_track_data data;
+            while (query.next() == true)
+            {
+                if (Utils::get_hash_128(query.value(0).toString(), hash) == true) // Skip tracks without a valid hash.
+                {
+                    data.key        = Utils::get_camelot_index(query.value(1).toString());
+                    data.bpm        = query.value(2).toFloat();
+                    data.first_beat = query.value(3).toUInt();
+                    data.loudness   = query.value(4).toFloat();
+                    data.analyzed   = query.value(5).toBool();
+                    out_data.insert(hash, data);
+                }
+            }
+        }
+        query.finish();
+    }
+    else
+    {
+        result = false;
     }
 
     return result;
@@ -369,29 +739,22 @@ bool Data_persistence::store_cue_point(const QSharedPointer<Audio_track> &at,
     if ((result == true) &&
         (this->is_initialized == true))
     {
-        // Create audio track if not already in DB.
-        if (this->store_audio_track(at) == false)
+        if (this->begin_write() == false)
         {
             result = false;
         }
         else
         {
-            // Ensure no other thread can access the DB connection.
-            this->mutex.lock();
-
-            // Get audio track id from Db.
-            QSqlQuery query_at = this->db.exec("SELECT id_track FROM TRACK WHERE hash=\"" + at->get_hash() + "\"");
-            if (query_at.lastError().isValid())
-            {
-                qCWarning(DS_DB) << "SELECT track failed: " << query_at.lastError().text();
-                result = false;
-            }
-            else if (query_at.next() == true) // Check if there is a record.
+            // Create audio track if not already in DB.
+            int id_track = -1;
+            result = this->write_audio_track(at, id_track);
+            if (result == true)
             {
                 // Audio track found, search for the cue point.
-                QSqlQuery query_cuepoint = this->db.exec(
-                          "SELECT id_cuepoint, position FROM TRACK_CUE_POINT WHERE id_track=\"" + query_at.value(0).toString() + "\" AND number=\"" + QString::number(number) + "\"");
-                if (query_cuepoint.lastError().isValid())
+                QSqlQuery &query_cuepoint = this->get_query("SELECT id_cuepoint, position FROM TRACK_CUE_POINT WHERE id_track = :id_track AND number = :number");
+                query_cuepoint.bindValue(":id_track", id_track);
+                query_cuepoint.bindValue(":number",   number);
+                if (query_cuepoint.exec() == false)
                 {
                     qCWarning(DS_DB) << "SELECT cue_point failed: " << query_cuepoint.lastError().text();
                     result = false;
@@ -402,14 +765,12 @@ bool Data_persistence::store_cue_point(const QSharedPointer<Audio_track> &at,
                     if (query_cuepoint.value(1) != position_msec)
                     {
                         int id_cuepoint = query_cuepoint.value(0).toInt();
-                        query_cuepoint.prepare("UPDATE TRACK_CUE_POINT SET position = :position WHERE id_cuepoint = :id_cuepoint");
-                        query_cuepoint.bindValue(":position", position_msec);
-                        query_cuepoint.bindValue(":id_cuepoint", id_cuepoint);
-                        query_cuepoint.exec();
-
-                        if (query_cuepoint.lastError().isValid())
+                        QSqlQuery &query_update = this->get_query("UPDATE TRACK_CUE_POINT SET position = :position WHERE id_cuepoint = :id_cuepoint");
+                        query_update.bindValue(":position",    position_msec);
+                        query_update.bindValue(":id_cuepoint", id_cuepoint);
+                        if (query_update.exec() == false)
                         {
-                            qCWarning(DS_DB) << "UPDATE cue point failed: " << query_cuepoint.lastError().text();
+                            qCWarning(DS_DB) << "UPDATE cue point failed: " << query_update.lastError().text();
                             result = false;
                         }
                     }
@@ -417,23 +778,19 @@ bool Data_persistence::store_cue_point(const QSharedPointer<Audio_track> &at,
                 else
                 {
                     // No existing cue point found, insert it in DB.
-                    query_cuepoint.prepare("INSERT INTO TRACK_CUE_POINT (id_track, number, position) "
-                                  "VALUES (:id_track, :number, :position)");
-                    query_cuepoint.bindValue(":id_track", query_at.value(0));
-                    query_cuepoint.bindValue(":number",   number);
-                    query_cuepoint.bindValue(":position", position_msec);
-                    query_cuepoint.exec();
-
-                    if (query_cuepoint.lastError().isValid())
+                    QSqlQuery &query_insert = this->get_query("INSERT INTO TRACK_CUE_POINT (id_track, number, position) "
+                                                              "VALUES (:id_track, :number, :position)");
+                    query_insert.bindValue(":id_track", id_track);
+                    query_insert.bindValue(":number",   number);
+                    query_insert.bindValue(":position", position_msec);
+                    if (query_insert.exec() == false)
                     {
-                        qCWarning(DS_DB) << "INSERT cue point failed: " << query_cuepoint.lastError().text();
+                        qCWarning(DS_DB) << "INSERT cue point failed: " << query_insert.lastError().text();
                         result = false;
                     }
                 }
             }
-
-            // Release the DB connection.
-            this->mutex.unlock();
+            result = this->end_write(result);
         }
     }
     else
@@ -462,55 +819,100 @@ bool Data_persistence::get_cue_point(const QSharedPointer<Audio_track> &at,
         result = false;
     }
 
-    // Search the audio track (based on its hash) in DB.
+    // Search the cue point of the audio track (based on its hash) in DB.
     if ((result == true) &&
         (this->is_initialized == true))
     {
-        // Ensure no other thread can access the DB connection.
-        this->mutex.lock();
-
-        QSqlQuery query = this->db.exec("SELECT id_track FROM TRACK WHERE hash=\"" + at->get_hash() + "\"");
-        if (query.lastError().isValid())
+        QSqlQuery &query = this->get_query("SELECT TRACK_CUE_POINT.position FROM TRACK_CUE_POINT "
+                                           "JOIN TRACK ON TRACK.id_track = TRACK_CUE_POINT.id_track "
+                                           "WHERE TRACK.hash = :hash AND TRACK_CUE_POINT.number = :number");
+        query.bindValue(":hash",   at->get_hash());
+        query.bindValue(":number", number);
+        if (query.exec() == false)
         {
-            qCWarning(DS_DB) << "SELECT track failed: " << query.lastError().text();
+            qCWarning(DS_DB) << "SELECT cue point failed: " << query.lastError().text();
             result = false;
         }
         else if (query.next() == true) // Check if there is a record.
         {
-            // The audio track exists, look for the specified cue point.
-            QSqlQuery query_cue_point = this->db.exec(
-                        "SELECT position FROM TRACK_CUE_POINT WHERE id_track=\"" + query.value(0).toString() + "\" AND number=\"" + QString::number(number) + "\"");
-            if (query_cue_point.lastError().isValid())
-            {
-                qCWarning(DS_DB) << "SELECT cue point failed: " << query_cue_point.lastError().text();
-                result = false;
-            }
-            else if (query_cue_point.next() == true) // Check if there is a record.
-            {
-                // The cue point exists, get position.
-                out_position_msec = query_cue_point.value(0).toInt();
-            }
-            else
-            {
-                // Cue point not found.
-                result = false;
-            }
+            // The cue point exists, get position.
+            out_position_msec = query.value(0).toInt();
         }
         else
         {
-            // Audio track not found.
+            // Audio track or cue point not found.
             result = false;
         }
-
-        // Release the DB connection.
-        this->mutex.unlock();
+        query.finish();
     }
 
     return result;
 }
 
-bool Data_persistence::delete_cue_point(const QSharedPointer<Audio_track> &at,
-                                        const unsigned int                &number)
+bool Data_persistence::get_cue_points_and_tags(QSharedPointer<Audio_track> &io_at)
+{
+    // Init result.
+    bool result = true;
+
+    // Check input parameter.
+    if ((io_at.data() == nullptr) ||
+        (io_at->get_hash().size() == 0))
+    {
+        qCWarning(DS_DB) << "can not get cue points and tags: hash not specified.";
+        result = false;
+    }
+
+    // Get cue points (with a number) and tags (with a name) of the track in one query.
+    if ((result == true) &&
+        (this->is_initialized == true))
+    {
+        QSqlQuery &query = this->get_query("SELECT TRACK_CUE_POINT.number, TRACK_CUE_POINT.position, NULL FROM TRACK_CUE_POINT "
+                                           "JOIN TRACK ON TRACK.id_track = TRACK_CUE_POINT.id_track "
+                                           "WHERE TRACK.hash = :hash "
+                                           "UNION ALL "
+                                           "SELECT NULL, NULL, TAG.name FROM TAG "
+                                           "JOIN TRACK_TAG ON TAG.id_tag = TRACK_TAG.id_tag "
+                                           "JOIN TRACK ON TRACK_TAG.id_track = TRACK.id_track "
+                                           "WHERE TRACK.hash = :hash_tag");
+        query.bindValue(":hash",     io_at->get_hash());
+        query.bindValue(":hash_tag", io_at->get_hash());
+        if (query.exec() == false)
+        {
+            qCWarning(DS_DB) << "SELECT cue points and tags failed: " << query.lastError().text();
+            result = false;
+        }
+        else
+        {
+            QStringList tags;
+            for (unsigned int i = 0; i < MAX_NB_CUE_POINTS; i++)
+            {
+                io_at->set_cue_point(i, 0);
+            }
+            while (query.next() == true)
+            {
+                if (query.value(0).isNull() == false)
+                {
+                    io_at->set_cue_point(query.value(0).toUInt(), query.value(1).toUInt());
+                }
+                else
+                {
+                    tags << query.value(2).toString();
+                }
+            }
+            io_at->set_tags(tags);
+        }
+        query.finish();
+    }
+    else
+    {
+        result = false;
+    }
+
+    return result;
+}
+
+bool Data_persistence::store_waveform_bands(const QSharedPointer<Audio_track> &at,
+                                            const QByteArray                  &bands)
 {
     // Init result.
     bool result = true;
@@ -518,46 +920,294 @@ bool Data_persistence::delete_cue_point(const QSharedPointer<Audio_track> &at,
     // Check input parameter.
     if ((at.data() == nullptr) ||
         (at->get_hash().size() == 0) ||
-        (number >= MAX_NB_CUE_POINTS))
+        (bands.size() == 0))
     {
-        qCWarning(DS_DB) << "can not delete cue point: wrong params.";
         result = false;
     }
 
-    // Search the audio track (based on its hash) in DB.
+    // Insert or update band energies for the specified audio track (identified by the hash).
+    if ((result == true) &&
+        (this->is_initialized == true))
+    {
+        if (this->begin_write() == false)
+        {
+            result = false;
+        }
+        else
+        {
+            // Create audio track if not already in DB, then replace its band energies.
+            int id_track = -1;
+            result = this->write_audio_track(at, id_track);
+            if (result == true)
+            {
+                result = this->write_waveform_bands(at, id_track, bands);
+            }
+            result = this->end_write(result);
+        }
+    }
+
+    return result;
+}
+
+bool Data_persistence::write_waveform_bands(const QSharedPointer<Audio_track> &at,
+                                            const int                         &id_track,
+                                            const QByteArray                  &bands)
+{
+    // Init result.
+    bool result = true;
+
+    QSqlQuery &query = this->get_query("INSERT OR REPLACE INTO TRACK_WAVEFORM (id_track, sample_rate, bands) "
+                                       "VALUES (:id_track, :sample_rate, :bands)");
+    query.bindValue(":id_track",    id_track);
+    query.bindValue(":sample_rate", at->get_sample_rate());
+    query.bindValue(":bands",       bands);
+    if (query.exec() == false)
+    {
+        qCWarning(DS_DB) << "INSERT waveform failed: " << query.lastError().text();
+        result = false;
+    }
+
+    return result;
+}
+
+bool Data_persistence::get_waveform_bands(const QSharedPointer<Audio_track> &at,
+                                          QByteArray                        &out_bands)
+{
+    // Init result.
+    bool result = true;
+
+    // Check input parameter.
+    if ((at.data() == nullptr) ||
+        (at->get_hash().size() == 0))
+    {
+        qCWarning(DS_DB) << "can not get waveform: wrong params.";
+        result = false;
+    }
+
+    // Search the band energies of the audio track (based on its hash) in DB.
     if ((result == true) &&
         (this->is_initialized == true))
     {
-        // Ensure no other thread can access the DB connection.
-        this->mutex.lock();
+        QSqlQuery &query = this->get_query("SELECT TRACK_WAVEFORM.sample_rate, TRACK_WAVEFORM.bands FROM TRACK_WAVEFORM "
+                                           "JOIN TRACK ON TRACK.id_track = TRACK_WAVEFORM.id_track "
+                                           "WHERE TRACK.hash = :hash");
+        query.bindValue(":hash", at->get_hash());
+        if (query.exec() == false)
+        {
+            qCWarning(DS_DB) << "SELECT waveform failed: " << query.lastError().text();
+            result = false;
+        }
+        else if ((query.next() == true) && // Check if there is a record.
+                 (query.value(0).toUInt() == at->get_sample_rate()))
+        {
+            // Band energies exist and their bins match the decoded track.
+            out_bands = query.value(1).toByteArray();
+        }
+        else
+        {
+            // Waveform not found (or computed for another sample rate).
+            result = false;
+        }
+        query.finish();
+    }
+    else
+    {
+        result = false;
+    }
+
+    return result;
+}
+
+bool Data_persistence::get_file_identities(const QString                 &root_path,
+                                           QHash<QString, File_identity> &out_identities)
+{
+    // Init result.
+    bool result = true;
 
-        QSqlQuery query = this->db.exec("SELECT id_track FROM TRACK WHERE hash=\"" + at->get_hash() + "\"");
-        if (query.lastError().isValid())
+    if (this->is_initialized == true)
+    {
+        // Get all files under the root path in one query.
+        QSqlQuery &query = this->get_query("SELECT path, size, mtime, inode, hash FROM FILE_IDENTITY "
+                                           "WHERE substr(path, 1, length(:root)) = :root");
+        query.bindValue(":root", root_path);
+        if (query.exec() == false)
         {
-            // Can not select audio track in DB.
-            qCWarning(DS_DB) << "SELECT track failed: " << query.lastError().text();
+            qCWarning(DS_DB) << "SELECT file identities failed: " << query.lastError().text();
             result = false;
         }
-        else if (query.next() == true) // Check if there is a record.
+        else
         {
-            // The audio track exists, look for the specified cue point.
-            QSqlQuery query_cue_point = this->db.exec(
-                        "DELETE FROM TRACK_CUE_POINT WHERE id_track=\"" + query.value(0).toString() + "\" AND number=\"" + QString::number(number) + "\"");
-            if (query_cue_point.lastError().isValid())
+            while (query.next() == true)
             {
-                // Can not delete cue point.
-                qCWarning(DS_DB) << "DELETE cue point failed: " << query_cue_point.lastError().text();
-                result = false;
+                File_identity identity;
+                identity.size  = query.value(1).toLongLong();
+                identity.mtime = query.value(2).toLongLong();
+                identity.inode = query.value(3).toULongLong();
+                identity.hash  = query.value(4).toString();
+                out_identities.insert(query.value(0).toString(), identity);
             }
         }
+        query.finish();
+    }
+    else
+    {
+        result = false;
+    }
+
+    return result;
+}
+
+bool Data_persistence::store_file_identities(const QHash<QString, File_identity> &identities)
+{
+    // Init result.
+    bool result = true;
+
+    if ((identities.size() > 0) &&
+        (this->is_initialized == true))
+    {
+        // Insert all identities in one transaction (much faster than one per file).
+        if (this->begin_write() == false)
+        {
+            result = false;
+        }
         else
         {
-            // Audio track not found.
+            QSqlQuery &query = this->get_query("INSERT OR REPLACE INTO FILE_IDENTITY (path, size, mtime, inode, hash) "
+                                               "VALUES (:path, :size, :mtime, :inode, :hash)");
+            int nb_migrated = 0;
+            QHashIterator<QString, File_identity> i(identities);
+            while ((result == true) && (i.hasNext() == true))
+            {
+                i.next();
+                query.bindValue(":path",  i.key());
+                query.bindValue(":size",  i.value().size);
+                query.bindValue(":mtime", i.value().mtime);
+                query.bindValue(":inode", (qint64)i.value().inode);
+                query.bindValue(":hash",  i.value().hash);
+                if (query.exec() == false)
+                {
+                    qCWarning(DS_DB) << "INSERT file identity failed: " << query.lastError().text();
+                    result = false;
+                }
+
+                // Track stored by a previous version: cue points, tags and waveforms reference the track id,
+                // so only its hash has to change (unless the new hash is already used).
+                if ((result == true) && (i.value().legacy_hash.isEmpty() == false))
+                {
+                    QSqlQuery &query_migrate = this->get_query("UPDATE TRACK SET is_legacy_hash = 0, "
+                                                               "hash = CASE WHEN EXISTS (SELECT 1 FROM TRACK WHERE hash = :hash) "
+                                                               "THEN hash ELSE :hash END "
+                                                               "WHERE hash = :legacy_hash AND is_legacy_hash = 1");
+                    query_migrate.bindValue(":hash",        i.value().hash);
+                    query_migrate.bindValue(":legacy_hash", i.value().legacy_hash);
+                    if (query_migrate.exec() == false)
+                    {
+                        qCWarning(DS_DB) << "UPDATE legacy hash failed: " << query_migrate.lastError().text();
+                        result = false;
+                    }
+                    else
+                    {
+                        nb_migrated += query_migrate.numRowsAffected();
+                    }
+                }
+            }
+            result = this->end_write(result);
+            if (result == true)
+            {
+                this->nb_legacy_tracks.fetchAndAddOrdered(-nb_migrated);
+            }
+        }
+    }
+
+    return result;
+}
+
+bool Data_persistence::delete_file_identities(const QStringList &paths)
+{
+    // Init result.
+    bool result = true;
+
+    if ((paths.size() > 0) &&
+        (this->is_initialized == true))
+    {
+        // Delete all of them in one transaction, a path can be a directory.
+        if (this->begin_write() == false)
+        {
             result = false;
         }
+        else
+        {
+            QSqlQuery &query = this->get_query("DELETE FROM FILE_IDENTITY "
+                                               "WHERE path = :path OR substr(path, 1, length(:dir)) = :dir");
+            foreach (const QString &path, paths)
+            {
+                query.bindValue(":path", path);
+                query.bindValue(":dir",  path + "/");
+                if (query.exec() == false)
+                {
+                    qCWarning(DS_DB) << "DELETE file identity failed: " << query.lastError().text();
+                    result = false;
+                    break;
+                }
+            }
+            result = this->end_write(result);
+        }
+    }
 
-        // Release the DB connection.
-        this->mutex.unlock();
+    return result;
+}
+
+bool Data_persistence::has_legacy_tracks()
+{
+    return this->nb_legacy_tracks.load() > 0;
+}
+
+bool Data_persistence::delete_cue_point(const QSharedPointer<Audio_track> &at,
+                                        const unsigned int                &number)
+{
+    // Init result.
+    bool result = true;
+
+    // Check input parameter.
+    if ((at.data() == nullptr) ||
+        (at->get_hash().size() == 0) ||
+        (number >= MAX_NB_CUE_POINTS))
+    {
+        qCWarning(DS_DB) << "can not delete cue point: wrong params.";
+        result = false;
+    }
+
+    // Search the audio track (based on its hash) in DB.
+    if ((result == true) &&
+        (this->is_initialized == true))
+    {
+        if (this->begin_write() == false)
+        {
+            result = false;
+        }
+        else
+        {
+            int id_track = this->get_track_id(at->get_hash());
+            if (id_track != -1)
+            {
+                // The audio track exists, delete the specified cue point.
+                QSqlQuery &query = this->get_query("DELETE FROM TRACK_CUE_POINT WHERE id_track = :id_track AND number = :number");
+                query.bindValue(":id_track", id_track);
+                query.bindValue(":number",   number);
+                if (query.exec() == false)
+                {
+                    // Can not delete cue point.
+                    qCWarning(DS_DB) << "DELETE cue point failed: " << query.lastError().text();
+                    result = false;
+                }
+            }
+            else
+            {
+                // Audio track not found.
+                result = false;
+            }
+            result = this->end_write(result);
+        }
     }
 
     return result;
@@ -579,33 +1229,25 @@ bool Data_persistence::store_tag(const QString &name)
     if ((result == true) &&
         (this->is_initialized == true))
     {
-        // Ensure no other thread can access the DB connection.
-        this->mutex.lock();
-
-        // Try to get tag from Db.
-        QSqlQuery query = this->db.exec("SELECT id_tag, name FROM TAG WHERE name=\"" + name + "\"");
-        if (query.lastError().isValid())
+        if (this->begin_write() == false)
         {
-            qCWarning(DS_DB) << "SELECT tag failed: " << query.lastError().text();
             result = false;
         }
-        else if (query.next() == false)
+        else
         {
-            // Tag not found, add it.
-            query.prepare("INSERT INTO TAG (name) "
-                          "VALUES (:name)");
-            query.bindValue(":name", name);
-            query.exec();
-
-            if (query.lastError().isValid())
+            if (this->get_tag_id(name) == -1)
             {
-                qCWarning(DS_DB) << "INSERT tag failed: " << query.lastError().text();
-                result = false;
+                // Tag not found, add it.
+                QSqlQuery &query = this->get_query("INSERT INTO TAG (name) VALUES (:name)");
+                query.bindValue(":name", name);
+                if (query.exec() == false)
+                {
+                    qCWarning(DS_DB) << "INSERT tag failed: " << query.lastError().text();
+                    result = false;
+                }
             }
+            result = this->end_write(result);
         }
-
-        // Release the DB connection.
-        this->mutex.unlock();
     }
     else
     {
@@ -633,41 +1275,33 @@ bool Data_persistence::rename_tag(const QString &old_name, const QString &new_na
     if ((result == true) &&
         (this->is_initialized == true))
     {
-        // Ensure no other thread can access the DB connection.
-        this->mutex.lock();
-
-        // Try to get tag from Db.
-        QSqlQuery query = this->db.exec("SELECT id_tag, name FROM TAG WHERE name=\"" + old_name + "\"");
-        if (query.lastError().isValid())
+        if (this->begin_write() == false)
         {
-            qCWarning(DS_DB) << "SELECT tag failed: " << query.lastError().text();
             result = false;
         }
-        else if (query.next() == true)
+        else
         {
-            // Tag found.
-            int existing_id = query.value(0).toInt();
-            query.prepare("UPDATE TAG SET name = :name "
-                          "WHERE id_tag = :id_tag");
-            query.bindValue(":name", new_name);
-            query.bindValue(":id_tag", QString::number(existing_id));
-            query.exec();
-
-            if (query.lastError().isValid())
+            int id_tag = this->get_tag_id(old_name);
+            if (id_tag != -1)
             {
-                qCWarning(DS_DB) << "UPDATE tag failed: " << query.lastError().text();
+                // Tag found.
+                QSqlQuery &query = this->get_query("UPDATE TAG SET name = :name WHERE id_tag = :id_tag");
+                query.bindValue(":name",   new_name);
+                query.bindValue(":id_tag", id_tag);
+                if (query.exec() == false)
+                {
+                    qCWarning(DS_DB) << "UPDATE tag failed: " << query.lastError().text();
+                    result = false;
+                }
+            }
+            else
+            {
+                // Tag not found, error.
                 result = false;
+                qCWarning(DS_DB) << "can not found the tag " << old_name;
             }
+            result = this->end_write(result);
         }
-        else
-        {
-            // Tag not found, error.
-            result = false;
-            qCWarning(DS_DB) << "can not found the tag " << old_name;
-        }
-
-        // Release the DB connection.
-        this->mutex.unlock();
     }
     else
     {
@@ -694,48 +1328,45 @@ bool Data_persistence::delete_tag(const QString &name)
     if ((result == true) &&
         (this->is_initialized == true))
     {
-        // Ensure no other thread can access the DB connection.
-        this->mutex.lock();
-
-        QSqlQuery query = this->db.exec("SELECT id_tag FROM TAG WHERE name=\"" + name + "\"");
-        if (query.lastError().isValid())
+        if (this->begin_write() == false)
         {
-            // Can not select tag in DB.
-            qCWarning(DS_DB) << "SELECT tag failed: " << query.lastError().text();
             result = false;
         }
-        else if (query.next() == true) // Check if there is a record.
+        else
         {
-            // The tag exists, remove it.
-            QSqlQuery query_tag = this->db.exec("DELETE FROM TAG WHERE id_tag=\"" + query.value(0).toString() + "\"");
-            if (query_tag.lastError().isValid())
-            {
-                // Can not delete tag.
-                qCWarning(DS_DB) << "DELETE tag failed: " << query_tag.lastError().text();
-                result = false;
-            }
-            else
+            int id_tag = this->get_tag_id(name);
+            if (id_tag != -1)
             {
-                // Delete also all references to this tag for all tracks.
-                QSqlQuery query_track_tag = this->db.exec("DELETE FROM TRACK_TAG "
-                                                          "WHERE id_tag=\"" + query.value(0).toString() + "\"");
-                if (query_track_tag.lastError().isValid())
+                // The tag exists, delete first all references to this tag for all tracks.
+                QSqlQuery &query_track_tag = this->get_query("DELETE FROM TRACK_TAG WHERE id_tag = :id_tag");
+                query_track_tag.bindValue(":id_tag", id_tag);
+                if (query_track_tag.exec() == false)
                 {
                     // Can not delete track/tag.
                     qCWarning(DS_DB) << "DELETE track/tag failed: " << query_track_tag.lastError().text();
                     result = false;
                 }
+                else
+                {
+                    // Then remove the tag.
+                    QSqlQuery &query_tag = this->get_query("DELETE FROM TAG WHERE id_tag = :id_tag");
+                    query_tag.bindValue(":id_tag", id_tag);
+                    if (query_tag.exec() == false)
+                    {
+                        // Can not delete tag.
+                        qCWarning(DS_DB) << "DELETE tag failed: " << query_tag.lastError().text();
+                        result = false;
+                    }
+                }
             }
+            else
+            {
+                // Tag not found.
+                qCWarning(DS_DB) << "can not delete tag: tag not found";
+                result = false;
+            }
+            result = this->end_write(result);
         }
-        else
-        {
-            // Tag not found.
-            qCWarning(DS_DB) << "can not delete tag: tag not found";
-            result = false;
-        }
-
-        // Release the DB connection.
-        this->mutex.unlock();
     }
 
     return result;
@@ -749,11 +1380,8 @@ bool Data_persistence::get_full_tag_list(QStringList &out_tags)
     // Get all tags.
     if (this->is_initialized == true)
     {
-        // Ensure no other thread can access the DB connection.
-        this->mutex.lock();
-
-        QSqlQuery query = this->db.exec("SELECT name FROM TAG");
-        if (query.lastError().isValid())
+        QSqlQuery &query = this->get_query("SELECT name FROM TAG");
+        if (query.exec() == false)
         {
             // Can not select tag in DB.
             qCWarning(DS_DB) << "SELECT tags failed: " << query.lastError().text();
@@ -766,9 +1394,7 @@ bool Data_persistence::get_full_tag_list(QStringList &out_tags)
                 out_tags.push_back(query.value(0).toString());
             }
         }
-
-        // Release the DB connection.
-        this->mutex.unlock();
+        query.finish();
     }
 
     return result;
@@ -793,103 +1419,71 @@ bool Data_persistence::add_tag_to_track(const QSharedPointer<Audio_track> &at,
     if ((result == true) &&
         (this->is_initialized == true))
     {
-        // Ensure no other thread can access the DB connection.
-        this->mutex.lock();
-
-        QSqlQuery query = this->db.exec("SELECT id_track FROM TRACK WHERE hash=\"" + at->get_hash() + "\"");
-        if (query.lastError().isValid())
+        if (this->begin_write() == false)
         {
-            qCWarning(DS_DB) << "SELECT track failed: " << query.lastError().text();
             result = false;
         }
-        else if (query.next() == true) // Check if there is a record.
+        else
         {
-            // The audio track exists, let's search the tag.
-            QSqlQuery query_tag = this->db.exec("SELECT id_tag FROM TAG WHERE name=\"" + tag_name + "\"");
-            if (query_tag.lastError().isValid())
+            int id_track = this->get_track_id(at->get_hash());
+            int id_tag   = this->get_tag_id(tag_name);
+            if (id_track == -1)
             {
-                qCWarning(DS_DB) << "SELECT tag failed: " << query_tag.lastError().text();
+                // Audio track not found.
+                qCWarning(DS_DB) << "can not add tag to track: track not found";
                 result = false;
             }
-            else if (query_tag.next() == true) // Check if there is a record.
-            {
-                // The tag exists, let's do the association with the track (do not duplicate).
-                result = this->store_track_tag(query.value(0).toString(),
-                                               query_tag.value(0).toString());
-            }
-            else
+            else if (id_tag == -1)
             {
                 // Tag not found.
                 qCWarning(DS_DB) << "can not add tag to track: tag not found";
                 result = false;
             }
+            else
+            {
+                // Both exist, let's do the association with the track (do not duplicate).
+                result = this->store_track_tag(id_track, id_tag);
+            }
+            result = this->end_write(result);
         }
-        else
-        {
-            // Audio track not found.
-            qCWarning(DS_DB) << "can not add tag to track: track not found";
-            result = false;
-        }
-
-        // Release the DB connection.
-        this->mutex.unlock();
-    }
-
-    // Reorganize position of tracks in tracklist of a tag.
-    if (result == true)    
-    {
-        result = this->reorganize_track_pos_in_tag_list();
     }
 
     return result;
 }
 
-bool Data_persistence::store_track_tag(const QString &id_track,
-                                       const QString &id_tag)
+bool Data_persistence::store_track_tag(const int &id_track,
+                                       const int &id_tag)
 {
     // Init result.
     bool result = true;
-    
-    // Check input parameter.
-    if ((id_track == "") ||
-        (id_tag   == ""))
+
+    // Try to get tag/track association from Db.
+    QSqlQuery &query = this->get_query("SELECT id_track, id_tag FROM TRACK_TAG WHERE id_track = :id_track AND id_tag = :id_tag");
+    query.bindValue(":id_track", id_track);
+    query.bindValue(":id_tag",   id_tag);
+    if (query.exec() == false)
     {
+        qCWarning(DS_DB) << "SELECT track/tag failed: " << query.lastError().text();
         result = false;
-        qCWarning(DS_DB) << "Bad input ids";
     }
-
-    // Insert the tag/track association (prevent duplicate).
-    if ((result == true) &&
-        (this->is_initialized == true))
+    else if (query.next() == false)
     {
-        // Try to get tag/track association  from Db.
-        QSqlQuery query = this->db.exec("SELECT id_track, id_tag FROM TRACK_TAG WHERE id_track=\"" + id_track + "\" AND id_tag=\"" + id_tag + "\"");
-        if (query.lastError().isValid())
+        // Track/tag not found, add it at the end of the track list of the tag.
+        QSqlQuery &query_insert = this->get_query("INSERT INTO TRACK_TAG (id_track, id_tag, position) "
+                                                  "VALUES (:id_track, :id_tag, "
+                                                  "(SELECT COALESCE(MAX(position), 0) + :step FROM TRACK_TAG WHERE id_tag = :id_tag_last))");
+        query_insert.bindValue(":id_track",    id_track);
+        query_insert.bindValue(":id_tag",      id_tag);
+        query_insert.bindValue(":step",        TAG_POSITION_STEP);
+        query_insert.bindValue(":id_tag_last", id_tag);
+        if (query_insert.exec() == false)
         {
-            qCWarning(DS_DB) << "SELECT track/tag failed: " << query.lastError().text();
+            qCWarning(DS_DB) << "INSERT track/tag failed: " << query_insert.lastError().text();
             result = false;
         }
-        else if (query.next() == false)
-        {
-            // Track/tag not found, add it.
-            query.prepare("INSERT INTO TRACK_TAG (id_track, id_tag) VALUES (:id_track, :id_tag)");
-            query.bindValue(":id_track", id_track);
-            query.bindValue(":id_tag", id_tag);
-            query.exec();
-
-            if (query.lastError().isValid())
-            {
-                qCWarning(DS_DB) << "INSERT track/tag failed: " << query.lastError().text();
-                result = false;
-            }
-        }
-    }
-    else
-    {
-        // Db not open.
-        qCWarning(DS_DB) << "can not store track/tag: db not open";
     }
-    
+    query.finish();
+
     return result;
 }
 
@@ -908,36 +1502,34 @@ bool Data_persistence::rem_tag_from_track(const QSharedPointer<Audio_track> &at,
         result = false;
     }
 
-    // Get all tags.
+    // Delete the association.
     if ((result == true) &&
         (this->is_initialized == true))
     {
-        // Ensure no other thread can access the DB connection.
-        this->mutex.lock();
-
-        QSqlQuery query = this->db.exec("DELETE FROM TRACK_TAG "
-                                        "WHERE id_track_tag IN "
-                                        "(SELECT id_track_tag FROM TRACK_TAG "
-                                        "JOIN TAG "
-                                        "ON TRACK_TAG.id_tag=TAG.id_tag "
-                                        "JOIN TRACK "
-                                        "ON TRACK_TAG.id_track=TRACK.id_track "
-                                        "WHERE TRACK.hash=\"" + at->get_hash() + "\" AND TAG.name=\"" + tag_name + "\")");
-        if (query.lastError().isValid())
-        {
-            // Can not delete tag in DB.
-            qCWarning(DS_DB) << "DELETE FROM TRACK_TAG failed: " << query.lastError().text();
+        if (this->begin_write() == false)
+        {
             result = false;
         }
-
-        // Release the DB connection.
-        this->mutex.unlock();
-    }
-
-    // Reorganize position of tracks in tracklist of a tag.
-    if (result == true)    
-    {
-        result = this->reorganize_track_pos_in_tag_list();
+        else
+        {
+            QSqlQuery &query = this->get_query("DELETE FROM TRACK_TAG "
+                                               "WHERE id_track_tag IN "
+                                               "(SELECT id_track_tag FROM TRACK_TAG "
+                                               "JOIN TAG "
+                                               "ON TRACK_TAG.id_tag=TAG.id_tag "
+                                               "JOIN TRACK "
+                                               "ON TRACK_TAG.id_track=TRACK.id_track "
+                                               "WHERE TRACK.hash = :hash AND TAG.name = :tag)");
+            query.bindValue(":hash", at->get_hash());
+            query.bindValue(":tag",  tag_name);
+            if (query.exec() == false)
+            {
+                // Can not delete tag in DB.
+                qCWarning(DS_DB) << "DELETE FROM TRACK_TAG failed: " << query.lastError().text();
+                result = false;
+            }
+            result = this->end_write(result);
+        }
     }
 
     return result;
@@ -961,16 +1553,14 @@ bool Data_persistence::get_tags_from_track(const QSharedPointer<Audio_track> &at
     if ((result == true) &&
         (this->is_initialized == true))
     {
-        // Ensure no other thread can access the DB connection.
-        this->mutex.lock();
-
-        QSqlQuery query = this->db.exec("SELECT name FROM TAG "
-                                        "JOIN TRACK_TAG "
-                                        "ON TAG.id_tag=TRACK_TAG.id_tag "
-                                        "JOIN TRACK "
-                                        "ON TRACK_TAG.id_track=TRACK.id_track "
-                                        "WHERE TRACK.hash=\"" + at->get_hash() + "\"");
-        if (query.lastError().isValid())
+        QSqlQuery &query = this->get_query("SELECT name FROM TAG "
+                                           "JOIN TRACK_TAG "
+                                           "ON TAG.id_tag=TRACK_TAG.id_tag "
+                                           "JOIN TRACK "
+                                           "ON TRACK_TAG.id_track=TRACK.id_track "
+                                           "WHERE TRACK.hash = :hash");
+        query.bindValue(":hash", at->get_hash());
+        if (query.exec() == false)
         {
             // Can not select tag list in DB.
             qCWarning(DS_DB) << "SELECT tags failed: " << query.lastError().text();
@@ -984,9 +1574,45 @@ bool Data_persistence::get_tags_from_track(const QSharedPointer<Audio_track> &at
                 out_tags.push_back(query.value(0).toString());
             }
         }
+        query.finish();
+    }
 
-        // Release the DB connection.
-        this->mutex.unlock();
+    return result;
+}
+
+bool Data_persistence::get_tags_of_tracks(QHash<QString, QStringList> &out_tags)
+{
+    // Init result.
+    bool result = true;
+    out_tags.clear();
+
+    // Get all associations of tracks and tags in one query.
+    if (this->is_initialized == true)
+    {
+        QSqlQuery &query = this->get_query("SELECT TRACK.hash, TAG.name FROM TRACK_TAG "
+                                           "JOIN TAG "
+                                           "ON TAG.id_tag=TRACK_TAG.id_tag "
+                                           "JOIN TRACK "
+                                           "ON TRACK_TAG.id_track=TRACK.id_track");
+        if (query.exec() == false)
+        {
+            // Can not select tags in DB.
+            qCWarning(DS_DB) << "SELECT tags of tracks failed: " << query.lastError().text();
+            result = false;
+        }
+        else
+        {
+            // Fill result by hash of track.
+            while (query.next() == true)
+            {
+                out_tags[query.value(0).toString()] << query.value(1).toString();
+            }
+        }
+        query.finish();
+    }
+    else
+    {
+        result = false;
     }
 
     return result;
@@ -1009,17 +1635,15 @@ bool Data_persistence::get_tracks_from_tag(const QString &tag_name,
     if ((result == true) &&
         (this->is_initialized == true))
     {
-        // Ensure no other thread can access the DB connection.
-        this->mutex.lock();
-
-        QSqlQuery query = this->db.exec("SELECT path, filename FROM TRACK "
-                                        "JOIN TRACK_TAG "
-                                        "ON TRACK.id_track=TRACK_TAG.id_track "
-                                        "JOIN TAG "
-                                        "ON TRACK_TAG.id_tag=TAG.id_tag "
-                                        "WHERE TAG.name=\"" + tag_name + "\" "
-                                        "ORDER BY TRACK_TAG.position");
-        if (query.lastError().isValid())
+        QSqlQuery &query = this->get_query("SELECT path, filename FROM TRACK "
+                                           "JOIN TRACK_TAG "
+                                           "ON TRACK.id_track=TRACK_TAG.id_track "
+                                           "JOIN TAG "
+                                           "ON TRACK_TAG.id_tag=TAG.id_tag "
+                                           "WHERE TAG.name = :tag "
+                                           "ORDER BY TRACK_TAG.position");
+        query.bindValue(":tag", tag_name);
+        if (query.exec() == false)
         {
             // Can not select track list in DB.
             qCWarning(DS_DB) << "SELECT tracks failed: " << query.lastError().text();
@@ -1033,182 +1657,286 @@ bool Data_persistence::get_tracks_from_tag(const QString &tag_name,
                 out_tracklist.push_back(query.value(0).toString() + "/" + query.value(1).toString());
             }
         }
-
-        // Release the DB connection.
-        this->mutex.unlock();
+        query.finish();
     }
 
     return result;
 }
 
-bool Data_persistence::reorganize_track_pos_in_tag_list() // TODO: do it only for a specified tag (much faster).
+bool Data_persistence::renumber_track_pos_in_tag_list(const int &id_tag)
 {
     // Init result.
     bool result = true;
 
-    if (this->is_initialized == true)
+    // Get the track list of the tag (associations without position, made by previous versions, go at the end).
+    QList<int> id_track_tags;
+    QSqlQuery &query_tracklist = this->get_query("SELECT id_track_tag FROM TRACK_TAG "
+                                                 "WHERE id_tag = :id_tag "
+                                                 "ORDER BY CASE WHEN position IS NULL THEN 1 ELSE 0 END, position, id_track_tag");
+    query_tracklist.bindValue(":id_tag", id_tag);
+    if (query_tracklist.exec() == false)
     {
-        // Ensure no other thread can access the DB connection.
-        this->mutex.lock();
+        qCWarning(DS_DB) << "SELECT tracklist failed: " << query_tracklist.lastError().text();
+        result = false;
+    }
+    else
+    {
+        while (query_tracklist.next() == true)
+        {
+            id_track_tags << query_tracklist.value(0).toInt();
+        }
+    }
+    query_tracklist.finish();
 
-        // Get all tag ids.
-        QSqlQuery query_tag_ids = this->db.exec("SELECT id_tag FROM TAG");
-        if (query_tag_ids.lastError().isValid())
+    // Spread positions again, keeping the order.
+    QSqlQuery &query_update = this->get_query("UPDATE TRACK_TAG SET position = :position WHERE id_track_tag = :id_track_tag");
+    for (int i = 0; (result == true) && (i < id_track_tags.size()); i++)
+    {
+        query_update.bindValue(":position",     (qint64)(i + 1) * TAG_POSITION_STEP);
+        query_update.bindValue(":id_track_tag", id_track_tags[i]);
+        if (query_update.exec() == false)
         {
-            // Can not select tag in DB.
-            qCWarning(DS_DB) << "SELECT tags failed: " << query_tag_ids.lastError().text();
+            qCWarning(DS_DB) << "UPDATE track_tag failed: " << query_update.lastError().text();
             result = false;
         }
-        else
-        {
-            // For each tag ids, get the list of track ids (position value in ascendant order).
-            while (query_tag_ids.next() == true)
-            {
-                int pos = 0;
-                QSqlQuery query_tracklist = this->db.exec("SELECT id_track_tag, position FROM TRACK_TAG "
-                                                          "WHERE TRACK_TAG.id_tag=" + query_tag_ids.value(0).toString() + " "
-                                                          "ORDER BY CASE WHEN position IS NULL THEN 1 ELSE 0 END, position");
-                if (query_tracklist.lastError().isValid())
-                {
-                    // Can not select tag in DB.
-                    qCWarning(DS_DB) << "SELECT tracklist failed: " << query_tracklist.lastError().text();
-                    result = false;
-                }
-                else
-                {
-                    // For each tag_track association (which are ordered), overwrite the position starting from 0.
-                    // tag_track associations with no position are append at the end.
-                    QSqlQuery query_update_tracklist(this->db);
-                    while (query_tracklist.next() == true)
-                    {
-                        query_update_tracklist.prepare("UPDATE TRACK_TAG SET position = :position "
-                                                       "WHERE id_track_tag = :id_track_tag");
-                        query_update_tracklist.bindValue(":position", QString::number(pos));
-                        query_update_tracklist.bindValue(":id_track_tag", query_tracklist.value(0).toString());
-                        query_update_tracklist.exec();
+    }
 
-                        if (query_update_tracklist.lastError().isValid())
-                        {
-                            qCWarning(DS_DB) << "UPDATE track_tag failed: " << query_update_tracklist.lastError().text();
-                            result = false;
-                        }
+    return result;
+}
 
-                        pos++;
-                    }
-                }
-            }
-        }
+bool Data_persistence::get_track_pos_in_tag_list(const QSharedPointer<Audio_track> &at,
+                                                 const int                         &id_tag,
+                                                 qint64                            &out_position)
+{
+    // Init result.
+    bool result = true;
 
-        // Release the DB connection.
-        this->mutex.unlock();
+    QSqlQuery &query = this->get_query("SELECT TRACK_TAG.position FROM TRACK_TAG "
+                                       "JOIN TRACK ON TRACK.id_track = TRACK_TAG.id_track "
+                                       "WHERE TRACK.hash = :hash AND TRACK_TAG.id_tag = :id_tag");
+    query.bindValue(":hash",   at->get_hash());
+    query.bindValue(":id_tag", id_tag);
+    if (query.exec() == false)
+    {
+        // Can not select position in DB.
+        qCWarning(DS_DB) << "SELECT position failed: " << query.lastError().text();
+        result = false;
+    }
+    else if (query.next() == true)
+    {
+        // Get position of track in the tracklist of the specified tag.
+        out_position = query.value(0).toLongLong();
+    }
+    else
+    {
+        // Track not tagged.
+        result = false;
+    }
+    query.finish();
+
+    return result;
+}
+
+bool Data_persistence::set_track_position_in_tag_list(const QSharedPointer<Audio_track> &at,
+                                                      const int                         &id_tag,
+                                                      const qint64                      &position)
+{
+    // Init result.
+    bool result = true;
+
+    QSqlQuery &query_update_pos = this->get_query("UPDATE TRACK_TAG SET position = :position "
+                                                  "WHERE id_tag = :id_tag "
+                                                  "AND id_track = (SELECT id_track FROM TRACK WHERE hash = :hash)");
+    query_update_pos.bindValue(":position", position);
+    query_update_pos.bindValue(":id_tag",   id_tag);
+    query_update_pos.bindValue(":hash",     at->get_hash());
+    if (query_update_pos.exec() == false)
+    {
+        qCWarning(DS_DB) << "UPDATE position failed: " << query_update_pos.lastError().text();
+        result = false;
     }
 
     return result;
 }
 
-int Data_persistence::get_track_pos_in_tag_list(const QSharedPointer<Audio_track> &at,
-                                                const QString &tag_name)
+bool Data_persistence::switch_track_positions_in_tag_list(const QString &tag_name,
+                                                          const QSharedPointer<Audio_track> &at1,
+                                                          const QSharedPointer<Audio_track> &at2)
 {
-    int pos = -1;
+    // Init result.
+    bool result = true;
 
-    if (this->is_initialized == true)
+    // Check input parameter.
+    if ((at1.data() == nullptr) ||
+        (at2.data() == nullptr) ||
+        (tag_name == ""))
     {
-        // Ensure no other thread can access the DB connection.
-        this->mutex.lock();
+        qCWarning(DS_DB) << "can not switch tracks: wrong params.";
+        result = false;
+    }
 
-        QSqlQuery query = this->db.exec("SELECT TRACK_TAG.position FROM TRACK_TAG "
-                                        "JOIN TRACK ON TRACK.id_track=TRACK_TAG.id_track "
-                                        "JOIN TAG ON TAG.id_tag=TRACK_TAG.id_tag "
-                                        "WHERE TRACK.hash=\"" + at->get_hash() + "\" AND TAG.name=\"" + tag_name + "\"");
-        if (query.lastError().isValid())
+    if ((result == true) &&
+        (this->is_initialized == true))
+    {
+        if (this->begin_write() == false)
         {
-            // Can not select position in DB.
-            qCWarning(DS_DB) << "SELECT position failed: " << query.lastError().text();
+            result = false;
         }
         else
         {
-            if (query.next() == true)
+            // Get positions of tracks (both must be tagged with the tag).
+            int    id_tag = this->get_tag_id(tag_name);
+            qint64 pos1   = 0;
+            qint64 pos2   = 0;
+            if ((id_tag == -1) ||
+                (this->get_track_pos_in_tag_list(at1, id_tag, pos1) == false) ||
+                (this->get_track_pos_in_tag_list(at2, id_tag, pos2) == false))
             {
-                // Get position of track in the tracklist of the specified tag.
-                pos = query.value(0).toInt();
+                qCWarning(DS_DB) << "Track not tagged with " << tag_name;
+                result = false;
             }
-        }
 
-        // Release the DB connection.
-        this->mutex.unlock();
+            // Update position of track 1 with the position of track 2 and vice versa (both or none).
+            else if ((this->set_track_position_in_tag_list(at1, id_tag, pos2) == false) ||
+                     (this->set_track_position_in_tag_list(at2, id_tag, pos1) == false))
+            {
+                qCWarning(DS_DB) << "Can not change position of tracks";
+                result = false;
+            }
+            result = this->end_write(result);
+        }
+    }
+    else
+    {
+        result = false;
     }
 
-    return pos;
+    return result;
 }
 
-bool Data_persistence::set_track_position_in_tag_list(const QString &tag_name,
-                                                      const QSharedPointer<Audio_track> &at,
-                                                      const int &position)
+bool Data_persistence::move_track_in_tag_list(const QString                     &tag_name,
+                                              const QSharedPointer<Audio_track> &at,
+                                              const QSharedPointer<Audio_track> &at_next)
 {
     // Init result.
     bool result = true;
 
-    if (this->is_initialized == true)
+    // Check input parameter.
+    if ((at.data() == nullptr) ||
+        (tag_name == ""))
     {
-        // Ensure no other thread can access the DB connection.
-        this->mutex.lock();
-
-        QSqlQuery query_update_pos(this->db);
-        query_update_pos.prepare("UPDATE TRACK_TAG SET position = :position "
-                                 "WHERE id_track_tag = (SELECT TRACK_TAG.id_track_tag FROM TRACK_TAG "
-                                                        "JOIN TRACK ON TRACK.id_track = TRACK_TAG.id_track "
-                                                        "JOIN TAG ON TAG.id_tag = TRACK_TAG.id_tag "
-                                                        "WHERE TRACK.hash = :hash AND TAG.name = :tag)");
-        query_update_pos.bindValue(":position", QString::number(position));
-        query_update_pos.bindValue(":hash", at->get_hash());
-        query_update_pos.bindValue(":tag", tag_name);
-        query_update_pos.exec();
-        if (query_update_pos.lastError().isValid())
-        {
-            qCWarning(DS_DB) << "UPDATE position failed: " << query_update_pos.lastError().text();
+        qCWarning(DS_DB) << "can not move track: wrong params.";
+        result = false;
+    }
+
+    if ((result == true) &&
+        (this->is_initialized == true))
+    {
+        if (this->begin_write() == false)
+        {
             result = false;
         }
-
-        // Release the DB connection.
-        this->mutex.unlock();
+        else
+        {
+            // The track must be tagged with the tag.
+            int    id_tag   = this->get_tag_id(tag_name);
+            qint64 position = 0;
+            if ((id_tag == -1) ||
+                (this->get_track_pos_in_tag_list(at, id_tag, position) == false))
+            {
+                qCWarning(DS_DB) << "Track not tagged with " << tag_name;
+                result = false;
+            }
+            else if ((at_next.data() == nullptr) ||
+                     (at_next->get_hash() == at->get_hash()))
+            {
+                // Move it after the last one (or nowhere).
+                if (at_next.data() == nullptr)
+                {
+                    result = this->get_new_track_pos_in_tag_list(id_tag, -1, position) &&
+                             this->set_track_position_in_tag_list(at, id_tag, position);
+                }
+            }
+            else
+            {
+                // Move it between the track before at_next and at_next (only one row is written).
+                qint64 next_position = 0;
+                if (this->get_track_pos_in_tag_list(at_next, id_tag, next_position) == false)
+                {
+                    qCWarning(DS_DB) << "Track not tagged with " << tag_name;
+                    result = false;
+                }
+                else
+                {
+                    result = this->get_new_track_pos_in_tag_list(id_tag, next_position, position);
+                    if ((result == true) && (position == -1))
+                    {
+                        // No room left in between, spread positions of this tag (rarely needed) and try again.
+                        result = this->renumber_track_pos_in_tag_list(id_tag) &&
+                                 this->get_track_pos_in_tag_list(at_next, id_tag, next_position) &&
+                                 this->get_new_track_pos_in_tag_list(id_tag, next_position, position);
+                    }
+                    result = result && this->set_track_position_in_tag_list(at, id_tag, position);
+                }
+            }
+            result = this->end_write(result);
+        }
+    }
+    else
+    {
+        result = false;
     }
 
     return result;
 }
 
-bool Data_persistence::switch_track_positions_in_tag_list(const QString &tag_name,
-                                                          const QSharedPointer<Audio_track> &at1,
-                                                          const QSharedPointer<Audio_track> &at2)
+bool Data_persistence::get_new_track_pos_in_tag_list(const int    &id_tag,
+                                                     const qint64 &next_position,
+                                                     qint64       &out_position)
 {
     // Init result.
     bool result = true;
 
-    // First ensure that both tracks are tagged with the tag.
-    QStringList tags_1;
-    this->get_tags_from_track(at1, tags_1);
-    QStringList tags_2;
-    this->get_tags_from_track(at2, tags_2);
-    if ((tags_1.contains(tag_name) == false)
-        || (tags_2.contains(tag_name) == false))
+    // Get position of the track just before next_position (of the last track if next_position is -1),
+    // it is a seek in index_TRACK_TAG_id_tag_position.
+    QSqlQuery &query = (next_position == -1) ?
+                       this->get_query("SELECT position FROM TRACK_TAG "
+                                       "WHERE id_tag = :id_tag AND position IS NOT NULL "
+                                       "ORDER BY position DESC LIMIT 1") :
+                       this->get_query("SELECT position FROM TRACK_TAG "
+                                       "WHERE id_tag = :id_tag AND position < :next_position "
+                                       "ORDER BY position DESC LIMIT 1");
+    query.bindValue(":id_tag", id_tag);
+    if (next_position != -1)
+    {
+        query.bindValue(":next_position", next_position);
+    }
+    if (query.exec() == false)
     {
-        qCWarning(DS_DB) << "Track not tagged with " << tag_name;
+        qCWarning(DS_DB) << "SELECT position failed: " << query.lastError().text();
         result = false;
     }
     else
     {
-        // Get positions of tracks.
-        int pos1 = this->get_track_pos_in_tag_list(at1, tag_name);
-        int pos2 = this->get_track_pos_in_tag_list(at2, tag_name);
-        
-        // Update position of track 1 with the position of track 2 and vice versa.
-        if ((this->set_track_position_in_tag_list(tag_name, at1, pos2) == false) ||
-            (this->set_track_position_in_tag_list(tag_name, at2, pos1) == false))
+        // Positions start after 0.
+        qint64 previous_position = (query.next() == true) ? query.value(0).toLongLong() : 0;
+        if (next_position == -1)
         {
-            qCWarning(DS_DB) << "Can not change position of tracks";
-            result = false;
+            // Append.
+            out_position = previous_position + TAG_POSITION_STEP;
+        }
+        else if (next_position - previous_position >= 2)
+        {
+            // Middle of the gap.
+            out_position = previous_position + (next_position - previous_position) / 2;
+        }
+        else
+        {
+            // No room left.
+            out_position = -1;
         }
-
     }
+    query.finish();
 
     return result;
 }
@@ -0,0 +1,429 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*--------------------------------------------( data_persistence_worker.cpp )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: write data to DB in a dedicated thread (commands are      */
+/*                  queued and coalesced), read data of tracks to load.       */
+/*                                                                            */
+/*============================================================================*/
+
+#include <QtDebug>
+
+#include "app/application_logging.h"
+#include "tracks/data_persistence.h"
+#include "tracks/data_persistence_worker.h"
+#include "singleton.h"
+
+Data_persistence_worker::Data_persistence_worker()
+{
+    // The DB must outlive the worker.
+    Singleton<Data_persistence>::get_instance();
+
+    this->is_running_commands = false;
+    this->is_urgent           = false;
+    this->is_stopping         = false;
+    this->start();
+
+    return;
+}
+
+Data_persistence_worker::~Data_persistence_worker()
+{
+    this->stop();
+
+    return;
+}
+
+void
+Data_persistence_worker::store_audio_track(const QSharedPointer<Audio_track> &at,
+                                           const QByteArray                  &bands)
+{
+    Persistence_command command;
+    command.type  = Persistence_command_type::STORE_AUDIO_TRACK;
+    command.at    = at->get_metadata_copy();
+    command.bands = bands;
+    this->push(command, "track:" + at->get_hash());
+
+    return;
+}
+
+void
+Data_persistence_worker::store_cue_point(const QSharedPointer<Audio_track> &at,
+                                         const unsigned int                &number,
+                                         const unsigned int                &position_msec)
+{
+    Persistence_command command;
+    command.type     = Persistence_command_type::STORE_CUE_POINT;
+    command.at       = at->get_metadata_copy();
+    command.number   = number;
+    command.position = position_msec;
+    this->push(command, "cue:" + at->get_hash() + ":" + QString::number(number));
+
+    return;
+}
+
+void
+Data_persistence_worker::delete_cue_point(const QSharedPointer<Audio_track> &at,
+                                          const unsigned int                &number)
+{
+    Persistence_command command;
+    command.type   = Persistence_command_type::DELETE_CUE_POINT;
+    command.at     = at->get_metadata_copy();
+    command.number = number;
+    this->push(command, "cue:" + at->get_hash() + ":" + QString::number(number));
+
+    return;
+}
+
+void
+Data_persistence_worker::add_tag_to_track(const QSharedPointer<Audio_track> &at,
+                                          const QString                     &tag_name)
+{
+    Persistence_command command;
+    command.type = Persistence_command_type::ADD_TAG_TO_TRACK;
+    command.at   = at->get_metadata_copy();
+    command.tag  = tag_name;
+    this->push(command, "tag:" + at->get_hash() + ":" + tag_name);
+
+    return;
+}
+
+void
+Data_persistence_worker::rem_tag_from_track(const QSharedPointer<Audio_track> &at,
+                                            const QString                     &tag_name)
+{
+    Persistence_command command;
+    command.type = Persistence_command_type::REM_TAG_FROM_TRACK;
+    command.at   = at->get_metadata_copy();
+    command.tag  = tag_name;
+    this->push(command, "tag:" + at->get_hash() + ":" + tag_name);
+
+    return;
+}
+
+QFuture<bool>
+Data_persistence_worker::load_cue_points_and_tags(const QSharedPointer<Audio_track> &io_at)
+{
+    Persistence_command command;
+    command.type = Persistence_command_type::LOAD_CUE_POINTS_AND_TAGS;
+    command.at   = io_at;
+
+    return this->push_load(command);
+}
+
+QFuture<bool>
+Data_persistence_worker::load_audio_tracks(const QList<QSharedPointer<Audio_track>> &io_tracks)
+{
+    Persistence_command command;
+    command.type   = Persistence_command_type::LOAD_AUDIO_TRACKS;
+    command.tracks = io_tracks;
+
+    return this->push_load(command);
+}
+
+void
+Data_persistence_worker::store_file_identities(const QHash<QString, File_identity> &identities)
+{
+    if (identities.isEmpty() == true)
+    {
+        return;
+    }
+    Persistence_command command;
+    command.type       = Persistence_command_type::STORE_FILE_IDENTITIES;
+    command.identities = QSharedPointer<QHash<QString, File_identity>>(new QHash<QString, File_identity>(identities));
+    this->push(command, "");
+
+    return;
+}
+
+void
+Data_persistence_worker::delete_file_identities(const QStringList &paths)
+{
+    if (paths.isEmpty() == true)
+    {
+        return;
+    }
+    Persistence_command command;
+    command.type  = Persistence_command_type::DELETE_FILE_IDENTITIES;
+    command.paths = paths;
+    this->push(command, "");
+
+    return;
+}
+
+QFuture<bool>
+Data_persistence_worker::load_file_identities(const QString                                 &root_path,
+                                              QSharedPointer<QHash<QString, File_identity>>  out_identities)
+{
+    Persistence_command command;
+    command.type       = Persistence_command_type::LOAD_FILE_IDENTITIES;
+    command.path       = root_path;
+    command.identities = out_identities;
+
+    return this->push_load(command);
+}
+
+QFuture<bool>
+Data_persistence_worker::load_tags(QSharedPointer<QHash<QString, QStringList>> out_tags)
+{
+    Persistence_command command;
+    command.type = Persistence_command_type::LOAD_TAGS;
+    command.tags = out_tags;
+
+    return this->push_load(command);
+}
+
+QFuture<bool>
+Data_persistence_worker::push_load(Persistence_command &command)
+{
+    command.result = QSharedPointer<QFutureInterface<bool>>(new QFutureInterface<bool>());
+    command.result->reportStarted();
+    QFuture<bool> future = command.result->future();
+    this->push(command, "");
+
+    return future;
+}
+
+void
+Data_persistence_worker::flush()
+{
+    // Nothing runs anymore once stopped.
+    if (this->isFinished() == true)
+    {
+        return;
+    }
+
+    this->mutex.lock();
+    this->is_urgent = true;
+    this->wake.wakeOne();
+    while ((this->commands.isEmpty() == false) || (this->is_running_commands == true))
+    {
+        this->idle.wait(&this->mutex);
+    }
+    this->mutex.unlock();
+
+    return;
+}
+
+void
+Data_persistence_worker::stop()
+{
+    this->mutex.lock();
+    this->is_stopping = true;
+    this->wake.wakeOne();
+    this->mutex.unlock();
+    this->wait();
+
+    return;
+}
+
+void
+Data_persistence_worker::push(const Persistence_command &command,
+                              const QString             &key)
+{
+    this->mutex.lock();
+
+    // A waiting write of the same thing is replaced (band energies of a track are kept if not computed again).
+    // The new one is queued at the end, so it stays after the commands pushed before it.
+    bool                was_empty   = this->commands.isEmpty();
+    int                 index       = (key.isEmpty() == true) ? -1 : this->pending.value(key, -1);
+    Persistence_command new_command = command;
+    if (index >= 0)
+    {
+        if (new_command.bands.isEmpty() == true)
+        {
+            new_command.bands = this->commands[index].bands;
+        }
+        this->commands.removeAt(index);
+        QMutableHashIterator<QString, int> i(this->pending);
+        while (i.hasNext() == true)
+        {
+            i.next();
+            if (i.value() > index)
+            {
+                i.setValue(i.value() - 1);
+            }
+        }
+    }
+    if (key.isEmpty() == false)
+    {
+        this->pending.insert(key, this->commands.size());
+    }
+    this->commands << new_command;
+
+    // A load is waited for, do not delay it.
+    if (command.result.data() != nullptr)
+    {
+        this->is_urgent = true;
+    }
+    if ((was_empty == true) || (this->is_urgent == true))
+    {
+        this->wake.wakeOne();
+    }
+
+    this->mutex.unlock();
+
+    return;
+}
+
+void
+Data_persistence_worker::run()
+{
+    while (true)
+    {
+        // Wait for commands.
+        this->mutex.lock();
+        while ((this->commands.isEmpty() == true) && (this->is_stopping == false))
+        {
+            this->wake.wait(&this->mutex);
+        }
+
+        // Let writes of a burst (analysis results, cue point edits) gather, unless someone waits for them.
+        if ((this->is_urgent == false) && (this->is_stopping == false))
+        {
+            this->wake.wait(&this->mutex, PERSISTENCE_DELAY_MSEC);
+        }
+        if (this->commands.isEmpty() == true)
+        {
+            // Nothing left and the worker must stop.
+            this->mutex.unlock();
+            break;
+        }
+
+        // Take all waiting commands.
+        QList<Persistence_command> commands;
+        commands.swap(this->commands);
+        this->pending.clear();
+        this->is_urgent           = false;
+        this->is_running_commands = true;
+        this->mutex.unlock();
+
+        this->run_commands(commands);
+
+        // Wake up threads waiting for them.
+        this->mutex.lock();
+        this->is_running_commands = false;
+        if (this->commands.isEmpty() == true)
+        {
+            this->idle.wakeAll();
+        }
+        this->mutex.unlock();
+    }
+
+    return;
+}
+
+void
+Data_persistence_worker::run_commands(const QList<Persistence_command> &commands)
+{
+    Data_persistence *data_persist = &Singleton<Data_persistence>::get_instance();
+
+    int i = 0;
+    while (i < commands.size())
+    {
+        const Persistence_command &command = commands[i];
+        switch (command.type)
+        {
+            case Persistence_command_type::STORE_AUDIO_TRACK:
+            {
+                // Following tracks are stored together in one transaction.
+                QList<QSharedPointer<Audio_track>> tracks;
+                QList<QByteArray>                  bands;
+                while ((i < commands.size()) &&
+                       (commands[i].type == Persistence_command_type::STORE_AUDIO_TRACK) &&
+                       (tracks.size() < PERSISTENCE_BATCH_MAX_TRACKS))
+                {
+                    tracks << commands[i].at;
+                    bands  << commands[i].bands;
+                    i++;
+                }
+                if (data_persist->store_audio_tracks(tracks, bands) == false)
+                {
+                    qCWarning(DS_DB) << "can not store" << tracks.size() << "tracks";
+                }
+                continue;
+            }
+            case Persistence_command_type::STORE_CUE_POINT:
+                if (data_persist->store_cue_point(command.at, command.number, command.position) == false)
+                {
+                    qCWarning(DS_DB) << "can not store cue point of" << command.at->get_filename();
+                }
+                break;
+            case Persistence_command_type::DELETE_CUE_POINT:
+                data_persist->delete_cue_point(command.at, command.number);
+                break;
+            case Persistence_command_type::ADD_TAG_TO_TRACK:
+                if (data_persist->add_tag_to_track(command.at, command.tag) == false)
+                {
+                    qCWarning(DS_DB) << "can not add tag" << command.tag << "to" << command.at->get_filename();
+                }
+                break;
+            case Persistence_command_type::REM_TAG_FROM_TRACK:
+                data_persist->rem_tag_from_track(command.at, command.tag);
+                break;
+            case Persistence_command_type::LOAD_CUE_POINTS_AND_TAGS:
+            {
+                QSharedPointer<Audio_track> at = command.at;
+                bool result = data_persist->get_cue_points_and_tags(at);
+                command.result->reportResult(result);
+                command.result->reportFinished();
+                break;
+            }
+            case Persistence_command_type::LOAD_AUDIO_TRACKS:
+            {
+                bool result = false;
+                for (QSharedPointer<Audio_track> at : command.tracks)
+                {
+                    result |= data_persist->get_audio_track(at);
+                }
+                command.result->reportResult(result);
+                command.result->reportFinished();
+                break;
+            }
+            case Persistence_command_type::STORE_FILE_IDENTITIES:
+                if (data_persist->store_file_identities(*command.identities) == false)
+                {
+                    qCWarning(DS_DB) << "can not store identities of" << command.identities->size() << "files";
+                }
+                break;
+            case Persistence_command_type::DELETE_FILE_IDENTITIES:
+                data_persist->delete_file_identities(command.paths);
+                break;
+            case Persistence_command_type::LOAD_FILE_IDENTITIES:
+                command.result->reportResult(data_persist->get_file_identities(command.path, *command.identities));
+                command.result->reportFinished();
+                break;
+            case Persistence_command_type::LOAD_TAGS:
+                command.result->reportResult(data_persist->get_tags_of_tracks(*command.tags));
+                command.result->reportFinished();
+                break;
+        }
+        i++;
+    }
+
+    return;
+}
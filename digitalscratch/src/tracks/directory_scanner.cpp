@@ -0,0 +1,496 @@
+/*============================================================================*/
+/*                                                                            */
+/*                                                                            */
+/*                           Digital Scratch Player                           */
+/*                                                                            */
+/*                                                                            */
+/*--------------------------------------------------( directory_scanner.cpp )-*/
+/*                                                                            */
+/*  Copyright (C) 2003-2016                                                   */
+/*                Julien Rosener <julien.rosener@digital-scratch.org>         */
+/*                                                                            */
+/*----------------------------------------------------------------( License )-*/
+/*                                                                            */
+/*  This program is free software: you can redistribute it and/or modify      */
+/*  it under the terms of the GNU General Public License as published by      */
+/*  the Free Software Foundation, either version 3 of the License, or         */
+/*  (at your option) any later version.                                       */
+/*                                                                            */
+/*  This package is distributed in the hope that it will be useful,           */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of            */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             */
+/*  GNU General Public License for more details.                              */
+/*                                                                            */
+/*  You should have received a copy of the GNU General Public License         */
+/*  along with this program. If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                            */
+/*------------------------------------------------------------( Description )-*/
+/*                                                                            */
+/*  Behavior class: list audio files under directories with parallel          */
+/*                  workers (work stealing).                                  */
+/*                                                                            */
+/*============================================================================*/
+
+#include <QtDebug>
+#include <QThread>
+#include <QDir>
+#include <QFileInfo>
+#include <QFile>
+#include <QElapsedTimer>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+// Entry returned by getdents64 (not defined by the libc headers).
+struct linux_dirent64
+{
+    quint64        d_ino;
+    qint64         d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[];
+};
+#endif
+
+#include "tracks/directory_scanner.h"
+#include "app/job_scheduler.h"
+#include "app/application_logging.h"
+#include "singleton.h"
+
+Directory_scanner::Directory_scanner(const QStringList &extensions,
+                                     const int         &nb_workers)
+{
+    this->extensions = extensions;
+    this->nb_workers = nb_workers;
+    if (this->nb_workers <= 0)
+    {
+        this->nb_workers = QThread::idealThreadCount();
+    }
+    if (this->nb_workers <= 0)
+    {
+        this->nb_workers = 1;
+    }
+
+    return;
+}
+
+Directory_scanner::~Directory_scanner()
+{
+    return;
+}
+
+void
+Directory_scanner::scan(const QStringList                                 &dir_paths,
+                        std::function<void(const QVector<Scanned_file>&)>  report,
+                        std::function<bool()>                              is_canceled)
+{
+    if (dir_paths.isEmpty() == true)
+    {
+        return;
+    }
+
+    // State is shared with helper jobs, a helper which starts after the end of the scan only reads it.
+    QSharedPointer<Scanner_state> state(new Scanner_state());
+    foreach (const QString &extension, this->extensions)
+    {
+        state->extensions << ("." + extension.toLower()).toUtf8();
+        state->filters    << "*." + extension;
+    }
+    for (int i = 0; i < this->nb_workers; i++)
+    {
+        state->deques << QSharedPointer<Scanner_deque>(new Scanner_deque());
+    }
+    state->nb_pending  = 0;
+    state->nb_queued   = 0;
+    state->nb_idle     = 0;
+    state->next_worker = 1;
+    state->nb_helpers  = 0;
+    state->is_over     = false;
+    state->report      = report;
+    state->is_canceled = is_canceled;
+
+    // Spread top directories over the workers.
+    for (int i = 0; i < dir_paths.size(); i++)
+    {
+        push(*state, i % this->nb_workers, QFile::encodeName(QDir(dir_paths[i]).absolutePath()));
+    }
+
+    // Helpers are background jobs, the calling thread is the first worker.
+    for (int i = 1; i < this->nb_workers; i++)
+    {
+        Singleton<Job_scheduler>::get_instance().run<bool>(Job_priority::PREFETCH, [state]()
+        {
+            Directory_scanner::help(state);
+            return true;
+        });
+    }
+    work(*state, 0);
+
+    // Wait for helpers still listing (the report and cancel functions belong to the caller).
+    state->workers_mutex.lock();
+    state->is_over = true;
+    while (state->nb_helpers > 0)
+    {
+        state->workers_done.wait(&state->workers_mutex);
+    }
+    state->workers_mutex.unlock();
+
+    return;
+}
+
+void
+Directory_scanner::help(QSharedPointer<Scanner_state> state)
+{
+    // Join the scan only if it is not over.
+    state->workers_mutex.lock();
+    if (state->is_over == true)
+    {
+        state->workers_mutex.unlock();
+        return;
+    }
+    state->nb_helpers++;
+    state->workers_mutex.unlock();
+
+    int index = state->next_worker.fetchAndAddOrdered(1);
+    if (index < state->deques.size())
+    {
+        work(*state, index);
+    }
+
+    state->workers_mutex.lock();
+    state->nb_helpers--;
+    state->workers_done.wakeAll();
+    state->workers_mutex.unlock();
+
+    return;
+}
+
+void
+Directory_scanner::work(Scanner_state &state, const int &index)
+{
+    QVector<Scanned_file> batch;
+    batch.reserve(SCANNER_BATCH_SIZE);
+    QElapsedTimer batch_timer;
+    batch_timer.start();
+    while (state.is_canceled() == false)
+    {
+        // Give way to the playback.
+        while (Singleton<Job_scheduler>::get_instance().must_pause_current_job() == true)
+        {
+            QThread::msleep(JOB_PAUSE_MSEC);
+        }
+
+        // Take a directory from the own deque or from another worker, stop when no directory is left anywhere.
+        QByteArray dir;
+        if (pop(state, index, dir) == false)
+        {
+            // Files already found are not kept while waiting.
+            if (batch.isEmpty() == false)
+            {
+                state.report(batch);
+                batch.clear();
+                batch_timer.restart();
+            }
+            if (state.nb_pending.loadAcquire() == 0)
+            {
+                break;
+            }
+            wait_work(state);
+            continue;
+        }
+        list_directory(state, index, dir, batch);
+        if (state.nb_pending.deref() == false)
+        {
+            // Last directory listed, waiting workers can stop.
+            wake_workers(state);
+        }
+
+        // Files are reported while the scan goes on (they are hashed and analyzed meanwhile).
+        if ((batch.isEmpty() == false) && (batch_timer.elapsed() >= SCANNER_REPORT_MSEC))
+        {
+            state.report(batch);
+            batch.clear();
+            batch_timer.restart();
+        }
+    }
+    if (batch.isEmpty() == false)
+    {
+        state.report(batch);
+    }
+
+    return;
+}
+
+bool
+Directory_scanner::pop(Scanner_state &state, const int &index, QByteArray &out_dir)
+{
+    // Last pushed directory of the own deque (depth first, its parent was just listed).
+    Scanner_deque *own = state.deques[index].data();
+    own->mutex.lock();
+    if (own->dirs.isEmpty() == false)
+    {
+        out_dir = own->dirs.takeLast();
+        own->mutex.unlock();
+        state.nb_queued.deref();
+        return true;
+    }
+    own->mutex.unlock();
+
+    // Otherwise steal the oldest directory of another worker (nearest from the top, so the biggest subtree).
+    int nb_deques = state.deques.size();
+    for (int i = 1; i < nb_deques; i++)
+    {
+        Scanner_deque *other = state.deques[(index + i) % nb_deques].data();
+        other->mutex.lock();
+        if (other->dirs.isEmpty() == false)
+        {
+            out_dir = other->dirs.takeFirst();
+            other->mutex.unlock();
+            state.nb_queued.deref();
+            return true;
+        }
+        other->mutex.unlock();
+    }
+
+    return false;
+}
+
+void
+Directory_scanner::push(Scanner_state &state, const int &index, const QByteArray &dir)
+{
+    // Counted before it is visible, so the scan can not be seen as over meanwhile.
+    state.nb_pending.ref();
+    state.nb_queued.ref();
+    Scanner_deque *own = state.deques[index].data();
+    own->mutex.lock();
+    own->dirs << dir;
+    own->mutex.unlock();
+
+    // Wake up a worker waiting for a directory to steal.
+    if (state.nb_idle.loadAcquire() > 0)
+    {
+        state.idle_mutex.lock();
+        state.work_available.wakeOne();
+        state.idle_mutex.unlock();
+    }
+
+    return;
+}
+
+void
+Directory_scanner::wait_work(Scanner_state &state)
+{
+    // Sleep until a directory is queued or the scan is over (the timeout only covers a wake up sent
+    // just before this worker was counted as idle, and lets it check if the scan is canceled).
+    state.idle_mutex.lock();
+    state.nb_idle.ref();
+    if ((state.nb_queued.loadAcquire() == 0) && (state.nb_pending.loadAcquire() > 0))
+    {
+        state.work_available.wait(&state.idle_mutex, SCANNER_IDLE_WAIT_MSEC);
+    }
+    state.nb_idle.deref();
+    state.idle_mutex.unlock();
+
+    return;
+}
+
+void
+Directory_scanner::wake_workers(Scanner_state &state)
+{
+    state.idle_mutex.lock();
+    state.work_available.wakeAll();
+    state.idle_mutex.unlock();
+
+    return;
+}
+
+bool
+Directory_scanner::has_extension(const Scanner_state &state, const char *name, const size_t &length)
+{
+    // Compare the end of the name in place (no allocation for files which are not audio files).
+    foreach (const QByteArray &extension, state.extensions)
+    {
+        size_t extension_length = (size_t)extension.size();
+        if (length <= extension_length)
+        {
+            continue;
+        }
+        const char *end = name + length - extension_length;
+        size_t      i   = 0;
+        while (i < extension_length)
+        {
+            char c = end[i];
+            if ((c >= 'A') && (c <= 'Z'))
+            {
+                c = c - 'A' + 'a';
+            }
+            if (c != extension[(int)i])
+            {
+                break;
+            }
+            i++;
+        }
+        if (i == extension_length)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#ifdef __linux__
+void
+Directory_scanner::list_directory(Scanner_state         &state,
+                                  const int             &index,
+                                  const QByteArray      &dir,
+                                  QVector<Scanned_file> &io_batch)
+{
+    int fd = open(dir.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        qCDebug(DS_FILE) << "can not open directory" << QFile::decodeName(dir);
+        return;
+    }
+
+    // A directory reached twice (by a symlink) is listed only once.
+    struct stat dir_info;
+    if (fstat(fd, &dir_info) == 0)
+    {
+        QPair<quint64, quint64> key((quint64)dir_info.st_dev, (quint64)dir_info.st_ino);
+        state.visited_mutex.lock();
+        bool is_new = (state.visited.contains(key) == false);
+        if (is_new == true)
+        {
+            state.visited.insert(key);
+        }
+        state.visited_mutex.unlock();
+        if (is_new == false)
+        {
+            close(fd);
+            return;
+        }
+    }
+
+    // Read raw entries, only symlinks, unknown types and audio files need a stat.
+    QByteArray prefix = dir.endsWith('/') ? dir : dir + '/';
+    char buffer[SCANNER_DENTS_BUFFER];
+    long nb_bytes;
+    while ((nb_bytes = syscall(SYS_getdents64, fd, buffer, sizeof(buffer))) > 0)
+    {
+        for (long pos = 0; pos < nb_bytes;)
+        {
+            struct linux_dirent64 *entry = (struct linux_dirent64 *)(buffer + pos);
+            pos += entry->d_reclen;
+
+            // Hidden entries are skipped (as with QDir default filters), this includes "." and "..".
+            const char *name = entry->d_name;
+            if (name[0] == '.')
+            {
+                continue;
+            }
+
+            struct stat info;
+            bool        has_info = false;
+            unsigned char type   = entry->d_type;
+            if ((type == DT_LNK) || (type == DT_UNKNOWN))
+            {
+                // Follow symlinks, some file systems do not give the type.
+                if (fstatat(fd, name, &info, 0) != 0)
+                {
+                    continue;
+                }
+                has_info = true;
+                type = S_ISDIR(info.st_mode) ? DT_DIR : (S_ISREG(info.st_mode) ? DT_REG : DT_UNKNOWN);
+            }
+
+            if (type == DT_DIR)
+            {
+                push(state, index, prefix + name);
+            }
+            else if (type == DT_REG)
+            {
+                size_t length = strlen(name);
+                if (has_extension(state, name, length) == false)
+                {
+                    continue;
+                }
+                if ((has_info == false) && (fstatat(fd, name, &info, 0) != 0))
+                {
+                    continue;
+                }
+                Scanned_file file;
+                file.name           = QFile::decodeName(QByteArray::fromRawData(name, (int)length));
+                file.path           = QFile::decodeName(prefix + name);
+                file.identity.size  = (qint64)info.st_size;
+                file.identity.mtime = (qint64)info.st_mtim.tv_sec * 1000000000LL + (qint64)info.st_mtim.tv_nsec;
+                file.identity.inode = (quint64)info.st_ino;
+                io_batch << file;
+                if (io_batch.size() == SCANNER_BATCH_SIZE)
+                {
+                    state.report(io_batch);
+                    io_batch.clear();
+                }
+            }
+        }
+    }
+    close(fd);
+
+    return;
+}
+#else
+void
+Directory_scanner::list_directory(Scanner_state         &state,
+                                  const int             &index,
+                                  const QByteArray      &dir,
+                                  QVector<Scanned_file> &io_batch)
+{
+    // Without getdents64, use a QDir listing of the directory.
+    QString path = QFile::decodeName(dir);
+    QString canonical_path = QFileInfo(path).canonicalFilePath();
+    state.visited_mutex.lock();
+    bool is_new = (state.visited_paths.contains(canonical_path) == false);
+    if (is_new == true)
+    {
+        state.visited_paths.insert(canonical_path);
+    }
+    state.visited_mutex.unlock();
+    if (is_new == false)
+    {
+        return;
+    }
+
+    QDir qdir(path);
+    qdir.setNameFilters(state.filters);
+    qdir.setFilter(QDir::AllDirs | QDir::Files | QDir::NoDotAndDotDot);
+    foreach (const QFileInfo &file_info, qdir.entryInfoList())
+    {
+        if (file_info.isDir() == true)
+        {
+            push(state, index, QFile::encodeName(file_info.absoluteFilePath()));
+        }
+        else
+        {
+            Scanned_file file;
+            file.name = file_info.fileName();
+            file.path = file_info.absoluteFilePath();
+            if (Utils::get_file_identity(file.path, file.identity) == false)
+            {
+                continue;
+            }
+            io_batch << file;
+            if (io_batch.size() == SCANNER_BATCH_SIZE)
+            {
+                state.report(io_batch);
+                io_batch.clear();
+            }
+        }
+    }
+
+    return;
+}
+#endif
@@ -35,22 +35,219 @@
 #include <algorithm>
 #include <QtDebug>
 #include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
 #include <QStringList>
 #include <QScopedPointer>
 #include <QSharedPointer>
 
 #include "tracks/audio_track.h"
-#include "tracks/audio_file_decoding_process.h"
+#include "tracks/audio_file_analysis_process.h"
 #include "tracks/audio_track_key_process.h"
 #include "app/application_settings.h"
 #include "app/application_logging.h"
 #include "singleton.h"
 
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
 // Global static data.
 QStringList Utils::audio_file_extensions = QStringList() << "ac3" << "flac" << "m4a" << "mp2" << "mp3" << "ogg" << "wav" << "wma";
 
 // Static utils functions.
 QString Utils::get_file_hash(const QString &path, const unsigned int &kbytes)
+{
+    // Check if path is defined.
+    if (path == nullptr)
+    {
+        qCWarning(DS_FILE) << "path is null.";
+        return "";
+    }
+
+    // Check file size.
+    if (kbytes == 0)
+    {
+        qCWarning(DS_FILE) << "nb bytes to hash is 0.";
+        return "";
+    }
+
+    // Open file as binary.
+    QFile file(path);
+    if (file.open(QIODevice::ReadOnly) == false)
+    {
+        qCWarning(DS_FILE) << "can not open file to hash:" << path;
+        return "";
+    }
+
+    // Read regions evenly spread in the file (not the beginning and the end, where tags are), or the whole file if it is small.
+    qint64     size        = file.size();
+    qint64     region_size = (qint64)kbytes * 1024;
+    QByteArray bin;
+    if (size <= region_size * FILE_HASH_NB_REGIONS)
+    {
+        bin = file.readAll();
+    }
+    else
+    {
+        bin.reserve(region_size * FILE_HASH_NB_REGIONS + (int)sizeof(qint64));
+        for (int i = 1; i <= FILE_HASH_NB_REGIONS; i++)
+        {
+            file.seek((size * i) / (FILE_HASH_NB_REGIONS + 1) - (region_size / 2));
+            bin.append(file.read(region_size));
+        }
+    }
+    file.close();
+
+    // The size of the file limits collisions between files sharing the same content (e.g. silence).
+    for (unsigned int i = 0; i < sizeof(qint64); i++)
+    {
+        bin.append((char)((size >> (i * 8)) & 0xff));
+    }
+
+    // Get a 128 bits hash as an hexadecimal string (same length as a MD5).
+    quint64 h1 = 0;
+    quint64 h2 = 0;
+    Utils::hash_128(bin, h1, h2);
+
+    return QString("%1%2").arg(h1, 16, 16, QChar('0')).arg(h2, 16, 16, QChar('0'));
+}
+
+static inline quint64
+rotl64(const quint64 &x, const int &r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline quint64
+fmix64(quint64 k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+
+    return k;
+}
+
+void Utils::hash_128(const QByteArray &data, quint64 &out_h1, quint64 &out_h2)
+{
+    // MurmurHash3 (x64, 128 bits), fast and well distributed, not cryptographic.
+    const quint8  *bytes     = reinterpret_cast<const quint8*>(data.constData());
+    const int      len       = data.size();
+    const int      nb_blocks = len / 16;
+    const quint64  c1        = 0x87c37b91114253d5ULL;
+    const quint64  c2        = 0x4cf5ad432745937fULL;
+    quint64        h1        = 0;
+    quint64        h2        = 0;
+
+    // Body.
+    for (int i = 0; i < nb_blocks; i++)
+    {
+        quint64 k1 = 0;
+        quint64 k2 = 0;
+        for (int j = 7; j >= 0; j--)
+        {
+            k1 = (k1 << 8) | bytes[i * 16 + j];
+            k2 = (k2 << 8) | bytes[i * 16 + 8 + j];
+        }
+
+        k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    // Tail.
+    const quint8 *tail = bytes + nb_blocks * 16;
+    const int     rest = len & 15;
+    quint64       k1   = 0;
+    quint64       k2   = 0;
+    for (int j = rest - 1; j >= 8; j--)
+    {
+        k2 = (k2 << 8) | tail[j];
+    }
+    for (int j = qMin(rest, 8) - 1; j >= 0; j--)
+    {
+        k1 = (k1 << 8) | tail[j];
+    }
+    if (rest > 8)
+    {
+        k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+    }
+    if (rest > 0)
+    {
+        k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+    }
+
+    // Finalization.
+    h1 ^= (quint64)len;
+    h2 ^= (quint64)len;
+    h1 += h2;
+    h2 += h1;
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+    h1 += h2;
+    h2 += h1;
+
+    out_h1 = h1;
+    out_h2 = h2;
+
+    return;
+}
+
+bool Utils::get_file_identity(const QString &path, File_identity &out_identity)
+{
+    out_identity.hash = "";
+#ifdef Q_OS_UNIX
+    struct stat info;
+    if (stat(QFile::encodeName(path).constData(), &info) != 0)
+    {
+        return false;
+    }
+    out_identity.size  = (qint64)info.st_size;
+    out_identity.inode = (quint64)info.st_ino;
+#ifdef __linux__
+    out_identity.mtime = (qint64)info.st_mtim.tv_sec * 1000000000LL + (qint64)info.st_mtim.tv_nsec;
+#else
+    out_identity.mtime = (qint64)info.st_mtime * 1000000000LL;
+#endif
+#else
+    QFileInfo info(path);
+    if (info.exists() == false)
+    {
+        return false;
+    }
+    out_identity.size  = info.size();
+    out_identity.inode = 0;
+    out_identity.mtime = info.lastModified().toMSecsSinceEpoch() * 1000000LL;
+#endif
+
+    return true;
+}
+
+bool Utils::get_hash_128(const QString &hash, Hash_128 &out_hash)
+{
+    bool ok_high = false;
+    bool ok_low  = false;
+    if (hash.length() == 32)
+    {
+        out_hash.high = hash.left(16).toULongLong(&ok_high, 16);
+        out_hash.low  = hash.right(16).toULongLong(&ok_low, 16);
+    }
+    if ((ok_high == false) || (ok_low == false))
+    {
+        out_hash.high = 0;
+        out_hash.low  = 0;
+        return false;
+    }
+
+    return true;
+}
+
+QString Utils::get_file_legacy_hash(const QString &path, const unsigned int &kbytes)
 {   
     // Init.
     QString hash("");
@@ -114,14 +311,12 @@ QString Utils::get_file_music_key(const QString &path)
     // Init result.
     QString result = "";
 
-    // Decode the audio track.
-    QSharedPointer<Audio_track>                 at(new Audio_track(10, 44100)); // Force 44100 to calculate music key.
-    QScopedPointer<Audio_file_decoding_process> dec(new Audio_file_decoding_process(at, false));
-    dec->run(path, "", "");
-
-    // Compute the music key.
-    QScopedPointer<Audio_track_key_process> key_proc(new Audio_track_key_process(at));
-    if (key_proc->run() == true)
+    // Decode the audio track and compute the music key on the fly.
+    QSharedPointer<Audio_track> at(new Audio_track(ANALYSIS_SAMPLE_RATE)); // Force 44100 to calculate music key.
+    Audio_track_key_process     key_proc;
+    Audio_file_analysis_process analysis;
+    analysis.add_analyzer(&key_proc);
+    if ((analysis.run(path, at) == true) && (at->get_music_key() != ""))
     {
         result = at->get_music_key();
     }
@@ -197,6 +392,42 @@ void Utils::setup_keys()
     major_keys.append("12B");
 }
 
+qint8 Utils::get_camelot_index(const QString &key)
+{
+    // Parse it (no shared list, it is called by analysis threads).
+    int length = key.length();
+    if ((length < 2) || (length > 3))
+    {
+        return CAMELOT_UNKNOWN_KEY;
+    }
+    bool ok     = false;
+    int  number = key.left(length - 1).toInt(&ok);
+    if ((ok == false) || (number < 1) || (number > 12))
+    {
+        return CAMELOT_UNKNOWN_KEY;
+    }
+    if (key.at(length - 1) == 'A')
+    {
+        return (qint8)(number - 1);
+    }
+    if (key.at(length - 1) == 'B')
+    {
+        return (qint8)(12 + number - 1);
+    }
+
+    return CAMELOT_UNKNOWN_KEY;
+}
+
+QString Utils::get_camelot_key(const qint8 &index)
+{
+    if ((index < 0) || (index >= CAMELOT_NB_KEYS))
+    {
+        return "";
+    }
+
+    return QString::number((index % 12) + 1) + ((index < 12) ? "A" : "B");
+}
+
 void Utils::get_next_music_keys(const QString &key,
                                 QString &next_key,
                                 QString &prev_key,
@@ -0,0 +1,195 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QSignalSpy>
+#include "audio_collection_model_test.h"
+#include "tracks/audio_collection_model.h"
+#include "tracks/data_persistence.h"
+#include "singleton.h"
+#include "utils.h"
+
+#define FETCH_WAIT_MSEC 5000 // Max time to enumerate a test directory.
+
+static bool create_file(const QString &path)
+{
+    // Content is the path, so all files have different hashes.
+    QFile file(path);
+    if (file.open(QIODevice::WriteOnly) == false)
+    {
+        return false;
+    }
+    file.write(path.toUtf8());
+
+    return true;
+}
+
+static QStringList get_names(Audio_collection_model &model, const QModelIndex &parent)
+{
+    QStringList names;
+    for (int row = 0; row < model.rowCount(parent); row++)
+    {
+        names << model.data(model.index(row, COLUMN_FILE_NAME, parent), Qt::DisplayRole).toString();
+    }
+
+    return names;
+}
+
+static QModelIndex get_index(Audio_collection_model &model, const QModelIndex &parent, const QString &name)
+{
+    for (int row = 0; row < model.rowCount(parent); row++)
+    {
+        QModelIndex index = model.index(row, COLUMN_FILE_NAME, parent);
+        if (model.data(index, Qt::DisplayRole).toString() == name)
+        {
+            return index;
+        }
+    }
+
+    return QModelIndex();
+}
+
+Audio_collection_model_Test::Audio_collection_model_Test()
+{
+}
+
+void Audio_collection_model_Test::initTestCase()
+{
+}
+
+void Audio_collection_model_Test::cleanupTestCase()
+{
+}
+
+void Audio_collection_model_Test::testCaseSortByDirectory()
+{
+    QTemporaryDir dir;
+    QVERIFY2(dir.isValid() == true, "temporary directory");
+    QVERIFY2(QDir(dir.path()).mkdir("sub") == true, "sub directory");
+    QStringList files;
+    files << "Track 10.mp3" << "track 9.mp3" << "a.mp3" << "b.mp3" << "sub/x.mp3" << "sub/y.mp3";
+    foreach (const QString &file, files)
+    {
+        QVERIFY2(create_file(dir.filePath(file)) == true, "create file");
+    }
+
+    // Enumerate the root directory.
+    Audio_collection_model model;
+    QModelIndex root = model.set_root_path(dir.path());
+    QVERIFY2(model.canFetchMore(root) == true, "root can be fetched");
+    model.fetchMore(root);
+    QTRY_VERIFY_WITH_TIMEOUT(model.rowCount(root) == 5, FETCH_WAIT_MSEC);
+
+    // By name: directories first, numbers by value, case insensitive.
+    model.sort(COLUMN_FILE_NAME, Qt::AscendingOrder);
+    QVERIFY2(get_names(model, root) == QStringList() << "sub" << "a.mp3" << "b.mp3" << "track 9.mp3" << "Track 10.mp3",
+             "sorted by name");
+
+    // By Camelot key: 1A, 1B, 2A,... 12B, files without key last.
+    QHash<QString, QString> keys;
+    keys.insert("a.mp3",       "12A");
+    keys.insert("b.mp3",       "1B");
+    keys.insert("track 9.mp3", "1A");
+    for (int row = 0; row < model.rowCount(root); row++)
+    {
+        QModelIndex index = model.index(row, COLUMN_FILE_NAME, root);
+        QString     name  = model.data(index, Qt::DisplayRole).toString();
+        if (keys.contains(name) == true)
+        {
+            static_cast<Audio_collection_item*>(index.internalPointer())->set_data(COLUMN_KEY, keys.value(name));
+        }
+    }
+    model.sort(COLUMN_KEY, Qt::AscendingOrder);
+    QVERIFY2(get_names(model, root) == QStringList() << "sub" << "track 9.mp3" << "b.mp3" << "a.mp3" << "Track 10.mp3",
+             "sorted by key");
+    model.sort(COLUMN_KEY, Qt::DescendingOrder);
+    QVERIFY2(get_names(model, root) == QStringList() << "sub" << "a.mp3" << "b.mp3" << "track 9.mp3" << "Track 10.mp3",
+             "sorted by key, descending");
+
+    // A directory enumerated later gets the same order.
+    model.sort(COLUMN_FILE_NAME, Qt::DescendingOrder);
+    QVERIFY2(get_names(model, root) == QStringList() << "sub" << "Track 10.mp3" << "track 9.mp3" << "b.mp3" << "a.mp3",
+             "sorted by name, descending");
+    QModelIndex sub = model.index(0, COLUMN_FILE_NAME, root);
+    model.fetchMore(sub);
+    QTRY_VERIFY_WITH_TIMEOUT(model.rowCount(sub) == 2, FETCH_WAIT_MSEC);
+    QVERIFY2(get_names(model, sub) == QStringList() << "y.mp3" << "x.mp3", "sub directory sorted");
+}
+
+void Audio_collection_model_Test::testCaseSortedFetch()
+{
+    // A directory listed in several batches.
+    QTemporaryDir dir;
+    QVERIFY2(dir.isValid() == true, "temporary directory");
+    QVERIFY2(QDir(dir.path()).mkdir("sub") == true, "sub directory");
+    int nb_files = COLLECTION_FETCH_BATCH_SIZE * 3 + 5;
+    for (int i = 0; i < nb_files; i++)
+    {
+        QVERIFY2(create_file(dir.filePath("sub/track " + QString::number(i) + ".mp3")) == true, "create file");
+    }
+    Audio_collection_model model;
+    QModelIndex root = model.set_root_path(dir.path());
+    model.fetchMore(root);
+    QTRY_VERIFY_WITH_TIMEOUT(model.rowCount(root) == 1, FETCH_WAIT_MSEC);
+
+    // Sorted before it is listed: rows are inserted at their place, the layout does not change.
+    model.sort(COLUMN_FILE_NAME, Qt::DescendingOrder);
+    QSignalSpy layout_spy(&model, SIGNAL(layoutChanged()));
+    QModelIndex sub = model.index(0, COLUMN_FILE_NAME, root);
+    model.fetchMore(sub);
+    QTRY_VERIFY_WITH_TIMEOUT(model.rowCount(sub) == nb_files, FETCH_WAIT_MSEC);
+    QVERIFY2(layout_spy.count() == 0, "no layout change");
+    QStringList names = get_names(model, sub);
+    for (int i = 0; i < nb_files; i++)
+    {
+        QVERIFY2(names[i] == "track " + QString::number(nb_files - 1 - i) + ".mp3", "sorted rows");
+    }
+}
+
+void Audio_collection_model_Test::testCaseLazyFetch()
+{
+    QTemporaryDir dir;
+    QVERIFY2(dir.isValid() == true, "temporary directory");
+    QVERIFY2(QDir(dir.path()).mkpath("a/b") == true, "sub directories");
+    QStringList files;
+    files << "a/b/c.mp3" << "a/d.mp3" << "e.mp3";
+    foreach (const QString &file, files)
+    {
+        QVERIFY2(create_file(dir.filePath(file)) == true, "create file");
+    }
+
+    // Analysis data of a file are already in DB.
+    QSharedPointer<Audio_track> at(new Audio_track(44100));
+    at->set_hash(Utils::get_file_hash(dir.filePath("e.mp3")));
+    at->set_music_key("4A");
+    at->set_bpm(123.0f);
+    QVERIFY2(Singleton<Data_persistence>::get_instance().store_audio_track(at) == true, "store track");
+
+    // Enumerate the root directory, data of its files are shown without waiting for the listing of the whole collection.
+    Audio_collection_model model;
+    QModelIndex root = model.set_root_path(dir.path());
+    model.fetchMore(root);
+    QTRY_VERIFY_WITH_TIMEOUT(model.rowCount(root) == 2, FETCH_WAIT_MSEC);
+    QModelIndex e = get_index(model, root, "e.mp3");
+    QVERIFY2(e.isValid() == true, "file of root directory");
+    QTRY_VERIFY_WITH_TIMEOUT(model.data(e.sibling(e.row(), COLUMN_KEY), Qt::DisplayRole).toString() == "4A", FETCH_WAIT_MSEC);
+    QVERIFY2(model.data(e.sibling(e.row(), COLUMN_BPM), Qt::DisplayRole).toString() == "123.0", "bpm read from DB");
+
+    // Sub directories are enumerated only when they are needed.
+    QModelIndex a = get_index(model, root, "a");
+    QVERIFY2(a.isValid() == true, "sub directory");
+    QVERIFY2(model.hasChildren(a) == true, "sub directory can be expanded");
+    QVERIFY2(model.canFetchMore(a) == true, "sub directory not enumerated");
+
+    // Selecting a file enumerates directories on the way in background.
+    QSignalSpy selected(&model, SIGNAL(path_selected(QModelIndex)));
+    QString path = QFileInfo(dir.filePath("a/b/c.mp3")).absoluteFilePath();
+    model.select_path(path);
+    QVERIFY2(selected.count() == 0, "not selected before its directories are enumerated");
+    QTRY_VERIFY_WITH_TIMEOUT(selected.count() == 1, FETCH_WAIT_MSEC);
+    QModelIndex c = selected.at(0).at(0).value<QModelIndex>();
+    QVERIFY2(static_cast<Audio_collection_item*>(c.internalPointer())->get_full_path() == path, "selected file");
+    QVERIFY2(model.rowCount(a) == 2, "directory on the way enumerated");
+
+    // A path which is not in the tree is not selected.
+    model.select_path(QFileInfo(dir.filePath("a/none.mp3")).absoluteFilePath());
+    QVERIFY2(selected.count() == 1, "unknown path not selected");
+}
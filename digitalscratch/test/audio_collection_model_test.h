@@ -0,0 +1,18 @@
+#include <QObject>
+#include <QtTest>
+
+class Audio_collection_model_Test : public QObject
+{
+    Q_OBJECT
+
+public:
+    Audio_collection_model_Test();
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testCaseSortByDirectory();
+    void testCaseSortedFetch();
+    void testCaseLazyFetch();
+};
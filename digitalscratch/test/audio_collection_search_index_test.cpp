@@ -0,0 +1,109 @@
+#include <QtTest>
+
+#include "audio_collection_search_index_test.h"
+#include "utils.h"
+
+#define HASH_1 "0123456789abcdef0011223344556677"
+
+Audio_collection_search_index_Test::Audio_collection_search_index_Test()
+{
+}
+
+void Audio_collection_search_index_Test::initTestCase()
+{
+}
+
+void Audio_collection_search_index_Test::cleanupTestCase()
+{
+}
+
+void Audio_collection_search_index_Test::testCaseNormalize()
+{
+    QVERIFY2(Audio_collection_search_index::normalize("Daft Punk - Da Funk.MP3") == "daft punk da funk mp3", "lower case, words");
+    QVERIFY2(Audio_collection_search_index::normalize("  Beyoncé_Déjà  Vu ")    == "beyonce deja vu",       "accents, spaces");
+    QVERIFY2(Audio_collection_search_index::normalize("--")                      == "",                      "no word");
+}
+
+void Audio_collection_search_index_Test::testCaseSearch()
+{
+    Audio_collection_store        store;
+    Audio_collection_search_index index(&store);
+    int id_1 = store.add_file("/music/house",  "Daft Punk - Da Funk.mp3",      HASH_1);
+    int id_2 = store.add_file("/music/house",  "Stardust - Music Sounds.mp3",  HASH_1);
+    int id_3 = store.add_file("/music/techno", "Jeff Mills - The Bells.mp3",   HASH_1);
+    int id_4 = store.add_file("/music/punk",   "Ramones - Blitzkrieg Bop.flac", HASH_1);
+    index.set_file(id_1, QStringList());
+    index.set_file(id_2, QStringList() << "classic");
+    index.set_file(id_3, QStringList() << "classic" << "detroit");
+    index.set_file(id_4, QStringList());
+    store.set_key(id_3, Utils::get_camelot_index("8A"));
+    store.set_bpm(id_3, 132.2);
+
+    // Substring of a name, files matching in their name first.
+    QVector<int> ids = index.search("unk");
+    QVERIFY2((ids.size() == 2) && (ids[0] == id_1) && (ids[1] == id_4),   "substring, names first");
+
+    // Path, tags, several words, key and bpm.
+    QVERIFY2(index.search("techno") == QVector<int>() << id_3,           "path");
+    QVERIFY2(index.search("classic") == QVector<int>() << id_2 << id_3,  "tag");
+    QVERIFY2(index.search("classic DETROIT") == QVector<int>() << id_3,  "words");
+    QVERIFY2(index.search("8a") == QVector<int>() << id_3,               "key");
+    QVERIFY2(index.search("132") == QVector<int>() << id_3,              "bpm");
+    QVERIFY2(index.search("house 132").isEmpty() == true,                "no match");
+
+    // Removed files and changed files.
+    store.set_flag(id_4, COLLECTION_FILE_REMOVED, true);
+    QVERIFY2(index.search("ramones").isEmpty() == true,                  "removed");
+    index.set_file(id_2, QStringList());
+    QVERIFY2(index.search("classic") == QVector<int>() << id_3,          "tag removed");
+}
+
+void Audio_collection_search_index_Test::testCaseSearchTypos()
+{
+    Audio_collection_store        store;
+    Audio_collection_search_index index(&store);
+    int id_1 = store.add_file("/music", "Blitzkrieg Bop.mp3",  HASH_1);
+    int id_2 = store.add_file("/music", "Blitzkrieg Pop.mp3",  HASH_1);
+    int id_3 = store.add_file("/music", "Something else.mp3",  HASH_1);
+    index.set_file(id_1, QStringList());
+    index.set_file(id_2, QStringList());
+    index.set_file(id_3, QStringList());
+
+    // Exact matches first, then matches with typos.
+    QVERIFY2(index.search("blitzkreig") == QVector<int>() << id_1 << id_2, "typo");
+    QVERIFY2(index.search("blitzkrieg bop") == QVector<int>() << id_1,     "exact, short word has no typo");
+    QVERIFY2(index.search("somethnig").contains(id_3) == true,             "swapped letters");
+    QVERIFY2(index.search("xyzxyzxyz").isEmpty() == true,                  "too many typos");
+}
+
+void Audio_collection_search_index_Test::testCaseSearchIncremental()
+{
+    Audio_collection_store        store;
+    Audio_collection_search_index index(&store);
+    int id_1 = store.add_file("/music", "Around the World.mp3", HASH_1);
+    int id_2 = store.add_file("/music", "Aerodynamic.mp3",      HASH_1);
+    index.set_file(id_1, QStringList());
+    index.set_file(id_2, QStringList());
+
+    // Results while typing.
+    QVERIFY2(index.search("a").size() == 2,                                 "1 char");
+    QVERIFY2(index.search("ar").size() == 1,                                "2 chars");
+    QVERIFY2(index.search("aro") == QVector<int>() << id_1,                 "3 chars");
+    QVERIFY2(index.search("arou") == QVector<int>() << id_1,                "4 chars");
+
+    // A file indexed while typing is found.
+    int id_3 = store.add_file("/music", "Arousal.mp3", HASH_1);
+    index.set_file(id_3, QStringList());
+    QVERIFY2(index.search("arous") == QVector<int>() << id_3 << id_1,       "new file");
+
+    // A bpm typed digit by digit is not a filter of the shorter number.
+    store.set_bpm(id_2, 120.0);
+    QVERIFY2(index.search("12").isEmpty() == true,                          "bpm 12");
+    QVERIFY2(index.search("120") == QVector<int>() << id_2,                 "bpm 120");
+
+    // A file restored while typing is found.
+    store.set_flag(id_2, COLLECTION_FILE_REMOVED, true);
+    QVERIFY2(index.search("aer").isEmpty() == true,                         "removed file");
+    store.set_flag(id_2, COLLECTION_FILE_REMOVED, false);
+    QVERIFY2(index.search("aero") == QVector<int>() << id_2,                "restored file");
+}
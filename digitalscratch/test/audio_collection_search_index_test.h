@@ -0,0 +1,21 @@
+#include <QObject>
+#include <QtTest>
+
+#include "tracks/audio_collection_search_index.h"
+
+class Audio_collection_search_index_Test : public QObject
+{
+    Q_OBJECT
+
+public:
+    Audio_collection_search_index_Test();
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testCaseNormalize();
+    void testCaseSearch();
+    void testCaseSearchTypos();
+    void testCaseSearchIncremental();
+};
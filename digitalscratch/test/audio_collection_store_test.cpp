@@ -0,0 +1,157 @@
+#include <QtTest>
+
+#include "audio_collection_store_test.h"
+#include "utils.h"
+
+#define HASH_1 "0123456789abcdef0011223344556677"
+#define HASH_2 "fedcba98765432108899aabbccddeeff"
+
+Audio_collection_store_Test::Audio_collection_store_Test()
+{
+}
+
+void Audio_collection_store_Test::initTestCase()
+{
+}
+
+void Audio_collection_store_Test::cleanupTestCase()
+{
+}
+
+void Audio_collection_store_Test::testCaseAddFile()
+{
+    Audio_collection_store store;
+
+    // Files of a same directory share it.
+    int id_1 = store.add_file("/music/album", "track_1.mp3", HASH_1);
+    int id_2 = store.add_file("/music/album", "track_2.mp3", HASH_2);
+    int id_3 = store.add_file("/music",       "track_3.mp3", HASH_1);
+    QVERIFY2(store.get_nb_files() == 3,                                   "nb files");
+    QVERIFY2((id_1 == 0) && (id_2 == 1) && (id_3 == 2),                   "ids");
+    QVERIFY2(store.get_name(id_2) == "track_2.mp3",                       "name");
+    QVERIFY2(store.get_dir_path(id_2) == "/music/album",                  "dir path");
+    QVERIFY2(store.get_full_path(id_3) == "/music/track_3.mp3",           "full path");
+
+    // Not analyzed yet.
+    QVERIFY2(store.get_key(id_1) == CAMELOT_UNKNOWN_KEY,                  "no key");
+    QVERIFY2(store.get_bpm(id_1) == 0.0,                                  "no bpm");
+    QVERIFY2(store.get_nb_missing_data() == 3,                            "all missing");
+
+    // Analyzed (even with a bpm of 0) and removed files are not missing data.
+    store.set_key(id_1, Utils::get_camelot_index("8A"));
+    store.set_bpm(id_1, 124.5);
+    store.set_first_beat(id_1, 350);
+    store.set_loudness(id_1, -9.5);
+    store.set_flag(id_1, COLLECTION_FILE_ANALYZED, true);
+    store.set_flag(id_2, COLLECTION_FILE_REMOVED, true);
+    store.set_flag(id_3, COLLECTION_FILE_ANALYZED, true);
+    QVERIFY2(Utils::get_camelot_key(store.get_key(id_1)) == "8A",         "key");
+    QVERIFY2(store.get_bpm(id_1) == (float)124.5,                         "bpm");
+    QVERIFY2(store.get_first_beat(id_1) == 350,                           "first beat");
+    QVERIFY2(store.get_loudness(id_1) == (float)-9.5,                     "loudness");
+    QVERIFY2(store.get_nb_missing_data() == 0,                            "none missing");
+    store.set_flag(id_3, COLLECTION_FILE_ANALYZED, false);
+    QVERIFY2(store.get_nb_missing_data() == 1,                            "one missing");
+
+    // Clear.
+    store.clear();
+    QVERIFY2(store.get_nb_files() == 0,                                   "cleared");
+    QVERIFY2(store.add_file("/other", "track_1.mp3", HASH_1) == 0,        "id after clear");
+    QVERIFY2(store.get_dir_path(0) == "/other",                           "dir after clear");
+}
+
+void Audio_collection_store_Test::testCaseHash()
+{
+    Audio_collection_store store;
+
+    // Stored as binary, got back as hexadecimal.
+    int id = store.add_file("/music", "track_1.mp3", HASH_1);
+    QVERIFY2(store.get_hash(id) == HASH_1,                                "hash");
+    QVERIFY2(store.has_flag(id, COLLECTION_FILE_HAS_HASH) == true,       "has hash");
+    store.set_hash(id, HASH_2);
+    QVERIFY2(store.get_hash(id) == HASH_2,                                "changed hash");
+
+    // Unreadable file.
+    store.set_hash(id, "");
+    QVERIFY2(store.get_hash(id) == "",                                    "no hash");
+    QVERIFY2(store.has_flag(id, COLLECTION_FILE_HAS_HASH) == false,      "has no hash");
+    int id_2 = store.add_file("/music", "track_2.mp3", "not a hash");
+    QVERIFY2(store.get_hash(id_2) == "",                                  "invalid hash");
+}
+
+void Audio_collection_store_Test::testCaseNextKeys()
+{
+    Audio_collection_store store;
+    int id_1 = store.add_file("/music/a", "track_1.mp3", HASH_1);
+    int id_2 = store.add_file("/music/b", "track_2.mp3", HASH_1);
+    int id_3 = store.add_file("/music/b", "track_3.mp3", HASH_1);
+    int id_4 = store.add_file("/music/c", "track_4.mp3", HASH_1);
+    int id_5 = store.add_file("/music/d", "track_5.mp3", HASH_1);
+    store.set_key(id_1, Utils::get_camelot_index("9A"));
+    store.set_key(id_2, Utils::get_camelot_index("7A"));
+    store.set_key(id_3, Utils::get_camelot_index("8B"));
+    store.set_key(id_4, Utils::get_camelot_index("1A"));
+    store.set_key(id_5, Utils::get_camelot_index("9A"));
+    store.set_flag(id_5, COLLECTION_FILE_REMOVED, true);
+
+    // Next keys of 8A.
+    QVector<int> dir_ids;
+    store.set_next_keys(Utils::get_camelot_index("9A"),
+                        Utils::get_camelot_index("7A"),
+                        Utils::get_camelot_index("8B"),
+                        dir_ids);
+    QVERIFY2(store.is_next_key(id_1) == true,                               "next key");
+    QVERIFY2(store.is_next_key(id_2) == true,                               "previous key");
+    QVERIFY2(store.is_next_major_key(id_3) == true,                         "next major key");
+    QVERIFY2(store.is_next_key(id_3) == false,                              "not next key");
+    QVERIFY2(store.is_next_key(id_4) == false,                              "other key");
+    QVERIFY2(store.is_next_key(id_5) == false,                              "removed");
+    QVERIFY2(dir_ids.size() == 2,                                           "nb directories");
+    QVERIFY2((store.get_dir(dir_ids[0]) == "/music/a") && (store.get_dir(dir_ids[1]) == "/music/b"), "directories");
+    QVERIFY2(store.get_next_key_files(false, 10).size() == 2,               "next key files");
+    QVERIFY2(store.get_next_key_files(false, 1).size() == 1,                "max files");
+    QVERIFY2(store.get_next_key_files(true, 10).size() == 1,                "next major key files");
+
+    // The index follows changes of keys and removed files.
+    store.set_key(id_2, Utils::get_camelot_index("1A"));
+    store.set_flag(id_1, COLLECTION_FILE_REMOVED, true);
+    store.set_next_keys(Utils::get_camelot_index("9A"),
+                        Utils::get_camelot_index("7A"),
+                        Utils::get_camelot_index("8B"),
+                        dir_ids);
+    QVERIFY2(store.get_next_key_files(false, 10).size() == 0,               "no next key files");
+    QVERIFY2((dir_ids.size() == 1) && (store.get_dir(dir_ids[0]) == "/music/b"), "directory of next major key");
+    store.set_flag(id_5, COLLECTION_FILE_REMOVED, false);
+    store.set_next_keys(Utils::get_camelot_index("9A"),
+                        Utils::get_camelot_index("7A"),
+                        Utils::get_camelot_index("8B"),
+                        dir_ids);
+    QVERIFY2((store.get_next_key_files(false, 10).size() == 1) &&
+             (store.get_next_key_files(false, 10)[0] == id_5),              "restored file");
+
+    // Selection of other keys.
+    store.set_next_keys(Utils::get_camelot_index("2A"),
+                        Utils::get_camelot_index("12A"),
+                        Utils::get_camelot_index("1B"),
+                        dir_ids);
+    QVERIFY2(store.is_next_key(id_5) == false,                              "reset");
+    QVERIFY2(store.is_next_major_key(id_3) == false,                        "reset major");
+    QVERIFY2(store.get_next_key_files(false, 10).size() == 0,               "no next key files");
+    QVERIFY2(dir_ids.isEmpty() == true,                                     "no directory");
+}
+
+void Audio_collection_store_Test::testCaseManyFiles()
+{
+    Audio_collection_store store;
+
+    // Files are in several chunks.
+    int nb_files = COLLECTION_STORE_CHUNK_SIZE * 2 + 10;
+    for (int i = 0; i < nb_files; i++)
+    {
+        store.add_file("/music/" + QString::number(i % 100), "track_" + QString::number(i) + ".mp3", HASH_1);
+    }
+    QVERIFY2(store.get_nb_files() == nb_files,                                                  "nb files");
+    QVERIFY2(store.get_full_path(nb_files - 1) == "/music/" + QString::number((nb_files - 1) % 100)
+                                                  + "/track_" + QString::number(nb_files - 1) + ".mp3", "last file");
+    QVERIFY2(store.get_nb_missing_data() == nb_files,                                           "all missing");
+}
@@ -0,0 +1,21 @@
+#include <QObject>
+#include <QtTest>
+
+#include "tracks/audio_collection_store.h"
+
+class Audio_collection_store_Test : public QObject
+{
+    Q_OBJECT
+
+public:
+    Audio_collection_store_Test();
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testCaseAddFile();
+    void testCaseHash();
+    void testCaseNextKeys();
+    void testCaseManyFiles();
+};
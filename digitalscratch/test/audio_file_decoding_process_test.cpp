@@ -1,5 +1,9 @@
 #include <QString>
 #include <QtTest>
+#include <QtEndian>
+#include <QDir>
+#include <QtMath>
+#include <sys/resource.h>
 #include "audio_file_decoding_process_test.h"
 #include "tracks/audio_track.h"
 #include "tracks/audio_file_decoding_process.h"
@@ -8,6 +12,37 @@
 #define DATA_DIR     "./test/data/"
 #define DATA_TRACK_1 "track_1.mp3"
 #define DATA_TRACK_2 "b_comp_-_p_dust.mp3"
+#define DATA_TRACK_3 "track_flac_8khz.flac" // 20 sec, mono.
+
+static bool write_wav(const QString &path, const QVector<short signed int> &samples, const quint16 &nb_channels)
+{
+    QFile file(path);
+    if (file.open(QIODevice::WriteOnly) == false)
+    {
+        return false;
+    }
+    quint32 data_size = samples.size() * 2;
+    uchar   header[44];
+    memcpy(&header[0], "RIFF", 4);  qToLittleEndian<quint32>(36 + data_size, &header[4]);
+    memcpy(&header[8], "WAVEfmt ", 8);
+    qToLittleEndian<quint32>(16, &header[16]);
+    qToLittleEndian<quint16>(1, &header[20]);                       // PCM.
+    qToLittleEndian<quint16>(nb_channels, &header[22]);
+    qToLittleEndian<quint32>(44100, &header[24]);
+    qToLittleEndian<quint32>(44100 * nb_channels * 2, &header[28]);
+    qToLittleEndian<quint16>(nb_channels * 2, &header[32]);
+    qToLittleEndian<quint16>(16, &header[34]);
+    memcpy(&header[36], "data", 4); qToLittleEndian<quint32>(data_size, &header[40]);
+    file.write((const char*)header, 44);
+    for (int i = 0; i < samples.size(); i++)
+    {
+        uchar sample[2];
+        qToLittleEndian<qint16>(samples[i], sample);
+        file.write((const char*)sample, 2);
+    }
+
+    return true;
+}
 
 Audio_file_decoding_process_Test::Audio_file_decoding_process_Test()
 {
@@ -54,3 +89,170 @@ void Audio_file_decoding_process_Test::testCaseRun()
     QVERIFY2(decoder.run(file_info_2.absoluteFilePath(), "", "") == true,  "decode normal sized mp3");
 }
 
+void Audio_file_decoding_process_Test::testCaseRunSegmented()
+{
+    QString fullpath = QFileInfo(QString(DATA_DIR) + QString(DATA_TRACK_3)).absoluteFilePath();
+
+    // Same sample rate: segmented decoding gives exactly the sequential result.
+    QSharedPointer<Audio_track> at_seq(new Audio_track(15, 8000));
+    QSharedPointer<Audio_track> at_seg(new Audio_track(15, 8000));
+    Audio_file_decoding_process decoder_seq(at_seq, false);
+    Audio_file_decoding_process decoder_seg(at_seg, false);
+    decoder_seq.set_max_nb_threads(1);
+    decoder_seg.set_max_nb_threads(4);
+    QVERIFY2(decoder_seq.run(fullpath, "", "") == true, "decode flac sequentially");
+    QVERIFY2(decoder_seg.run(fullpath, "", "") == true, "decode flac by segments");
+    QVERIFY2(at_seq->get_end_of_samples() == 20 * 8000 * 2, "number of samples decoded sequentially");
+    QVERIFY2(at_seg->get_end_of_samples() == at_seq->get_end_of_samples(), "number of samples decoded by segments");
+    QVERIFY2(memcmp(at_seq->get_samples(), at_seg->get_samples(),
+                    at_seq->get_end_of_samples() * sizeof(short signed int)) == 0, "same samples");
+
+    // Resampling: segments are primed, only the dither can differ.
+    QSharedPointer<Audio_track> at_seq_44(new Audio_track(15, 44100));
+    QSharedPointer<Audio_track> at_seg_44(new Audio_track(15, 44100));
+    Audio_file_decoding_process decoder_seq_44(at_seq_44, true);
+    Audio_file_decoding_process decoder_seg_44(at_seg_44, true);
+    decoder_seq_44.set_max_nb_threads(1);
+    decoder_seg_44.set_max_nb_threads(4);
+    QVERIFY2(decoder_seq_44.run(fullpath, "", "") == true, "decode and resample flac sequentially");
+    QVERIFY2(decoder_seg_44.run(fullpath, "", "") == true, "decode and resample flac by segments");
+    QVERIFY2(qAbs((int)at_seg_44->get_end_of_samples() - (int)at_seq_44->get_end_of_samples()) <= 16,
+             "number of resampled samples");
+    unsigned int nb_samples = qMin(at_seq_44->get_end_of_samples(), at_seg_44->get_end_of_samples());
+    int          max_diff   = 0;
+    for (unsigned int i = 0; i < nb_samples; i++)
+    {
+        max_diff = qMax(max_diff, qAbs(at_seq_44->get_samples()[i] - at_seg_44->get_samples()[i]));
+    }
+    QVERIFY2(max_diff <= 3, "same resampled samples");
+}
+
+void Audio_file_decoding_process_Test::testCaseSegmentBoundaries()
+{
+    QString fullpath = QFileInfo(QString(DATA_DIR) + QString(DATA_TRACK_3)).absoluteFilePath();
+
+    // 20 sec at 8 kHz decoded by 4 threads: segments start every 5 sec (input aligned on 80 frames).
+    QSharedPointer<Audio_track> at_seq(new Audio_track(15, 44100));
+    QSharedPointer<Audio_track> at_seg(new Audio_track(15, 44100));
+    Audio_file_decoding_process decoder_seq(at_seq, true);
+    Audio_file_decoding_process decoder_seg(at_seg, true);
+    decoder_seq.set_max_nb_threads(1);
+    decoder_seg.set_max_nb_threads(4);
+    QVERIFY2(decoder_seq.run(fullpath, "", "") == true, "decode and resample flac sequentially");
+    QVERIFY2(decoder_seg.run(fullpath, "", "") == true, "decode and resample flac by segments");
+
+    // Around each boundary, the primed resampler gives the sequential output (except dither).
+    const short signed int *seq = at_seq->get_samples();
+    const short signed int *seg = at_seg->get_samples();
+    for (int i = 1; i < 4; i++)
+    {
+        int64_t boundary = (((int64_t)160000 * i / 4) / 80) * 80 * 44100 / 8000;
+        int     max_diff = 0;
+        for (int64_t frame = boundary - 4096; frame < boundary + 4096; frame++)
+        {
+            max_diff = qMax(max_diff, qAbs(seq[frame * 2]     - seg[frame * 2]));
+            max_diff = qMax(max_diff, qAbs(seq[frame * 2 + 1] - seg[frame * 2 + 1]));
+        }
+        QVERIFY2(max_diff <= 2, qPrintable(QString("same samples around boundary %1").arg(i)));
+    }
+}
+
+void Audio_file_decoding_process_Test::testCaseResample()
+{
+    // 2 sec of a 1 kHz sine at 44.1 kHz.
+    QVector<short signed int> samples(44100 * 2 * 2);
+    for (int i = 0; i < 44100 * 2; i++)
+    {
+        samples[i * 2] = samples[i * 2 + 1] = (short signed int)qRound(16000.0 * qSin(2.0 * M_PI * 1000.0 * i / 44100.0));
+    }
+    QString path = QDir::temp().filePath("ds_test_sine.wav");
+    QVERIFY2(write_wav(path, samples, 2) == true, "write sine wav");
+
+    // Loaded at 48 kHz: the file is decoded and resampled, same duration and same sine.
+    QSharedPointer<Audio_track> at(new Audio_track(15, 48000));
+    Audio_file_decoding_process decoder(at, true);
+    QVERIFY2(decoder.run(path, "", "") == true, "decode and resample sine");
+    QVERIFY2(at->is_mapped() == false,          "resampled wav is not mapped");
+    QVERIFY2(qAbs((int)at->get_end_of_samples() - 48000 * 2 * 2) <= 16, "number of resampled samples");
+    int max_diff = 0;
+    for (int i = 2048; i < 48000 * 2 - 2048; i++)
+    {
+        int expected = qRound(16000.0 * qSin(2.0 * M_PI * 1000.0 * i / 48000.0));
+        max_diff = qMax(max_diff, qAbs(at->get_samples()[i * 2]     - expected));
+        max_diff = qMax(max_diff, qAbs(at->get_samples()[i * 2 + 1] - expected));
+    }
+    QVERIFY2(max_diff <= 32, "resampled sine");
+
+    QFile::remove(path);
+}
+
+void Audio_file_decoding_process_Test::testCaseRunUncompressed()
+{
+    QVector<short signed int> samples(44100 * 2);
+    for (int i = 0; i < samples.size(); i++)
+    {
+        samples[i] = (short signed int)(i * 37 - 20000);
+    }
+    QString stereo_path = QDir::temp().filePath("ds_test_stereo.wav");
+    QString mono_path   = QDir::temp().filePath("ds_test_mono.wav");
+    QVERIFY2(write_wav(stereo_path, samples, 2) == true, "write stereo wav");
+    QVERIFY2(write_wav(mono_path,   samples, 1) == true, "write mono wav");
+
+    // Stereo 16 bits at the right sample rate: samples are used directly from the file.
+    QSharedPointer<Audio_track> at(new Audio_track(15, 44100));
+    Audio_file_decoding_process decoder(at, true);
+    QVERIFY2(decoder.run(stereo_path, "", "") == true,                      "load stereo wav");
+    QVERIFY2(at->is_mapped() == true,                                       "stereo wav is mapped");
+    QVERIFY2(at->get_end_of_samples() == (unsigned int)samples.size(),      "number of stereo samples");
+    QVERIFY2(memcmp(at->get_samples(), samples.constData(), samples.size() * 2) == 0, "stereo samples");
+
+    // Mono: converted in the track.
+    decoder.clear();
+    QVERIFY2(decoder.run(mono_path, "", "") == true,                        "load mono wav");
+    QVERIFY2(at->is_mapped() == false,                                      "mono wav is converted");
+    QVERIFY2(at->get_end_of_samples() == (unsigned int)samples.size() * 2,  "number of mono samples");
+    bool is_ok = true;
+    for (int i = 0; i < samples.size(); i++)
+    {
+        is_ok &= (at->get_samples()[i * 2] == samples[i]) && (at->get_samples()[i * 2 + 1] == samples[i]);
+    }
+    QVERIFY2(is_ok == true, "mono samples");
+
+    QFile::remove(stereo_path);
+    QFile::remove(mono_path);
+}
+
+void Audio_file_decoding_process_Test::testCaseRunUncompressedMemlockLimit()
+{
+    QVector<short signed int> samples(44100 * 2);
+    for (int i = 0; i < samples.size(); i++)
+    {
+        samples[i] = (short signed int)(i * 37 - 20000);
+    }
+    QString stereo_path = QDir::temp().filePath("ds_test_stereo_memlock.wav");
+    QVERIFY2(write_wav(stereo_path, samples, 2) == true, "write stereo wav");
+
+    // Memlock limit lower than the size of the file: samples are still used from the file (not copied).
+    struct rlimit limit;
+    QVERIFY2(getrlimit(RLIMIT_MEMLOCK, &limit) == 0, "get memlock limit");
+    struct rlimit low_limit = limit;
+    low_limit.rlim_cur = qMin(limit.rlim_cur, (rlim_t)(64 * 1024));
+    QVERIFY2(setrlimit(RLIMIT_MEMLOCK, &low_limit) == 0, "set low memlock limit");
+
+    QSharedPointer<Audio_track> at(new Audio_track(15, 44100));
+    Audio_file_decoding_process decoder(at, true);
+    bool is_loaded = decoder.run(stereo_path, "", "");
+    setrlimit(RLIMIT_MEMLOCK, &limit);
+    QVERIFY2(is_loaded == true,                                             "load stereo wav");
+    QVERIFY2(at->is_mapped() == true,                                       "stereo wav is mapped");
+    QVERIFY2(at->get_end_of_samples() == (unsigned int)samples.size(),      "number of stereo samples");
+    QVERIFY2(memcmp(at->get_samples(), samples.constData(), samples.size() * 2) == 0, "stereo samples");
+
+    // Releasing the track stops loading pages in background.
+    decoder.clear();
+    at->reset();
+    QVERIFY2(at->is_mapped() == false, "mapping released");
+
+    QFile::remove(stereo_path);
+}
+
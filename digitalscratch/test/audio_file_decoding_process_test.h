@@ -15,4 +15,9 @@ private Q_SLOTS:
 
     void testCaseCreate();
     void testCaseRun();
+    void testCaseRunSegmented();
+    void testCaseSegmentBoundaries();
+    void testCaseResample();
+    void testCaseRunUncompressed();
+    void testCaseRunUncompressedMemlockLimit();
 };
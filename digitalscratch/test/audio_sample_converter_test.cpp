@@ -0,0 +1,262 @@
+#include <QtTest>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include "audio_sample_converter_test.h"
+#include "tracks/audio_sample_converter.h"
+
+#define NB_FRAMES 37 // Not a multiple of the SIMD width, so the scalar tail is also used.
+
+static int16_t expected_s16(const float &value)
+{
+    float sample = nearbyintf(value * 32768.0f);
+    if (sample > 32767.0f)
+    {
+        return 32767;
+    }
+    else if (sample < -32768.0f)
+    {
+        return -32768;
+    }
+
+    return (int16_t)sample;
+}
+
+Audio_sample_converter_Test::Audio_sample_converter_Test()
+{
+}
+
+void Audio_sample_converter_Test::initTestCase()
+{
+}
+
+void Audio_sample_converter_Test::cleanupTestCase()
+{
+}
+
+void Audio_sample_converter_Test::testCaseS16Planar()
+{
+    // Prepare 2 channels.
+    int16_t left[NB_FRAMES];
+    int16_t right[NB_FRAMES];
+    int16_t output[NB_FRAMES * 2];
+    for (int i = 0; i < NB_FRAMES; i++)
+    {
+        left[i]  = i * 100 - 1000;
+        right[i] = -i * 7;
+    }
+    const int16_t *planes[2] = { left, right };
+
+    // Interleave them.
+    Audio_sample_converter converter;
+    converter.s16_planar_to_s16(planes, 2, NB_FRAMES, output);
+    bool is_ok = true;
+    for (int i = 0; i < NB_FRAMES; i++)
+    {
+        is_ok &= (output[i * 2] == left[i]) && (output[i * 2 + 1] == right[i]);
+    }
+    QVERIFY2(is_ok == true, "s16 planar interleaving");
+}
+
+void Audio_sample_converter_Test::testCaseFloat()
+{
+    // Prepare 2 channels (with some clipped samples).
+    float   left[NB_FRAMES];
+    float   right[NB_FRAMES];
+    float   interleaved[NB_FRAMES * 2];
+    int16_t output[NB_FRAMES * 2];
+    for (int i = 0; i < NB_FRAMES; i++)
+    {
+        left[i]  = sinf(i * 0.3f) * 1.2f;
+        right[i] = cosf(i * 0.2f) * 0.5f;
+        interleaved[i * 2]     = left[i];
+        interleaved[i * 2 + 1] = right[i];
+    }
+    const float *planes[2] = { left, right };
+    Audio_sample_converter converter;
+    converter.set_dither(false);
+
+    // Planar float.
+    converter.flt_planar_to_s16(planes, 2, NB_FRAMES, output);
+    bool is_ok = true;
+    for (int i = 0; i < NB_FRAMES; i++)
+    {
+        is_ok &= (output[i * 2] == expected_s16(left[i])) && (output[i * 2 + 1] == expected_s16(right[i]));
+    }
+    QVERIFY2(is_ok == true, "float planar conversion");
+
+    // Interleaved float.
+    converter.flt_to_s16(interleaved, 2, NB_FRAMES, output);
+    is_ok = true;
+    for (int i = 0; i < NB_FRAMES; i++)
+    {
+        is_ok &= (output[i * 2] == expected_s16(left[i])) && (output[i * 2 + 1] == expected_s16(right[i]));
+    }
+    QVERIFY2(is_ok == true, "float interleaved conversion");
+}
+
+void Audio_sample_converter_Test::testCaseS32AndDouble()
+{
+    int32_t left_s32[NB_FRAMES];
+    int32_t right_s32[NB_FRAMES];
+    double  left_dbl[NB_FRAMES];
+    double  right_dbl[NB_FRAMES];
+    int16_t output[NB_FRAMES * 2];
+    for (int i = 0; i < NB_FRAMES; i++)
+    {
+        left_dbl[i]  = sin(i * 0.3) * 0.9;
+        right_dbl[i] = cos(i * 0.2) * 0.5;
+        left_s32[i]  = (int32_t)(left_dbl[i]  * 2147483647.0);
+        right_s32[i] = (int32_t)(right_dbl[i] * 2147483647.0);
+    }
+    Audio_sample_converter converter;
+    converter.set_dither(false);
+
+    // Planar 32 bits integer (only lowest bit may differ because of rounding).
+    const int32_t *planes_s32[2] = { left_s32, right_s32 };
+    converter.s32_planar_to_s16(planes_s32, 2, NB_FRAMES, output);
+    bool is_ok = true;
+    for (int i = 0; i < NB_FRAMES; i++)
+    {
+        is_ok &= (abs(output[i * 2]     - (left_s32[i]  >> 16)) <= 1) &&
+                 (abs(output[i * 2 + 1] - (right_s32[i] >> 16)) <= 1);
+    }
+    QVERIFY2(is_ok == true, "s32 planar conversion");
+
+    // Planar double.
+    const double *planes_dbl[2] = { left_dbl, right_dbl };
+    converter.dbl_planar_to_s16(planes_dbl, 2, NB_FRAMES, output);
+    is_ok = true;
+    for (int i = 0; i < NB_FRAMES; i++)
+    {
+        is_ok &= (output[i * 2]     == expected_s16((float)left_dbl[i])) &&
+                 (output[i * 2 + 1] == expected_s16((float)right_dbl[i]));
+    }
+    QVERIFY2(is_ok == true, "double planar conversion");
+}
+
+void Audio_sample_converter_Test::testCaseSwappedAndS24()
+{
+    int16_t big_endian[NB_FRAMES * 2];
+    uint8_t packed_s24[NB_FRAMES * 2 * 3];
+    int16_t expected[NB_FRAMES * 2];
+    int16_t output[NB_FRAMES * 2];
+    for (int i = 0; i < NB_FRAMES * 2; i++)
+    {
+        expected[i] = (int16_t)(i * 1733 - 30000);
+        uint16_t sample = (uint16_t)expected[i];
+        big_endian[i] = (int16_t)((sample << 8) | (sample >> 8));
+        packed_s24[i * 3]     = 0x7F;
+        packed_s24[i * 3 + 1] = sample & 0xFF;
+        packed_s24[i * 3 + 2] = sample >> 8;
+    }
+    Audio_sample_converter converter;
+    converter.set_dither(false);
+
+    // Big endian 16 bits (AIFF).
+    converter.s16_swapped_to_s16(big_endian, 2, NB_FRAMES, output);
+    QVERIFY2(memcmp(output, expected, sizeof(output)) == 0, "swapped 16 bits conversion");
+
+    // Packed 24 bits (only lowest bit may differ because of rounding).
+    converter.s24_packed_to_s16(packed_s24, 2, NB_FRAMES, output);
+    bool is_ok = true;
+    for (int i = 0; i < NB_FRAMES * 2; i++)
+    {
+        is_ok &= (abs(output[i] - expected[i]) <= 1);
+    }
+    QVERIFY2(is_ok == true, "packed 24 bits conversion");
+}
+
+void Audio_sample_converter_Test::testCaseMono()
+{
+    // Mono is duplicated on both channels.
+    float   mono[NB_FRAMES];
+    int16_t output[NB_FRAMES * 2];
+    for (int i = 0; i < NB_FRAMES; i++)
+    {
+        mono[i] = sinf(i * 0.1f) * 0.7f;
+    }
+    const float *planes[1] = { mono };
+    Audio_sample_converter converter;
+    converter.set_dither(false);
+
+    converter.flt_planar_to_s16(planes, 1, NB_FRAMES, output);
+    bool is_ok = true;
+    for (int i = 0; i < NB_FRAMES; i++)
+    {
+        is_ok &= (output[i * 2] == expected_s16(mono[i])) && (output[i * 2 + 1] == expected_s16(mono[i]));
+    }
+    QVERIFY2(is_ok == true, "planar mono to stereo");
+
+    converter.flt_to_s16(mono, 1, NB_FRAMES, output);
+    is_ok = true;
+    for (int i = 0; i < NB_FRAMES; i++)
+    {
+        is_ok &= (output[i * 2] == expected_s16(mono[i])) && (output[i * 2 + 1] == expected_s16(mono[i]));
+    }
+    QVERIFY2(is_ok == true, "interleaved mono to stereo");
+}
+
+void Audio_sample_converter_Test::testCaseDither()
+{
+    // A constant signal of a quarter of LSB must be dithered around its value.
+    const int nb_frames = 4096;
+    float    *mono      = new float[nb_frames];
+    int16_t  *output    = new int16_t[nb_frames * 2];
+    for (int i = 0; i < nb_frames; i++)
+    {
+        mono[i] = 0.25f / 32768.0f;
+    }
+    const float *planes[1] = { mono };
+    Audio_sample_converter converter;
+    converter.flt_planar_to_s16(planes, 1, nb_frames, output);
+
+    double sum     = 0.0;
+    int    max_abs = 0;
+    for (int i = 0; i < nb_frames * 2; i++)
+    {
+        sum    += output[i];
+        max_abs = qMax(max_abs, abs(output[i]));
+    }
+    QVERIFY2(max_abs <= 1,                                   "dither amplitude");
+    QVERIFY2(qAbs(sum / (nb_frames * 2) - 0.25) < 0.05,      "dither keeps the mean value");
+
+    delete [] mono;
+    delete [] output;
+}
+
+void Audio_sample_converter_Test::testCaseNanAndInfinite()
+{
+    // Same result on SIMD lanes and scalar tail: NaN is silent, infinites are saturated.
+    float   left[NB_FRAMES];
+    float   right[NB_FRAMES];
+    float   interleaved[NB_FRAMES * 2];
+    int16_t output[NB_FRAMES * 2];
+    int16_t expected[3] = { 0, 32767, -32768 };
+    for (int i = 0; i < NB_FRAMES; i++)
+    {
+        left[i]  = (i % 3 == 0) ? std::numeric_limits<float>::quiet_NaN() :
+                   (i % 3 == 1) ? std::numeric_limits<float>::infinity()  : -std::numeric_limits<float>::infinity();
+        right[i] = left[i];
+        interleaved[i * 2]     = left[i];
+        interleaved[i * 2 + 1] = right[i];
+    }
+    const float *planes[2] = { left, right };
+
+    Audio_sample_converter converter;
+    converter.flt_planar_to_s16(planes, 2, NB_FRAMES, output);
+    bool is_ok = true;
+    for (int i = 0; i < NB_FRAMES; i++)
+    {
+        is_ok &= (output[i * 2] == expected[i % 3]) && (output[i * 2 + 1] == expected[i % 3]);
+    }
+    QVERIFY2(is_ok == true, "float planar NaN and infinites");
+
+    converter.flt_to_s16(interleaved, 2, NB_FRAMES, output);
+    is_ok = true;
+    for (int i = 0; i < NB_FRAMES; i++)
+    {
+        is_ok &= (output[i * 2] == expected[i % 3]) && (output[i * 2 + 1] == expected[i % 3]);
+    }
+    QVERIFY2(is_ok == true, "float interleaved NaN and infinites");
+}
@@ -0,0 +1,23 @@
+#include <QObject>
+#include <QtTest>
+#include "app/application_const.h"
+
+class Audio_sample_converter_Test : public QObject
+{
+    Q_OBJECT
+
+public:
+    Audio_sample_converter_Test();
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testCaseS16Planar();
+    void testCaseFloat();
+    void testCaseS32AndDouble();
+    void testCaseSwappedAndS24();
+    void testCaseMono();
+    void testCaseDither();
+    void testCaseNanAndInfinite();
+};
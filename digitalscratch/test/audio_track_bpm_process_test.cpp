@@ -0,0 +1,109 @@
+#include <QtTest>
+#include <QSharedPointer>
+#include <cmath>
+#include "audio_track_bpm_process_test.h"
+#include "tracks/audio_track.h"
+#include "tracks/audio_track_bpm_process.h"
+
+#define NB_SECONDS 30
+
+// Kick (decaying low sine) on each beat and a shorter hi-hat (decaying noise) between beats.
+static void fill_beats(const QSharedPointer<Audio_track> &at, const float &bpm, const unsigned int &first_beat_msec)
+{
+    short signed int *samples   = at->get_samples();
+    unsigned int      nb_frames = NB_SECONDS * at->get_sample_rate();
+    float             period    = 60.0f / bpm;
+    memset(samples, 0, nb_frames * 2 * sizeof(short signed int));
+    qsrand(1);
+    for (float beat = first_beat_msec / 1000.0f; beat < NB_SECONDS - 1; beat += period)
+    {
+        unsigned int kick   = (unsigned int)(beat * at->get_sample_rate());
+        unsigned int hi_hat = (unsigned int)((beat + period / 2.0f) * at->get_sample_rate());
+        for (unsigned int i = 0; i < 2000; i++)
+        {
+            short signed int value = (short signed int)(12000.0f * expf(-(float)i / 300.0f) * sinf(2.0f * (float)M_PI * 60.0f * i / at->get_sample_rate()));
+            samples[(kick + i) * 2]     = value;
+            samples[(kick + i) * 2 + 1] = value;
+        }
+        for (unsigned int i = 0; (i < 500) && (hi_hat + i < nb_frames); i++)
+        {
+            short signed int value = (short signed int)(15.0f * ((qrand() % 200) - 100) * expf(-(float)i / 80.0f));
+            samples[(hi_hat + i) * 2]     += value;
+            samples[(hi_hat + i) * 2 + 1] += value;
+        }
+    }
+    at->set_end_of_samples(nb_frames * 2);
+}
+
+Audio_track_bpm_process_Test::Audio_track_bpm_process_Test()
+{
+}
+
+void Audio_track_bpm_process_Test::initTestCase()
+{
+}
+
+void Audio_track_bpm_process_Test::cleanupTestCase()
+{
+}
+
+void Audio_track_bpm_process_Test::testCaseRun()
+{
+    QSharedPointer<Audio_track> at(new Audio_track(1, 44100));
+    Audio_track_bpm_process bpm_proc(at);
+
+    // Tempo inside the searched range, beat grid not starting at the beginning of the track.
+    fill_beats(at, 128.0, 250);
+    QVERIFY2(bpm_proc.run() == true,                   "run at 128 bpm");
+    QVERIFY2(qAbs(at->get_bpm() - 128.0f) < 0.1f,      "bpm 128");
+    QVERIFY2(qAbs((int)at->get_first_beat() - 250) <= 10, "first beat at 250 ms");
+
+    // Slow tempo, with hi-hats between beats (must not be detected as the double).
+    fill_beats(at, 95.0, 700);
+    QVERIFY2(bpm_proc.run() == true,                   "run at 95 bpm");
+    QVERIFY2(qAbs(at->get_bpm() - 95.0f) < 0.1f,       "bpm 95");
+    QVERIFY2(qAbs((int)at->get_first_beat() - (700 - 632)) <= 10, "first beat is the first one of the grid");
+
+    // Tempo with decimals.
+    fill_beats(at, 122.3f, 50);
+    QVERIFY2(bpm_proc.run() == true,                   "run at 122.3 bpm");
+    QVERIFY2(qAbs(at->get_bpm() - 122.3f) < 0.1f,      "bpm 122.3");
+}
+
+void Audio_track_bpm_process_Test::testCaseRunSilence()
+{
+    QSharedPointer<Audio_track> at(new Audio_track(1, 44100));
+    Audio_track_bpm_process bpm_proc(at);
+
+    // No decoded samples.
+    QVERIFY2(bpm_proc.run() == false, "empty track");
+
+    // Silence.
+    at->set_end_of_samples(NB_SECONDS * 44100 * 2);
+    QVERIFY2(bpm_proc.run() == false, "silent track");
+    QVERIFY2(at->get_bpm()  == 0.0f,  "no bpm");
+}
+
+void Audio_track_bpm_process_Test::testCaseStream()
+{
+    QSharedPointer<Audio_track> at(new Audio_track(1, 44100));
+    QSharedPointer<Audio_track> result_at(new Audio_track(44100));
+    Audio_track_bpm_process     bpm_proc;
+
+    // Track given by chunks (size not a multiple of the onset hop) gives the same result as the whole track.
+    fill_beats(at, 128.0, 250);
+    bpm_proc.start(at->get_sample_rate());
+    unsigned int nb_frames = at->get_end_of_samples() / 2;
+    for (unsigned int i = 0; i < nb_frames; i += 1000)
+    {
+        bpm_proc.process(&at->get_samples()[i * 2], qMin(1000u, nb_frames - i));
+    }
+    QVERIFY2(bpm_proc.finish(result_at) == true,           "finish stream");
+    QVERIFY2(qAbs(result_at->get_bpm() - 128.0f) < 0.1f,   "stream bpm 128");
+    QVERIFY2(qAbs((int)result_at->get_first_beat() - 250) <= 10, "stream first beat at 250 ms");
+
+    Audio_track_bpm_process track_proc(at);
+    QVERIFY2(track_proc.run() == true,                     "run on track");
+    QVERIFY2(at->get_bpm() == result_at->get_bpm(),        "same bpm");
+    QVERIFY2(at->get_first_beat() == result_at->get_first_beat(), "same first beat");
+}
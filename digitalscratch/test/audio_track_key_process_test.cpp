@@ -0,0 +1,74 @@
+#include <QtTest>
+#include <QSharedPointer>
+#include <QElapsedTimer>
+#include <keyfinder_api.h>
+#include "audio_track_key_process_test.h"
+#include "tracks/audio_track.h"
+#include "tracks/audio_track_key_process.h"
+#include "tracks/audio_file_decoding_process.h"
+#include "utils.h"
+
+#define DATA_DIR     "./test/data/"
+#define DATA_TRACK_1 "track_1.mp3"
+#define DATA_TRACK_2 "track_2.mp3"
+#define DATA_TRACK_3 "track_éèà@ù&_3.mp3"
+#define DATA_TRACK_4 "track_éèà@ù&_4.mp3"
+
+#define TEST_NB_WINDOWS  4
+#define TEST_WINDOW_MSEC 3000
+
+Audio_track_key_process_Test::Audio_track_key_process_Test()
+{
+}
+
+void Audio_track_key_process_Test::initTestCase()
+{
+}
+
+void Audio_track_key_process_Test::cleanupTestCase()
+{
+}
+
+void Audio_track_key_process_Test::testCaseRegression()
+{
+    QList<QString> filenames = QList<QString>() << DATA_TRACK_1 << DATA_TRACK_2 << DATA_TRACK_3 << DATA_TRACK_4;
+    QList<QString> expected  = QList<QString>() << "1A"         << "6A"         << "9A"         << "";
+
+    QSharedPointer<Audio_track> at(new Audio_track(10, 44100));
+    Audio_file_decoding_process dec(at, false);
+    Audio_track_key_process     key_proc(at);
+    QElapsedTimer               timer;
+    qint64                      reference_msec = 0;
+    qint64                      windows_msec   = 0;
+    for (int i = 0; i < filenames.size(); i++)
+    {
+        QVERIFY2(dec.run(QString(DATA_DIR) + filenames[i], "", "") == true, qPrintable("decode " + filenames[i]));
+
+        // Reference: whole stereo track at the decoded rate.
+        timer.start();
+        QString reference = Utils::convert_music_key_to_clock_number(kfinder_get_key(at->get_samples(),
+                                                                                     at->get_end_of_samples(),
+                                                                                     at->get_sample_rate(),
+                                                                                     2));
+        reference_msec += timer.elapsed();
+        if (expected[i] != "")
+        {
+            QVERIFY2(reference == expected[i], qPrintable(filenames[i] + " reference key: " + reference));
+        }
+
+        // Downsampled mono signal of the whole track.
+        key_proc.set_windows(0, 0);
+        QVERIFY2(key_proc.run() == true,            qPrintable("downsampled key of " + filenames[i]));
+        QVERIFY2(at->get_music_key() == reference, qPrintable(filenames[i] + " downsampled key: " + at->get_music_key()));
+
+        // Downsampled mono signal of windows (shorter than test tracks, default windows would select the whole track).
+        unsigned int track_msec = (unsigned int)((quint64)at->get_end_of_samples() / 2 * 1000 / at->get_sample_rate());
+        QVERIFY2(track_msec > TEST_NB_WINDOWS * TEST_WINDOW_MSEC, qPrintable(filenames[i] + " longer than the windows"));
+        key_proc.set_windows(TEST_NB_WINDOWS, TEST_WINDOW_MSEC);
+        timer.start();
+        QVERIFY2(key_proc.run() == true,            qPrintable("windowed key of " + filenames[i]));
+        windows_msec += timer.elapsed();
+        QVERIFY2(at->get_music_key() == reference, qPrintable(filenames[i] + " windowed key: " + at->get_music_key()));
+    }
+    qInfo() << "key of test tracks:" << reference_msec << "msec for full tracks," << windows_msec << "msec with windows";
+}
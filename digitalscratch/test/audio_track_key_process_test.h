@@ -0,0 +1,17 @@
+#include <QObject>
+#include <QtTest>
+#include "app/application_const.h"
+
+class Audio_track_key_process_Test : public QObject
+{
+    Q_OBJECT
+
+public:
+    Audio_track_key_process_Test();
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testCaseRegression();
+};
@@ -0,0 +1,89 @@
+#include <QtTest>
+#include <QSharedPointer>
+#include <QVector>
+#include <cmath>
+#include "audio_track_loudness_process_test.h"
+#include "tracks/audio_track.h"
+#include "tracks/audio_track_loudness_process.h"
+
+#define NB_SECONDS 5
+
+// Stereo 1 kHz sine, level in dBFS (0 = full scale).
+static void fill_sine(QVector<short signed int> &samples, const unsigned int &sample_rate, const float &level)
+{
+    unsigned int nb_frames = NB_SECONDS * sample_rate;
+    float        amplitude = 32767.0f * powf(10.0f, level / 20.0f);
+    samples.resize(nb_frames * 2);
+    for (unsigned int i = 0; i < nb_frames; i++)
+    {
+        samples[i * 2]     = (short signed int)(amplitude * sinf(2.0f * (float)M_PI * 1000.0f * i / sample_rate));
+        samples[i * 2 + 1] = samples[i * 2];
+    }
+}
+
+static bool analyze(Audio_track_loudness_process           &loudness_proc,
+                    const QVector<short signed int>        &samples,
+                    const unsigned int                     &sample_rate,
+                    const QSharedPointer<Audio_track>      &at)
+{
+    // Give samples by chunks like the decoder does.
+    loudness_proc.start(sample_rate);
+    unsigned int nb_frames = samples.size() / 2;
+    for (unsigned int i = 0; i < nb_frames; i += 777)
+    {
+        loudness_proc.process(&samples.constData()[i * 2], qMin(777u, nb_frames - i));
+    }
+
+    return loudness_proc.finish(at);
+}
+
+Audio_track_loudness_process_Test::Audio_track_loudness_process_Test()
+{
+}
+
+void Audio_track_loudness_process_Test::initTestCase()
+{
+}
+
+void Audio_track_loudness_process_Test::cleanupTestCase()
+{
+}
+
+void Audio_track_loudness_process_Test::testCaseSine()
+{
+    QSharedPointer<Audio_track>  at(new Audio_track(48000));
+    Audio_track_loudness_process loudness_proc;
+    QVector<short signed int>    samples;
+
+    // BS.1770 calibration: a stereo 1 kHz sine at -20 dBFS is -20 LUFS.
+    fill_sine(samples, 48000, -20.0f);
+    QVERIFY2(analyze(loudness_proc, samples, 48000, at) == true, "analyze -20 dBFS");
+    QVERIFY2(qAbs(at->get_loudness() + 20.0f) < 0.1f,             "-20 LUFS");
+
+    // Same at another sample rate.
+    fill_sine(samples, 44100, -6.0f);
+    QVERIFY2(analyze(loudness_proc, samples, 44100, at) == true, "analyze -6 dBFS");
+    QVERIFY2(qAbs(at->get_loudness() + 6.0f) < 0.1f,              "-6 LUFS");
+}
+
+void Audio_track_loudness_process_Test::testCaseGating()
+{
+    QSharedPointer<Audio_track>  at(new Audio_track(44100));
+    Audio_track_loudness_process loudness_proc;
+    QVector<short signed int>    samples;
+
+    // Silence has no loudness.
+    samples.fill(0, NB_SECONDS * 44100 * 2);
+    QVERIFY2(analyze(loudness_proc, samples, 44100, at) == false, "silence");
+    QVERIFY2(at->get_loudness() == 0.0f,                          "no loudness");
+
+    // Silent parts are not taken into account (only blocks at the transition lower the result a bit).
+    fill_sine(samples, 44100, -20.0f);
+    samples.resize(samples.size() * 2);
+    for (int i = samples.size() / 2; i < samples.size(); i++)
+    {
+        samples[i] = 0;
+    }
+    QVERIFY2(analyze(loudness_proc, samples, 44100, at) == true, "analyze with silence");
+    QVERIFY2(qAbs(at->get_loudness() + 20.0f) < 0.2f,             "silence is gated");
+}
@@ -0,0 +1,18 @@
+#include <QObject>
+#include <QtTest>
+#include "app/application_const.h"
+
+class Audio_track_loudness_process_Test : public QObject
+{
+    Q_OBJECT
+
+public:
+    Audio_track_loudness_process_Test();
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testCaseSine();
+    void testCaseGating();
+};
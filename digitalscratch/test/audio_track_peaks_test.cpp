@@ -0,0 +1,120 @@
+#include <QtTest>
+#include <cmath>
+#include "audio_track_peaks_test.h"
+#include "tracks/audio_track_peaks.h"
+
+#define NB_FRAMES 10000 // Not a multiple of bin sizes, so the last bins are incomplete.
+
+static void fill_samples(short signed int *samples)
+{
+    for (int i = 0; i < NB_FRAMES; i++)
+    {
+        samples[i * 2]     = (short signed int)(sinf(i * 0.01f) * 20000.0f);
+        samples[i * 2 + 1] = (short signed int)(cosf(i * 0.03f) * 10000.0f);
+    }
+}
+
+static Audio_peak expected_peak(const short signed int *samples, const unsigned int &first_frame, const unsigned int &last_frame)
+{
+    Audio_peak peak = { SHRT_MAX, SHRT_MIN, 0.0f };
+    double     sum  = 0.0;
+    for (unsigned int i = first_frame * 2; i < last_frame * 2; i++)
+    {
+        peak.min = qMin(peak.min, samples[i]);
+        peak.max = qMax(peak.max, samples[i]);
+        sum     += (double)samples[i] * (double)samples[i];
+    }
+    peak.rms = sqrt(sum / ((last_frame - first_frame) * 2));
+
+    return peak;
+}
+
+Audio_track_peaks_Test::Audio_track_peaks_Test()
+{
+}
+
+void Audio_track_peaks_Test::initTestCase()
+{
+}
+
+void Audio_track_peaks_Test::cleanupTestCase()
+{
+}
+
+void Audio_track_peaks_Test::testCaseComputeBins()
+{
+    short signed int *samples = new short signed int[NB_FRAMES * 2];
+    fill_samples(samples);
+    Audio_track_peaks peaks(NB_FRAMES * 2);
+
+    // Summarize 2 regions decoded separately, bins across their boundary are done at the end.
+    QVERIFY2(peaks.compute_bins(samples, 0, 5000)       == 4992,  "first region stops at the last complete bin");
+    QVERIFY2(peaks.compute_bins(samples, 5000, NB_FRAMES) == 9984, "second region starts at the next bin");
+    QVERIFY2(peaks.compute_bins(samples, 9984, 10000)   == 9984,  "no complete bin");
+    peaks.finish(samples, NB_FRAMES);
+
+    QVERIFY2(peaks.get_nb_bins(0) == (NB_FRAMES + 63) / 64, "number of bins");
+    bool is_ok = true;
+    for (unsigned int bin = 0; bin < peaks.get_nb_bins(0); bin++)
+    {
+        Audio_peak peak     = peaks.get_bins(0)[bin];
+        Audio_peak expected = expected_peak(samples, bin * 64, qMin((bin + 1) * 64, (unsigned int)NB_FRAMES));
+        is_ok &= (peak.min == expected.min) && (peak.max == expected.max) && (fabs(peak.rms - expected.rms) < 1.0f);
+    }
+    QVERIFY2(is_ok == true, "first level bins");
+
+    delete [] samples;
+}
+
+void Audio_track_peaks_Test::testCaseLevels()
+{
+    short signed int *samples = new short signed int[NB_FRAMES * 2];
+    fill_samples(samples);
+    Audio_track_peaks peaks(NB_FRAMES * 2);
+    peaks.finish(samples, NB_FRAMES);
+
+    // Levels of 64, 256, 1024 and 4096 frames per bin.
+    QVERIFY2(peaks.get_bin_size(3) == 4096,             "bin size of last level");
+    QVERIFY2(peaks.get_nb_bins(3)  == 3,                "number of bins of last level");
+    QVERIFY2(peaks.get_level(10.0)   == 0,              "level for a zoomed view");
+    QVERIFY2(peaks.get_level(300.0)  == 1,              "level for 300 frames per pixel");
+    QVERIFY2(peaks.get_level(5000.0) == 3,              "level for an overview");
+
+    bool is_ok = true;
+    for (unsigned short int level = 1; level < 4; level++)
+    {
+        unsigned int bin_size = peaks.get_bin_size(level);
+        for (unsigned int bin = 0; bin < peaks.get_nb_bins(level); bin++)
+        {
+            Audio_peak peak     = peaks.get_bins(level)[bin];
+            Audio_peak expected = expected_peak(samples, bin * bin_size, qMin((bin + 1) * bin_size, (unsigned int)NB_FRAMES));
+            is_ok &= (peak.min == expected.min) && (peak.max == expected.max);
+        }
+    }
+    QVERIFY2(is_ok == true, "min and max of all levels");
+
+    delete [] samples;
+}
+
+void Audio_track_peaks_Test::testCaseBands()
+{
+    Audio_track_peaks peaks(NB_FRAMES * 2);
+    QVERIFY2(peaks.has_bands() == false, "no bands before analysis");
+
+    // 3 band bins (low, mid, high).
+    const char energies[9] = { 10, 20, 30,
+                               40,  5, 60,
+                               70, 80,  1 };
+    peaks.set_bands(QByteArray(energies, 9));
+    QVERIFY2(peaks.has_bands() == true, "bands are set");
+
+    Audio_bands bands = peaks.get_bands(0, 100);
+    QVERIFY2((bands.low == 10) && (bands.mid == 20) && (bands.high == 30), "range inside the first bin");
+    bands = peaks.get_bands(1024, 3072);
+    QVERIFY2((bands.low == 70) && (bands.mid == 80) && (bands.high == 60), "highest energies of 2 bins");
+    bands = peaks.get_bands(5000, 6000);
+    QVERIFY2((bands.low == 0) && (bands.mid == 0) && (bands.high == 0), "range after the last bin");
+
+    peaks.reset();
+    QVERIFY2(peaks.has_bands() == false, "bands are cleared by reset");
+}
@@ -0,0 +1,78 @@
+#include <QString>
+#include <QtTest>
+#include "audio_track_prefetch_pool_test.h"
+#include "tracks/audio_track.h"
+#include "tracks/audio_track_prefetch_pool.h"
+
+#define DATA_DIR       "./test/data/"
+#define DATA_TRACK_1   "track_1.mp3"
+#define DATA_TRACK_2   "track_2.mp3"
+#define DECODING_MSEC  20000 // Max time to decode a test track.
+
+Audio_track_prefetch_pool_Test::Audio_track_prefetch_pool_Test()
+{
+}
+
+void Audio_track_prefetch_pool_Test::initTestCase()
+{
+}
+
+void Audio_track_prefetch_pool_Test::cleanupTestCase()
+{
+}
+
+void Audio_track_prefetch_pool_Test::testCaseTakeWhileDecoding()
+{
+    QString path = QString(DATA_DIR) + QString(DATA_TRACK_1);
+    QSharedPointer<Audio_track> deck_at(new Audio_track(MAX_MINUTES_TRACK, 44100));
+    Audio_track_prefetch_pool pool(1, 44100);
+
+    // Unknown track.
+    QVERIFY2(pool.take(path, deck_at) == false, "track not prefetched");
+
+    // Decoding starts once candidates are stable. Taking the track does not wait for the end of decoding:
+    // a track still being decoded is canceled (the deck decodes it itself).
+    pool.set_candidates(QStringList() << path);
+    QTest::qWait(PREFETCH_START_DELAY_MSEC + 50);
+    QElapsedTimer timer;
+    timer.start();
+    bool is_taken = pool.take(path, deck_at);
+    QVERIFY2(timer.elapsed() < PREFETCH_START_DELAY_MSEC, "take does not wait for decoding");
+    if (is_taken == true)
+    {
+        QVERIFY2(deck_at->get_filename() == DATA_TRACK_1, "deck track");
+        QVERIFY2(deck_at->get_end_of_samples() > 0, "deck samples");
+    }
+
+    // The slot is free again and the taken (or canceled) track is not decoded again.
+    QTest::qWait(PREFETCH_START_DELAY_MSEC * 2);
+    QVERIFY2(pool.is_prefetched(path) == false, "track taken");
+    QVERIFY2(pool.take(path, deck_at) == false, "track taken only once");
+
+    // Once decoded, the track is swapped.
+    pool.set_candidates(QStringList() << path);
+    QTRY_VERIFY_WITH_TIMEOUT(pool.is_prefetched(path) == true, DECODING_MSEC);
+    QVERIFY2(pool.take(path, deck_at) == true, "take prefetched track");
+    QVERIFY2(deck_at->get_filename() == DATA_TRACK_1, "deck track");
+    QVERIFY2(deck_at->get_end_of_samples() > 0, "deck samples");
+}
+
+void Audio_track_prefetch_pool_Test::testCaseEviction()
+{
+    QString path_1 = QString(DATA_DIR) + QString(DATA_TRACK_1);
+    QString path_2 = QString(DATA_DIR) + QString(DATA_TRACK_2);
+    QSharedPointer<Audio_track> deck_at(new Audio_track(MAX_MINUTES_TRACK, 44100));
+    Audio_track_prefetch_pool pool(1, 44100);
+
+    // Prefetch a track.
+    pool.set_candidates(QStringList() << path_1);
+    QTRY_VERIFY_WITH_TIMEOUT(pool.is_prefetched(path_1) == true, DECODING_MSEC);
+
+    // It is not a candidate anymore, its slot is used for the new one.
+    pool.set_candidates(QStringList() << path_2);
+    QTRY_VERIFY_WITH_TIMEOUT(pool.is_prefetched(path_2) == true, DECODING_MSEC);
+    QVERIFY2(pool.is_prefetched(path_1) == false, "evicted track");
+    QVERIFY2(pool.take(path_1, deck_at) == false, "take evicted track");
+    QVERIFY2(pool.take(path_2, deck_at) == true,  "take prefetched track");
+    QVERIFY2(deck_at->get_filename() == DATA_TRACK_2, "deck track");
+}
@@ -0,0 +1,18 @@
+#include <QObject>
+#include <QtTest>
+#include "app/application_const.h"
+
+class Audio_track_prefetch_pool_Test : public QObject
+{
+    Q_OBJECT
+
+public:
+    Audio_track_prefetch_pool_Test();
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testCaseTakeWhileDecoding();
+    void testCaseEviction();
+};
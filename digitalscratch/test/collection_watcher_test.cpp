@@ -0,0 +1,74 @@
+#include <QtTest>
+#include <QDir>
+#include <QFile>
+#include <QSignalSpy>
+
+#include "collection_watcher_test.h"
+
+#define DATA_DIR     "./test/data/"
+#define DATA_TRACK_1 "track_1.mp3"
+#define WATCH_DIR    "./test/data/watcher/"
+#define WAIT_MSEC    (WATCHER_FLUSH_DELAY_MSEC * 5)
+
+Collection_watcher_Test::Collection_watcher_Test()
+{
+}
+
+void Collection_watcher_Test::initTestCase()
+{
+    QDir().mkpath(QString(WATCH_DIR) + "sub");
+}
+
+void Collection_watcher_Test::cleanupTestCase()
+{
+    QDir(WATCH_DIR).removeRecursively();
+}
+
+void Collection_watcher_Test::testCaseWatch()
+{
+    // Watch the directory tree (watches are added in background).
+    Collection_watcher watcher;
+    QString root = QDir(WATCH_DIR).absolutePath();
+    QVERIFY2(watcher.set_root_path(WATCH_DIR) == true, "watch directory");
+    QTest::qWait(WATCHER_FLUSH_DELAY_MSEC);
+    QSignalSpy spy(&watcher, SIGNAL(files_changed(QStringList, QStringList)));
+
+    // Copy an audio file in a sub directory and a file which is not an audio file.
+    QFile::copy(QString(DATA_DIR) + DATA_TRACK_1, QString(WATCH_DIR) + "sub/" + DATA_TRACK_1);
+    QFile::copy(QString(DATA_DIR) + DATA_TRACK_1, QString(WATCH_DIR) + "sub/not_audio.txt");
+    QVERIFY2(spy.wait(WAIT_MSEC) == true, "changes reported");
+    QStringList changed = spy.at(0).at(0).toStringList();
+    QStringList removed = spy.at(0).at(1).toStringList();
+    QVERIFY2(changed == (QStringList() << root + "/sub/" + DATA_TRACK_1), "new audio file");
+    QVERIFY2(removed.isEmpty() == true, "nothing removed");
+
+    // Rename it: the old path is removed and the new one is changed.
+    spy.clear();
+    QFile::rename(QString(WATCH_DIR) + "sub/" + DATA_TRACK_1, QString(WATCH_DIR) + "sub/renamed.mp3");
+    QVERIFY2(spy.wait(WAIT_MSEC) == true, "rename reported");
+    QVERIFY2(spy.at(0).at(0).toStringList() == (QStringList() << root + "/sub/renamed.mp3"),   "renamed file changed");
+    QVERIFY2(spy.at(0).at(1).toStringList() == (QStringList() << root + "/sub/" + DATA_TRACK_1), "old name removed");
+
+    // Move a directory with an audio file in the tree, its files are reported.
+    spy.clear();
+    QDir().mkpath(QString(DATA_DIR) + "watcher_outside");
+    QFile::copy(QString(DATA_DIR) + DATA_TRACK_1, QString(DATA_DIR) + "watcher_outside/" + DATA_TRACK_1);
+    QDir().rename(QString(DATA_DIR) + "watcher_outside", QString(WATCH_DIR) + "moved_in");
+    changed.clear();
+    while ((changed.contains(root + "/moved_in/" + DATA_TRACK_1) == false) &&
+           ((spy.count() > 0) || (spy.wait(WAIT_MSEC) == true)))
+    {
+        // Files of the directory can be reported after the directory itself.
+        changed += spy.takeFirst().at(0).toStringList();
+    }
+    QVERIFY2(changed.contains(root + "/moved_in") == true,                  "moved directory");
+    QVERIFY2(changed.contains(root + "/moved_in/" + DATA_TRACK_1) == true,  "file of moved directory");
+
+    // Delete a directory.
+    spy.clear();
+    QDir(QString(WATCH_DIR) + "moved_in").removeRecursively();
+    QVERIFY2(spy.wait(WAIT_MSEC) == true, "deleted directory reported");
+    QVERIFY2(spy.at(0).at(1).toStringList().contains(root + "/moved_in") == true, "directory removed");
+
+    watcher.stop();
+}
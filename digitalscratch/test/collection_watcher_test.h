@@ -0,0 +1,18 @@
+#include <QObject>
+#include <QtTest>
+
+#include "tracks/collection_watcher.h"
+
+class Collection_watcher_Test : public QObject
+{
+    Q_OBJECT
+
+public:
+    Collection_watcher_Test();
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testCaseWatch();
+};
@@ -1,10 +1,14 @@
 #include <QtTest>
 #include <QDesktopServices>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QStandardPaths>
 #include "data_persistence_test.h"
 #include "singleton.h"
 #include "utils.h"
 #include "tracks/audio_file_decoding_process.h"
 #include "tracks/data_persistence.h"
+#include "tracks/data_persistence_worker.h"
 
 #define DATA_DIR     "./test/data/"
 #define DATA_TRACK_1 "track_1.mp3"
@@ -65,6 +69,9 @@ void Data_persistence_Test::testCaseGetAudioTrack()
     at->set_fullpath(fullpath);
     at->set_hash(Utils::get_file_hash(fullpath));
     at->set_music_key("A1");
+    at->set_bpm(128.5);
+    at->set_first_beat(250);
+    at->set_loudness(-9.5);
     QVERIFY2(data_persist->store_audio_track(at) == true, "audio track store");
 
     // Get this audio track.
@@ -74,6 +81,27 @@ void Data_persistence_Test::testCaseGetAudioTrack()
     QVERIFY2(at_from_db->get_path()      == at->get_path(),      "path from DB");
     QVERIFY2(at_from_db->get_filename()  == at->get_filename(),  "filename from DB");
     QVERIFY2(at_from_db->get_music_key() == at->get_music_key(), "key from DB");
+    QVERIFY2(at_from_db->get_bpm()        == 128.5f,             "bpm from DB");
+    QVERIFY2(at_from_db->get_first_beat() == 250,                "first beat from DB");
+    QVERIFY2(at_from_db->get_loudness()   == -9.5f,              "loudness from DB");
+
+    // Storing the track without bpm keeps the stored one.
+    at->set_bpm(0.0);
+    at->set_loudness(0.0);
+    QVERIFY2(data_persist->store_audio_track(at) == true,       "audio track store without bpm");
+    QVERIFY2(data_persist->get_audio_track(at_from_db) == true, "get audio track again");
+    QVERIFY2(at_from_db->get_bpm() == 128.5f,                   "bpm kept in DB");
+    QVERIFY2(at_from_db->get_loudness() == -9.5f,               "loudness kept in DB");
+
+    // An analysis can find a bpm of 0, the track is still marked as analyzed.
+    at->set_analyzed(true);
+    QVERIFY2(data_persist->store_audio_track(at) == true,       "audio track store analyzed");
+    QVERIFY2(data_persist->get_audio_track(at_from_db) == true, "get analyzed audio track");
+    QVERIFY2(at_from_db->is_analyzed() == true,                 "analyzed from DB");
+    at->set_analyzed(false);
+    QVERIFY2(data_persist->store_audio_track(at) == true,       "audio track store not analyzed");
+    QVERIFY2(data_persist->get_audio_track(at_from_db) == true, "get audio track once more");
+    QVERIFY2(at_from_db->is_analyzed() == true,                 "analyzed kept in DB");
 
     // Get not exising audio track.
     at_from_db->reset();
@@ -185,6 +213,109 @@ void Data_persistence_Test::testCaseStoreAndGetCuePoint()
     QVERIFY2(data_persist->get_cue_point(at, 1, position) == false, "get cue point 2");
 }
 
+void Data_persistence_Test::testCaseStoreAndGetWaveformBands()
+{
+    // Get DB instance.
+    Data_persistence *data_persist = &Singleton<Data_persistence>::get_instance();
+
+    // Precondition: a track with its hash.
+    QSharedPointer<Audio_track> at(new Audio_track(44100));
+    QString fullpath = QString(DATA_DIR) + QString(DATA_TRACK_1);
+    at->set_fullpath(fullpath);
+    at->set_hash(Utils::get_file_hash(fullpath));
+
+    // Store band energies: wrong params.
+    QSharedPointer<Audio_track> at_wrong(new Audio_track(44100));
+    QVERIFY2(data_persist->store_waveform_bands(at_wrong, QByteArray("abc")) == false, "wrong audio track");
+    QVERIFY2(data_persist->store_waveform_bands(at, QByteArray())           == false, "no band energies");
+
+    // Store, then replace band energies.
+    QVERIFY2(data_persist->store_waveform_bands(at, QByteArray("abcdef")) == true, "store band energies");
+    QVERIFY2(data_persist->store_waveform_bands(at, QByteArray("ghi"))    == true, "replace band energies");
+
+    // Get band energies.
+    QByteArray bands;
+    QVERIFY2(data_persist->get_waveform_bands(at, bands) == true, "get band energies");
+    QVERIFY2(bands == QByteArray("ghi"), "band energies from DB");
+
+    // Band energies computed at another sample rate are not used.
+    QSharedPointer<Audio_track> at_48k(new Audio_track(48000));
+    at_48k->set_hash(at->get_hash());
+    QVERIFY2(data_persist->get_waveform_bands(at_48k, bands) == false, "other sample rate");
+}
+
+void Data_persistence_Test::testCaseStoreAudioTracks()
+{
+    // Get DB instance.
+    Data_persistence *data_persist = &Singleton<Data_persistence>::get_instance();
+
+    // Precondition: 2 analyzed tracks, only the first one has band energies.
+    QSharedPointer<Audio_track> at1(new Audio_track(44100));
+    QString fullpath = QString(DATA_DIR) + QString(DATA_TRACK_1);
+    at1->set_fullpath(fullpath);
+    at1->set_hash(Utils::get_file_hash(fullpath));
+    at1->set_music_key("B1");
+    at1->set_bpm(124.0f);
+    QSharedPointer<Audio_track> at2(new Audio_track(44100));
+    fullpath = QString(DATA_DIR) + QString(DATA_TRACK_2);
+    at2->set_fullpath(fullpath);
+    at2->set_hash(Utils::get_file_hash(fullpath));
+    at2->set_music_key("B2");
+    QList<QSharedPointer<Audio_track>> tracks;
+    tracks << at1 << at2;
+    QList<QByteArray> bands;
+    bands << QByteArray("jkl") << QByteArray();
+
+    // Wrong params.
+    QSharedPointer<Audio_track> at_wrong(new Audio_track(44100));
+    QVERIFY2(data_persist->store_audio_tracks(tracks, QList<QByteArray>()) == false, "missing band energies");
+    QVERIFY2(data_persist->store_audio_tracks(QList<QSharedPointer<Audio_track>>() << at1 << at_wrong, bands) == false, "wrong audio track");
+
+    // Store both tracks in one transaction.
+    QVERIFY2(data_persist->store_audio_tracks(tracks, bands) == true, "store audio tracks");
+    QSharedPointer<Audio_track> at_from_db(new Audio_track(44100));
+    at_from_db->set_hash(at1->get_hash());
+    QVERIFY2(data_persist->get_audio_track(at_from_db) == true, "get audio track 1");
+    QVERIFY2(at_from_db->get_music_key() == "B1",  "key of track 1");
+    QVERIFY2(at_from_db->get_bpm()       == 124.0f, "bpm of track 1");
+    at_from_db->set_hash(at2->get_hash());
+    QVERIFY2(data_persist->get_audio_track(at_from_db) == true, "get audio track 2");
+    QVERIFY2(at_from_db->get_music_key() == "B2", "key of track 2");
+    QByteArray bands_from_db;
+    QVERIFY2(data_persist->get_waveform_bands(at1, bands_from_db) == true, "get band energies of track 1");
+    QVERIFY2(bands_from_db == QByteArray("jkl"), "band energies of track 1");
+}
+
+void Data_persistence_Test::testCaseGetAudioTracksData()
+{
+    // Get DB instance.
+    Data_persistence *data_persist = &Singleton<Data_persistence>::get_instance();
+
+    // Precondition: an analyzed track.
+    QSharedPointer<Audio_track> at(new Audio_track(44100));
+    QString fullpath = QString(DATA_DIR) + QString(DATA_TRACK_2);
+    at->set_fullpath(fullpath);
+    at->set_hash(Utils::get_file_hash(fullpath));
+    at->set_music_key("4A");
+    at->set_bpm(126.0f);
+    at->set_first_beat(300);
+    at->set_loudness(-8.0f);
+    at->set_analyzed(true);
+    QVERIFY2(data_persist->store_audio_track(at) == true, "store audio track");
+
+    // Get data of all tracks, by binary hash.
+    QHash<Hash_128, Audio_track_data> data;
+    Hash_128 hash;
+    QVERIFY2(data_persist->get_audio_tracks_data(data) == true, "get data of all tracks");
+    QVERIFY2(Utils::get_hash_128(at->get_hash(), hash) == true, "binary hash");
+    QVERIFY2(data.contains(hash) == true,             "track found");
+    QVERIFY2(data[hash].key        == 3,              "key of track");
+    QVERIFY2(data[hash].bpm        == 126.0f,         "bpm of track");
+    QVERIFY2(data[hash].first_beat == 300,            "first beat of track");
+    QVERIFY2(data[hash].loudness   == -8.0f,          "loudness of track");
+    QVERIFY2(data[hash].analyzed   == true,           "track analyzed");
+}
+
 void Data_persistence_Test::testCasePersistTag()
 {
     Data_persistence *data_persist = &Singleton<Data_persistence>::get_instance();
@@ -264,6 +395,12 @@ void Data_persistence_Test::testCasePersistTag()
     QVERIFY2(tags.size() == 1, "nb tags = 1");
     QVERIFY2(tags[0] == "house", "tags[0] = house");
 
+    // Get tags of all tracks.
+    QHash<QString, QStringList> tags_of_tracks;
+    QVERIFY2(data_persist->get_tags_of_tracks(tags_of_tracks) == true,    "get tags of tracks");
+    QVERIFY2(tags_of_tracks.value(at1->get_hash()) == QStringList() << "techno", "tags of track 1");
+    QVERIFY2(tags_of_tracks.value(at2->get_hash()) == QStringList() << "house",  "tags of track 2");
+
     // Get track list of a specified tag.
     QStringList tracklist;
     tracklist.clear();
@@ -295,5 +432,136 @@ void Data_persistence_Test::testCasePersistTag()
     QVERIFY2(tracklist.size() == 3, "nb house tracks = 3");
     QVERIFY2(tracklist[0] == QFileInfo(QString(DATA_DIR) + QString(DATA_TRACK_1)).absoluteFilePath(), "tracklist[0] = track_1.mp3");
     QVERIFY2(tracklist[1] == QFileInfo(QString(DATA_DIR) + QString(DATA_TRACK_2)).absoluteFilePath(), "tracklist[0] = track_2.mp3");
+
+    // Move tracks in a tag tracklist (again and again, until positions have to be spread again).
+    QSharedPointer<Audio_track> no_track;
+    QVERIFY2(data_persist->move_track_in_tag_list("dnb", at2, at1) == false, "move a track not tagged");
+    for (int i = 0; i < 40; i++)
+    {
+        QSharedPointer<Audio_track> first  = (i % 2 == 0) ? at2 : at1;
+        QSharedPointer<Audio_track> second = (i % 2 == 0) ? at1 : at2;
+        QVERIFY2(data_persist->move_track_in_tag_list("house", first, second) == true, "move a track before the other one");
+        tracklist.clear();
+        data_persist->get_tracks_from_tag("house", tracklist);
+        QVERIFY2(tracklist.size() == 3, "nb house tracks = 3");
+        QVERIFY2(tracklist[0] == QFileInfo(first->get_fullpath()).absoluteFilePath(), "moved track first");
+    }
+    QVERIFY2(data_persist->move_track_in_tag_list("house", at2, no_track) == true, "move a track to the end");
+    tracklist.clear();
+    data_persist->get_tracks_from_tag("house", tracklist);
+    QVERIFY2(tracklist.size() == 3, "nb house tracks = 3");
+    QVERIFY2(tracklist[2] == QFileInfo(at2->get_fullpath()).absoluteFilePath(), "moved track last");
 }
 
+void Data_persistence_Test::testCaseFileIdentities()
+{
+    Data_persistence *data_persist = &Singleton<Data_persistence>::get_instance();
+    QString fullpath = QFileInfo(QString(DATA_DIR) + QString(DATA_TRACK_3)).absoluteFilePath();
+    QString root     = QFileInfo(QString(DATA_DIR)).absoluteFilePath();
+
+    // Store identity of a file.
+    File_identity identity;
+    QVERIFY2(Utils::get_file_identity(fullpath, identity) == true, "get file identity");
+    QVERIFY2(identity.size == QFileInfo(fullpath).size(), "identity size");
+    identity.hash = Utils::get_file_hash(fullpath);
+    QHash<QString, File_identity> identities;
+    identities.insert(fullpath, identity);
+    QVERIFY2(data_persist->store_file_identities(identities) == true, "store file identities");
+
+    // Get identities of files under the root path.
+    QHash<QString, File_identity> cached;
+    QVERIFY2(data_persist->get_file_identities(root, cached) == true, "get file identities");
+    QVERIFY2(cached.contains(fullpath) == true, "file identity cached");
+    QVERIFY2(cached[fullpath].size  == identity.size,  "cached size");
+    QVERIFY2(cached[fullpath].mtime == identity.mtime, "cached mtime");
+    QVERIFY2(cached[fullpath].inode == identity.inode, "cached inode");
+    QVERIFY2(cached[fullpath].hash  == identity.hash,  "cached hash");
+    cached.clear();
+    QVERIFY2(data_persist->get_file_identities(root + "not_here/", cached) == true, "get file identities (other root)");
+    QVERIFY2(cached.isEmpty() == true, "no file identity under other root");
+
+    // Forget identities of a removed directory.
+    identities.clear();
+    identities.insert(root + "removed_dir/track.mp3", identity);
+    identities.insert(root + "removed_dir_2/track.mp3", identity);
+    QVERIFY2(data_persist->store_file_identities(identities) == true, "store file identities (in directories)");
+    QVERIFY2(data_persist->delete_file_identities(QStringList() << root + "removed_dir") == true, "delete file identities");
+    QVERIFY2(data_persist->get_file_identities(root, cached) == true, "get file identities after delete");
+    QVERIFY2(cached.contains(root + "removed_dir/track.mp3")   == false, "file identity deleted");
+    QVERIFY2(cached.contains(root + "removed_dir_2/track.mp3") == true,  "file identity of other directory kept");
+    QVERIFY2(cached.contains(fullpath)                         == true,  "file identity of other file kept");
+    QVERIFY2(data_persist->delete_file_identities(QStringList() << root + "removed_dir_2") == true, "delete file identities (cleanup)");
+
+    // Store a track with a legacy hash and a cue point.
+    QSharedPointer<Audio_track> at(new Audio_track(15, 44100));
+    Audio_file_decoding_process decoder(at, false);
+    decoder.run(QString(DATA_DIR) + QString(DATA_TRACK_2), "legacy_test_hash", "A2");
+    QVERIFY2(data_persist->store_audio_track(at) == true, "store legacy audio track");
+    QVERIFY2(data_persist->store_cue_point(at, 0, 1234) == true, "store legacy cue point");
+    QVERIFY2(data_persist->has_legacy_tracks() == false, "new tracks do not use the legacy hash");
+    {
+        // Mark it as stored by a previous version (as done when the DB is upgraded).
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "legacy_test");
+        db.setDatabaseName(QStandardPaths::writableLocation(QStandardPaths::DataLocation) + "/digitalscratch.sqlite");
+        QVERIFY2(db.open() == true, "open DB");
+        QSqlQuery query(db);
+        QVERIFY2(query.exec("UPDATE TRACK SET is_legacy_hash = 1 WHERE hash = 'legacy_test_hash'") == true, "mark legacy track");
+        query.finish();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("legacy_test");
+
+    // Migrate it to the new hash with the identity of its file, its data are kept.
+    identity.hash        = "new_test_hash";
+    identity.legacy_hash = "legacy_test_hash";
+    identities.clear();
+    identities.insert(root + "legacy_track.mp3", identity);
+    QVERIFY2(data_persist->store_file_identities(identities) == true, "store identities and migrate legacy hash");
+    QVERIFY2(data_persist->delete_file_identities(QStringList() << root + "legacy_track.mp3") == true, "delete file identities (cleanup)");
+    QVERIFY2(data_persist->get_audio_track(at) == false, "legacy hash not found anymore");
+    at->set_hash("new_test_hash");
+    QVERIFY2(data_persist->get_audio_track(at) == true, "track found with new hash");
+    QVERIFY2(at->get_music_key() == "A2", "migrated key");
+    unsigned int position = 0;
+    QVERIFY2(data_persist->get_cue_point(at, 0, position) == true, "migrated cue point");
+    QVERIFY2(position == 1234, "migrated cue point position");
+}
+
+void Data_persistence_Test::testCaseWorkerCuePointsAndTags()
+{
+    Data_persistence        *data_persist = &Singleton<Data_persistence>::get_instance();
+    Data_persistence_worker *worker       = &Singleton<Data_persistence_worker>::get_instance();
+
+    // Precondition: a decoded track and a tag.
+    QSharedPointer<Audio_track> at(new Audio_track(15, 44100));
+    Audio_file_decoding_process decoder(at, false);
+    QString fullpath = QString(DATA_DIR) + QString(DATA_TRACK_3);
+    decoder.run(fullpath, Utils::get_file_hash(fullpath), "B3");
+    QVERIFY2(data_persist->store_tag("worker tag") == true, "store tag");
+
+    // Queue writes, the second cue point 0 replaces the first one.
+    worker->store_audio_track(at);
+    worker->store_cue_point(at, 0, 1000);
+    worker->store_cue_point(at, 0, 2000);
+    worker->store_cue_point(at, 1, 3000);
+    worker->delete_cue_point(at, 1);
+    worker->add_tag_to_track(at, "worker tag");
+
+    // Writes are done once flushed.
+    worker->flush();
+    unsigned int position = 0;
+    QVERIFY2(data_persist->get_cue_point(at, 0, position) == true, "cue point written");
+    QVERIFY2(position == 2000, "last cue point position written");
+    QVERIFY2(data_persist->get_cue_point(at, 1, position) == false, "deleted cue point");
+
+    // Cue points and tags are loaded together, after queued writes.
+    worker->store_cue_point(at, 2, 4000);
+    QSharedPointer<Audio_track> track_data = at->get_metadata_copy();
+    QFuture<bool> future = worker->load_cue_points_and_tags(track_data);
+    future.waitForFinished();
+    QVERIFY2(future.result() == true, "load cue points and tags");
+    QVERIFY2(track_data->get_cue_point(0) == 2000, "loaded cue point 1");
+    QVERIFY2(track_data->get_cue_point(1) == 0,    "loaded deleted cue point 2");
+    QVERIFY2(track_data->get_cue_point(2) == 4000, "loaded cue point 3");
+    QVERIFY2(track_data->get_tags() == QStringList() << "worker tag", "loaded tags");
+}
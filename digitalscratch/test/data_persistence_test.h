@@ -16,5 +16,10 @@ class Data_persistence_Test : public QObject
     void testCaseGetAudioTrack();
     void testCaseStoreAndGetATCharge();
     void testCaseStoreAndGetCuePoint();
+    void testCaseStoreAndGetWaveformBands();
+    void testCaseStoreAudioTracks();
+    void testCaseGetAudioTracksData();
     void testCasePersistTag();
+    void testCaseFileIdentities();
+    void testCaseWorkerCuePointsAndTags();
 };
@@ -0,0 +1,92 @@
+#include <QtTest>
+#include <QDir>
+#include <QFile>
+#include <QMutex>
+
+#include "directory_scanner_test.h"
+#include "utils.h"
+
+#define DATA_DIR     "./test/data/"
+#define DATA_TRACK_1 "track_1.mp3"
+#define DATA_TRACK_2 "track_2.mp3"
+#define SCAN_DIR     "./test/data/scanner/"
+
+Directory_scanner_Test::Directory_scanner_Test()
+{
+}
+
+void Directory_scanner_Test::initTestCase()
+{
+    // Create a small tree: audio files in several levels, a file which is not an audio file, a hidden file and a symlink loop.
+    QDir().mkpath(QString(SCAN_DIR) + "a/b/c");
+    QDir().mkpath(QString(SCAN_DIR) + "d");
+    QFile::copy(QString(DATA_DIR) + DATA_TRACK_1, QString(SCAN_DIR) + DATA_TRACK_1);
+    QFile::copy(QString(DATA_DIR) + DATA_TRACK_1, QString(SCAN_DIR) + "a/b/c/" + DATA_TRACK_1);
+    QFile::copy(QString(DATA_DIR) + DATA_TRACK_2, QString(SCAN_DIR) + "d/TRACK_2.MP3");
+    QFile::copy(QString(DATA_DIR) + DATA_TRACK_2, QString(SCAN_DIR) + "a/.hidden.mp3");
+    QFile::copy(QString(DATA_DIR) + DATA_TRACK_2, QString(SCAN_DIR) + "a/b/not_audio.txt");
+    QFile::link(QDir(SCAN_DIR).absolutePath(), QString(SCAN_DIR) + "d/loop");
+}
+
+void Directory_scanner_Test::cleanupTestCase()
+{
+    QDir(SCAN_DIR).removeRecursively();
+}
+
+void Directory_scanner_Test::testCaseScan()
+{
+    // Scan the tree with several workers.
+    Directory_scanner scanner(Utils::audio_file_extensions, 4);
+    QMutex            mutex;
+    QStringList       paths;
+    QList<qint64>     sizes;
+    scanner.scan(QStringList() << SCAN_DIR,
+                 [&](const QVector<Scanned_file> &files)
+                 {
+                     mutex.lock();
+                     foreach (const Scanned_file &file, files)
+                     {
+                         paths << file.path;
+                         sizes << file.identity.size;
+                     }
+                     mutex.unlock();
+                 },
+                 [](){ return false; });
+
+    // Each audio file is found once (also with an upper case extension), the symlink loop is not followed twice.
+    QString root = QDir(SCAN_DIR).absolutePath();
+    QVERIFY2(paths.size() == 3,                                                "nb files");
+    QVERIFY2(paths.contains(root + "/" + DATA_TRACK_1) == true,                "track at top");
+    QVERIFY2(paths.contains(root + "/a/b/c/" + DATA_TRACK_1) == true,          "track in sub directory");
+    QVERIFY2(paths.contains(root + "/d/TRACK_2.MP3") == true,                  "upper case extension");
+
+    // Size is got while scanning.
+    for (int i = 0; i < paths.size(); i++)
+    {
+        QVERIFY2(sizes[i] == QFileInfo(paths[i]).size(), "file size");
+    }
+
+    // Nothing to scan.
+    int nb_reports = 0;
+    scanner.scan(QStringList(),
+                 [&](const QVector<Scanned_file> &){ nb_reports++; },
+                 [](){ return false; });
+    QVERIFY2(nb_reports == 0, "empty list of directories");
+}
+
+void Directory_scanner_Test::testCaseScanCanceled()
+{
+    // A canceled scan reports nothing.
+    Directory_scanner scanner(Utils::audio_file_extensions, 2);
+    QMutex            mutex;
+    int               nb_files = 0;
+    scanner.scan(QStringList() << SCAN_DIR,
+                 [&](const QVector<Scanned_file> &files)
+                 {
+                     mutex.lock();
+                     nb_files += files.size();
+                     mutex.unlock();
+                 },
+                 [](){ return true; });
+    QVERIFY2(nb_files == 0, "canceled scan");
+}
@@ -0,0 +1,19 @@
+#include <QObject>
+#include <QtTest>
+
+#include "tracks/directory_scanner.h"
+
+class Directory_scanner_Test : public QObject
+{
+    Q_OBJECT
+
+public:
+    Directory_scanner_Test();
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testCaseScan();
+    void testCaseScanCanceled();
+};
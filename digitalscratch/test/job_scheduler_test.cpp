@@ -0,0 +1,101 @@
+#include <QtTest>
+#include <QAtomicInt>
+#include <QThread>
+#include "job_scheduler_test.h"
+#include "app/job_scheduler.h"
+#include "singleton.h"
+
+#define JOB_WAIT_MSEC 5000 // Max time for the scheduler to react.
+
+Job_scheduler_Test::Job_scheduler_Test()
+{
+}
+
+void Job_scheduler_Test::initTestCase()
+{
+}
+
+void Job_scheduler_Test::cleanupTestCase()
+{
+    // Do not pause jobs of other tests.
+    Singleton<Job_scheduler>::get_instance().set_playing_check(std::function<bool()>());
+}
+
+void Job_scheduler_Test::testCasePrefetchWhileAnalysisPaused()
+{
+    Job_scheduler &scheduler = Singleton<Job_scheduler>::get_instance();
+
+    // Decks are playing: analysis is paused.
+    QSharedPointer<QAtomicInt> playing(new QAtomicInt(1));
+    scheduler.set_playing_check([playing]() { return playing->load() == 1; });
+    QTRY_VERIFY_WITH_TIMEOUT(scheduler.must_pause(Job_priority::ANALYSIS) == true, JOB_WAIT_MSEC);
+    QVERIFY2(scheduler.must_pause(Job_priority::PREFETCH) == false, "prefetch is not paused");
+
+    // Analysis jobs waiting inside their work (like decoding) hold all their threads.
+    int nb_threads = QThreadPool::globalInstance()->maxThreadCount();
+    QList<QFuture<bool>> waiting_jobs;
+    for (int i = 0; i < nb_threads; i++)
+    {
+        waiting_jobs << scheduler.run<bool>(Job_priority::ANALYSIS, [&scheduler]()
+        {
+            while (scheduler.must_pause_current_job() == true)
+            {
+                QThread::msleep(JOB_PAUSE_MSEC);
+            }
+            return true;
+        });
+    }
+
+    // A paused map does not take any thread.
+    QList<int> items;
+    for (int i = 0; i < nb_threads * 4; i++)
+    {
+        items << i;
+    }
+    QSharedPointer<QAtomicInt> nb_analyzed(new QAtomicInt(0));
+    QFuture<void> analysis = scheduler.map(Job_priority::ANALYSIS, items, [nb_analyzed](int) { nb_analyzed->ref(); });
+
+    // Prefetch still runs.
+    QFuture<int> prefetch = scheduler.run<int>(Job_priority::PREFETCH, []() { return 42; });
+    QTRY_VERIFY_WITH_TIMEOUT(prefetch.isFinished() == true, JOB_WAIT_MSEC);
+    QVERIFY2(prefetch.result() == 42,        "prefetch result");
+    QVERIFY2(nb_analyzed->load() == 0,       "analysis is paused");
+    QVERIFY2(analysis.isFinished() == false, "analysis is not finished");
+
+    // Decks stopped: analysis continues.
+    playing->store(0);
+    QTRY_VERIFY_WITH_TIMEOUT(analysis.isFinished() == true, JOB_WAIT_MSEC);
+    QVERIFY2(nb_analyzed->load() == items.size(), "all items analyzed");
+    for (QFuture<bool> &job : waiting_jobs)
+    {
+        job.waitForFinished();
+    }
+}
+
+void Job_scheduler_Test::testCaseCancelParkedMap()
+{
+    Job_scheduler &scheduler = Singleton<Job_scheduler>::get_instance();
+
+    // Decks are playing: the analysis map is parked.
+    QSharedPointer<QAtomicInt> playing(new QAtomicInt(1));
+    scheduler.set_playing_check([playing]() { return playing->load() == 1; });
+    QTRY_VERIFY_WITH_TIMEOUT(scheduler.must_pause(Job_priority::ANALYSIS) == true, JOB_WAIT_MSEC);
+    QList<int> items;
+    for (int i = 0; i < 100; i++)
+    {
+        items << i;
+    }
+    QSharedPointer<QAtomicInt> nb_analyzed(new QAtomicInt(0));
+    QFuture<void> analysis = scheduler.map(Job_priority::ANALYSIS, items, [nb_analyzed](int) { nb_analyzed->ref(); });
+    QTest::qWait(JOB_PAUSE_MSEC * 4);
+    QVERIFY2(nb_analyzed->load() == 0,       "analysis is paused");
+    QVERIFY2(analysis.isFinished() == false, "analysis is not finished");
+
+    // Canceled while the budget is still tight: waiting for it (without running the budget check) returns.
+    analysis.cancel();
+    analysis.waitForFinished();
+    QVERIFY2(analysis.isFinished() == true,  "canceled analysis finished");
+    QVERIFY2(nb_analyzed->load() == 0,       "items of canceled analysis skipped");
+    playing->store(0);
+    QTRY_VERIFY_WITH_TIMEOUT(scheduler.must_pause(Job_priority::ANALYSIS) == false, JOB_WAIT_MSEC);
+}
@@ -0,0 +1,17 @@
+#include <QObject>
+#include <QtTest>
+
+class Job_scheduler_Test : public QObject
+{
+    Q_OBJECT
+
+public:
+    Job_scheduler_Test();
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testCasePrefetchWhileAnalysisPaused();
+    void testCaseCancelParkedMap();
+};
@@ -1,16 +1,33 @@
 #include <QTextCodec>
+#include <QGuiApplication>
 #include "audio_track_test.h"
 #include "audio_file_decoding_process_test.h"
+#include "audio_sample_converter_test.h"
+#include "audio_track_peaks_test.h"
+#include "audio_track_prefetch_pool_test.h"
+#include "job_scheduler_test.h"
+#include "audio_track_bpm_process_test.h"
+#include "audio_track_key_process_test.h"
+#include "audio_track_loudness_process_test.h"
 #include "utils_test.h"
 #include "data_persistence_test.h"
 #include "playlist_persistence_test.h"
+#include "directory_scanner_test.h"
+#include "collection_watcher_test.h"
+#include "audio_collection_store_test.h"
+#include "audio_collection_search_index_test.h"
+#include "audio_collection_model_test.h"
 #include "audio_device_access_rules_test.h"
 #include "control_and_playback_process_test.h"
 
 int main(int argc, char** argv)
 {
-    // Necessary to have an event loop needed by some tests.
-    QCoreApplication app(argc, argv);
+    // Necessary to have an event loop needed by some tests (a GUI one for the collection model, which has pixmaps).
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM") == true)
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QGuiApplication app(argc, argv);
 
    // Logging settings.
    qSetMessagePattern("[%{type}] | %{category} | %{function}@%{line} | %{message}");
@@ -27,6 +44,34 @@ int main(int argc, char** argv)
       Audio_file_decoding_process_Test tc;
       status |= QTest::qExec(&tc, argc, argv);
    }
+   {
+      Audio_sample_converter_Test tc;
+      status |= QTest::qExec(&tc, argc, argv);
+   }
+   {
+      Audio_track_peaks_Test tc;
+      status |= QTest::qExec(&tc, argc, argv);
+   }
+   {
+      Audio_track_prefetch_pool_Test tc;
+      status |= QTest::qExec(&tc, argc, argv);
+   }
+   {
+      Job_scheduler_Test tc;
+      status |= QTest::qExec(&tc, argc, argv);
+   }
+   {
+      Audio_track_bpm_process_Test tc;
+      status |= QTest::qExec(&tc, argc, argv);
+   }
+   {
+      Audio_track_key_process_Test tc;
+      status |= QTest::qExec(&tc, argc, argv);
+   }
+   {
+      Audio_track_loudness_process_Test tc;
+      status |= QTest::qExec(&tc, argc, argv);
+   }
    {
       Utils_Test tc;
       status |= QTest::qExec(&tc, argc, argv);
@@ -39,6 +84,28 @@ int main(int argc, char** argv)
       Playlist_persistence_Test tc;
       status |= QTest::qExec(&tc, argc, argv);
    }
+   {
+      Directory_scanner_Test tc;
+      status |= QTest::qExec(&tc, argc, argv);
+   }
+   {
+      Audio_collection_store_Test tc;
+      status |= QTest::qExec(&tc, argc, argv);
+   }
+   {
+      Audio_collection_search_index_Test tc;
+      status |= QTest::qExec(&tc, argc, argv);
+   }
+   {
+      Audio_collection_model_Test tc;
+      status |= QTest::qExec(&tc, argc, argv);
+   }
+#ifdef __linux__
+   {
+      Collection_watcher_Test tc;
+      status |= QTest::qExec(&tc, argc, argv);
+   }
+#endif
 #ifdef ENABLE_TEST_DEVICE
    {
       Audio_device_access_rules_Test tc;
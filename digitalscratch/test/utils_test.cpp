@@ -26,18 +26,32 @@ void Utils_Test::testCaseGetFileHash()
 {
     // Get hash of test files.
     QVERIFY2(Utils::get_file_hash(QString(DATA_DIR) + QString(DATA_TRACK_1))
-              == "10f96d453a96fd08874d1940be4fbeb1", "track 1 hash");
+              == "a7a71560c459f20cd4ae28f38f3fe8d4", "track 1 hash");
 
     QVERIFY2(Utils::get_file_hash(QString(DATA_DIR) + QString(DATA_TRACK_2))
-              == "d34d5bc6792be6d1e5a70919e053cff6", "track 2 hash");
+              == "d885bf0ee1ef647d0e791e63ae0e306a", "track 2 hash");
 
     QVERIFY2(Utils::get_file_hash(QString(DATA_DIR) + QString(DATA_TRACK_3))
-              == "e5f389b7d18f81df5a6144cbaae21bb9", "track 3 hash");
+              == "c2e58dcd9b93d9249a2fb40ce6d9af79", "track 3 hash");
+
+    // Get legacy hash of test files (used to migrate DB of previous versions).
+    QVERIFY2(Utils::get_file_legacy_hash(QString(DATA_DIR) + QString(DATA_TRACK_1))
+              == "10f96d453a96fd08874d1940be4fbeb1", "track 1 legacy hash");
+
+    QVERIFY2(Utils::get_file_legacy_hash(QString(DATA_DIR) + QString(DATA_TRACK_3))
+              == "e5f389b7d18f81df5a6144cbaae21bb9", "track 3 legacy hash");
 
     // Check bad input parameters.
     QVERIFY2(Utils::get_file_hash("", 200) == "", "path does not exist, no hash");
     QVERIFY2(Utils::get_file_hash(nullptr, 200) == "", "path is null, no hash");
     QVERIFY2(Utils::get_file_hash(QString(DATA_DIR) + QString(DATA_TRACK_1), 0) == "", "nb kbytes is 0");
+
+    // Binary value of a hash.
+    Hash_128 hash;
+    QVERIFY2(Utils::get_hash_128("a7a71560c459f20cd4ae28f38f3fe8d4", hash) == true, "binary hash");
+    QVERIFY2((hash.high == 0xa7a71560c459f20cULL) && (hash.low == 0xd4ae28f38f3fe8d4ULL), "binary hash value");
+    QVERIFY2(Utils::get_hash_128("a7a71560c459f20c", hash) == false, "hash too short");
+    QVERIFY2(Utils::get_hash_128("z7a71560c459f20cd4ae28f38f3fe8d4", hash) == false, "not an hexadecimal hash");
 }
 
 void Utils_Test::testCaseGetFileHashCharge()
@@ -130,3 +144,21 @@ void Utils_Test::testCaseGetNextMusicKeys()
     QVERIFY2(prev  == "11B", "12B prev key");
     QVERIFY2(oppos == "12A", "12B oppos key");
 }
+
+void Utils_Test::testCaseCamelotIndex()
+{
+    QVERIFY2(Utils::get_camelot_index("1A")  == 0,  "1A index");
+    QVERIFY2(Utils::get_camelot_index("12A") == 11, "12A index");
+    QVERIFY2(Utils::get_camelot_index("1B")  == 12, "1B index");
+    QVERIFY2(Utils::get_camelot_index("12B") == 23, "12B index");
+    QVERIFY2(Utils::get_camelot_index("")    == CAMELOT_UNKNOWN_KEY, "empty key");
+    QVERIFY2(Utils::get_camelot_index("13A") == CAMELOT_UNKNOWN_KEY, "bad number");
+    QVERIFY2(Utils::get_camelot_index("Am")  == CAMELOT_UNKNOWN_KEY, "not a clock number");
+
+    // Back to the clock number.
+    for (qint8 i = 0; i < CAMELOT_NB_KEYS; i++)
+    {
+        QVERIFY2(Utils::get_camelot_index(Utils::get_camelot_key(i)) == i, "round trip");
+    }
+    QVERIFY2(Utils::get_camelot_key(CAMELOT_UNKNOWN_KEY) == "", "unknown key");
+}
@@ -19,4 +19,5 @@ private Q_SLOTS:
     void testCaseGetFileHashCharge();
     void testCaseGetFileMusicKey();
     void testCaseGetNextMusicKeys();
+    void testCaseCamelotIndex();
 };